@@ -60,7 +60,7 @@ configure() (
     --enable-w32threads             \
     --disable-demuxer=matroska      \
     --disable-filters               \
-    --enable-filter=scale,yadif,w3fdif,bwdif \
+    --enable-filter=scale,yadif,w3fdif,bwdif,kerndeint \
     --disable-protocol=async,cache,concat,httpproxy,icecast,md5,subfile \
     --disable-muxers                \
     --enable-muxer=spdif            \
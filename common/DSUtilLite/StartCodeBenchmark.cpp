@@ -0,0 +1,178 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "StartCodeBenchmark.h"
+#include "StartCodeScanner.h"
+#include "DShowUtil.h"
+
+#include <stdio.h>
+#include <vector>
+
+extern "C"
+{
+#include "libavutil/cpu.h"
+};
+
+// Byte-wise start code search, as reference for the optimized scanners
+static const uint8_t *find_startcode_ref(const uint8_t *p, const uint8_t *end)
+{
+    for (; end - p >= 3; p++)
+    {
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    }
+    return end;
+}
+
+// Find the positions of all start codes with the given implementation, returns the time per run in seconds
+static double ScanStartCodes(FindStartCodeFn fn, const std::vector<uint8_t> &buf, std::vector<size_t> &positions)
+{
+    const uint8_t *begin = buf.data(), *end = buf.data() + buf.size();
+
+    LARGE_INTEGER frequency, start, stop;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    for (int run = 0; run < 10; run++)
+    {
+        positions.clear();
+        for (const uint8_t *p = begin; (p = fn(p, end)) < end; p += 3)
+            positions.push_back(p - begin);
+    }
+
+    QueryPerformanceCounter(&stop);
+    return (stop.QuadPart - start.QuadPart) / (double)frequency.QuadPart / 10.0;
+}
+
+// Same with the incremental scanner, on buffers of the given size, as delivered by a demuxer
+static double ScanStartCodesIncremental(size_t chunk, const std::vector<uint8_t> &buf, std::vector<size_t> &positions)
+{
+    LARGE_INTEGER frequency, start, stop;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    for (int run = 0; run < 10; run++)
+    {
+        CStartCodeScanner scanner;
+        positions.clear();
+        for (size_t pos = 0; pos < buf.size(); pos += chunk)
+        {
+            const size_t size = min(chunk, buf.size() - pos);
+            ptrdiff_t offset;
+            for (size_t scanned = 0; (offset = scanner.Scan(buf.data() + pos + scanned, size - scanned)) >= 0;)
+            {
+                scanned += offset;
+                positions.push_back(pos + scanned - 3);
+            }
+        }
+    }
+
+    QueryPerformanceCounter(&stop);
+    return (stop.QuadPart - start.QuadPart) / (double)frequency.QuadPart / 10.0;
+}
+
+static HRESULT RunStartCodeBenchmark()
+{
+    // One second of H.264 at 24 fps, with 4 slices per frame, for typical Blu-ray and broadcast bitrates
+    static const int bitrates[] = {8, 20, 40};
+
+    // Buffer sizes for the incremental scanner, odd ones split start codes at every possible position
+    static const size_t chunks[] = {188, 4093, 65536};
+
+    static const struct
+    {
+        const wchar_t *name;
+        int flags;
+    } impls[] = {
+        {L"C", 0},
+        {L"SSE2", AV_CPU_FLAG_SSE2},
+        {L"AVX2", AV_CPU_FLAG_SSE2 | AV_CPU_FLAG_AVX2},
+    };
+
+    const int cpu = av_get_cpu_flags();
+    HRESULT hr = S_OK;
+    for (int b = 0; b < countof(bitrates); b++)
+    {
+        const size_t nal_size = (size_t)bitrates[b] * 1000000 / 8 / 24 / 4;
+        std::vector<uint8_t> buf(nal_size * 24 * 4);
+
+        // Random payload, which also contains zero bytes and stray start codes
+        srand(42);
+        for (size_t i = 0; i < buf.size(); i++)
+            buf[i] = (uint8_t)((rand() & 7) ? rand() | 0x80 : rand() & 1);
+        for (size_t i = 0; i + 4 < buf.size(); i += nal_size)
+        {
+            buf[i] = buf[i + 1] = buf[i + 2] = 0;
+            buf[i + 3] = 1;
+        }
+
+        // Odd sizes leave a remainder after the last full vector
+        buf.resize(buf.size() - b - 1);
+
+        std::vector<size_t> ref, opt;
+        const double dRefTime = ScanStartCodes(find_startcode_ref, buf, ref);
+        wprintf(L"%2d MBit/s, %Iu start codes\n", bitrates[b], ref.size());
+        wprintf(L"  %-17s %6.0f MB/s\n", L"byte-wise", buf.size() / 1000000.0 / dRefTime);
+
+        for (int i = 0; i < countof(impls); i++)
+        {
+            if ((cpu & impls[i].flags) != impls[i].flags)
+                continue;
+
+            const double dTime = ScanStartCodes(GetFindStartCode(impls[i].flags), buf, opt);
+            const bool bMatch = (opt == ref);
+            wprintf(L"  %-17s %6.0f MB/s%s\n", impls[i].name, buf.size() / 1000000.0 / dTime,
+                    bMatch ? L"" : L" -> MISMATCH");
+            if (!bMatch)
+                hr = E_FAIL;
+        }
+
+        for (int i = 0; i < countof(chunks); i++)
+        {
+            const double dTime = ScanStartCodesIncremental(chunks[i], buf, opt);
+            const bool bMatch = (opt == ref);
+            wprintf(L"  incremental %-5Iu %6.0f MB/s%s\n", chunks[i], buf.size() / 1000000.0 / dTime,
+                    bMatch ? L"" : L" -> MISMATCH");
+            if (!bMatch)
+                hr = E_FAIL;
+        }
+    }
+
+    return hr;
+}
+
+void CALLBACK RunStartCodeBenchmarkW(HWND hwnd, HINSTANCE hinst, LPWSTR lpszCmdLine, int nCmdShow)
+{
+    // rundll32 is a windowed process, report into the console it was started from
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+        AllocConsole();
+
+    FILE *fConsole = nullptr;
+    _wfreopen_s(&fConsole, L"CONOUT$", L"w", stdout);
+
+    HRESULT hr = RunStartCodeBenchmark();
+
+    if (fConsole)
+        fclose(fConsole);
+
+    // Verification failures are reported through the exit code of rundll32
+    if (FAILED(hr))
+        ExitProcess(1);
+}
@@ -0,0 +1,29 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Start code scanner benchmark
+//
+// Compares the implementations of FindStartCode and the incremental CStartCodeScanner against a byte-wise search,
+// on synthetic H.264 streams at typical Blu-ray and broadcast bitrates. The throughput is reported on the console,
+// and the exit code of rundll32 is 1 if any implementation finds different start codes.
+//
+// Usage: rundll32 LAVSplitter.ax,RunStartCodeBenchmark
+void CALLBACK RunStartCodeBenchmarkW(HWND hwnd, HINSTANCE hinst, LPWSTR lpszCmdLine, int nCmdShow);
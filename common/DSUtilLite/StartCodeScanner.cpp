@@ -0,0 +1,152 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "StartCodeScanner.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+extern "C"
+{
+#include "libavutil/cpu.h"
+};
+
+static const uint8_t *find_startcode_c(const uint8_t *p, const uint8_t *end)
+{
+    if (end - p < 3)
+        return end;
+
+    // Check the third byte first, which lets us skip ahead by up to three bytes for most data
+    const uint8_t *last = end - 2;
+    while (p < last)
+    {
+        if (p[2] > 1)
+            p += 3;
+        else if (p[1])
+            p += 2;
+        else if (p[0] || p[2] != 1)
+            p++;
+        else
+            return p;
+    }
+    return end;
+}
+
+static const uint8_t *find_startcode_sse2(const uint8_t *p, const uint8_t *end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+
+    // Compare three shifted loads, so every set bit in the mask is a verified start code
+    while (end - p >= 18)
+    {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(p + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *)(p + 2));
+
+        __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                      _mm_cmpeq_epi8(b2, one));
+        unsigned mask = (unsigned)_mm_movemask_epi8(match);
+        if (mask)
+        {
+            unsigned long idx;
+            _BitScanForward(&idx, mask);
+            return p + idx;
+        }
+        p += 16;
+    }
+    return find_startcode_c(p, end);
+}
+
+static const uint8_t *find_startcode_avx2(const uint8_t *p, const uint8_t *end)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+
+    while (end - p >= 34)
+    {
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(p + 1));
+        __m256i b2 = _mm256_loadu_si256((const __m256i *)(p + 2));
+
+        __m256i match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+                                         _mm256_cmpeq_epi8(b2, one));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(match);
+        if (mask)
+        {
+            unsigned long idx;
+            _BitScanForward(&idx, mask);
+            return p + idx;
+        }
+        p += 32;
+    }
+    return find_startcode_sse2(p, end);
+}
+
+FindStartCodeFn GetFindStartCode(int cpu)
+{
+    if (cpu & AV_CPU_FLAG_AVX2)
+        return find_startcode_avx2;
+    else if (cpu & AV_CPU_FLAG_SSE2)
+        return find_startcode_sse2;
+
+    return find_startcode_c;
+}
+
+const uint8_t *FindStartCode(const uint8_t *p, const uint8_t *end)
+{
+    static const FindStartCodeFn fn = GetFindStartCode(av_get_cpu_flags());
+    return fn(p, end);
+}
+
+ptrdiff_t CStartCodeScanner::Scan(const uint8_t *buf, size_t size)
+{
+    if (size == 0)
+        return -1;
+
+    // Check for a start code spanning the buffer boundary
+    if (m_nZeros == 2 && buf[0] == 1)
+    {
+        m_nZeros = 0;
+        return 1;
+    }
+    if (m_nZeros >= 1 && size >= 2 && buf[0] == 0 && buf[1] == 1)
+    {
+        m_nZeros = 0;
+        return 2;
+    }
+
+    const uint8_t *sc = FindStartCode(buf, buf + size);
+    if (sc < buf + size)
+    {
+        m_nZeros = 0;
+        return (sc - buf) + 3;
+    }
+
+    // Remember trailing zeros for the next buffer
+    if (size >= 2 && buf[size - 2] == 0 && buf[size - 1] == 0)
+        m_nZeros = 2;
+    else if (buf[size - 1] == 0)
+        m_nZeros = (size == 1 && m_nZeros > 0) ? 2 : 1;
+    else
+        m_nZeros = 0;
+
+    return -1;
+}
@@ -0,0 +1,75 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef const uint8_t *(*FindStartCodeFn)(const uint8_t *p, const uint8_t *end);
+
+/**
+ * Find the next start code prefix (00 00 01) in the buffer, as used by MPEG-1/2, VC-1 and Annex-B H.264/HEVC.
+ *
+ * Returns a pointer to the first byte of the prefix, or end if no complete prefix was found.
+ * The fastest available implementation (AVX2, SSE2 or scalar) is selected on first use.
+ */
+const uint8_t *FindStartCode(const uint8_t *p, const uint8_t *end);
+
+/**
+ * Get the implementation FindStartCode uses for the given AV_CPU_FLAG_* flags, for benchmarking.
+ */
+FindStartCodeFn GetFindStartCode(int cpu_flags);
+
+/**
+ * Find the next start code including the following code byte (00 00 01 xx).
+ *
+ * Returns a pointer to the first byte of the prefix, or end if no complete start code was found.
+ */
+inline const uint8_t *FindStartCodeMarker(const uint8_t *p, const uint8_t *end)
+{
+    if (end - p < 4)
+        return end;
+
+    const uint8_t *sc = FindStartCode(p, end - 1);
+    return (sc < end - 1) ? sc : end;
+}
+
+/**
+ * Incremental start code scanner, for data that is delivered in multiple buffers.
+ *
+ * Start codes that are split between two buffers are detected as well.
+ */
+class CStartCodeScanner
+{
+  public:
+    void Reset() { m_nZeros = 0; }
+
+    /**
+     * Scan the buffer for the next start code prefix, taking the end of the previous buffer into account.
+     *
+     * Returns the offset of the first byte after the 00 00 01 prefix, or -1 if none was found.
+     * The prefix can begin up to two bytes before the buffer, in the previous one.
+     * To continue scanning after a hit, call Scan again with the remainder of the buffer.
+     */
+    ptrdiff_t Scan(const uint8_t *buf, size_t size);
+
+  private:
+    int m_nZeros = 0; // number of zero bytes at the end of the previous buffer (up to 2)
+};
@@ -35,6 +35,7 @@
 #include "resource.h"
 
 #include "DeCSS/DeCSSInputPin.h"
+#include "ILAVDynamicAllocator.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4018)
@@ -1959,6 +1960,16 @@ HRESULT CLAVAudio::Receive(IMediaSample *pIn)
         bufflen = m_buff.GetCount();
     }
 
+    UpdateCopyStats(len, 0);
+
+    // Decode straight from the sample if nothing is buffered, only data that is not consumed (ie. the start of a
+    // frame continuing in the next sample) is copied into the input buffer
+    if (bufflen == 0 && m_bDynamicInputAllocator && !m_bFindDTSInPCM && !m_bMPEGAudioResync && !m_raData.deint_id &&
+        inMt.subtype != MEDIASUBTYPE_DOLBY_AC3_SPDIF)
+    {
+        return ProcessSample(pIn, pDataIn, len);
+    }
+
     // Ensure the size of the buffer doesn't overflow (its used as signed int in various places)
     if (bufflen > (INT_MAX - (DWORD)len))
     {
@@ -1970,6 +1981,7 @@ HRESULT CLAVAudio::Receive(IMediaSample *pIn)
 
     m_buff.Allocate(bufflen + len + AV_INPUT_BUFFER_PADDING_SIZE);
     m_buff.Append(pDataIn, len);
+    m_CopyStats.nCopied += len;
 
     hr = ProcessBuffer(pIn);
 
@@ -2029,6 +2041,44 @@ HRESULT CLAVAudio::ResyncMPEGAudio()
     return S_FALSE;
 }
 
+HRESULT CLAVAudio::ProcessSample(IMediaSample *pMediaSample, const BYTE *pData, int len)
+{
+    HRESULT hr = S_OK, hr2 = S_OK;
+    int consumed = 0;
+
+    if (m_avBSContext)
+        hr2 = Bitstream(pData, len, consumed, &hr);
+    else
+        hr2 = Decode(pData, len, consumed, &hr, pMediaSample);
+
+    if (FAILED(hr2))
+    {
+        DbgLog((LOG_TRACE, 10, L"Dropped invalid sample in ProcessSample"));
+        m_bQueueResync = TRUE;
+        return S_FALSE;
+    }
+    else if (FAILED(hr))
+    {
+        DbgLog((LOG_TRACE, 10, L"::ProcessSample indicates delivery failed"));
+        return hr;
+    }
+    else if (hr2 == S_FALSE)
+    {
+        hr = S_FALSE;
+    }
+
+    // Keep the remaining data for the next sample
+    consumed = max(consumed, 0);
+    if (consumed < len)
+    {
+        m_buff.Allocate(len - consumed + AV_INPUT_BUFFER_PADDING_SIZE);
+        m_buff.Append(pData + consumed, len - consumed);
+        m_CopyStats.nCopied += len - consumed;
+    }
+
+    return hr;
+}
+
 HRESULT CLAVAudio::ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF)
 {
     HRESULT hr = S_OK, hr2 = S_OK;
@@ -2225,6 +2275,58 @@ static DWORD get_lav_channel_layout(AVChannelLayout *layout)
     return (DWORD)mask;
 }
 
+static void avpacket_mediasample_free(void *opaque, uint8_t *buffer)
+{
+    IMediaSample *pSample = (IMediaSample *)opaque;
+    SafeRelease(&pSample);
+}
+
+// Reference the input sample from the packet if its data lies within the sample, so the decoder doesn't copy it
+void CLAVAudio::ReferenceInputSample(AVPacket *pkt, IMediaSample *pMediaSample)
+{
+    // Only packets that end with the sample are followed by its zeroed padding, parser output that ends within the
+    // sample is followed by the next frame
+    BYTE *pData = nullptr;
+    if (m_bDynamicInputAllocator && pMediaSample && SUCCEEDED(pMediaSample->GetPointer(&pData)) &&
+        pkt->data >= pData && pkt->data + pkt->size == pData + pMediaSample->GetActualDataLength())
+    {
+        pkt->buf = av_buffer_create(pkt->data, pkt->size, avpacket_mediasample_free, pMediaSample,
+                                    AV_BUFFER_FLAG_READONLY);
+        if (pkt->buf)
+            pMediaSample->AddRef();
+    }
+
+    // packets without a reference are copied by avcodec
+    if (!pkt->buf)
+        m_CopyStats.nCopied += pkt->size;
+}
+
+void CLAVAudio::UpdateCopyStats(int nInput, int nCopied)
+{
+    if (m_CopyStats.nSamples == 0)
+        QueryPerformanceCounter(&m_CopyStats.liStart);
+
+    m_CopyStats.nInput += nInput;
+    m_CopyStats.nCopied += nCopied;
+
+    if (++m_CopyStats.nSamples >= INPUT_COPY_STATS_INTERVAL)
+    {
+        LARGE_INTEGER liFrequency, liNow;
+        QueryPerformanceFrequency(&liFrequency);
+        QueryPerformanceCounter(&liNow);
+
+        double secs = (liNow.QuadPart - m_CopyStats.liStart.QuadPart) / (double)liFrequency.QuadPart;
+        if (secs > 0.0)
+        {
+            DbgLog((LOG_TRACE, 10, L"CLAVAudio: input %.0f kB/s, copied %.0f kB/s (%.1f%%)",
+                    m_CopyStats.nInput / secs / 1000.0, m_CopyStats.nCopied / secs / 1000.0,
+                    m_CopyStats.nInput ? m_CopyStats.nCopied * 100.0 / m_CopyStats.nInput : 0.0));
+        }
+        m_CopyStats.nInput = m_CopyStats.nCopied = 0;
+        m_CopyStats.nSamples = 0;
+    }
+}
+
 HRESULT CLAVAudio::Decode(const BYTE *pDataBuffer, int buffsize, int &consumed, HRESULT *hrDeliver,
                           IMediaSample *pMediaSample)
 {
@@ -2358,6 +2460,7 @@ HRESULT CLAVAudio::Decode(const BYTE *pDataBuffer, int buffsize, int &consumed,
                 m_pDecodePacket->dts = m_rtStartInputCache;
                 m_pDecodePacket->pts = m_rtStartInputCache;
                 m_pDecodePacket->time_base = m_pAVCtx->pkt_timebase;
+                ReferenceInputSample(m_pDecodePacket, pMediaSample);
 
                 CopyMediaSideDataFF(m_pDecodePacket, &pFFSideData);
 
@@ -2399,6 +2502,7 @@ HRESULT CLAVAudio::Decode(const BYTE *pDataBuffer, int buffsize, int &consumed,
             m_pDecodePacket->dts = m_rtStartInput;
             m_pDecodePacket->pts = m_rtStartInput;
             m_pDecodePacket->time_base = m_pAVCtx->pkt_timebase;
+            ReferenceInputSample(m_pDecodePacket, pMediaSample);
 
             CopyMediaSideDataFF(m_pDecodePacket, &pFFSideData);
 
@@ -2929,3 +3033,23 @@ HRESULT CLAVAudio::BreakConnect(PIN_DIRECTION dir)
     }
     return __super::BreakConnect(dir);
 }
+
+HRESULT CLAVAudio::StartStreaming()
+{
+    // Samples from a dynamic allocator are padded, and can be held by the decoder without starving upstream
+    m_bDynamicInputAllocator = FALSE;
+
+    IMemAllocator *pAllocator = nullptr;
+    if (SUCCEEDED(m_pInput->GetAllocator(&pAllocator)))
+    {
+        ILAVDynamicAllocator *pDynamicAllocator = nullptr;
+        if (SUCCEEDED(pAllocator->QueryInterface(&pDynamicAllocator)))
+        {
+            m_bDynamicInputAllocator = pDynamicAllocator->IsDynamicAllocator();
+        }
+        SafeRelease(&pDynamicAllocator);
+    }
+    SafeRelease(&pAllocator);
+
+    return __super::StartStreaming();
+}
@@ -45,6 +45,9 @@
 
 #define MAX_VOLUME_STAT_CHANNEL 8
 
+// Number of input samples between logging the input copy statistics
+#define INPUT_COPY_STATS_INTERVAL 1000
+
 //////////////////// End Configuration //////////////////////
 
 #define AV_CODEC_ID_PCM_SxxBE (AVCodecID)0x19001
@@ -175,6 +178,7 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     HRESULT NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, double dRate);
 
     HRESULT BreakConnect(PIN_DIRECTION Dir);
+    HRESULT StartStreaming();
 
   public:
     // Pin Configuration
@@ -205,6 +209,9 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
                                DWORD dwChannelMask, WORD wBitsPerSample = 0) const;
     HRESULT ReconnectOutput(long cbBuffer, CMediaType &mt);
     HRESULT ProcessBuffer(IMediaSample *pMediaSample, BOOL bEOF = FALSE);
+    HRESULT ProcessSample(IMediaSample *pMediaSample, const BYTE *pData, int len);
+    void ReferenceInputSample(AVPacket *pkt, IMediaSample *pMediaSample);
+    void UpdateCopyStats(int nInput, int nCopied);
     HRESULT Decode(const BYTE *p, int buffsize, int &consumed, HRESULT *hrDeliver, IMediaSample *pMediaSample);
     HRESULT DecodeReceive(HRESULT *hrDeliver);
     HRESULT PostProcess(BufferDetails *buffer);
@@ -282,6 +289,16 @@ class __declspec(uuid("E8E73B6B-4CB3-44A4-BE99-4F7BCB96E491")) CLAVAudio
     BOOL m_bUpdateTimeCache = TRUE;
 
     GrowableArray<BYTE> m_buff; // Input Buffer
+    BOOL m_bDynamicInputAllocator = FALSE;
+
+    // Input bytes, and bytes copied before reaching the decoder
+    struct
+    {
+        int64_t nInput;
+        int64_t nCopied;
+        int nSamples;
+        LARGE_INTEGER liStart;
+    } m_CopyStats{};
     LAVAudioSampleFormat m_DecodeFormat = SampleFormat_16;
     LAVAudioSampleFormat m_MixingInputFormat = SampleFormat_None;
     LAVAudioSampleFormat m_FallbackFormat = SampleFormat_None;
@@ -0,0 +1,1239 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "Benchmark.h"
+
+#include "LAVVideo.h"
+#include "Deinterlacer.h"
+#include "decoders/avcodec.h"
+#include "parsers/AnnexBConverter.h"
+#include "subtitles/LAVSubtitleConsumer.h"
+#include "subtitles/LAVSubtitleFrame.h"
+#include "version.h"
+
+#include <Psapi.h>
+#include <shellapi.h>
+#include <utility>
+#include <vector>
+
+#pragma warning(push)
+#pragma warning(disable : 4244)
+extern "C"
+{
+#include "libavformat/avformat.h"
+}
+#pragma warning(pop)
+
+// Output formats, in the order of LAVOutPixFmts
+// clang-format off
+static const struct
+{
+    LPCWSTR name;
+    LAVOutPixFmts pixfmt;
+} output_formats[] = {
+    { L"yv12",  LAVOutPixFmt_YV12  },
+    { L"nv12",  LAVOutPixFmt_NV12  },
+    { L"yuy2",  LAVOutPixFmt_YUY2  },
+    { L"uyvy",  LAVOutPixFmt_UYVY  },
+    { L"ayuv",  LAVOutPixFmt_AYUV  },
+    { L"p010",  LAVOutPixFmt_P010  },
+    { L"p210",  LAVOutPixFmt_P210  },
+    { L"y410",  LAVOutPixFmt_Y410  },
+    { L"p016",  LAVOutPixFmt_P016  },
+    { L"p216",  LAVOutPixFmt_P216  },
+    { L"y416",  LAVOutPixFmt_Y416  },
+    { L"rgb32", LAVOutPixFmt_RGB32 },
+    { L"rgb24", LAVOutPixFmt_RGB24 },
+    { L"v210",  LAVOutPixFmt_v210  },
+    { L"v410",  LAVOutPixFmt_v410  },
+    { L"yv16",  LAVOutPixFmt_YV16  },
+    { L"yv24",  LAVOutPixFmt_YV24  },
+    { L"rgb48", LAVOutPixFmt_RGB48 },
+};
+// clang-format on
+
+typedef struct BenchmarkOptions
+{
+    CStringW file;
+    CStringW out;
+    DWORD dwThreads = 0;
+    LAVOutPixFmts outputFormat = LAVOutPixFmt_None;
+    BOOL bSubtitles = FALSE;
+    ULONGLONG nMaxFrames = 0;
+    DWORD dwPreviewHeight = 0;
+    BOOL bDeinterlace = FALSE;
+    BOOL bAnnexB = FALSE;
+} BenchmarkOptions;
+
+typedef struct BenchmarkSubtitleContext
+{
+    LPWSTR name;
+    LPWSTR version;
+    bool isBitmap;
+    bool isMovable;
+} BenchmarkSubtitleContext;
+
+#define OFFSET(x) offsetof(BenchmarkSubtitleContext, x)
+// clang-format off
+static const SubRenderOption options[] = {
+  { "name",      OFFSET(name),      SROPT_TYPE_STRING, SROPT_FLAG_READONLY },
+  { "version",   OFFSET(version),   SROPT_TYPE_STRING, SROPT_FLAG_READONLY },
+  { "isBitmap",  OFFSET(isBitmap),  SROPT_TYPE_BOOL,   SROPT_FLAG_READONLY },
+  { "isMovable", OFFSET(isMovable), SROPT_TYPE_BOOL,   SROPT_FLAG_READONLY },
+  { 0 }
+};
+// clang-format on
+
+// Subtitle provider which shows the same semi-transparent bar on every frame
+class CBenchmarkSubtitleProvider
+    : public ISubRenderProvider
+    , public CSubRenderOptionsImpl
+    , public CUnknown
+{
+  public:
+    CBenchmarkSubtitleProvider(ISubRenderConsumer *pConsumer)
+        : CSubRenderOptionsImpl(::options, &context)
+        , CUnknown(L"CBenchmarkSubtitleProvider", nullptr)
+        , m_pConsumer(pConsumer)
+    {
+        ZeroMemory(&context, sizeof(context));
+        context.name = TEXT(LAV_VIDEO);
+        context.version = TEXT(LAV_VERSION_STR);
+        context.isBitmap = true;
+    }
+    ~CBenchmarkSubtitleProvider() { SafeRelease(&m_pBitmap); }
+    DECLARE_IUNKNOWN;
+    DECLARE_ISUBRENDEROPTIONS;
+
+    // ISubRenderProvider
+    STDMETHODIMP RequestFrame(REFERENCE_TIME start, REFERENCE_TIME stop, LPVOID context);
+    STDMETHODIMP Disconnect(void)
+    {
+        m_pConsumer = nullptr;
+        return S_OK;
+    }
+
+  private:
+    HRESULT CreateBitmap(SIZE videoSize);
+
+  private:
+    BenchmarkSubtitleContext context;
+    ISubRenderConsumer *m_pConsumer = nullptr;
+
+    CLAVSubRect *m_pBitmap = nullptr;
+    SIZE m_VideoSize{};
+};
+
+HRESULT CBenchmarkSubtitleProvider::CreateBitmap(SIZE videoSize)
+{
+    SafeRelease(&m_pBitmap);
+    m_VideoSize = videoSize;
+
+    // Two lines of text cover about a tenth of the height and three quarters of the width of the video
+    SIZE size = {FFALIGN(videoSize.cx * 3 / 4, 2), FFALIGN(videoSize.cy / 10, 2)};
+    if (size.cx <= 0 || size.cy <= 0)
+        return S_FALSE;
+
+    int pitch = FFALIGN(size.cx, 16);
+    BYTE *pixels = (BYTE *)CoTaskMemAlloc(pitch * size.cy * 4);
+    if (!pixels)
+        return E_OUTOFMEMORY;
+
+    // Pre-multiplied light grey at 75% opacity
+    for (int i = 0; i < pitch * size.cy; i++)
+    {
+        pixels[(i << 2) + 0] = 150;
+        pixels[(i << 2) + 1] = 150;
+        pixels[(i << 2) + 2] = 150;
+        pixels[(i << 2) + 3] = 192;
+    }
+
+    m_pBitmap = new CLAVSubRect();
+    m_pBitmap->pitch = pitch;
+    m_pBitmap->pixels = pixels;
+    m_pBitmap->freePixels = true;
+    m_pBitmap->position.x = ((videoSize.cx - size.cx) / 2) & ~1;
+    m_pBitmap->position.y = (videoSize.cy - size.cy * 2) & ~1;
+    m_pBitmap->size = size;
+    m_pBitmap->AddRef();
+
+    return S_OK;
+}
+
+STDMETHODIMP CBenchmarkSubtitleProvider::RequestFrame(REFERENCE_TIME start, REFERENCE_TIME stop, LPVOID context)
+{
+    CheckPointer(m_pConsumer, E_FAIL);
+
+    SIZE videoSize{};
+    m_pConsumer->GetSize("originalVideoSize", &videoSize);
+    if (videoSize.cx != m_VideoSize.cx || videoSize.cy != m_VideoSize.cy)
+        CreateBitmap(videoSize);
+
+    CLAVSubtitleFrame *subtitleFrame = new CLAVSubtitleFrame();
+    subtitleFrame->AddRef();
+
+    RECT outputRect;
+    ::SetRect(&outputRect, 0, 0, videoSize.cx, videoSize.cy);
+    subtitleFrame->SetOutputRect(outputRect);
+    if (m_pBitmap)
+        subtitleFrame->AddBitmap(m_pBitmap);
+
+    m_pConsumer->DeliverFrame(start, stop, context, subtitleFrame);
+    SafeRelease(&subtitleFrame);
+
+    return S_OK;
+}
+
+// Decoder callback which runs the output stages of the filter on every frame, and discards it
+class CBenchmarkCallback : public ILAVVideoCallback
+{
+  public:
+    CBenchmarkCallback(ILAVVideoSettings *pSettings, const BenchmarkOptions &options, CPipelineStats *pStats);
+    ~CBenchmarkCallback();
+
+    // ILAVVideoCallback
+    STDMETHODIMP AllocateFrame(LAVFrame **ppFrame);
+    STDMETHODIMP ReleaseFrame(LAVFrame **ppFrame);
+    STDMETHODIMP Deliver(LAVFrame *pFrame);
+    STDMETHODIMP_(LPWSTR) GetFileExtension() { return nullptr; }
+    STDMETHODIMP_(DWORD) GetDecodeFlags() { return LAV_VIDEO_DEC_FLAG_LAVSPLITTER; }
+    STDMETHODIMP_(CMediaType &) GetInputMediaType() { return m_mtInput; }
+    STDMETHODIMP GetLAVPinInfo(LAVPinInfo &info) { return E_FAIL; }
+    STDMETHODIMP_(CBasePin *) GetOutputPin() { return nullptr; }
+    STDMETHODIMP GetOutputFormat(GUID *pSubtype, LONG *pStride, REFERENCE_TIME *pAvgTimePerFrame) { return E_NOTIMPL; }
+    STDMETHODIMP DVDStripPacket(BYTE *&p, long &len) { return S_FALSE; }
+    STDMETHODIMP_(LAVFrame *) GetFlushFrame();
+    STDMETHODIMP ReleaseAllDXVAResources() { return S_OK; }
+    STDMETHODIMP_(DWORD) GetGPUDeviceIndex() { return DWORD_MAX; }
+    STDMETHODIMP_(BOOL) HasDynamicInputAllocator() { return FALSE; }
+    STDMETHODIMP SetX264Build(int nBuild)
+    {
+        m_X264Build = nBuild;
+        return S_OK;
+    }
+    STDMETHODIMP_(int) GetX264Build() { return m_X264Build; }
+    STDMETHODIMP AddParseTime(LONGLONG llTicks)
+    {
+        m_llParseTicks += llTicks;
+        return S_OK;
+    }
+
+    HRESULT SetInputMediaType(const CMediaType &mt);
+
+    ULONGLONG GetFrameCount() const { return m_nFrames; }
+    BOOL IsDecimated() const { return m_bDecimated; }
+
+    // Time spent in the callbacks since the last call, to separate it from the decoding time
+    LONGLONG TakeParseTicks() { return std::exchange(m_llParseTicks, 0); }
+    LONGLONG TakeCallbackTicks() { return std::exchange(m_llCallbackTicks, 0); }
+
+  private:
+    HRESULT ProcessSubtitles(LAVFrame *pFrame, LONGLONG *pllTicks);
+
+  private:
+    CPipelineStats *m_pStats = nullptr;
+    CMediaType m_mtInput;
+    int m_X264Build = -1;
+
+    LAVOutPixFmts m_OutputFormat = LAVOutPixFmt_None;
+    CLAVPixFmtConverter m_PixFmtConverter;
+    BYTE *m_pOutputBuffer = nullptr;
+    DWORD m_dwOutputBufferSize = 0;
+
+    CLAVSubtitleConsumer *m_SubtitleConsumer = nullptr;
+
+    ULONGLONG m_nFrames = 0;
+    BOOL m_bDecimated = FALSE;
+    LONGLONG m_llParseTicks = 0;
+    LONGLONG m_llCallbackTicks = 0;
+};
+
+CBenchmarkCallback::CBenchmarkCallback(ILAVVideoSettings *pSettings, const BenchmarkOptions &options,
+                                       CPipelineStats *pStats)
+    : m_pStats(pStats)
+    , m_OutputFormat(options.outputFormat)
+{
+    m_PixFmtConverter.SetSettings(pSettings);
+    m_PixFmtConverter.SetNumThreads(DecoderThreadBudget::GetConverterThreads());
+    if (m_OutputFormat != LAVOutPixFmt_None)
+        m_PixFmtConverter.SetOutputPixFmt(m_OutputFormat);
+
+    if (options.bSubtitles)
+    {
+        m_SubtitleConsumer = new CLAVSubtitleConsumer(nullptr);
+        m_SubtitleConsumer->AddRef();
+
+        CBenchmarkSubtitleProvider *pProvider = new CBenchmarkSubtitleProvider(m_SubtitleConsumer);
+        pProvider->AddRef();
+        m_SubtitleConsumer->Connect(pProvider);
+    }
+}
+
+CBenchmarkCallback::~CBenchmarkCallback()
+{
+    if (m_SubtitleConsumer)
+        m_SubtitleConsumer->DisconnectProvider();
+    SafeRelease(&m_SubtitleConsumer);
+
+    if (m_pOutputBuffer)
+        _aligned_free(m_pOutputBuffer);
+}
+
+HRESULT CBenchmarkCallback::SetInputMediaType(const CMediaType &mt)
+{
+    m_mtInput = mt;
+    return S_OK;
+}
+
+STDMETHODIMP CBenchmarkCallback::AllocateFrame(LAVFrame **ppFrame)
+{
+    CheckPointer(ppFrame, E_POINTER);
+
+    *ppFrame = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+    if (!*ppFrame)
+        return E_OUTOFMEMORY;
+
+    ZeroMemory(*ppFrame, sizeof(LAVFrame));
+    (*ppFrame)->bpp = 8;
+    (*ppFrame)->rtStart = AV_NOPTS_VALUE;
+    (*ppFrame)->rtStop = AV_NOPTS_VALUE;
+    (*ppFrame)->aspect_ratio = {0, 1};
+    (*ppFrame)->frame_type = '?';
+
+    return S_OK;
+}
+
+STDMETHODIMP CBenchmarkCallback::ReleaseFrame(LAVFrame **ppFrame)
+{
+    CheckPointer(ppFrame, E_POINTER);
+
+    if (*ppFrame)
+    {
+        FreeLAVFrameBuffers(*ppFrame);
+        SAFE_CO_FREE(*ppFrame);
+    }
+    return S_OK;
+}
+
+STDMETHODIMP_(LAVFrame *) CBenchmarkCallback::GetFlushFrame()
+{
+    LAVFrame *pFlushFrame = nullptr;
+    AllocateFrame(&pFlushFrame);
+    pFlushFrame->flags |= LAV_FRAME_FLAG_FLUSH;
+    pFlushFrame->rtStart = INT64_MAX;
+    pFlushFrame->rtStop = INT64_MAX;
+    return pFlushFrame;
+}
+
+HRESULT CBenchmarkCallback::ProcessSubtitles(LAVFrame *pFrame, LONGLONG *pllTicks)
+{
+    LONGLONG llStart = CPipelineStats::Now();
+    HRESULT hr = m_SubtitleConsumer->ProcessFrame(pFrame);
+    *pllTicks += CPipelineStats::Now() - llStart;
+    return hr;
+}
+
+STDMETHODIMP CBenchmarkCallback::Deliver(LAVFrame *pFrame)
+{
+    if (pFrame->flags & LAV_FRAME_FLAG_FLUSH)
+    {
+        ReleaseFrame(&pFrame);
+        return S_OK;
+    }
+
+    LONGLONG llDeliverStart = CPipelineStats::Now();
+    m_nFrames++;
+    m_bDecimated |= (pFrame->decimation > 0);
+
+    // Preview frames are decimated by the converter, subtitles are still laid out for the full size
+    const int width = AV_CEIL_RSHIFT(pFrame->width, pFrame->decimation);
+    const int height = AV_CEIL_RSHIFT(pFrame->height, pFrame->decimation);
+
+    // Blend subtitles before the conversion for YUV output, and after the conversion for RGB output, like the filter
+    const BOOL bRGBOut = (m_OutputFormat == LAVOutPixFmt_RGB32 || m_OutputFormat == LAVOutPixFmt_RGB24);
+    LONGLONG llSubtitleTicks = 0;
+    if (m_SubtitleConsumer)
+    {
+        LONGLONG llStart = CPipelineStats::Now();
+        m_SubtitleConsumer->SetVideoSize(pFrame->width, pFrame->height);
+        m_SubtitleConsumer->RequestFrame(pFrame->rtStart, pFrame->rtStop);
+        llSubtitleTicks += CPipelineStats::Now() - llStart;
+
+        if (!bRGBOut)
+            ProcessSubtitles(pFrame, &llSubtitleTicks);
+    }
+
+    if (m_OutputFormat != LAVOutPixFmt_None)
+    {
+        LONGLONG llConvertStart = CPipelineStats::Now();
+
+        m_PixFmtConverter.SetInputFmt(pFrame->sw_format, pFrame->bpp);
+        m_PixFmtConverter.SetColorProps(pFrame->ext_format, 0);
+        m_PixFmtConverter.SetDecimation(pFrame->decimation);
+
+        DWORD dwSize = m_PixFmtConverter.GetImageSize(width, height);
+        if (dwSize > m_dwOutputBufferSize)
+        {
+            if (m_pOutputBuffer)
+                _aligned_free(m_pOutputBuffer);
+            m_pOutputBuffer = (BYTE *)_aligned_malloc(dwSize, 64);
+            m_dwOutputBufferSize = m_pOutputBuffer ? dwSize : 0;
+        }
+        if (!m_pOutputBuffer)
+        {
+            ReleaseFrame(&pFrame);
+            return E_OUTOFMEMORY;
+        }
+
+        m_PixFmtConverter.Convert(pFrame->data, pFrame->stride, m_pOutputBuffer, width, height, width, height);
+        m_pStats->Add(LAVPipelineStage_Convert, CPipelineStats::Now() - llConvertStart);
+
+        if (bRGBOut && m_SubtitleConsumer)
+        {
+            FreeLAVFrameBuffers(pFrame);
+
+            LAVPixelFormat pixFmt = (m_OutputFormat == LAVOutPixFmt_RGB32) ? LAVPixFmt_RGB32 : LAVPixFmt_RGB24;
+            pFrame->data[0] = m_pOutputBuffer;
+            pFrame->stride[0] = width * ((pixFmt == LAVPixFmt_RGB32) ? 4 : 3);
+            pFrame->width = width;
+            pFrame->height = height;
+            pFrame->format = pixFmt;
+            pFrame->sw_format = pixFmt;
+            pFrame->bpp = 8;
+            pFrame->flags |= LAV_FRAME_FLAG_BUFFER_MODIFY;
+
+            ProcessSubtitles(pFrame, &llSubtitleTicks);
+        }
+    }
+    else if (bRGBOut && m_SubtitleConsumer)
+    {
+        // Complete the requested subtitle frame
+        ProcessSubtitles(pFrame, &llSubtitleTicks);
+    }
+
+    if (m_SubtitleConsumer)
+        m_pStats->Add(LAVPipelineStage_Subtitles, llSubtitleTicks);
+
+    ReleaseFrame(&pFrame);
+
+    m_llCallbackTicks += CPipelineStats::Now() - llDeliverStart;
+    return S_OK;
+}
+
+// Build the media type LAV Splitter would offer for the stream
+static HRESULT CreateStreamMediaType(const AVStream *st, CMediaType &mt)
+{
+    const AVCodecParameters *par = st->codecpar;
+
+    unsigned codec_tag = par->codec_tag;
+    if (codec_tag == 0)
+    {
+        const AVCodecTag *const tags[] = {avformat_get_riff_video_tags(), avformat_get_mov_video_tags(), nullptr};
+        codec_tag = av_codec_get_tag(tags, par->codec_id);
+    }
+
+    // AVC1 streams carry the parameter sets in the MPEG2VIDEOINFO, each with a two byte length prefix
+    BOOL bAVC1 = par->codec_id == AV_CODEC_ID_H264 && par->extradata_size >= 7 && par->extradata[0] == 1;
+    std::vector<BYTE> sequence;
+    if (bAVC1)
+    {
+        codec_tag = MAKEFOURCC('a', 'v', 'c', '1');
+
+        const uint8_t *p = par->extradata + 5;
+        const uint8_t *end = par->extradata + par->extradata_size;
+        for (int set = 0; set < 2 && p < end; set++)
+        {
+            int count = (set == 0) ? (*p++ & 0x1f) : *p++;
+            for (int i = 0; i < count && end - p >= 2; i++)
+            {
+                int len = AV_RB16(p);
+                if (end - p < 2 + len)
+                    break;
+                sequence.insert(sequence.end(), p, p + 2 + len);
+                p += 2 + len;
+            }
+        }
+    }
+
+    const BYTE *extra = bAVC1 ? sequence.data() : par->extradata;
+    const size_t extralen = bAVC1 ? sequence.size() : (par->extradata ? par->extradata_size : 0);
+
+    REFERENCE_TIME rtAvgTimePerFrame = 0;
+    if (st->avg_frame_rate.num > 0 && st->avg_frame_rate.den > 0)
+        rtAvgTimePerFrame = av_rescale(REF_SECOND_MULT, st->avg_frame_rate.den, st->avg_frame_rate.num);
+
+    AVRational dar = {par->width, par->height};
+    if (par->sample_aspect_ratio.num > 0 && par->sample_aspect_ratio.den > 0)
+        dar = av_mul_q(dar, par->sample_aspect_ratio);
+    av_reduce(&dar.num, &dar.den, dar.num, dar.den, INT_MAX);
+
+    mt.InitMediaType();
+    mt.SetType(&MEDIATYPE_Video);
+    FOURCCMap subtype(codec_tag);
+    mt.SetSubtype(&subtype);
+    mt.SetTemporalCompression(TRUE);
+
+    VIDEOINFOHEADER2 *vih2 = nullptr;
+    if (bAVC1)
+    {
+        MPEG2VIDEOINFO *mp2vi = (MPEG2VIDEOINFO *)mt.AllocFormatBuffer(sizeof(MPEG2VIDEOINFO) + (ULONG)extralen);
+        if (!mp2vi)
+            return E_OUTOFMEMORY;
+        ZeroMemory(mp2vi, sizeof(MPEG2VIDEOINFO) + extralen);
+
+        mp2vi->dwProfile = par->extradata[1];
+        mp2vi->dwLevel = par->extradata[3];
+        mp2vi->dwFlags = (par->extradata[4] & 3) + 1;
+        mp2vi->cbSequenceHeader = (DWORD)extralen;
+        memcpy(mp2vi->dwSequenceHeader, extra, extralen);
+
+        vih2 = &mp2vi->hdr;
+        mt.SetFormatType(&FORMAT_MPEG2Video);
+    }
+    else
+    {
+        vih2 = (VIDEOINFOHEADER2 *)mt.AllocFormatBuffer(sizeof(VIDEOINFOHEADER2) + (ULONG)extralen);
+        if (!vih2)
+            return E_OUTOFMEMORY;
+        ZeroMemory(vih2, sizeof(VIDEOINFOHEADER2) + extralen);
+
+        if (extralen)
+            memcpy((BYTE *)vih2 + sizeof(VIDEOINFOHEADER2), extra, extralen);
+
+        mt.SetFormatType(&FORMAT_VideoInfo2);
+    }
+
+    vih2->AvgTimePerFrame = rtAvgTimePerFrame;
+    vih2->dwPictAspectRatioX = dar.num;
+    vih2->dwPictAspectRatioY = dar.den;
+    vih2->bmiHeader.biWidth = par->width;
+    vih2->bmiHeader.biHeight = par->height;
+    vih2->bmiHeader.biPlanes = 1;
+    vih2->bmiHeader.biBitCount = (WORD)par->bits_per_coded_sample;
+    vih2->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    vih2->bmiHeader.biCompression = codec_tag;
+
+    return S_OK;
+}
+
+static void Report(FILE *fOut, const wchar_t *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vwprintf(format, args);
+    va_end(args);
+
+    if (fOut)
+    {
+        va_start(args, format);
+        vfwprintf(fOut, format, args);
+        va_end(args);
+    }
+}
+
+static HRESULT ParseOptions(LPCWSTR lpszCmdLine, BenchmarkOptions &options)
+{
+    if (!lpszCmdLine || !*lpszCmdLine)
+        return E_INVALIDARG;
+
+    int argc = 0;
+    LPWSTR *argv = CommandLineToArgvW(lpszCmdLine, &argc);
+    if (!argv)
+        return E_INVALIDARG;
+
+    HRESULT hr = S_OK;
+    for (int i = 0; i < argc && SUCCEEDED(hr); i++)
+    {
+        BOOL bHasValue = (i + 1 < argc);
+        if (_wcsicmp(argv[i], L"-threads") == 0 && bHasValue)
+        {
+            options.dwThreads = wcstoul(argv[++i], nullptr, 10);
+        }
+        else if (_wcsicmp(argv[i], L"-format") == 0 && bHasValue)
+        {
+            const WCHAR *name = argv[++i];
+            options.outputFormat = LAVOutPixFmt_None;
+            for (int j = 0; j < countof(output_formats); j++)
+            {
+                if (_wcsicmp(name, output_formats[j].name) == 0)
+                    options.outputFormat = output_formats[j].pixfmt;
+            }
+            if (options.outputFormat == LAVOutPixFmt_None)
+                hr = E_INVALIDARG;
+        }
+        else if (_wcsicmp(argv[i], L"-subtitles") == 0)
+        {
+            options.bSubtitles = TRUE;
+        }
+        else if (_wcsicmp(argv[i], L"-frames") == 0 && bHasValue)
+        {
+            options.nMaxFrames = _wcstoui64(argv[++i], nullptr, 10);
+        }
+        else if (_wcsicmp(argv[i], L"-preview") == 0 && bHasValue)
+        {
+            options.dwPreviewHeight = wcstoul(argv[++i], nullptr, 10);
+            if (options.dwPreviewHeight == 0)
+                hr = E_INVALIDARG;
+        }
+        else if (_wcsicmp(argv[i], L"-deinterlace") == 0)
+        {
+            options.bDeinterlace = TRUE;
+        }
+        else if (_wcsicmp(argv[i], L"-annexb") == 0)
+        {
+            options.bAnnexB = TRUE;
+        }
+        else if (_wcsicmp(argv[i], L"-out") == 0 && bHasValue)
+        {
+            options.out = argv[++i];
+        }
+        else if (argv[i][0] != L'-' && options.file.IsEmpty())
+        {
+            options.file = argv[i];
+        }
+        else
+        {
+            hr = E_INVALIDARG;
+        }
+    }
+    LocalFree(argv);
+
+    if (options.file.IsEmpty() && (!options.bDeinterlace || options.bAnnexB))
+        return E_INVALIDARG;
+
+    return hr;
+}
+
+// Pixel formats for the deinterlacer verification, with the planar format used for avfilter
+// clang-format off
+static const struct
+{
+    LPCWSTR name;
+    LAVPixelFormat format;
+    int bpp;
+    AVPixelFormat ff_format;
+} deint_formats[] = {
+    { L"yuv420",    LAVPixFmt_YUV420,   8,  AV_PIX_FMT_YUV420P   },
+    { L"nv12",      LAVPixFmt_NV12,     8,  AV_PIX_FMT_YUV420P   },
+    { L"yuv420p12", LAVPixFmt_YUV420bX, 12, AV_PIX_FMT_YUV420P12 },
+    { L"yuv422p10", LAVPixFmt_YUV422bX, 10, AV_PIX_FMT_YUV422P10 },
+    { L"yuv444",    LAVPixFmt_YUV444,   8,  AV_PIX_FMT_YUV444P   },
+    { L"p016",      LAVPixFmt_P016,     16, AV_PIX_FMT_YUV420P16 },
+};
+
+// Instruction sets of the filter, selected with av_force_cpu_flags
+static const struct
+{
+    LPCWSTR name;
+    int required;
+    int flags;
+} deint_cpus[] = {
+    { L"avx2", AV_CPU_FLAG_AVX2, -1 },
+    { L"sse2", AV_CPU_FLAG_SSE2, AV_CPU_FLAG_MMX | AV_CPU_FLAG_MMXEXT | AV_CPU_FLAG_SSE | AV_CPU_FLAG_SSE2 },
+    { L"c",    0,                0 },
+};
+// clang-format on
+
+// Deinterlace synthetic frames with the native deinterlacer and with the bwdif filter of avfilter, and count the
+// differing lines and timestamps
+static HRESULT CompareDeinterlacer(ILAVVideoCallback *pCallback, int f, int width, int height, size_t *pnFields,
+                                   int *pnMismatches)
+{
+    const int nFrames = 8;
+    const AVPixFmtDescriptor *ff_desc = av_pix_fmt_desc_get(deint_formats[f].ff_format);
+    const LAVPixFmtDesc desc = getPixelFormatDesc(deint_formats[f].format);
+    const int maxval = (1 << deint_formats[f].bpp) - 1;
+
+    char args[256];
+    _snprintf_s(args, sizeof(args), "video_size=%dx%d:pix_fmt=%s:time_base=1/10000000:pixel_aspect=1/1", width,
+                height, ff_desc->name);
+
+    AVFilterGraph *graph = avfilter_graph_alloc();
+    AVFilterContext *src = nullptr, *bwdif = nullptr, *sink = nullptr;
+    int ret = graph ? 0 : AVERROR(ENOMEM);
+    if (ret >= 0)
+        ret = avfilter_graph_create_filter(&src, avfilter_get_by_name("buffer"), "in", args, nullptr, graph);
+    if (ret >= 0)
+        ret = avfilter_graph_create_filter(&bwdif, avfilter_get_by_name("bwdif"), "deint",
+                                           "mode=send_field:parity=auto:deint=interlaced", nullptr, graph);
+    if (ret >= 0)
+        ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"), "out", nullptr, nullptr, graph);
+    if (ret >= 0)
+        ret = avfilter_link(src, 0, bwdif, 0);
+    if (ret >= 0)
+        ret = avfilter_link(bwdif, 0, sink, 0);
+    if (ret >= 0)
+        ret = avfilter_graph_config(graph, nullptr);
+    if (ret < 0)
+    {
+        avfilter_graph_free(&graph);
+        return E_FAIL;
+    }
+
+    CDeinterlacer deint(pCallback);
+    deint.SetFramePerField(TRUE);
+    deint.SetNumThreads(4);
+
+    // Sample of one of the three planes, the chroma of semi-planar formats is interleaved
+    auto sample = [&](LAVFrame *pFrame, int plane, int x, int y) {
+        if (desc.planes == 2 && plane > 0)
+            return pFrame->data[1] + y * pFrame->stride[1] + (2 * x + plane - 1) * desc.codedbytes;
+        return pFrame->data[plane] + y * pFrame->stride[plane] + x * desc.codedbytes;
+    };
+    auto plane_size = [&](int plane, int *w, int *h) {
+        *w = AV_CEIL_RSHIFT(width, plane ? ff_desc->log2_chroma_w : 0);
+        *h = AV_CEIL_RSHIFT(height, plane ? ff_desc->log2_chroma_h : 0);
+    };
+
+    std::vector<LAVFrame *> native;
+    std::vector<AVFrame *> reference;
+    HRESULT hr = S_OK;
+
+    srand(42);
+    for (int i = 0; i <= nFrames && SUCCEEDED(hr); i++)
+    {
+        if (i < nFrames)
+        {
+            LAVFrame *pFrame = nullptr;
+            AVFrame *in = av_frame_alloc();
+            hr = in ? pCallback->AllocateFrame(&pFrame) : E_OUTOFMEMORY;
+            if (SUCCEEDED(hr))
+            {
+                pFrame->format = pFrame->sw_format = deint_formats[f].format;
+                pFrame->bpp = deint_formats[f].bpp;
+                pFrame->width = width;
+                pFrame->height = height;
+                pFrame->rtStart = i * 400000LL;
+                pFrame->rtStop = pFrame->rtStart + 400000LL;
+                pFrame->interlaced = (i != 5); // one progressive frame in between
+                pFrame->tff = 1;
+                hr = AllocLAVFrameBuffers(pFrame);
+            }
+
+            if (SUCCEEDED(hr))
+            {
+                in->width = width;
+                in->height = height;
+                in->format = deint_formats[f].ff_format;
+                in->pts = pFrame->rtStart;
+                in->flags |= (pFrame->interlaced ? AV_FRAME_FLAG_INTERLACED : 0) | AV_FRAME_FLAG_TOP_FIELD_FIRST;
+                if (av_frame_get_buffer(in, 64) < 0)
+                    hr = E_OUTOFMEMORY;
+            }
+
+            if (FAILED(hr))
+            {
+                pCallback->ReleaseFrame(&pFrame);
+                av_frame_free(&in);
+                break;
+            }
+
+            // Moving diagonal pattern with different motion in both fields, and some noise
+            for (int plane = 0; plane < 3; plane++)
+            {
+                int w, h;
+                plane_size(plane, &w, &h);
+                for (int y = 0; y < h; y++)
+                {
+                    for (int x = 0; x < w; x++)
+                    {
+                        int v = ((x * 3 + y * 5 + i * ((y & 1) ? 7 : -11)) * (maxval / 255 + 1) + (rand() & 15)) &
+                                maxval;
+                        uint8_t *ref = in->data[plane] + y * in->linesize[plane] + x * desc.codedbytes;
+                        if (desc.codedbytes == 1)
+                            *sample(pFrame, plane, x, y) = *ref = (uint8_t)v;
+                        else
+                            *(uint16_t *)sample(pFrame, plane, x, y) = *(uint16_t *)ref = (uint16_t)v;
+                    }
+                }
+            }
+
+            hr = deint.Push(pFrame);
+            if (av_buffersrc_write_frame(src, in) < 0)
+                hr = E_FAIL;
+            av_frame_free(&in);
+        }
+        else
+        {
+            hr = deint.Drain();
+            if (av_buffersrc_write_frame(src, nullptr) < 0)
+                hr = E_FAIL;
+        }
+
+        LAVFrame *pOut = nullptr;
+        while (deint.GetFrame(&pOut) == S_OK)
+            native.push_back(pOut);
+
+        AVFrame *out = av_frame_alloc();
+        while (out && av_buffersink_get_frame(sink, out) >= 0)
+        {
+            reference.push_back(out);
+            out = av_frame_alloc();
+        }
+        av_frame_free(&out);
+    }
+
+    const AVRational tb = av_buffersink_get_time_base(sink);
+    int nMismatches = (native.size() != reference.size()) ? 1 : 0;
+    for (size_t i = 0; i < min(native.size(), reference.size()); i++)
+    {
+        LAVFrame *pFrame = native[i];
+        AVFrame *ref = reference[i];
+        for (int plane = 0; plane < 3; plane++)
+        {
+            int w, h;
+            plane_size(plane, &w, &h);
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    if (memcmp(sample(pFrame, plane, x, y),
+                               ref->data[plane] + y * ref->linesize[plane] + x * desc.codedbytes, desc.codedbytes) != 0)
+                    {
+                        nMismatches++;
+                        break;
+                    }
+                }
+            }
+        }
+        if (pFrame->rtStart != av_rescale(ref->pts, tb.num * 10000000LL, tb.den))
+            nMismatches++;
+    }
+
+    *pnFields = native.size();
+    *pnMismatches = nMismatches;
+
+    deint.Reset();
+    for (LAVFrame *pFrame : native)
+        pCallback->ReleaseFrame(&pFrame);
+    for (AVFrame *frame : reference)
+        av_frame_free(&frame);
+    avfilter_graph_free(&graph);
+
+    return hr;
+}
+
+// Verify the native deinterlacer against avfilter, for all supported instruction sets
+static HRESULT RunDeinterlacerVerification(FILE *fOut)
+{
+    // Odd sizes, to cover the edge handling, the rounding of the chroma size and the remainder of the vector loops
+    static const int widths[] = {719, 1918};
+    const int height = 481;
+
+    BenchmarkOptions defaults;
+    CBenchmarkCallback callback(nullptr, defaults, nullptr);
+
+    const int cpu = av_get_cpu_flags();
+    HRESULT hr = S_OK;
+    for (int c = 0; c < countof(deint_cpus); c++)
+    {
+        if ((cpu & deint_cpus[c].required) != deint_cpus[c].required)
+        {
+            Report(fOut, L"Deinterlacing (%s): not supported by the CPU\n", deint_cpus[c].name);
+            continue;
+        }
+
+        av_force_cpu_flags(deint_cpus[c].flags);
+        for (int f = 0; f < countof(deint_formats); f++)
+        {
+            for (int w = 0; w < countof(widths); w++)
+            {
+                size_t nFields = 0;
+                int nMismatches = 0;
+                if (FAILED(CompareDeinterlacer(&callback, f, widths[w], height, &nFields, &nMismatches)))
+                {
+                    Report(fOut, L"Deinterlacing (%s) %-9s %4dx%d: -> FAILED\n", deint_cpus[c].name,
+                           deint_formats[f].name, widths[w], height);
+                    hr = E_FAIL;
+                    continue;
+                }
+
+                Report(fOut, L"Deinterlacing (%s) %-9s %4dx%d: %Iu fields%s\n", deint_cpus[c].name,
+                       deint_formats[f].name, widths[w], height, nFields, nMismatches ? L" -> MISMATCH" : L"");
+                if (nMismatches)
+                    hr = E_FAIL;
+            }
+        }
+    }
+    av_force_cpu_flags(-1);
+
+    return hr;
+}
+
+// Time the Annex-B conversion of the video packets of the file, into the re-used buffer of the converter and into
+// a buffer allocated for every packet
+static HRESULT RunAnnexBBenchmark(const BenchmarkOptions &options, FILE *fOut)
+{
+    HRESULT hr = S_OK;
+    AVFormatContext *fmt = nullptr;
+    AVPacket *pkt = nullptr;
+    AVStream *st = nullptr;
+    const uint8_t *extra = nullptr;
+    int nNaluSize = 0;
+    std::vector<std::vector<BYTE>> packets;
+    size_t nBytes = 0;
+
+    ATL::CW2A file(options.file, CP_UTF8);
+    int ret = avformat_open_input(&fmt, file, nullptr, nullptr);
+    if (ret < 0 || (ret = avformat_find_stream_info(fmt, nullptr)) < 0)
+    {
+        Report(fOut, L"Failed to open the file (error %d)\n", ret);
+        hr = E_FAIL;
+        goto done;
+    }
+
+    ret = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (ret < 0)
+    {
+        Report(fOut, L"No video stream found\n");
+        hr = VFW_E_INVALID_MEDIA_TYPE;
+        goto done;
+    }
+    st = fmt->streams[ret];
+
+    // The NAL size length is stored in the avcC or hvcC extradata, Annex-B streams need no conversion
+    extra = st->codecpar->extradata;
+    if (st->codecpar->codec_id == AV_CODEC_ID_H264 && st->codecpar->extradata_size >= 7 && extra[0] == 1)
+        nNaluSize = (extra[4] & 3) + 1;
+    else if (st->codecpar->codec_id == AV_CODEC_ID_HEVC && st->codecpar->extradata_size >= 23 && extra[0] == 1)
+        nNaluSize = (extra[21] & 3) + 1;
+    if (!nNaluSize)
+    {
+        Report(fOut, L"The video stream (%S) is not H.264 or HEVC with NAL sizes\n",
+               avcodec_get_name(st->codecpar->codec_id));
+        hr = VFW_E_INVALID_MEDIA_TYPE;
+        goto done;
+    }
+
+    // Read the packets first, so only the conversion is timed
+    pkt = av_packet_alloc();
+    if (!pkt)
+    {
+        hr = E_OUTOFMEMORY;
+        goto done;
+    }
+    while (av_read_frame(fmt, pkt) >= 0 && (!options.nMaxFrames || packets.size() < options.nMaxFrames))
+    {
+        if (pkt->stream_index == st->index && pkt->size > 0)
+        {
+            packets.emplace_back(pkt->data, pkt->data + pkt->size);
+            nBytes += pkt->size;
+        }
+        av_packet_unref(pkt);
+    }
+
+    {
+        CAnnexBConverter converter;
+        converter.SetNALUSize(nNaluSize);
+
+        LARGE_INTEGER liFrequency, liStart, liMid, liEnd;
+        QueryPerformanceFrequency(&liFrequency);
+
+        QueryPerformanceCounter(&liStart);
+        size_t nFailed = 0;
+        for (const std::vector<BYTE> &packet : packets)
+        {
+            const BYTE *pOut = nullptr;
+            int nOutSize = 0;
+            if (FAILED(converter.ConvertPacket(&pOut, &nOutSize, packet.data(), (int)packet.size())))
+                nFailed++;
+        }
+        QueryPerformanceCounter(&liMid);
+        for (const std::vector<BYTE> &packet : packets)
+        {
+            BYTE *pOut = nullptr;
+            int nOutSize = 0;
+            converter.Convert(&pOut, &nOutSize, packet.data(), (int)packet.size());
+            av_freep(&pOut);
+        }
+        QueryPerformanceCounter(&liEnd);
+
+        const double dReuse = (liMid.QuadPart - liStart.QuadPart) / (double)liFrequency.QuadPart;
+        const double dAlloc = (liEnd.QuadPart - liMid.QuadPart) / (double)liFrequency.QuadPart;
+        const size_t nPackets = max(packets.size(), (size_t)1);
+
+        Report(fOut, L"File:      %s\n", (LPCWSTR)options.file);
+        Report(fOut, L"Stream:    %S, %d byte NAL sizes\n", avcodec_get_name(st->codecpar->codec_id), nNaluSize);
+        Report(fOut, L"Packets:   %Iu (%.1f MB), %Iu invalid\n", packets.size(), nBytes / 1000000.0, nFailed);
+        Report(fOut, L"Annex-B:   re-used buffer %.3f us per packet (%.0f MB/s)\n", dReuse * 1000000.0 / nPackets,
+               dReuse > 0 ? nBytes / 1000000.0 / dReuse : 0.0);
+        Report(fOut, L"           allocated buffer %.3f us per packet (%.0f MB/s)\n", dAlloc * 1000000.0 / nPackets,
+               dAlloc > 0 ? nBytes / 1000000.0 / dAlloc : 0.0);
+    }
+
+done:
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt);
+    return hr;
+}
+
+static HRESULT RunBenchmark(const BenchmarkOptions &options, ILAVVideoSettings *pSettings, FILE *fOut,
+                            double *pdFPS)
+{
+    HRESULT hr = S_OK;
+    AVFormatContext *fmt = nullptr;
+    AVPacket *pkt = nullptr;
+    CDecAvcodec *pDecoder = nullptr;
+    CBenchmarkCallback *pCallback = nullptr;
+    CPipelineStats stats;
+    CMediaType mt;
+    AVStream *st = nullptr;
+    LONGLONG llStart = 0, llEnd = 0;
+    LARGE_INTEGER liFrequency;
+
+    ATL::CW2A file(options.file, CP_UTF8);
+    int ret = avformat_open_input(&fmt, file, nullptr, nullptr);
+    if (ret < 0 || (ret = avformat_find_stream_info(fmt, nullptr)) < 0)
+    {
+        Report(fOut, L"Failed to open the file (error %d)\n", ret);
+        hr = E_FAIL;
+        goto done;
+    }
+
+    ret = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (ret < 0)
+    {
+        Report(fOut, L"No video stream found\n");
+        hr = VFW_E_INVALID_MEDIA_TYPE;
+        goto done;
+    }
+    st = fmt->streams[ret];
+    for (unsigned i = 0; i < fmt->nb_streams; i++)
+    {
+        if (fmt->streams[i] != st)
+            fmt->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    if (FAILED(hr = CreateStreamMediaType(st, mt)))
+        goto done;
+
+    pCallback = new CBenchmarkCallback(pSettings, options, &stats);
+    pCallback->SetInputMediaType(mt);
+
+    pDecoder = new CDecAvcodec();
+    if (FAILED(hr = pDecoder->InitInterfaces(pSettings, pCallback)) ||
+        FAILED(hr = pDecoder->InitDecoder(st->codecpar->codec_id, &mt, nullptr)))
+    {
+        Report(fOut, L"Failed to initialize the decoder for %S (hr: 0x%x)\n", avcodec_get_name(st->codecpar->codec_id),
+               hr);
+        goto done;
+    }
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+    {
+        hr = E_OUTOFMEMORY;
+        goto done;
+    }
+
+    llStart = CPipelineStats::Now();
+    for (BOOL bEOS = FALSE; !bEOS;)
+    {
+        bEOS = (options.nMaxFrames && pCallback->GetFrameCount() >= options.nMaxFrames) ||
+               av_read_frame(fmt, pkt) < 0;
+
+        if (!bEOS && pkt->stream_index != st->index)
+        {
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        LONGLONG llDecodeStart = CPipelineStats::Now();
+        if (bEOS)
+        {
+            pDecoder->EndOfStream();
+        }
+        else
+        {
+            const AVRational tb = {1, REF_SECOND_MULT};
+            REFERENCE_TIME rtStart =
+                (pkt->pts != AV_NOPTS_VALUE) ? av_rescale_q(pkt->pts, st->time_base, tb) : AV_NOPTS_VALUE;
+            REFERENCE_TIME rtStop = (rtStart != AV_NOPTS_VALUE && pkt->duration > 0)
+                                        ? rtStart + av_rescale_q(pkt->duration, st->time_base, tb)
+                                        : AV_NOPTS_VALUE;
+
+            pDecoder->Decode(pkt->data, pkt->size, rtStart, rtStop, !!(pkt->flags & AV_PKT_FLAG_KEY), FALSE, nullptr);
+            av_packet_unref(pkt);
+        }
+
+        // Frames are delivered from within the decoder, so the time of the output stages is subtracted
+        LONGLONG llParseTicks = pCallback->TakeParseTicks();
+        LONGLONG llDecodeTicks =
+            CPipelineStats::Now() - llDecodeStart - llParseTicks - pCallback->TakeCallbackTicks();
+        if (llParseTicks)
+            stats.Add(LAVPipelineStage_Parse, llParseTicks);
+        stats.Add(LAVPipelineStage_Decode, llDecodeTicks);
+    }
+    llEnd = CPipelineStats::Now();
+
+    QueryPerformanceFrequency(&liFrequency);
+    {
+        const AVCodecParameters *par = st->codecpar;
+        double dSeconds = (llEnd - llStart) / (double)liFrequency.QuadPart;
+        ULONGLONG nFrames = pCallback->GetFrameCount();
+
+        Report(fOut, L"File:      %s\n", (LPCWSTR)options.file);
+        Report(fOut, L"Stream:    %S, %dx%d, %S\n", avcodec_get_name(par->codec_id), par->width, par->height,
+               av_get_pix_fmt_name((AVPixelFormat)par->format) ? av_get_pix_fmt_name((AVPixelFormat)par->format)
+                                                               : "unknown");
+        Report(fOut, L"Threads:   %u (allotted: %d)\n", options.dwThreads, pDecoder->GetThreadAllotment());
+        Report(fOut, L"Output:    %s%s\n",
+               options.outputFormat != LAVOutPixFmt_None ? output_formats[options.outputFormat].name : L"decoder",
+               options.bSubtitles ? L", subtitles" : L"");
+        if (int nPreviewScale = pDecoder->GetPreviewScale())
+        {
+            Report(fOut, L"Preview:   %dx%d (1/%d, decimated on output: %s)\n",
+                   AV_CEIL_RSHIFT(par->width, nPreviewScale), AV_CEIL_RSHIFT(par->height, nPreviewScale),
+                   1 << nPreviewScale, pCallback->IsDecimated() ? L"yes" : L"no");
+        }
+        Report(fOut, L"Frames:    %I64u in %.3f s, %.2f fps\n", nFrames, dSeconds,
+               dSeconds > 0.0 ? nFrames / dSeconds : 0.0);
+        if (pdFPS)
+            *pdFPS = dSeconds > 0.0 ? nFrames / dSeconds : 0.0;
+
+        static const struct
+        {
+            LAVPipelineStage stage;
+            LPCWSTR name;
+        } stages[] = {{LAVPipelineStage_Parse, L"parse"},
+                      {LAVPipelineStage_Decode, L"decode"},
+                      {LAVPipelineStage_Convert, L"convert"},
+                      {LAVPipelineStage_Subtitles, L"subtitles"}};
+
+        Report(fOut, L"Stage        total (ms)   avg (ms)   max (ms)\n");
+        for (int i = 0; i < countof(stages); i++)
+        {
+            LAVPipelineStageStats stageStats;
+            stats.GetStats(stages[i].stage, &stageStats);
+            if (stageStats.nSamples == 0)
+                continue;
+
+            Report(fOut, L"%-10s %12.1f %10.3f %10.3f\n", stages[i].name, stageStats.dTotal,
+                   stageStats.dTotal / stageStats.nSamples, stageStats.dMax);
+        }
+
+        PROCESS_MEMORY_COUNTERS pmc = {sizeof(pmc)};
+        if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        {
+            Report(fOut, L"Memory:    peak working set %.1f MB, peak commit %.1f MB\n",
+                   pmc.PeakWorkingSetSize / 1048576.0, pmc.PeakPagefileUsage / 1048576.0);
+        }
+    }
+
+done:
+    SAFE_DELETE(pDecoder);
+    SAFE_DELETE(pCallback);
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt);
+
+    return hr;
+}
+
+void CALLBACK RunBenchmarkW(HWND hwnd, HINSTANCE hinst, LPWSTR lpszCmdLine, int nCmdShow)
+{
+    // rundll32 is a windowed process, report into the console it was started from
+    if (!AttachConsole(ATTACH_PARENT_PROCESS))
+        AllocConsole();
+
+    FILE *fConsole = nullptr;
+    _wfreopen_s(&fConsole, L"CONOUT$", L"w", stdout);
+
+    BenchmarkOptions options;
+    if (FAILED(ParseOptions(lpszCmdLine, options)))
+    {
+        wprintf(L"Usage: rundll32 LAVVideo.ax,RunBenchmark [-threads <n>] [-format <name>] [-subtitles] "
+                L"[-frames <n>] [-preview <height>] [-deinterlace] [-annexb] [-out <file>] [<file>]\n");
+        return;
+    }
+
+    FILE *fOut = nullptr;
+    if (!options.out.IsEmpty() && _wfopen_s(&fOut, options.out, L"w") != 0)
+    {
+        wprintf(L"Failed to open %s\n", (LPCWSTR)options.out);
+        return;
+    }
+
+    // Verification failures are reported through the exit code of rundll32
+    BOOL bFailed = FALSE;
+    if (options.bDeinterlace)
+    {
+        bFailed |= FAILED(RunDeinterlacerVerification(fOut));
+        if (!options.file.IsEmpty())
+            Report(fOut, L"\n");
+    }
+
+    // The Annex-B conversion is measured instead of decoding the file
+    if (options.bAnnexB)
+        RunAnnexBBenchmark(options, fOut);
+
+    // The filter instance only provides the settings, which are reset to the defaults for the benchmark.
+    // It is created without any references, and is destroyed by the release of the last one.
+    HRESULT hr = S_OK;
+    CUnknown *pInstance = nullptr;
+    ILAVVideoSettings *pSettings = nullptr;
+    if (!options.file.IsEmpty() && !options.bAnnexB)
+    {
+        pInstance = CreateInstance<CLAVVideo>(nullptr, &hr);
+        if (pInstance)
+            pInstance->NonDelegatingAddRef();
+        if (pInstance && SUCCEEDED(hr))
+            hr = pInstance->NonDelegatingQueryInterface(__uuidof(ILAVVideoSettings), (void **)&pSettings);
+        if (!pSettings)
+        {
+            Report(fOut, L"Creating the filter failed (hr: 0x%08x)\n", hr);
+            bFailed = TRUE;
+        }
+    }
+    if (pSettings)
+    {
+        pSettings->SetRuntimeConfig(TRUE);
+        pSettings->SetNumThreads(options.dwThreads);
+
+        if (options.dwPreviewHeight)
+        {
+            // Compare preview decoding against decoding at the full resolution
+            double dFullFPS = 0.0, dPreviewFPS = 0.0;
+            pSettings->SetPreviewHeight(0);
+            if (SUCCEEDED(RunBenchmark(options, pSettings, fOut, &dFullFPS)))
+            {
+                Report(fOut, L"\n");
+                pSettings->SetPreviewHeight(options.dwPreviewHeight);
+                if (SUCCEEDED(RunBenchmark(options, pSettings, fOut, &dPreviewFPS)) && dFullFPS > 0.0)
+                    Report(fOut, L"\nPreview:   %.2fx the frame rate of full resolution decoding\n",
+                           dPreviewFPS / dFullFPS);
+            }
+        }
+        else
+        {
+            RunBenchmark(options, pSettings, fOut, nullptr);
+        }
+    }
+    SafeRelease(&pSettings);
+    if (pInstance)
+        pInstance->NonDelegatingRelease();
+
+    if (fOut)
+        fclose(fOut);
+    if (fConsole)
+        fclose(fConsole);
+
+    if (bFailed)
+        ExitProcess(1);
+}
@@ -0,0 +1,39 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Headless decoding benchmark
+//
+// Decodes the video stream of a file with the software decoder, without a DirectShow graph. Packets are read with
+// libavformat and fed to the decoder through a stub callback, which optionally converts the frames to an output
+// pixel format and blends a synthetic subtitle on them. The frame rate, the time spent in each stage and the peak
+// memory usage are reported on the console.
+//
+// Usage: rundll32 LAVVideo.ax,RunBenchmark [options] <file>
+//   -threads <n>     number of decoding threads, 0 for automatic (default)
+//   -format <name>   convert the frames to the output format (ie. nv12, yv12, p010, rgb32)
+//   -subtitles       blend a subtitle on every frame
+//   -frames <n>      stop after n frames
+//   -preview <h>     decode at the reduced resolution for a preview of height h, and compare the frame rate
+//                    against the full resolution
+//   -deinterlace     compare the native deinterlacer against the bwdif filter of avfilter, the file is optional
+//   -annexb          time the Annex-B conversion of the packets of the file instead of decoding it (H.264 and HEVC)
+//   -out <file>      also write the report to a file
+void CALLBACK RunBenchmarkW(HWND hwnd, HINSTANCE hinst, LPWSTR lpszCmdLine, int nCmdShow);
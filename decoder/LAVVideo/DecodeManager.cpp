@@ -121,6 +121,11 @@ STDMETHODIMP CDecodeManager::CreateDecoder(const CMediaType *pmt, AVCodecID code
         (LOG_TRACE, 10, L"CDecodeThread::CreateDecoder(): Creating new decoder for codec %S", avcodec_get_name(codec)));
     HRESULT hr = S_OK;
     BOOL bWMV9 = FALSE;
+    BOOL bReused = FALSE;
+    const BOOL bSwitch = m_pDecoder != nullptr;
+
+    LARGE_INTEGER liStart;
+    QueryPerformanceCounter(&liStart);
 
     BOOL bHWDecBlackList = _wcsicmp(m_processName.c_str(), L"dllhost.exe") == 0 ||
                            _wcsicmp(m_processName.c_str(), L"explorer.exe") == 0 ||
@@ -132,6 +137,21 @@ STDMETHODIMP CDecodeManager::CreateDecoder(const CMediaType *pmt, AVCodecID code
 
     CreateSideDataCache(pSideData);
 
+    LAVHWAccel hwAccel = m_pLAVVideo->GetHWAccel();
+    const BOOL bTryHWAccel = !bHWDecBlackList && hwAccel != HWAccel_None && !m_bHWDecoderFailed && HWFORMAT_ENABLED &&
+                             HWRESOLUTION_ENABLED;
+    const BOOL bTryWMV9 =
+        m_pLAVVideo->GetUseMSWMV9Decoder() && (codec == AV_CODEC_ID_VC1 || codec == AV_CODEC_ID_WMV3) && !m_bWMV9Failed;
+
+    // Keep the software decoder if the new format is compatible, and no other decoder would be chosen for it
+    if (m_pDecoder && !m_bHWDecoder && !bTryHWAccel && !bTryWMV9 && codec == m_Codec &&
+        m_pDecoder->ReuseDecoder(codec, pmt, &m_SideDataCache) == S_OK)
+    {
+        DbgLog((LOG_TRACE, 10, L"-> Re-using the software decoder"));
+        bReused = TRUE;
+        goto done;
+    }
+
     // Try reusing the current HW decoder
     if (m_pDecoder && m_bHWDecoder && !m_bHWDecoderFailed && HWFORMAT_ENABLED && HWRESOLUTION_ENABLED)
     {
@@ -141,8 +161,7 @@ STDMETHODIMP CDecodeManager::CreateDecoder(const CMediaType *pmt, AVCodecID code
     }
     SAFE_DELETE(m_pDecoder);
 
-    LAVHWAccel hwAccel = m_pLAVVideo->GetHWAccel();
-    if (!bHWDecBlackList && hwAccel != HWAccel_None && !m_bHWDecoderFailed && HWFORMAT_ENABLED && HWRESOLUTION_ENABLED)
+    if (bTryHWAccel)
     {
         DbgLog((LOG_TRACE, 10, L"-> Trying Hardware Codec %d", hwAccel));
         m_pDecoder = CreateHWAccelDecoder(hwAccel);
@@ -185,6 +204,8 @@ softwaredec:
         goto done;
     }
 
+    m_pDecoder->SetPrerollSkip(m_bPrerollSkip);
+
 done:
     if (FAILED(hr))
     {
@@ -207,9 +228,43 @@ done:
 
     m_Codec = codec;
 
+    if (bSwitch)
+    {
+        LARGE_INTEGER liEnd, liFreq;
+        QueryPerformanceCounter(&liEnd);
+        QueryPerformanceFrequency(&liFreq);
+
+        m_SwitchStats.nSwitches++;
+        m_SwitchStats.nReused += bReused;
+        m_SwitchStats.llTicks += liEnd.QuadPart - liStart.QuadPart;
+
+        DbgLog((LOG_TRACE, 10, L"-> Format switch took %.2f ms (reused: %d, %I64u of %I64u switches reused)",
+                (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFreq.QuadPart, bReused, m_SwitchStats.nReused,
+                m_SwitchStats.nSwitches));
+    }
+
     return hr;
 }
 
+STDMETHODIMP CDecodeManager::GetFormatSwitchStats(ULONGLONG *pnSwitches, ULONGLONG *pnReused, double *pdAvgTime)
+{
+    CAutoLock decoderLock(this);
+
+    LARGE_INTEGER liFreq;
+    QueryPerformanceFrequency(&liFreq);
+
+    if (pnSwitches)
+        *pnSwitches = m_SwitchStats.nSwitches;
+    if (pnReused)
+        *pnReused = m_SwitchStats.nReused;
+    if (pdAvgTime)
+        *pdAvgTime = m_SwitchStats.nSwitches
+                         ? m_SwitchStats.llTicks * 1000.0 / liFreq.QuadPart / m_SwitchStats.nSwitches
+                         : 0.0;
+
+    return S_OK;
+}
+
 STDMETHODIMP CDecodeManager::Decode(IMediaSample *pSample)
 {
     CAutoLock decoderLock(this);
@@ -86,8 +86,22 @@ class CDecodeManager : protected CCritSec
         return m_pDecoder->GetFrameDuration();
     }
     STDMETHODIMP HasThreadSafeBuffers() { return m_pDecoder ? m_pDecoder->HasThreadSafeBuffers() : S_FALSE; }
+    STDMETHODIMP_(int) GetThreadAllotment() { return m_pDecoder ? m_pDecoder->GetThreadAllotment() : 0; }
+    STDMETHODIMP SetQualityLevel(LAVQualityLevel level)
+    {
+        return m_pDecoder ? m_pDecoder->SetQualityLevel(level) : S_FALSE;
+    }
+    STDMETHODIMP_(int) GetPreviewScale() { return m_pDecoder ? m_pDecoder->GetPreviewScale() : 0; }
+    STDMETHODIMP SetPrerollSkip(BOOL bEnabled)
+    {
+        m_bPrerollSkip = bEnabled;
+        return m_pDecoder ? m_pDecoder->SetPrerollSkip(bEnabled) : S_FALSE;
+    }
     STDMETHODIMP SetDirectOutput(BOOL bDirect) { return m_pDecoder ? m_pDecoder->SetDirectOutput(bDirect) : S_FALSE; }
 
+    // Number of format switches, how many of them kept the decoder, and the average time per switch in ms
+    STDMETHODIMP GetFormatSwitchStats(ULONGLONG *pnSwitches, ULONGLONG *pnReused, double *pdAvgTime);
+
   private:
     STDMETHODIMP CreateSideDataCache(const MediaSideDataFFMpeg *pSideData);
     void FreeSideDataCache();
@@ -105,5 +119,15 @@ class CDecodeManager : protected CCritSec
 
     BOOL m_bWMV9Failed = FALSE;
 
+    // applied to every new decoder
+    BOOL m_bPrerollSkip = FALSE;
+
+    struct
+    {
+        ULONGLONG nSwitches;
+        ULONGLONG nReused;
+        LONGLONG llTicks;
+    } m_SwitchStats{};
+
     std::wstring m_processName;
 };
@@ -0,0 +1,760 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "Deinterlacer.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <ppl.h>
+#include <vector>
+
+// Filter coefficients of bwdif, in 1/8192 units
+static const int coef_lf[2] = {4309, 213};
+static const int coef_hf[3] = {5570, 3801, 1016};
+static const int coef_sp[2] = {5077, 981};
+
+// Interpolate a line of the missing field, with the new field as the temporal reference (parity 1) or the old one
+typedef void (*FilterLineFn)(void *dst, const void *prev, const void *cur, const void *next, int w, ptrdiff_t refs,
+                             int parity, int clip_max);
+
+//////////////////////////////////////////////////////////////////////////////
+// Reference implementation, identical to the C code of bwdif
+//////////////////////////////////////////////////////////////////////////////
+
+// Spatial interpolation only, for the first and the last field of the stream
+template <typename T>
+static void filter_intra_c(T *dst, const T *cur, int w, ptrdiff_t prefs, ptrdiff_t mrefs, ptrdiff_t prefs3,
+                           ptrdiff_t mrefs3, int clip_max)
+{
+    for (int x = 0; x < w; x++)
+    {
+        int interpol = (coef_sp[0] * (cur[mrefs] + cur[prefs]) - coef_sp[1] * (cur[mrefs3] + cur[prefs3])) >> 13;
+        dst[x] = av_clip(interpol, 0, clip_max);
+        cur++;
+    }
+}
+
+// Lines close to the top and bottom edge, without the lines further away
+template <typename T>
+static void filter_edge_c(T *dst, const T *prev, const T *cur, const T *next, int w, ptrdiff_t prefs,
+                          ptrdiff_t mrefs, ptrdiff_t prefs2, ptrdiff_t mrefs2, int parity, int clip_max, int spat)
+{
+    const T *prev2 = parity ? prev : cur;
+    const T *next2 = parity ? cur : next;
+
+    for (int x = 0; x < w; x++)
+    {
+        int c = cur[mrefs];
+        int d = (prev2[0] + next2[0]) >> 1;
+        int e = cur[prefs];
+        int temporal_diff0 = FFABS(prev2[0] - next2[0]);
+        int temporal_diff1 = (FFABS(prev[mrefs] - c) + FFABS(prev[prefs] - e)) >> 1;
+        int temporal_diff2 = (FFABS(next[mrefs] - c) + FFABS(next[prefs] - e)) >> 1;
+        int diff = FFMAX3(temporal_diff0 >> 1, temporal_diff1, temporal_diff2);
+
+        if (!diff)
+        {
+            dst[x] = d;
+        }
+        else
+        {
+            if (spat)
+            {
+                int b = ((prev2[mrefs2] + next2[mrefs2]) >> 1) - c;
+                int f = ((prev2[prefs2] + next2[prefs2]) >> 1) - e;
+                int dc = d - c;
+                int de = d - e;
+                int max = FFMAX3(de, dc, FFMIN(b, f));
+                int min = FFMIN3(de, dc, FFMAX(b, f));
+                diff = FFMAX3(diff, min, -max);
+            }
+
+            int interpol = (c + e) >> 1;
+            if (interpol > d + diff)
+                interpol = d + diff;
+            else if (interpol < d - diff)
+                interpol = d - diff;
+
+            dst[x] = av_clip(interpol, 0, clip_max);
+        }
+
+        prev++;
+        cur++;
+        next++;
+        prev2++;
+        next2++;
+    }
+}
+
+template <typename T>
+static void filter_line_c(void *dst1, const void *prev1, const void *cur1, const void *next1, int w, ptrdiff_t refs,
+                          int parity, int clip_max)
+{
+    T *dst = (T *)dst1;
+    const T *prev = (const T *)prev1;
+    const T *cur = (const T *)cur1;
+    const T *next = (const T *)next1;
+    const T *prev2 = parity ? prev : cur;
+    const T *next2 = parity ? cur : next;
+
+    const ptrdiff_t prefs = refs, mrefs = -refs;
+    const ptrdiff_t prefs2 = 2 * refs, mrefs2 = -2 * refs;
+    const ptrdiff_t prefs3 = 3 * refs, mrefs3 = -3 * refs;
+    const ptrdiff_t prefs4 = 4 * refs, mrefs4 = -4 * refs;
+
+    for (int x = 0; x < w; x++)
+    {
+        int c = cur[mrefs];
+        int d = (prev2[0] + next2[0]) >> 1;
+        int e = cur[prefs];
+        int temporal_diff0 = FFABS(prev2[0] - next2[0]);
+        int temporal_diff1 = (FFABS(prev[mrefs] - c) + FFABS(prev[prefs] - e)) >> 1;
+        int temporal_diff2 = (FFABS(next[mrefs] - c) + FFABS(next[prefs] - e)) >> 1;
+        int diff = FFMAX3(temporal_diff0 >> 1, temporal_diff1, temporal_diff2);
+
+        if (!diff)
+        {
+            dst[x] = d;
+        }
+        else
+        {
+            int b = ((prev2[mrefs2] + next2[mrefs2]) >> 1) - c;
+            int f = ((prev2[prefs2] + next2[prefs2]) >> 1) - e;
+            int dc = d - c;
+            int de = d - e;
+            int max = FFMAX3(de, dc, FFMIN(b, f));
+            int min = FFMIN3(de, dc, FFMAX(b, f));
+            diff = FFMAX3(diff, min, -max);
+
+            int interpol;
+            if (FFABS(c - e) > temporal_diff0)
+            {
+                interpol = (((coef_hf[0] * (prev2[0] + next2[0]) -
+                              coef_hf[1] * (prev2[mrefs2] + next2[mrefs2] + prev2[prefs2] + next2[prefs2]) +
+                              coef_hf[2] * (prev2[mrefs4] + next2[mrefs4] + prev2[prefs4] + next2[prefs4])) >>
+                             2) +
+                            coef_lf[0] * (c + e) - coef_lf[1] * (cur[mrefs3] + cur[prefs3])) >>
+                           13;
+            }
+            else
+            {
+                interpol = (coef_sp[0] * (c + e) - coef_sp[1] * (cur[mrefs3] + cur[prefs3])) >> 13;
+            }
+
+            if (interpol > d + diff)
+                interpol = d + diff;
+            else if (interpol < d - diff)
+                interpol = d - diff;
+
+            dst[x] = av_clip(interpol, 0, clip_max);
+        }
+
+        prev++;
+        cur++;
+        next++;
+        prev2++;
+        next2++;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// SIMD implementations of the line filter
+//
+// The samples are processed as 16-bit words, which limits these to a depth of 12 bits: the sums of four samples
+// have to fit into a signed word for the multiply-add. The weighted sums are computed in 32-bit, like in C.
+// Deeper formats use the C implementation.
+//////////////////////////////////////////////////////////////////////////////
+
+#define SIMD_MAX_DEPTH 12
+
+// Two 16-bit coefficients for _mm_madd_epi16 on interleaved words
+#define COEF_PAIR(lo, hi) ((int)(((unsigned)(hi) << 16) | ((unsigned)(lo)&0xffff)))
+
+static inline __m128i load8_sse2(const uint8_t *p)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+}
+
+static inline __m128i load8_sse2(const uint16_t *p)
+{
+    return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void store8_sse2(uint8_t *p, __m128i v)
+{
+    _mm_storel_epi64((__m128i *)p, _mm_packus_epi16(v, v));
+}
+
+static inline void store8_sse2(uint16_t *p, __m128i v)
+{
+    _mm_storeu_si128((__m128i *)p, v);
+}
+
+static inline __m128i absdiff_sse2(__m128i a, __m128i b)
+{
+    return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+// ((lo * a + hi * b) >> shift) of interleaved words, packed back to words
+static inline __m128i madd_shift_sse2(__m128i a, __m128i b, __m128i coefs, int shift)
+{
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coefs);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coefs);
+    return _mm_packs_epi32(_mm_srai_epi32(lo, shift), _mm_srai_epi32(hi, shift));
+}
+
+template <typename T>
+static void filter_line_sse2(void *dst1, const void *prev1, const void *cur1, const void *next1, int w,
+                             ptrdiff_t refs, int parity, int clip_max)
+{
+    T *dst = (T *)dst1;
+    const T *prev = (const T *)prev1;
+    const T *cur = (const T *)cur1;
+    const T *next = (const T *)next1;
+    const T *prev2 = parity ? prev : cur;
+    const T *next2 = parity ? cur : next;
+
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max_val = _mm_set1_epi16((short)clip_max);
+    const __m128i hf01 = _mm_set1_epi32(COEF_PAIR(coef_hf[0], -coef_hf[1]));
+    const __m128i hf2 = _mm_set1_epi32(COEF_PAIR(coef_hf[2], 0));
+    const __m128i lf = _mm_set1_epi32(COEF_PAIR(coef_lf[0], -coef_lf[1]));
+    const __m128i sp = _mm_set1_epi32(COEF_PAIR(coef_sp[0], -coef_sp[1]));
+
+    int x = 0;
+    for (; x + 8 <= w; x += 8)
+    {
+        __m128i c = load8_sse2(cur + x - refs);
+        __m128i e = load8_sse2(cur + x + refs);
+        __m128i p2 = load8_sse2(prev2 + x);
+        __m128i n2 = load8_sse2(next2 + x);
+
+        __m128i d = _mm_srli_epi16(_mm_add_epi16(p2, n2), 1);
+        __m128i td0 = absdiff_sse2(p2, n2);
+        __m128i td1 = _mm_srli_epi16(
+            _mm_add_epi16(absdiff_sse2(load8_sse2(prev + x - refs), c), absdiff_sse2(load8_sse2(prev + x + refs), e)),
+            1);
+        __m128i td2 = _mm_srli_epi16(
+            _mm_add_epi16(absdiff_sse2(load8_sse2(next + x - refs), c), absdiff_sse2(load8_sse2(next + x + refs), e)),
+            1);
+        __m128i diff = _mm_max_epi16(_mm_max_epi16(_mm_srli_epi16(td0, 1), td1), td2);
+
+        // Spatial check, a sample without temporal difference keeps the temporal average
+        __m128i m2 = _mm_add_epi16(load8_sse2(prev2 + x - 2 * refs), load8_sse2(next2 + x - 2 * refs));
+        __m128i p2s = _mm_add_epi16(load8_sse2(prev2 + x + 2 * refs), load8_sse2(next2 + x + 2 * refs));
+        __m128i b = _mm_sub_epi16(_mm_srli_epi16(m2, 1), c);
+        __m128i f = _mm_sub_epi16(_mm_srli_epi16(p2s, 1), e);
+        __m128i dc = _mm_sub_epi16(d, c);
+        __m128i de = _mm_sub_epi16(d, e);
+        __m128i vmax = _mm_max_epi16(_mm_max_epi16(de, dc), _mm_min_epi16(b, f));
+        __m128i vmin = _mm_min_epi16(_mm_min_epi16(de, dc), _mm_max_epi16(b, f));
+        __m128i diff_sp = _mm_max_epi16(_mm_max_epi16(diff, vmin), _mm_sub_epi16(zero, vmax));
+        diff = _mm_andnot_si128(_mm_cmpeq_epi16(diff, zero), diff_sp);
+
+        // Interpolation, with the high-frequency temporal component on vertical edges
+        __m128i ce = _mm_add_epi16(c, e);
+        __m128i c3 = _mm_add_epi16(load8_sse2(cur + x - 3 * refs), load8_sse2(cur + x + 3 * refs));
+        __m128i interp_sp = madd_shift_sse2(ce, c3, sp, 13);
+
+        __m128i s0 = _mm_add_epi16(p2, n2);
+        __m128i s2 = _mm_add_epi16(m2, p2s);
+        __m128i s4 = _mm_add_epi16(_mm_add_epi16(load8_sse2(prev2 + x - 4 * refs), load8_sse2(next2 + x - 4 * refs)),
+                                   _mm_add_epi16(load8_sse2(prev2 + x + 4 * refs), load8_sse2(next2 + x + 4 * refs)));
+        __m128i hf_lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(s0, s2), hf01),
+                                      _mm_madd_epi16(_mm_unpacklo_epi16(s4, zero), hf2));
+        __m128i hf_hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(s0, s2), hf01),
+                                      _mm_madd_epi16(_mm_unpackhi_epi16(s4, zero), hf2));
+        hf_lo = _mm_add_epi32(_mm_srai_epi32(hf_lo, 2), _mm_madd_epi16(_mm_unpacklo_epi16(ce, c3), lf));
+        hf_hi = _mm_add_epi32(_mm_srai_epi32(hf_hi, 2), _mm_madd_epi16(_mm_unpackhi_epi16(ce, c3), lf));
+        __m128i interp_hf = _mm_packs_epi32(_mm_srai_epi32(hf_lo, 13), _mm_srai_epi32(hf_hi, 13));
+
+        __m128i use_hf = _mm_cmpgt_epi16(absdiff_sse2(c, e), td0);
+        __m128i interpol = _mm_or_si128(_mm_and_si128(use_hf, interp_hf), _mm_andnot_si128(use_hf, interp_sp));
+
+        interpol = _mm_min_epi16(_mm_max_epi16(interpol, _mm_sub_epi16(d, diff)), _mm_add_epi16(d, diff));
+        interpol = _mm_min_epi16(_mm_max_epi16(interpol, zero), max_val);
+
+        store8_sse2(dst + x, interpol);
+    }
+
+    if (x < w)
+        filter_line_c<T>(dst + x, prev + x, cur + x, next + x, w - x, refs, parity, clip_max);
+}
+
+static inline __m256i load16_avx2(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+}
+
+static inline __m256i load16_avx2(const uint16_t *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+
+static inline void store16_avx2(uint8_t *p, __m256i v)
+{
+    // the pack works within the 128-bit lanes, move the results of both lanes together
+    v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+    _mm_storeu_si128((__m128i *)p, _mm256_castsi256_si128(v));
+}
+
+static inline void store16_avx2(uint16_t *p, __m256i v)
+{
+    _mm256_storeu_si256((__m256i *)p, v);
+}
+
+static inline __m256i absdiff_avx2(__m256i a, __m256i b)
+{
+    return _mm256_max_epi16(_mm256_sub_epi16(a, b), _mm256_sub_epi16(b, a));
+}
+
+static inline __m256i madd_shift_avx2(__m256i a, __m256i b, __m256i coefs, int shift)
+{
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), coefs);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), coefs);
+    return _mm256_packs_epi32(_mm256_srai_epi32(lo, shift), _mm256_srai_epi32(hi, shift));
+}
+
+template <typename T>
+static void filter_line_avx2(void *dst1, const void *prev1, const void *cur1, const void *next1, int w,
+                             ptrdiff_t refs, int parity, int clip_max)
+{
+    T *dst = (T *)dst1;
+    const T *prev = (const T *)prev1;
+    const T *cur = (const T *)cur1;
+    const T *next = (const T *)next1;
+    const T *prev2 = parity ? prev : cur;
+    const T *next2 = parity ? cur : next;
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max_val = _mm256_set1_epi16((short)clip_max);
+    const __m256i hf01 = _mm256_set1_epi32(COEF_PAIR(coef_hf[0], -coef_hf[1]));
+    const __m256i hf2 = _mm256_set1_epi32(COEF_PAIR(coef_hf[2], 0));
+    const __m256i lf = _mm256_set1_epi32(COEF_PAIR(coef_lf[0], -coef_lf[1]));
+    const __m256i sp = _mm256_set1_epi32(COEF_PAIR(coef_sp[0], -coef_sp[1]));
+
+    int x = 0;
+    for (; x + 16 <= w; x += 16)
+    {
+        __m256i c = load16_avx2(cur + x - refs);
+        __m256i e = load16_avx2(cur + x + refs);
+        __m256i p2 = load16_avx2(prev2 + x);
+        __m256i n2 = load16_avx2(next2 + x);
+
+        __m256i d = _mm256_srli_epi16(_mm256_add_epi16(p2, n2), 1);
+        __m256i td0 = absdiff_avx2(p2, n2);
+        __m256i td1 = _mm256_srli_epi16(_mm256_add_epi16(absdiff_avx2(load16_avx2(prev + x - refs), c),
+                                                         absdiff_avx2(load16_avx2(prev + x + refs), e)),
+                                        1);
+        __m256i td2 = _mm256_srli_epi16(_mm256_add_epi16(absdiff_avx2(load16_avx2(next + x - refs), c),
+                                                         absdiff_avx2(load16_avx2(next + x + refs), e)),
+                                        1);
+        __m256i diff = _mm256_max_epi16(_mm256_max_epi16(_mm256_srli_epi16(td0, 1), td1), td2);
+
+        __m256i m2 = _mm256_add_epi16(load16_avx2(prev2 + x - 2 * refs), load16_avx2(next2 + x - 2 * refs));
+        __m256i p2s = _mm256_add_epi16(load16_avx2(prev2 + x + 2 * refs), load16_avx2(next2 + x + 2 * refs));
+        __m256i b = _mm256_sub_epi16(_mm256_srli_epi16(m2, 1), c);
+        __m256i f = _mm256_sub_epi16(_mm256_srli_epi16(p2s, 1), e);
+        __m256i dc = _mm256_sub_epi16(d, c);
+        __m256i de = _mm256_sub_epi16(d, e);
+        __m256i vmax = _mm256_max_epi16(_mm256_max_epi16(de, dc), _mm256_min_epi16(b, f));
+        __m256i vmin = _mm256_min_epi16(_mm256_min_epi16(de, dc), _mm256_max_epi16(b, f));
+        __m256i diff_sp = _mm256_max_epi16(_mm256_max_epi16(diff, vmin), _mm256_sub_epi16(zero, vmax));
+        diff = _mm256_andnot_si256(_mm256_cmpeq_epi16(diff, zero), diff_sp);
+
+        __m256i ce = _mm256_add_epi16(c, e);
+        __m256i c3 = _mm256_add_epi16(load16_avx2(cur + x - 3 * refs), load16_avx2(cur + x + 3 * refs));
+        __m256i interp_sp = madd_shift_avx2(ce, c3, sp, 13);
+
+        __m256i s0 = _mm256_add_epi16(p2, n2);
+        __m256i s2 = _mm256_add_epi16(m2, p2s);
+        __m256i s4 =
+            _mm256_add_epi16(_mm256_add_epi16(load16_avx2(prev2 + x - 4 * refs), load16_avx2(next2 + x - 4 * refs)),
+                             _mm256_add_epi16(load16_avx2(prev2 + x + 4 * refs), load16_avx2(next2 + x + 4 * refs)));
+        __m256i hf_lo = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(s0, s2), hf01),
+                                         _mm256_madd_epi16(_mm256_unpacklo_epi16(s4, zero), hf2));
+        __m256i hf_hi = _mm256_add_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(s0, s2), hf01),
+                                         _mm256_madd_epi16(_mm256_unpackhi_epi16(s4, zero), hf2));
+        hf_lo = _mm256_add_epi32(_mm256_srai_epi32(hf_lo, 2), _mm256_madd_epi16(_mm256_unpacklo_epi16(ce, c3), lf));
+        hf_hi = _mm256_add_epi32(_mm256_srai_epi32(hf_hi, 2), _mm256_madd_epi16(_mm256_unpackhi_epi16(ce, c3), lf));
+        __m256i interp_hf = _mm256_packs_epi32(_mm256_srai_epi32(hf_lo, 13), _mm256_srai_epi32(hf_hi, 13));
+
+        __m256i use_hf = _mm256_cmpgt_epi16(absdiff_avx2(c, e), td0);
+        __m256i interpol = _mm256_blendv_epi8(interp_sp, interp_hf, use_hf);
+
+        interpol =
+            _mm256_min_epi16(_mm256_max_epi16(interpol, _mm256_sub_epi16(d, diff)), _mm256_add_epi16(d, diff));
+        interpol = _mm256_min_epi16(_mm256_max_epi16(interpol, zero), max_val);
+
+        store16_avx2(dst + x, interpol);
+    }
+
+    if (x < w)
+        filter_line_sse2<T>(dst + x, prev + x, cur + x, next + x, w - x, refs, parity, clip_max);
+}
+
+// The flags are not cached, so the benchmark can select the SSE2 and C code with av_force_cpu_flags
+template <typename T> static FilterLineFn select_filter_line(int clip_max)
+{
+    const int cpu = av_get_cpu_flags();
+
+    if (clip_max >= (1 << SIMD_MAX_DEPTH))
+        return filter_line_c<T>;
+    if (cpu & AV_CPU_FLAG_AVX2)
+        return filter_line_avx2<T>;
+    if (cpu & AV_CPU_FLAG_SSE2)
+        return filter_line_sse2<T>;
+
+    return filter_line_c<T>;
+}
+
+// Filter the lines of one band of a plane, lines of the existing field are copied
+template <typename T>
+static void filter_band(T *dst, ptrdiff_t dstStride, const T *prev, const T *cur, const T *next, ptrdiff_t refs,
+                        int w, int h, int start, int end, int parity, int tff, int clip_max, BOOL bIntra)
+{
+    // The edge handling of bwdif measures the distance to the edge in bytes, which is kept to match it exactly
+    const int df = sizeof(T);
+    const FilterLineFn filter_line = select_filter_line<T>(clip_max);
+
+    for (int y = start; y < end; y++)
+    {
+        T *d = dst + y * dstStride;
+        const T *c = cur + y * refs;
+
+        if ((y ^ parity) & 1)
+        {
+            const T *p = prev + y * refs;
+            const T *n = next + y * refs;
+
+            if (bIntra)
+                filter_intra_c(d, c, w, (y + df) < h ? refs : -refs, y > (df - 1) ? -refs : refs,
+                               (y + 3 * df) < h ? 3 * refs : -refs, y > (3 * df - 1) ? -3 * refs : refs, clip_max);
+            else if ((y < 4) || ((y + 5) > h))
+                filter_edge_c(d, p, c, n, w, (y + df) < h ? refs : -refs, y > (df - 1) ? -refs : refs, 2 * refs,
+                              -2 * refs, parity ^ tff, clip_max, (y < 2) || ((y + 3) > h) ? 0 : 1);
+            else
+                filter_line(d, p, c, n, w, refs, parity ^ tff, clip_max);
+        }
+        else
+        {
+            memcpy(d, c, w * sizeof(T));
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+// Frame handling, equivalent to the yadif/bwdif frame logic of avfilter
+//////////////////////////////////////////////////////////////////////////////
+
+static void deint_free_frame(void *opaque, uint8_t *data)
+{
+    LAVFrame *pFrame = (LAVFrame *)opaque;
+    FreeLAVFrameBuffers(pFrame);
+    SAFE_CO_FREE(pFrame);
+}
+
+static void deint_free_ref(LAVFrame *pFrame)
+{
+    av_buffer_unref((AVBufferRef **)&pFrame->priv_data);
+}
+
+CDeinterlacer::CDeinterlacer(ILAVVideoCallback *pCallback)
+    : m_pCallback(pCallback)
+{
+}
+
+CDeinterlacer::~CDeinterlacer()
+{
+    Reset();
+}
+
+BOOL CDeinterlacer::IsFormatSupported(LAVPixelFormat format)
+{
+    switch (format)
+    {
+    case LAVPixFmt_YUV420:
+    case LAVPixFmt_YUV420bX:
+    case LAVPixFmt_YUV422:
+    case LAVPixFmt_YUV422bX:
+    case LAVPixFmt_YUV444:
+    case LAVPixFmt_YUV444bX:
+    case LAVPixFmt_NV12:
+    case LAVPixFmt_P016: return TRUE;
+    }
+    return FALSE;
+}
+
+CDeinterlacer::DeintRef CDeinterlacer::CloneRef(const DeintRef &ref)
+{
+    DeintRef clone = ref;
+    clone.buf = av_buffer_ref(ref.buf);
+    return clone;
+}
+
+void CDeinterlacer::ReleaseRef(DeintRef &ref)
+{
+    av_buffer_unref(&ref.buf);
+    ref.frame = nullptr;
+}
+
+void CDeinterlacer::ReleaseRefs()
+{
+    ReleaseRef(m_Prev);
+    ReleaseRef(m_Cur);
+    ReleaseRef(m_Next);
+    m_Field = Field_Normal;
+}
+
+void CDeinterlacer::Reset()
+{
+    ReleaseRefs();
+
+    for (LAVFrame *pFrame : m_Output)
+        deint_free_frame(pFrame, nullptr);
+    m_Output.clear();
+}
+
+HRESULT CDeinterlacer::Push(LAVFrame *pFrame)
+{
+    CheckPointer(pFrame, E_POINTER);
+    ASSERT(!pFrame->direct && IsFormatSupported(pFrame->format));
+
+    // The filter references the neighbouring frames with the same stride, a change of the layout ends the sequence
+    if (m_Next.buf)
+    {
+        LAVFrame *pLast = m_Next.frame;
+        if (pLast->format != pFrame->format || pLast->bpp != pFrame->bpp || pLast->width != pFrame->width ||
+            pLast->height != pFrame->height || memcmp(pLast->stride, pFrame->stride, sizeof(pFrame->stride)) != 0)
+        {
+            DbgLog((LOG_TRACE, 10, L"CDeinterlacer::Push(): Frame layout changed, starting a new sequence"));
+            Drain();
+        }
+    }
+
+    DeintRef ref = {};
+    ref.buf = av_buffer_create((uint8_t *)pFrame, sizeof(LAVFrame), deint_free_frame, pFrame, AV_BUFFER_FLAG_READONLY);
+    if (!ref.buf)
+    {
+        deint_free_frame(pFrame, nullptr);
+        return E_OUTOFMEMORY;
+    }
+    ref.frame = pFrame;
+    ref.rtStart = pFrame->rtStart;
+
+    return ProcessFrame(ref);
+}
+
+HRESULT CDeinterlacer::Drain()
+{
+    if (!m_Cur.buf)
+        return S_FALSE;
+
+    // The last frame is repeated as the next reference, with its timestamp extrapolated
+    DeintRef next = CloneRef(m_Next);
+    if (!next.buf)
+    {
+        ReleaseRefs();
+        return E_OUTOFMEMORY;
+    }
+    if (m_Next.rtStart != AV_NOPTS_VALUE && m_Cur.rtStart != AV_NOPTS_VALUE)
+        next.rtStart = m_Next.rtStart * 2 - m_Cur.rtStart;
+
+    m_Field = Field_BackEnd;
+    HRESULT hr = ProcessFrame(next);
+
+    ReleaseRefs();
+    return hr;
+}
+
+HRESULT CDeinterlacer::GetFrame(LAVFrame **ppFrame)
+{
+    CheckPointer(ppFrame, E_POINTER);
+
+    if (m_Output.empty())
+        return S_FALSE;
+
+    *ppFrame = m_Output.front();
+    m_Output.pop_front();
+    return S_OK;
+}
+
+HRESULT CDeinterlacer::ProcessFrame(DeintRef next)
+{
+    ReleaseRef(m_Prev);
+    m_Prev = m_Cur;
+    m_Cur = m_Next;
+    m_Next = next;
+
+    // The first frame is its own previous frame, and its first field is interpolated spatially
+    if (!m_Cur.buf)
+    {
+        m_Cur = CloneRef(m_Next);
+        if (!m_Cur.buf)
+            return E_OUTOFMEMORY;
+        m_Field = Field_End;
+    }
+
+    // Progressive frames are passed on, with the same delay as the deinterlaced frames
+    if (!m_Cur.frame->interlaced)
+    {
+        ReleaseRef(m_Prev);
+        return OutputPassThrough();
+    }
+
+    if (!m_Prev.buf)
+    {
+        m_Prev = CloneRef(m_Cur);
+        if (!m_Prev.buf)
+            return E_OUTOFMEMORY;
+    }
+
+    const int tff = !!m_Cur.frame->tff;
+    HRESULT hr = OutputField(tff ^ 1, tff, FALSE);
+    if (SUCCEEDED(hr) && m_bFramePerField)
+    {
+        if (m_Field == Field_BackEnd)
+            m_Field = Field_End;
+        hr = OutputField(tff, tff, TRUE);
+    }
+
+    return hr;
+}
+
+HRESULT CDeinterlacer::OutputPassThrough()
+{
+    LAVFrame *pCur = m_Cur.frame;
+    LAVFrame *pOut = nullptr;
+    HRESULT hr = m_pCallback->AllocateFrame(&pOut);
+    if (FAILED(hr))
+        return hr;
+
+    AVBufferRef *buf = av_buffer_ref(m_Cur.buf);
+    if (!buf)
+    {
+        m_pCallback->ReleaseFrame(&pOut);
+        return E_OUTOFMEMORY;
+    }
+
+    // The output shares the buffers of the reference, so it can't be modified in-place
+    *pOut = *pCur;
+    pOut->flags &= ~LAV_FRAME_FLAG_BUFFER_MODIFY;
+    pOut->side_data = nullptr;
+    pOut->side_data_count = 0;
+    pOut->rtStart = m_Cur.rtStart;
+    pOut->destruct = deint_free_ref;
+    pOut->priv_data = buf;
+
+    m_Output.push_back(pOut);
+    return S_OK;
+}
+
+HRESULT CDeinterlacer::OutputField(int parity, int tff, BOOL bSecond)
+{
+    LAVFrame *pCur = m_Cur.frame;
+    LAVFrame *pOut = nullptr;
+    HRESULT hr = m_pCallback->AllocateFrame(&pOut);
+    if (FAILED(hr))
+        return hr;
+
+    pOut->format = pCur->format;
+    pOut->sw_format = pCur->sw_format;
+    pOut->bpp = pCur->bpp;
+    pOut->width = pCur->width;
+    pOut->height = pCur->height;
+    pOut->aspect_ratio = pCur->aspect_ratio;
+    pOut->ext_format = pCur->ext_format;
+    pOut->avgFrameDuration = pCur->avgFrameDuration;
+    pOut->flags = pCur->flags & ~LAV_FRAME_FLAG_MVC;
+    pOut->decimation = pCur->decimation;
+    pOut->tff = pCur->tff;
+
+    hr = AllocLAVFrameBuffers(pOut);
+    if (FAILED(hr))
+    {
+        m_pCallback->ReleaseFrame(&pOut);
+        return hr;
+    }
+
+    REFERENCE_TIME rtDuration = pCur->rtStop - pCur->rtStart;
+    if (m_bFramePerField)
+    {
+        rtDuration >>= 1;
+        if (pOut->avgFrameDuration != AV_NOPTS_VALUE)
+            pOut->avgFrameDuration /= 2;
+    }
+
+    // The second field is placed halfway to the next frame
+    if (!bSecond)
+        pOut->rtStart = m_Cur.rtStart;
+    else if (m_Cur.rtStart != AV_NOPTS_VALUE && m_Next.rtStart != AV_NOPTS_VALUE)
+        pOut->rtStart = av_rescale(m_Cur.rtStart + m_Next.rtStart, 1, 2);
+    else
+        pOut->rtStart = AV_NOPTS_VALUE;
+    pOut->rtStop = (pOut->rtStart != AV_NOPTS_VALUE) ? pOut->rtStart + rtDuration : AV_NOPTS_VALUE;
+
+    const int nBands = min(m_NumThreads, pOut->height / 16 + 1);
+    auto filter = [&](int band) {
+        LAVPixFmtDesc desc = getPixelFormatDesc(pOut->format);
+        for (int plane = 0; plane < desc.planes; plane++)
+            FilterBand(pOut, plane, parity, tff, band, nBands);
+    };
+
+    if (nBands > 1)
+        Concurrency::parallel_for(0, nBands, filter);
+    else
+        filter(0);
+
+    if (m_Field == Field_End)
+        m_Field = Field_Normal;
+
+    m_Output.push_back(pOut);
+    return S_OK;
+}
+
+void CDeinterlacer::FilterBand(LAVFrame *pDst, int plane, int parity, int tff, int band, int nBands)
+{
+    const LAVPixFmtDesc desc = getPixelFormatDesc(pDst->format);
+
+    // Chroma dimensions are rounded up, and the interleaved U/V plane is filtered as one plane of twice the width
+    int w = (pDst->width + desc.planeWidth[plane] - 1) / desc.planeWidth[plane];
+    int h = (pDst->height + desc.planeHeight[plane] - 1) / desc.planeHeight[plane];
+    if (desc.planes == 2 && plane == 1)
+        w = FFALIGN(pDst->width, 2);
+
+    const int start = (h * band) / nBands;
+    const int end = (h * (band + 1)) / nBands;
+    const BOOL bIntra = (m_Field == Field_End);
+
+    if (desc.codedbytes == 1)
+    {
+        filter_band<uint8_t>(pDst->data[plane], pDst->stride[plane], m_Prev.frame->data[plane],
+                             m_Cur.frame->data[plane], m_Next.frame->data[plane], m_Cur.frame->stride[plane], w, h,
+                             start, end, parity, tff, 255, bIntra);
+    }
+    else
+    {
+        const int clip_max = (pDst->format == LAVPixFmt_P016) ? 0xffff : (1 << pDst->bpp) - 1;
+        filter_band<uint16_t>((uint16_t *)pDst->data[plane], pDst->stride[plane] / 2,
+                              (const uint16_t *)m_Prev.frame->data[plane], (const uint16_t *)m_Cur.frame->data[plane],
+                              (const uint16_t *)m_Next.frame->data[plane], m_Cur.frame->stride[plane] / 2, w, h, start,
+                              end, parity, tff, clip_max, bIntra);
+    }
+}
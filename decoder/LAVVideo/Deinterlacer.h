@@ -0,0 +1,102 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "decoders/ILAVDecoder.h"
+
+#include <deque>
+
+// Native BWDIF deinterlacer
+//
+// Produces the same output as the bwdif filter of avfilter (parity=auto, deint=interlaced), but works directly on the
+// planes of the LAVFrames, without wrapping them into AVFrames and building a filter graph. Each plane is split into
+// horizontal bands, which are filtered on the thread pool of the Concurrency Runtime.
+//
+// Input frames are held as references for the temporal filter, up to three at once, and are released with the
+// frame callback when they are no longer needed.
+//
+// The output is verified against avfilter with the -deinterlace option of the RunBenchmark entry point.
+class CDeinterlacer
+{
+  public:
+    CDeinterlacer(ILAVVideoCallback *pCallback);
+    ~CDeinterlacer();
+
+    static BOOL IsFormatSupported(LAVPixelFormat format);
+
+    // Output one frame per field instead of one frame per frame
+    void SetFramePerField(BOOL bFramePerField) { m_bFramePerField = bFramePerField; }
+    void SetNumThreads(int nThreads) { m_NumThreads = max(1, nThreads); }
+
+    // Any frames held or pending output
+    BOOL IsActive() const { return m_Cur.buf != nullptr || !m_Output.empty(); }
+
+    // Add a frame, the deinterlacer takes ownership of it
+    // The frame buffers have to remain valid until the frame is released, and can't be direct frames.
+    HRESULT Push(LAVFrame *pFrame);
+
+    // Signal the end of the stream, the last frame is output and all references are released
+    HRESULT Drain();
+
+    // Get the next output frame, returns S_FALSE if there is none
+    HRESULT GetFrame(LAVFrame **ppFrame);
+
+    // Release all held and pending frames
+    void Reset();
+
+  private:
+    enum FieldType
+    {
+        Field_Normal,  // both neighbouring frames are available
+        Field_End,     // first or last field of the stream, interpolated within the field
+        Field_BackEnd, // last frame of the stream, its second field is Field_End
+    };
+
+    // Reference to an input frame, the buffer owns the frame
+    typedef struct DeintRef
+    {
+        AVBufferRef *buf;
+        LAVFrame *frame;
+        REFERENCE_TIME rtStart;
+    } DeintRef;
+
+    DeintRef CloneRef(const DeintRef &ref);
+    void ReleaseRef(DeintRef &ref);
+    void ReleaseRefs();
+
+    HRESULT ProcessFrame(DeintRef next);
+    HRESULT OutputPassThrough();
+    HRESULT OutputField(int parity, int tff, BOOL bSecond);
+
+    void FilterBand(LAVFrame *pDst, int plane, int parity, int tff, int band, int nBands);
+
+  private:
+    ILAVVideoCallback *m_pCallback = nullptr;
+
+    BOOL m_bFramePerField = FALSE;
+    int m_NumThreads = 1;
+
+    DeintRef m_Prev{};
+    DeintRef m_Cur{};
+    DeintRef m_Next{};
+    FieldType m_Field = Field_Normal;
+
+    std::deque<LAVFrame *> m_Output;
+};
@@ -0,0 +1,200 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "DeliveryPipeline.h"
+#include "LAVVideo.h"
+
+CDeliveryPipeline::CDeliveryPipeline(CLAVVideo *pFilter)
+    : m_pFilter(pFilter)
+{
+    QueryPerformanceFrequency(&m_liFrequency);
+}
+
+CDeliveryPipeline::~CDeliveryPipeline()
+{
+    Stop();
+}
+
+HRESULT CDeliveryPipeline::Start()
+{
+    if (ThreadExists())
+        return S_FALSE;
+
+    m_bExit = FALSE;
+    m_llWaitTicks = 0;
+    memset(&m_Stats, 0, sizeof(m_Stats));
+
+    if (!Create())
+    {
+        DbgLog((LOG_ERROR, 10, L"CDeliveryPipeline::Start(): Creating the delivery thread failed"));
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+void CDeliveryPipeline::Stop()
+{
+    if (!ThreadExists())
+        return;
+
+    Discard();
+
+    m_bExit = TRUE;
+    m_evQueued.Set();
+    Close();
+
+    // Frames queued after the discard are never picked up by the worker anymore
+    std::deque<LAVFrame *> discard;
+    {
+        CAutoLock lock(&m_csQueue);
+        discard.swap(m_Queue);
+    }
+    for (LAVFrame *pFrame : discard)
+        m_pFilter->ReleaseFrame(&pFrame);
+
+    LogStatistics();
+}
+
+HRESULT CDeliveryPipeline::Queue(LAVFrame *pFrame)
+{
+    LARGE_INTEGER liStart, liEnd;
+    QueryPerformanceCounter(&liStart);
+
+    for (;;)
+    {
+        {
+            CAutoLock lock(&m_csQueue);
+            if (m_Queue.size() < DELIVERY_PIPELINE_DEPTH)
+            {
+                m_Queue.push_back(pFrame);
+                m_evIdle.Reset();
+                break;
+            }
+            m_evSpace.Reset();
+        }
+        m_evSpace.Wait();
+    }
+    m_evQueued.Set();
+
+    QueryPerformanceCounter(&liEnd);
+    m_llWaitTicks += liEnd.QuadPart - liStart.QuadPart;
+
+    return S_OK;
+}
+
+void CDeliveryPipeline::Drain()
+{
+    // Frames delivered on the worker can trigger a drain through the decoder callbacks, which is implicit there
+    if (!ThreadExists() || GetCurrentThreadId() == m_dwThreadId)
+        return;
+
+    m_evIdle.Wait();
+}
+
+void CDeliveryPipeline::Discard()
+{
+    if (!ThreadExists() || GetCurrentThreadId() == m_dwThreadId)
+        return;
+
+    std::deque<LAVFrame *> discard;
+    {
+        CAutoLock lock(&m_csQueue);
+        discard.swap(m_Queue);
+        m_evSpace.Set();
+    }
+
+    for (LAVFrame *pFrame : discard)
+        m_pFilter->ReleaseFrame(&pFrame);
+
+    m_evIdle.Wait();
+}
+
+DWORD CDeliveryPipeline::ThreadProc()
+{
+    SetThreadName(-1, "LAV Video Delivery");
+    m_dwThreadId = GetCurrentThreadId();
+
+    LARGE_INTEGER liStart, liEnd;
+    while (!m_bExit)
+    {
+        m_evQueued.Wait();
+
+        for (;;)
+        {
+            LAVFrame *pFrame = nullptr;
+            {
+                CAutoLock lock(&m_csQueue);
+                if (m_Queue.empty())
+                {
+                    m_evIdle.Set();
+                    break;
+                }
+                pFrame = m_Queue.front();
+                m_Queue.pop_front();
+                m_evSpace.Set();
+            }
+
+            QueryPerformanceCounter(&liStart);
+            m_pFilter->ConvertAndDeliver(pFrame);
+            QueryPerformanceCounter(&liEnd);
+
+            m_Stats.llDeliver += liEnd.QuadPart - liStart.QuadPart;
+            if (++m_Stats.nFrames % DELIVERY_PIPELINE_STATS_INTERVAL == 0)
+                LogStatistics();
+        }
+    }
+
+    m_dwThreadId = 0;
+    return 0;
+}
+
+void CDeliveryPipeline::GetStatus(ULONGLONG *pnFrames, double *pdDecodeFps, double *pdConvertFps,
+                                  double *pdDownstreamFps)
+{
+    // The counters are updated by the decoding and the delivery thread, a snapshot is accurate enough here
+    const unsigned nFrames = m_Stats.nFrames;
+    const double decode = m_Stats.llDecode / (double)m_liFrequency.QuadPart;
+    const double convert = (m_Stats.llDeliver - m_Stats.llDownstream) / (double)m_liFrequency.QuadPart;
+    const double downstream = m_Stats.llDownstream / (double)m_liFrequency.QuadPart;
+
+    if (pnFrames)
+        *pnFrames = nFrames;
+    if (pdDecodeFps)
+        *pdDecodeFps = decode > 0 ? nFrames / decode : 0.0;
+    if (pdConvertFps)
+        *pdConvertFps = convert > 0 ? nFrames / convert : 0.0;
+    if (pdDownstreamFps)
+        *pdDownstreamFps = downstream > 0 ? nFrames / downstream : 0.0;
+}
+
+void CDeliveryPipeline::LogStatistics()
+{
+#ifdef DEBUG
+    if (m_Stats.nFrames == 0)
+        return;
+
+    ULONGLONG nFrames;
+    double decode, convert, downstream;
+    GetStatus(&nFrames, &decode, &convert, &downstream);
+    DbgLog((LOG_TRACE, 10, L"CDeliveryPipeline: %I64u frames, decode %.1f fps, convert %.1f fps, downstream %.1f fps",
+            nFrames, decode, convert, downstream));
+#endif
+}
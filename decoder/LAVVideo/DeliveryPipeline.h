@@ -0,0 +1,96 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "decoders/ILAVDecoder.h"
+
+#include <deque>
+
+// Maximum number of decoded frames waiting for the delivery thread
+#define DELIVERY_PIPELINE_DEPTH 4
+
+// Interval (in frames) of the throughput statistics in the log
+#define DELIVERY_PIPELINE_STATS_INTERVAL 500
+
+class CLAVVideo;
+
+// Runs the pixel format conversion, subtitle blending and delivery of decoded frames on a separate thread,
+// so the decoder can continue with the next frame while the previous one is being converted.
+// Frames are delivered strictly in the order they are queued.
+class CDeliveryPipeline : protected CAMThread
+{
+  public:
+    CDeliveryPipeline(CLAVVideo *pFilter);
+    ~CDeliveryPipeline();
+
+    HRESULT Start();
+    void Stop();
+    BOOL IsRunning() { return ThreadExists(); }
+
+    // Queue a frame for delivery, blocks while the queue is full
+    HRESULT Queue(LAVFrame *pFrame);
+
+    // Wait until all queued frames have been delivered
+    void Drain();
+
+    // Release all queued frames without delivering them, and wait for the frame currently being delivered
+    void Discard();
+
+    // Time spent in the decoder, excluding the time spent waiting for room in the queue
+    void AddDecodeTime(LONGLONG llTicks)
+    {
+        m_Stats.llDecode += llTicks - m_llWaitTicks;
+        m_llWaitTicks = 0;
+    }
+
+    // Time spent in the downstream filter, which is excluded from the conversion time
+    void AddDownstreamTime(LONGLONG llTicks) { m_Stats.llDownstream += llTicks; }
+
+    // Throughput of the stages since the pipeline was started, in frames per second
+    void GetStatus(ULONGLONG *pnFrames, double *pdDecodeFps, double *pdConvertFps, double *pdDownstreamFps);
+
+  private:
+    DWORD ThreadProc();
+
+    void LogStatistics();
+
+  private:
+    CLAVVideo *m_pFilter = nullptr;
+
+    CCritSec m_csQueue;
+    std::deque<LAVFrame *> m_Queue;
+
+    CAMEvent m_evQueued;
+    CAMEvent m_evSpace;
+    CAMEvent m_evIdle{TRUE};
+    volatile BOOL m_bExit = FALSE;
+    DWORD m_dwThreadId = 0;
+
+    LARGE_INTEGER m_liFrequency{};
+    LONGLONG m_llWaitTicks = 0;
+
+    struct
+    {
+        unsigned nFrames;
+        LONGLONG llDecode;
+        LONGLONG llDeliver;
+        LONGLONG llDownstream;
+    } m_Stats{};
+};
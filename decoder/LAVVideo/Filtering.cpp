@@ -42,11 +42,23 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
 {
     int ret = 0;
     BOOL bFlush = pFrame->flags & LAV_FRAME_FLAG_FLUSH;
+
+    // BWDIF runs natively on the frame planes, without a filter graph
+    if ((bFlush && m_Deinterlacer.IsActive()) ||
+        (m_Decoder.IsInterlaced(FALSE) && m_settings.DeintMode != DeintMode_Disable && UseNativeDeinterlacer() &&
+         CDeinterlacer::IsFormatSupported(pFrame->format)))
+    {
+        return Deinterlace(pFrame);
+    }
+
     if (m_Decoder.IsInterlaced(FALSE) && m_settings.DeintMode != DeintMode_Disable &&
         m_settings.SWDeintMode != SWDeintMode_None &&
         ((bFlush && m_pFilterGraph) || pFrame->format == LAVPixFmt_YUV420 || pFrame->format == LAVPixFmt_YUV422 ||
          pFrame->format == LAVPixFmt_NV12))
     {
+        // Time spent in the filter, without the delivery of the output frames
+        LONGLONG llFilterStart = CPipelineStats::Now(), llFilterTicks = 0;
+
         AVPixelFormat ff_pixfmt = (pFrame->format == LAVPixFmt_YUV420)
                                       ? AV_PIX_FMT_YUV420P
                                       : (pFrame->format == LAVPixFmt_YUV422) ? AV_PIX_FMT_YUV422P : AV_PIX_FMT_NV12;
@@ -117,7 +129,13 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
             inputs->pad_idx = 0;
             inputs->next = nullptr;
 
-            if (m_settings.SWDeintMode == SWDeintMode_YADIF)
+            // The other deinterlacers look one frame ahead, kerndeint only uses the current and previous frame
+            if (m_settings.bLowLatency)
+                _snprintf_s(args, sizeof(args), "kerndeint=thresh=10:order=%d",
+                            (m_settings.DeintFieldOrder == DeintFieldOrder_Auto)
+                                ? pFrame->tff
+                                : (m_settings.DeintFieldOrder == DeintFieldOrder_TopFieldFirst));
+            else if (m_settings.SWDeintMode == SWDeintMode_YADIF)
                 _snprintf_s(args, sizeof(args), "yadif=mode=%s:parity=auto:deint=interlaced",
                             (m_settings.SWDeintOutput == DeintOutput_FramePerField) ? "send_field" : "send_frame");
             else if (m_settings.SWDeintMode == SWDeintMode_W3FDIF_Simple)
@@ -218,8 +236,8 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
             goto deliver;
         }
 
-        BOOL bFramePerField =
-            (m_settings.SWDeintMode != SWDeintMode_None && m_settings.SWDeintOutput == DeintOutput_FramePerField);
+        BOOL bFramePerField = (m_settings.SWDeintMode != SWDeintMode_None &&
+                               m_settings.SWDeintOutput == DeintOutput_FramePerField && !m_settings.bLowLatency);
 
         AVFrame *out_frame = av_frame_alloc();
         HRESULT hrDeliver = S_OK;
@@ -240,6 +258,7 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
             outFrame->ext_format = pFrame->ext_format;
             outFrame->avgFrameDuration = pFrame->avgFrameDuration;
             outFrame->flags = pFrame->flags;
+            outFrame->decimation = pFrame->decimation;
 
             outFrame->width = out_frame->width;
             outFrame->height = out_frame->height;
@@ -267,13 +286,18 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
             outFrame->priv_data = av_frame_alloc();
             av_frame_move_ref((AVFrame *)outFrame->priv_data, out_frame);
 
+            llFilterTicks += CPipelineStats::Now() - llFilterStart;
             hrDeliver = DeliverToRenderer(outFrame);
+            llFilterStart = CPipelineStats::Now();
         }
         if (!refcountedFrame)
             ReleaseFrame(&pFrame);
         av_frame_free(&in_frame);
         av_frame_free(&out_frame);
 
+        llFilterTicks += CPipelineStats::Now() - llFilterStart;
+        m_PipelineStats.Add(LAVPipelineStage_Filter, llFilterTicks);
+
         // We EOF'ed the graph, need to close it
         if (bFlush)
         {
@@ -294,3 +318,74 @@ HRESULT CLAVVideo::Filter(LAVFrame *pFrame)
         return DeliverToRenderer(pFrame);
     }
 }
+
+HRESULT CLAVVideo::Deinterlace(LAVFrame *pFrame)
+{
+    // Time spent in the deinterlacer, without the delivery of the output frames
+    LONGLONG llFilterStart = CPipelineStats::Now(), llFilterTicks = 0;
+    HRESULT hr = S_OK;
+
+    if (pFrame->flags & LAV_FRAME_FLAG_FLUSH)
+    {
+        ReleaseFrame(&pFrame);
+        m_Deinterlacer.Drain();
+    }
+    else
+    {
+        if (pFrame->direct)
+        {
+            hr = DeDirectFrame(pFrame, true);
+            if (FAILED(hr))
+            {
+                ReleaseFrame(&pFrame);
+                return hr;
+            }
+        }
+
+        // The deinterlacer keeps up to three frames, which requires a copy if the decoder re-uses its buffers
+        if (m_Decoder.HasThreadSafeBuffers() != S_OK)
+        {
+            LAVFrame *pCopy = nullptr;
+            hr = CopyLAVFrame(pFrame, &pCopy);
+            if (FAILED(hr) && pCopy)
+            {
+                // a failed copy still references the side data of the source
+                pCopy->side_data = nullptr;
+                pCopy->side_data_count = 0;
+                ReleaseFrame(&pCopy);
+            }
+            ReleaseFrame(&pFrame);
+            if (FAILED(hr))
+                return hr;
+            pFrame = pCopy;
+        }
+
+        m_filterPixFmt = pFrame->format;
+        m_Deinterlacer.SetFramePerField(m_settings.SWDeintOutput == DeintOutput_FramePerField);
+
+        hr = m_Deinterlacer.Push(pFrame);
+        if (FAILED(hr))
+            DbgLog((LOG_ERROR, 10, L"::Deinterlace(): Deinterlacing failed with hr: %x", hr));
+    }
+
+    LAVFrame *pOutFrame = nullptr;
+    HRESULT hrDeliver = S_OK;
+    while (SUCCEEDED(hrDeliver) && m_Deinterlacer.GetFrame(&pOutFrame) == S_OK)
+    {
+        llFilterTicks += CPipelineStats::Now() - llFilterStart;
+        hrDeliver = DeliverToRenderer(pOutFrame);
+        llFilterStart = CPipelineStats::Now();
+    }
+
+    // The remaining output can't be delivered anymore, don't hold on to it until the next frame
+    if (FAILED(hrDeliver))
+    {
+        while (m_Deinterlacer.GetFrame(&pOutFrame) == S_OK)
+            ReleaseFrame(&pOutFrame);
+    }
+
+    llFilterTicks += CPipelineStats::Now() - llFilterStart;
+    m_PipelineStats.Add(LAVPipelineStage_Filter, llFilterTicks);
+
+    return FAILED(hrDeliver) ? hrDeliver : hr;
+}
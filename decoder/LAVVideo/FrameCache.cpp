@@ -0,0 +1,311 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "FrameCache.h"
+
+CFrameCache::CFrameCache()
+{
+}
+
+CFrameCache::~CFrameCache()
+{
+    ClearEntries();
+    for (CacheEntry &entry : m_Spare)
+        _aligned_free(entry.pData);
+}
+
+void CFrameCache::SetMaxSize(DWORD dwSizeMB)
+{
+    CAutoLock lock(&m_csCache);
+
+    m_nMaxSize = min((size_t)dwSizeMB, (size_t)FRAME_CACHE_MAX_SIZE_MB) << 20;
+    while (!m_Entries.empty() && m_nBytes > m_nMaxSize)
+        PopEntry();
+
+    if (m_nMaxSize == 0)
+    {
+        for (CacheEntry &entry : m_Spare)
+            _aligned_free(entry.pData);
+        m_Spare.clear();
+    }
+}
+
+void CFrameCache::Clear()
+{
+    CAutoLock lock(&m_csCache);
+    ClearEntries();
+    m_rtReplayEnd = AV_NOPTS_VALUE;
+}
+
+void CFrameCache::ClearEntries()
+{
+    // The rest of a running replay is gone
+    StopReplay();
+
+    for (CacheEntry &entry : m_Entries)
+        FreeEntry(entry);
+    m_Entries.clear();
+    m_nReplayIndex = 0;
+}
+
+void CFrameCache::PopEntry()
+{
+    FreeEntry(m_Entries.front());
+    m_Entries.pop_front();
+
+    // Keep the replay position on the same frame, if the next frame to replay was evicted the replay ends here
+    if (m_nReplayIndex > 0)
+        m_nReplayIndex--;
+    else
+        StopReplay();
+}
+
+void CFrameCache::FreeEntry(CacheEntry &entry)
+{
+    m_nBytes -= entry.lSize;
+
+    // Keep a few buffers, the frames of a stream all have the same size
+    if (m_nMaxSize && m_Spare.size() < FRAME_CACHE_SPARE_BUFFERS)
+        m_Spare.push_back(entry);
+    else
+        _aligned_free(entry.pData);
+    entry.pData = nullptr;
+}
+
+BYTE *CFrameCache::AllocBuffer(long lSize)
+{
+    CAutoLock lock(&m_csCache);
+
+    for (auto it = m_Spare.begin(); it != m_Spare.end(); it++)
+    {
+        if (it->lSize == lSize)
+        {
+            BYTE *pBuffer = it->pData;
+            m_Spare.erase(it);
+            return pBuffer;
+        }
+    }
+    return (BYTE *)_aligned_malloc(lSize, 64);
+}
+
+void CFrameCache::PushEntry(const CacheEntry &entry, const CMediaType &mt, BOOL bKeyFrame)
+{
+    // A new GOP, a gap or a format change starts a new range
+    if (!m_Entries.empty())
+    {
+        const CacheEntry &last = m_Entries.back();
+        if (bKeyFrame || mt != m_mt || entry.rtStart < last.rtStart ||
+            entry.rtStart > last.rtStop + (last.rtStop - last.rtStart))
+            ClearEntries();
+    }
+    m_mt = mt;
+
+    m_Entries.push_back(entry);
+    m_nBytes += entry.lSize;
+
+    while (m_Entries.size() > 1 && m_nBytes > m_nMaxSize)
+        PopEntry();
+
+    m_Status.nFramesStored++;
+    m_Status.nPeakBytes = max(m_Status.nPeakBytes, (ULONGLONG)m_nBytes);
+}
+
+HRESULT CFrameCache::Add(IMediaSample *pSample, const CMediaType &mt, REFERENCE_TIME rtSegment,
+                         const FrameFormat &format, BOOL bKeyFrame)
+{
+    REFERENCE_TIME rtStart = 0, rtStop = 0;
+    BYTE *pData = nullptr;
+    if (pSample->GetTime(&rtStart, &rtStop) != S_OK || FAILED(pSample->GetPointer(&pData)))
+        return E_FAIL;
+
+    DWORD dwTypeSpecificFlags = 0;
+    IMediaSample2 *pSample2 = nullptr;
+    if (SUCCEEDED(pSample->QueryInterface(&pSample2)))
+    {
+        AM_SAMPLE2_PROPERTIES props;
+        if (SUCCEEDED(pSample2->GetProperties(sizeof(props), (BYTE *)&props)))
+            dwTypeSpecificFlags = props.dwTypeSpecificFlags;
+        SafeRelease(&pSample2);
+    }
+
+    long lSize = pSample->GetActualDataLength();
+    BYTE *pBuffer = AllocBuffer(lSize);
+    if (!pBuffer)
+        return E_OUTOFMEMORY;
+    memcpy(pBuffer, pData, lSize);
+
+    return AddBuffer(pBuffer, lSize, mt, rtStart + rtSegment, rtStop + rtSegment, dwTypeSpecificFlags, format,
+                     bKeyFrame);
+}
+
+HRESULT CFrameCache::AddBuffer(BYTE *pBuffer, long lSize, const CMediaType &mt, REFERENCE_TIME rtStart,
+                               REFERENCE_TIME rtStop, DWORD dwTypeSpecificFlags, const FrameFormat &format,
+                               BOOL bKeyFrame)
+{
+    CAutoLock lock(&m_csCache);
+
+    CacheEntry entry = {pBuffer, lSize, rtStart, rtStop, dwTypeSpecificFlags, format};
+    if ((size_t)lSize > m_nMaxSize)
+    {
+        _aligned_free(pBuffer);
+        return S_FALSE;
+    }
+
+    PushEntry(entry, mt, bKeyFrame);
+    return S_OK;
+}
+
+BOOL CFrameCache::BeginReplay(REFERENCE_TIME rtStart, const CMediaType &mt)
+{
+    CAutoLock lock(&m_csCache);
+
+    m_Status.nLookups++;
+    m_bReplaying = FALSE;
+    m_rtReplayEnd = AV_NOPTS_VALUE;
+
+    if (m_Entries.empty() || mt != m_mt)
+        return FALSE;
+
+    // The target has to be within a cached frame, allowing for some rounding of the seek position
+    for (size_t i = 0; i < m_Entries.size(); i++)
+    {
+        const CacheEntry &entry = m_Entries[i];
+        if (entry.rtStop <= rtStart)
+            continue;
+        if (entry.rtStart - rtStart > (entry.rtStop - entry.rtStart) / 2)
+            break;
+
+        m_bReplaying = TRUE;
+        m_nReplayIndex = i;
+        m_nReplayed = 0;
+        m_bReplayDiscontinuity = TRUE;
+        m_rtReplayEnd = m_Entries.back().rtStop;
+        m_Status.nHits++;
+
+        DbgLog((LOG_TRACE, 10, L"CFrameCache::BeginReplay(): Serving %I64d from the cache (%u frames)", rtStart,
+                (unsigned)(m_Entries.size() - i)));
+        return TRUE;
+    }
+    return FALSE;
+}
+
+BOOL CFrameCache::GetReplayFormat(FrameFormat *pFormat)
+{
+    CAutoLock lock(&m_csCache);
+
+    if (!m_bReplaying || m_nReplayIndex >= m_Entries.size())
+        return FALSE;
+
+    *pFormat = m_Entries[m_nReplayIndex].format;
+    return TRUE;
+}
+
+HRESULT CFrameCache::ReplayFrame(IMediaSample *pSample, const CMediaType &mt, REFERENCE_TIME rtSegment)
+{
+    CAutoLock lock(&m_csCache);
+
+    if (!m_bReplaying || m_nReplayIndex >= m_Entries.size())
+        return S_FALSE;
+    if (mt != m_mt)
+        return VFW_E_TYPE_NOT_ACCEPTED;
+
+    const CacheEntry &entry = m_Entries[m_nReplayIndex];
+
+    BYTE *pData = nullptr;
+    if (FAILED(pSample->GetPointer(&pData)) || pSample->GetSize() < entry.lSize)
+        return E_FAIL;
+
+    memcpy(pData, entry.pData, entry.lSize);
+    pSample->SetActualDataLength(entry.lSize);
+
+    REFERENCE_TIME rtStart = entry.rtStart - rtSegment, rtStop = entry.rtStop - rtSegment;
+    pSample->SetTime(&rtStart, &rtStop);
+    pSample->SetMediaTime(nullptr, nullptr);
+    pSample->SetSyncPoint(TRUE);
+    pSample->SetDiscontinuity(m_bReplayDiscontinuity);
+
+    IMediaSample2 *pSample2 = nullptr;
+    if (SUCCEEDED(pSample->QueryInterface(&pSample2)))
+    {
+        AM_SAMPLE2_PROPERTIES props;
+        if (SUCCEEDED(pSample2->GetProperties(sizeof(props), (BYTE *)&props)))
+        {
+            props.dwTypeSpecificFlags = entry.dwTypeSpecificFlags;
+            pSample2->SetProperties(sizeof(props), (BYTE *)&props);
+        }
+        SafeRelease(&pSample2);
+    }
+
+    m_nReplayIndex++;
+    m_nReplayed++;
+    m_rtLastReplayed = entry.rtStop;
+    m_bReplayDiscontinuity = FALSE;
+    m_Status.nFramesServed++;
+
+    return S_OK;
+}
+
+BOOL CFrameCache::IsReplayed(REFERENCE_TIME rtStart)
+{
+    CAutoLock lock(&m_csCache);
+
+    if (m_rtReplayEnd == AV_NOPTS_VALUE)
+        return FALSE;
+
+    // Frames are output in presentation order, the first one past the replayed range ends the replay
+    if (rtStart < m_rtReplayEnd)
+        return TRUE;
+
+    m_rtReplayEnd = AV_NOPTS_VALUE;
+    return FALSE;
+}
+
+void CFrameCache::StopReplay()
+{
+    CAutoLock lock(&m_csCache);
+
+    if (!m_bReplaying)
+        return;
+    m_bReplaying = FALSE;
+
+    // Decoded frames up to the last replayed one were already delivered
+    if (m_rtReplayEnd != AV_NOPTS_VALUE && m_nReplayed)
+        m_rtReplayEnd = m_rtLastReplayed;
+    else
+        m_rtReplayEnd = AV_NOPTS_VALUE;
+}
+
+void CFrameCache::EndReplay()
+{
+    CAutoLock lock(&m_csCache);
+    m_bReplaying = FALSE;
+    m_rtReplayEnd = AV_NOPTS_VALUE;
+}
+
+void CFrameCache::GetStatus(LAVFrameCacheStatus *pStatus)
+{
+    CAutoLock lock(&m_csCache);
+
+    *pStatus = m_Status;
+    pStatus->nFrames = (UINT)m_Entries.size();
+    pStatus->nBytes = m_nBytes;
+    pStatus->rtStart = m_Entries.empty() ? 0 : m_Entries.front().rtStart;
+    pStatus->rtStop = m_Entries.empty() ? 0 : m_Entries.back().rtStop;
+}
@@ -0,0 +1,119 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+
+// Number of evicted frame buffers kept for re-use
+#define FRAME_CACHE_SPARE_BUFFERS 4
+
+// Upper limit of the cache size in megabytes, keeps the size in bytes well within the address space
+#define FRAME_CACHE_MAX_SIZE_MB (SIZE_MAX >> 21)
+
+// Cache of the converted frames of the most recent GOP
+//
+// Frames are stored in the output format, with their stream time (sample time plus the segment start), and form one
+// contiguous range. A key frame or a gap in the timestamps starts a new range, and the oldest frames are evicted
+// when the memory limit is exceeded.
+//
+// After a seek into the cached range, the cached frames are replayed from the seek target to the end of the range.
+// The decoder still receives the packets from the key frame on, and the frames it outputs within the replayed range
+// are dropped before conversion, so stepping backwards in a paused graph does not decode at all.
+class CFrameCache
+{
+  public:
+    CFrameCache();
+    ~CFrameCache();
+
+    // Output parameters of a cached frame, to request a delivery buffer for its replay
+    typedef struct FrameFormat
+    {
+        int width;
+        int height;
+        AVRational aspect_ratio;
+        DXVA2_ExtendedFormat ext_format;
+        REFERENCE_TIME avgFrameDuration;
+    } FrameFormat;
+
+    // Set the memory limit in megabytes, 0 disables the cache
+    void SetMaxSize(DWORD dwSizeMB);
+    BOOL IsEnabled() const { return m_nMaxSize > 0; }
+
+    void Clear();
+
+    // Store a delivered output sample, the sample times are offset by rtSegment
+    HRESULT Add(IMediaSample *pSample, const CMediaType &mt, REFERENCE_TIME rtSegment, const FrameFormat &format,
+                BOOL bKeyFrame);
+
+    // Store a frame converted into a buffer from AllocBuffer, which is owned by the cache afterwards
+    BYTE *AllocBuffer(long lSize);
+    HRESULT AddBuffer(BYTE *pBuffer, long lSize, const CMediaType &mt, REFERENCE_TIME rtStart, REFERENCE_TIME rtStop,
+                      DWORD dwTypeSpecificFlags, const FrameFormat &format, BOOL bKeyFrame);
+
+    // Start replaying at the stream time rtStart, fails if the frame is not cached in the format mt
+    BOOL BeginReplay(REFERENCE_TIME rtStart, const CMediaType &mt);
+    // Get the format of the next replayed frame, returns FALSE after the last frame
+    BOOL GetReplayFormat(FrameFormat *pFormat);
+    // Copy the next replayed frame into the sample, fails if the output format changed
+    HRESULT ReplayFrame(IMediaSample *pSample, const CMediaType &mt, REFERENCE_TIME rtSegment);
+    // Check if a decoded frame was already delivered by the replay
+    BOOL IsReplayed(REFERENCE_TIME rtStart);
+    // Stop replaying after the frames replayed so far, the decoder delivers the frames after them
+    void StopReplay();
+    void EndReplay();
+
+    void GetStatus(LAVFrameCacheStatus *pStatus);
+
+  private:
+    struct CacheEntry
+    {
+        BYTE *pData;
+        long lSize;
+        REFERENCE_TIME rtStart;
+        REFERENCE_TIME rtStop;
+        DWORD dwTypeSpecificFlags;
+        FrameFormat format;
+    };
+
+    void PushEntry(const CacheEntry &entry, const CMediaType &mt, BOOL bKeyFrame);
+    void PopEntry();
+    void FreeEntry(CacheEntry &entry);
+    void ClearEntries();
+
+  private:
+    CCritSec m_csCache;
+    size_t m_nMaxSize = 0;
+
+    CMediaType m_mt;
+    std::deque<CacheEntry> m_Entries;
+    std::vector<CacheEntry> m_Spare;
+    size_t m_nBytes = 0;
+
+    // next frame to replay, and the end of the replayed range
+    BOOL m_bReplaying = FALSE;
+    size_t m_nReplayIndex = 0;
+    size_t m_nReplayed = 0;
+    REFERENCE_TIME m_rtLastReplayed = AV_NOPTS_VALUE;
+    BOOL m_bReplayDiscontinuity = FALSE;
+    REFERENCE_TIME m_rtReplayEnd = AV_NOPTS_VALUE;
+
+    LAVFrameCacheStatus m_Status{};
+};
@@ -173,6 +173,7 @@ CLAVPixFmtConverter::~CLAVPixFmtConverter()
 {
     DestroySWScale();
     av_freep(&m_pAlignedBuffer);
+    av_freep(&m_pDecimateBuffer);
 }
 
 LAVOutPixFmts CLAVPixFmtConverter::GetOutputBySubtype(const GUID *guid)
@@ -619,6 +620,17 @@ HRESULT CLAVPixFmtConverter::Convert(const BYTE *const src[4], const ptrdiff_t s
         dstStrideArray[i] = byteStride / lav_pixfmt_desc[m_OutputPixFmt].planeWidth[i];
     }
 
+    uint8_t *decimated[4] = {0};
+    ptrdiff_t decimatedStride[4] = {0};
+    if (m_nDecimation > 0)
+    {
+        HRESULT hr = Decimate(src, srcStride, width, height, decimated, decimatedStride);
+        if (FAILED(hr))
+            return hr;
+        src = decimated;
+        srcStride = decimatedStride;
+    }
+
     HRESULT hr = (this->*convert)(src, srcStride, dstArray, dstStrideArray, width, height, m_InputPixFmt, m_InBpp,
                                   m_OutputPixFmt);
     if (out != dst)
@@ -69,6 +69,11 @@ class CLAVPixFmtConverter
     ~CLAVPixFmtConverter();
 
     void SetSettings(ILAVVideoSettings *pSettings) { m_pSettings = pSettings; }
+    void SetNumThreads(int nThreads) { m_NumThreads = max(1, nThreads); }
+
+    // Decimate the input by 2^nShift in both directions before converting (preview decoding)
+    // width/height passed to Convert are the decimated dimensions
+    void SetDecimation(int nShift) { m_nDecimation = nShift; }
 
     BOOL SetInputFmt(enum LAVPixelFormat pixfmt, int bpp)
     {
@@ -83,6 +88,7 @@ class CLAVPixFmtConverter
         }
         return FALSE;
     }
+    BOOL IsInputFmt(enum LAVPixelFormat pixfmt, int bpp) { return m_InputPixFmt == pixfmt && m_InBpp == bpp; }
     HRESULT SetOutputPixFmt(enum LAVOutPixFmts pix_fmt)
     {
         m_OutputPixFmt = pix_fmt;
@@ -164,6 +170,9 @@ class CLAVPixFmtConverter
     void ChangeStride(const uint8_t *src, ptrdiff_t srcStride, uint8_t *dst, ptrdiff_t dstStride, int width, int height,
                       int planeHeight, LAVOutPixFmts format);
 
+    HRESULT Decimate(const uint8_t *const src[4], const ptrdiff_t srcStride[4], int width, int height, uint8_t *dst[4],
+                     ptrdiff_t dstStride[4]);
+
     typedef HRESULT(CLAVPixFmtConverter::*ConverterFn) CONV_FUNC_PARAMS;
 
     // Conversion function pointer
@@ -226,6 +235,10 @@ class CLAVPixFmtConverter
     size_t m_nAlignedBufferSize = 0;
     uint8_t *m_pAlignedBuffer = nullptr;
 
+    int m_nDecimation = 0;
+    size_t m_nDecimateBufferSize = 0;
+    uint8_t *m_pDecimateBuffer = nullptr;
+
     int m_NumThreads = 1;
 
     ILAVVideoSettings *m_pSettings = nullptr;
@@ -25,6 +25,7 @@
 
 #include "VideoInputPin.h"
 #include "VideoOutputPin.h"
+#include "ThreadBudget.h"
 
 #include "moreuuids.h"
 #include "registry.h"
@@ -61,6 +62,10 @@ CLAVVideo::CLAVVideo(LPUNKNOWN pUnk, HRESULT *phr)
     memset(&m_SideData, 0, sizeof(m_SideData));
 
     LoadSettings();
+    DecoderThreadBudget::SetBudget((int)m_settings.ThreadBudget);
+    m_FrameCache.SetMaxSize(m_settings.dwFrameCacheSize);
+    m_Decoder.SetPrerollSkip(!m_FrameCache.IsEnabled());
+    QueryPerformanceFrequency(&m_SeekStats.liFrequency);
 
     m_PixFmtConverter.SetSettings(this);
 
@@ -75,9 +80,20 @@ CLAVVideo::~CLAVVideo()
 {
     SAFE_DELETE(m_pTrayIcon);
 
+    m_DeliveryPipeline.Stop();
     ReleaseLastSequenceFrame();
+    m_Deinterlacer.Reset();
     m_Decoder.Close();
 
+    for (LAVFrame *pFrame : m_FreeFrames)
+        CoTaskMemFree(pFrame);
+    m_FreeFrames.clear();
+
+    LAVFrameBufferPoolStats stats;
+    GetLAVFrameBufferPoolStats(&stats);
+    DbgLog((LOG_TRACE, 10, L"Frame buffer pool: %Iu allocated, %Iu re-used, peak %Iu bytes", stats.nAllocated,
+            stats.nReused, stats.nPeakBytes));
+
     if (m_pFilterGraph)
         avfilter_graph_free(&m_pFilterGraph);
     m_pFilterBufferSrc = nullptr;
@@ -125,6 +141,7 @@ HRESULT CLAVVideo::LoadDefaults()
     // Set Defaults
     m_settings.StreamAR = 2;
     m_settings.NumThreads = 0;
+    m_settings.ThreadBudget = 0;
     m_settings.DeintFieldOrder = DeintFieldOrder_Auto;
     m_settings.DeintMode = DeintMode_Auto;
     m_settings.RGBRange = 2; // Full range default
@@ -177,6 +194,11 @@ HRESULT CLAVVideo::LoadDefaults()
 
     m_settings.bH264MVCOverride = TRUE;
     m_settings.bCCOutputPinEnabled = FALSE;
+    m_settings.bPipelinedDelivery = FALSE;
+    m_settings.bQualityControl = FALSE;
+    m_settings.bLowLatency = FALSE;
+    m_settings.dwPreviewHeight = 0;
+    m_settings.dwFrameCacheSize = 0;
 
     return S_OK;
 }
@@ -216,6 +238,18 @@ HRESULT CLAVVideo::ReadSettings(HKEY rootKey)
         if (SUCCEEDED(hr))
             m_settings.NumThreads = dwVal;
 
+        dwVal = reg.ReadDWORD(L"ThreadBudget", hr);
+        if (SUCCEEDED(hr))
+            m_settings.ThreadBudget = dwVal;
+
+        dwVal = reg.ReadDWORD(L"PreviewHeight", hr);
+        if (SUCCEEDED(hr))
+            m_settings.dwPreviewHeight = dwVal;
+
+        dwVal = reg.ReadDWORD(L"FrameCacheSize", hr);
+        if (SUCCEEDED(hr))
+            m_settings.dwFrameCacheSize = dwVal;
+
         dwVal = reg.ReadDWORD(L"DeintFieldOrder", hr);
         if (SUCCEEDED(hr))
             m_settings.DeintFieldOrder = dwVal;
@@ -257,6 +291,18 @@ HRESULT CLAVVideo::ReadSettings(HKEY rootKey)
         if (SUCCEEDED(hr))
             m_settings.bDVDVideo = bFlag;
 
+        bFlag = reg.ReadBOOL(L"QualityControl", hr);
+        if (SUCCEEDED(hr))
+            m_settings.bQualityControl = bFlag;
+
+        bFlag = reg.ReadBOOL(L"LowLatency", hr);
+        if (SUCCEEDED(hr))
+            m_settings.bLowLatency = bFlag;
+
+        bFlag = reg.ReadBOOL(L"PipelinedDelivery", hr);
+        if (SUCCEEDED(hr))
+            m_settings.bPipelinedDelivery = bFlag;
+
         bFlag = reg.ReadBOOL(L"MSWMV9DMO", hr);
         if (SUCCEEDED(hr))
             m_settings.bMSWMV9DMO = bFlag;
@@ -380,6 +426,9 @@ HRESULT CLAVVideo::SaveSettings()
         reg.WriteBOOL(L"TrayIcon", m_settings.TrayIcon);
         reg.WriteDWORD(L"StreamAR", m_settings.StreamAR);
         reg.WriteDWORD(L"NumThreads", m_settings.NumThreads);
+        reg.WriteDWORD(L"ThreadBudget", m_settings.ThreadBudget);
+        reg.WriteDWORD(L"PreviewHeight", m_settings.dwPreviewHeight);
+        reg.WriteDWORD(L"FrameCacheSize", m_settings.dwFrameCacheSize);
         reg.WriteDWORD(L"DeintFieldOrder", m_settings.DeintFieldOrder);
         reg.WriteDWORD(L"DeintMode", m_settings.DeintMode);
         reg.WriteDWORD(L"RGBRange", m_settings.RGBRange);
@@ -394,6 +443,9 @@ HRESULT CLAVVideo::SaveSettings()
         }
 
         reg.WriteBOOL(L"DVDVideo", m_settings.bDVDVideo);
+        reg.WriteBOOL(L"QualityControl", m_settings.bQualityControl);
+        reg.WriteBOOL(L"LowLatency", m_settings.bLowLatency);
+        reg.WriteBOOL(L"PipelinedDelivery", m_settings.bPipelinedDelivery);
         reg.WriteBOOL(L"MSWMV9DMO", m_settings.bMSWMV9DMO);
 
         CreateRegistryKey(HKEY_CURRENT_USER, LAVC_VIDEO_REGISTRY_KEY_OUTPUT);
@@ -449,7 +501,7 @@ STDMETHODIMP CLAVVideo::NonDelegatingQueryInterface(REFIID riid, void **ppv)
 
     return QI(ISpecifyPropertyPages) QI(ISpecifyPropertyPages2) QI(IPropertyBag) QI2(ILAVVideoSettings)
         QI2(ILAVVideoSettingsMPCHCCustom)
-        QI2(ILAVVideoStatus) __super::NonDelegatingQueryInterface(riid, ppv);
+        QI2(ILAVVideoStatus) QI2(ILAVVideoPipelineStats) __super::NonDelegatingQueryInterface(riid, ppv);
 
 }
 
@@ -646,7 +698,15 @@ HRESULT CLAVVideo::GetMediaType(int iPosition, CMediaType *pMediaType)
             rtAvgTime /= 2;
     }
 
-    m_PixFmtConverter.GetMediaType(pMediaType, index, pBIH->biWidth, pBIH->biHeight, dwAspectX, dwAspectY, rtAvgTime,
+    // Preview decoding outputs at a reduced size
+    LONG biWidth = pBIH->biWidth, biHeight = pBIH->biHeight;
+    if (int nPreviewScale = m_Decoder.GetPreviewScale())
+    {
+        biWidth = AV_CEIL_RSHIFT(biWidth, nPreviewScale);
+        biHeight = biHeight < 0 ? -AV_CEIL_RSHIFT(-biHeight, nPreviewScale) : AV_CEIL_RSHIFT(biHeight, nPreviewScale);
+    }
+
+    m_PixFmtConverter.GetMediaType(pMediaType, index, biWidth, biHeight, dwAspectX, dwAspectY, rtAvgTime,
                                    IsInterlacedOutput(), bVIH1);
 
     return S_OK;
@@ -823,6 +883,9 @@ HRESULT CLAVVideo::CreateDecoder(const CMediaType *pmt)
 
     SAFE_CO_FREE(pszExtension);
 
+    // Cached frames belong to the previous stream
+    m_FrameCache.Clear();
+
     hr = m_Decoder.CreateDecoder(pmt, codec, pSideDataFFmpeg);
     if (FAILED(hr))
     {
@@ -830,6 +893,16 @@ HRESULT CLAVVideo::CreateDecoder(const CMediaType *pmt)
         goto done;
     }
 
+    // Scale the conversion and deinterlacing threads with the number of decoders sharing the thread budget
+    m_PixFmtConverter.SetNumThreads(DecoderThreadBudget::GetConverterThreads());
+    m_Deinterlacer.SetNumThreads(DecoderThreadBudget::GetConverterThreads());
+
+    // New decoders start at full quality
+    m_QualityControl.Reset();
+    m_DecoderQualityLevel = LAVQualityLevel_Full;
+    m_LatencyMonitor.Reset();
+    m_PipelineStats.Reset();
+
     // Get avg time per frame
     videoFormatTypeHandler(pmt->Format(), pmt->FormatType(), nullptr, &m_rtAvgTimePerFrame);
 
@@ -841,7 +914,8 @@ HRESULT CLAVVideo::CreateDecoder(const CMediaType *pmt)
     if (m_PixFmtConverter.SetInputFmt(sw_pixfmt, bpp) && m_pOutput->IsConnected())
         m_bForceFormatNegotiation = TRUE;
 
-    if (pix == LAVPixFmt_YUV420 || pix == LAVPixFmt_YUV422 || pix == LAVPixFmt_NV12)
+    if (pix == LAVPixFmt_YUV420 || pix == LAVPixFmt_YUV422 || pix == LAVPixFmt_NV12 ||
+        (UseNativeDeinterlacer() && CDeinterlacer::IsFormatSupported(pix)))
         m_filterPixFmt = pix;
 
     if (m_settings.bCCOutputPinEnabled && !bDVDPlayback &&
@@ -861,7 +935,8 @@ HRESULT CLAVVideo::CheckDirectMode()
     int bpp;
     m_Decoder.GetPixelFormat(&pix, &bpp, nullptr);
 
-    GUID outputSubtype = m_pOutput->CurrentMediaType().subtype;
+    GUID outputSubtype = GUID_NULL;
+    GetOutputFormat(&outputSubtype, nullptr, nullptr);
 
     BOOL bDirect = (pix == LAVPixFmt_NV12 || pix == LAVPixFmt_P016 || pix == LAVPixFmt_YUY2 || pix == LAVPixFmt_Y216 || pix == LAVPixFmt_AYUV || pix == LAVPixFmt_Y410 || pix == LAVPixFmt_Y416);
     if (pix == LAVPixFmt_NV12 && m_Decoder.IsInterlaced(FALSE) && m_settings.SWDeintMode != SWDeintMode_None)
@@ -883,6 +958,9 @@ HRESULT CLAVVideo::CheckDirectMode()
         bDirect = FALSE;
     else if (m_SubtitleConsumer && m_SubtitleConsumer->HasProvider())
         bDirect = FALSE;
+    // direct frames can only be accessed on the decoding thread
+    else if (m_DeliveryPipeline.IsRunning())
+        bDirect = FALSE;
 
     m_Decoder.SetDirectOutput(bDirect);
 
@@ -905,10 +983,31 @@ HRESULT CLAVVideo::SetMediaType(PIN_DIRECTION dir, const CMediaType *pmt)
     else if (dir == PINDIR_OUTPUT)
     {
         m_PixFmtConverter.SetOutputPixFmt(m_PixFmtConverter.GetOutputBySubtype(pmt->Subtype()));
+
+        BITMAPINFOHEADER *pBIH = nullptr;
+        REFERENCE_TIME rtAvgTimePerFrame = 0;
+        videoFormatTypeHandler(pmt->Format(), pmt->FormatType(), &pBIH, &rtAvgTimePerFrame);
+
+        CAutoLock lock(&m_OutputFormat.cs);
+        m_OutputFormat.subtype = pmt->subtype;
+        m_OutputFormat.lStride = pBIH ? pBIH->biWidth : 0;
+        m_OutputFormat.rtAvgTimePerFrame = rtAvgTimePerFrame;
     }
     return __super::SetMediaType(dir, pmt);
 }
 
+STDMETHODIMP CLAVVideo::GetOutputFormat(GUID *pSubtype, LONG *pStride, REFERENCE_TIME *pAvgTimePerFrame)
+{
+    CAutoLock lock(&m_OutputFormat.cs);
+    if (pSubtype)
+        *pSubtype = m_OutputFormat.subtype;
+    if (pStride)
+        *pStride = m_OutputFormat.lStride;
+    if (pAvgTimePerFrame)
+        *pAvgTimePerFrame = m_OutputFormat.rtAvgTimePerFrame;
+    return S_OK;
+}
+
 HRESULT CLAVVideo::EndOfStream()
 {
     DbgLog((LOG_TRACE, 1, L"EndOfStream, flushing decoder"));
@@ -916,6 +1015,7 @@ HRESULT CLAVVideo::EndOfStream()
 
     m_Decoder.EndOfStream();
     Filter(GetFlushFrame());
+    m_DeliveryPipeline.Drain();
 
     if (m_pCCOutputPin)
         m_pCCOutputPin->DeliverEndOfStream();
@@ -931,6 +1031,7 @@ HRESULT CLAVVideo::EndOfSegment()
 
     m_Decoder.EndOfStream();
     Filter(GetFlushFrame());
+    m_DeliveryPipeline.Drain();
 
     // Forward the EndOfSegment call downstream
     if (m_pOutput != NULL && m_pOutput->IsConnected())
@@ -964,6 +1065,8 @@ HRESULT CLAVVideo::EndFlush()
     DbgLog((LOG_TRACE, 1, L"::EndFlush"));
     CAutoLock cAutoLock(&m_csReceive);
 
+    // frames queued for delivery belong to the flushed segment
+    m_DeliveryPipeline.Discard();
     ReleaseLastSequenceFrame();
 
     if (m_dwDecodeFlags & LAV_VIDEO_DEC_FLAG_DVD)
@@ -1003,6 +1106,7 @@ HRESULT CLAVVideo::PerformFlush()
 {
     CAutoLock cAutoLock(&m_csReceive);
 
+    m_DeliveryPipeline.Drain();
     ReleaseLastSequenceFrame();
     m_Decoder.Flush();
 
@@ -1010,10 +1114,15 @@ HRESULT CLAVVideo::PerformFlush()
 
     if (m_pFilterGraph)
         avfilter_graph_free(&m_pFilterGraph);
+    m_Deinterlacer.Reset();
 
     m_rtPrevStart = m_rtPrevStop = 0;
     memset(&m_FilterPrevFrame, 0, sizeof(m_FilterPrevFrame));
 
+    m_QualityControl.Flush();
+    m_LatencyMonitor.Reset();
+    m_rtPrerollEnd = AV_NOPTS_VALUE;
+
     return S_OK;
 }
 
@@ -1023,6 +1132,14 @@ HRESULT CLAVVideo::NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, doubl
 
     PerformFlush();
 
+    // Check the frame cache for the new position with the first input sample
+    m_FrameCache.EndReplay();
+    m_bFrameCacheLookup = m_FrameCache.IsEnabled();
+
+    // Measure the time until the first frame of the new segment is shown
+    m_SeekStats.llStart = CPipelineStats::Now();
+    m_SeekStats.nPendingPreroll = 0;
+
     if (m_pCCOutputPin)
         m_pCCOutputPin->DeliverNewSegment(tStart, tStop, dRate);
 
@@ -1069,8 +1186,10 @@ HRESULT CLAVVideo::BreakConnect(PIN_DIRECTION dir)
     {
         if (m_pFilterGraph)
             avfilter_graph_free(&m_pFilterGraph);
+        m_Deinterlacer.Reset();
 
         m_Decoder.Close();
+        m_FrameCache.Clear();
         m_X264Build = -1;
     }
     else if (dir == PINDIR_OUTPUT)
@@ -1211,6 +1330,17 @@ HRESULT CLAVVideo::StartStreaming()
         }
     }
 
+    // Low-latency mode delivers every frame right away, without the delivery queue
+    if (m_settings.bPipelinedDelivery && !m_settings.bLowLatency)
+        m_DeliveryPipeline.Start();
+    CheckDirectMode();
+
+    return S_OK;
+}
+
+HRESULT CLAVVideo::StopStreaming()
+{
+    m_DeliveryPipeline.Stop();
     return S_OK;
 }
 
@@ -1453,6 +1583,8 @@ HRESULT CLAVVideo::ReconnectOutput(int width, int height, AVRational ar, DXVA2_E
     if (bNeedReconnect)
     {
         DbgLog((LOG_TRACE, 10, L"::ReconnectOutput(): Performing reconnect"));
+        TrimLAVFrameBufferPool();
+
         BITMAPINFOHEADER *pBIH = nullptr;
         if (mt.formattype == FORMAT_VideoInfo)
         {
@@ -1738,6 +1870,7 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
         {
             DbgLog((LOG_TRACE, 10, L"::Receive(): Input sample contained media type, dynamic format change..."));
             m_Decoder.EndOfStream();
+            m_DeliveryPipeline.Drain();
             hr = m_pInput->SetMediaType(&mt);
             if (FAILED(hr))
             {
@@ -1755,7 +1888,57 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
         return S_OK;
     }
 
+    // Serve the start of a new segment from the frame cache, if it has the frames
+    if (m_bFrameCacheLookup)
+    {
+        m_bFrameCacheLookup = FALSE;
+        DeliverCachedFrames();
+        if (FAILED(m_hrDeliver))
+            return m_hrDeliver;
+    }
+
+    if (m_settings.bLowLatency)
+    {
+        REFERENCE_TIME rtStart = AV_NOPTS_VALUE, rtStop = AV_NOPTS_VALUE;
+        if (pIn->GetTime(&rtStart, &rtStop) != VFW_E_SAMPLE_TIME_NOT_SET)
+            m_LatencyMonitor.InputSample(rtStart);
+    }
+
+    // Samples flagged as preroll are only decoded as references, even if their timestamp is after the segment start
+    if (pIn->IsPreroll() == S_OK)
+    {
+        REFERENCE_TIME rtStart = AV_NOPTS_VALUE, rtStop = AV_NOPTS_VALUE;
+        if (pIn->GetTime(&rtStart, &rtStop) != VFW_E_SAMPLE_TIME_NOT_SET)
+            m_rtPrerollEnd = max(m_rtPrerollEnd, rtStart);
+    }
+
+    LARGE_INTEGER liStart, liEnd;
+    m_llParseTicks = 0;
+    m_llCallbackTicks = 0;
+    QueryPerformanceCounter(&liStart);
     hr = m_Decoder.Decode(pIn);
+    QueryPerformanceCounter(&liEnd);
+
+    // Frames are processed from within the decoder, everything outside of the callback and the parser is decoding
+    LONGLONG llDecodeTicks = liEnd.QuadPart - liStart.QuadPart - m_llParseTicks - m_llCallbackTicks;
+    if (m_llParseTicks)
+        m_PipelineStats.Add(LAVPipelineStage_Parse, m_llParseTicks);
+    m_PipelineStats.Add(LAVPipelineStage_Decode, llDecodeTicks);
+    m_PipelineStats.LogPeriodic();
+
+    if (m_DeliveryPipeline.IsRunning())
+        m_DeliveryPipeline.AddDecodeTime(liEnd.QuadPart - liStart.QuadPart);
+
+    // Only the decoder itself can be sped up by lowering the quality, waiting for a free output buffer or the
+    // conversion of the decoded frames would make a busy renderer look like an overloaded decoder
+    m_QualityControl.AddDecodeTime(llDecodeTicks);
+
+    if (m_QualityControl.GetLevel() != m_DecoderQualityLevel)
+    {
+        m_DecoderQualityLevel = m_QualityControl.GetLevel();
+        m_Decoder.SetQualityLevel(m_DecoderQualityLevel);
+    }
+
     if (FAILED(hr))
         return hr;
 
@@ -1765,12 +1948,33 @@ HRESULT CLAVVideo::Receive(IMediaSample *pIn)
     return S_OK;
 }
 
+HRESULT CLAVVideo::AlterQuality(Quality q)
+{
+    // Pass the message upstream if we don't handle it
+    if (!m_settings.bQualityControl || m_Decoder.IsHWDecoderActive())
+        return S_FALSE;
+
+    m_QualityControl.Notify(q);
+    return S_OK;
+}
+
 // ILAVVideoCallback
 STDMETHODIMP CLAVVideo::AllocateFrame(LAVFrame **ppFrame)
 {
     CheckPointer(ppFrame, E_POINTER);
 
-    *ppFrame = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
+    *ppFrame = nullptr;
+    {
+        CAutoLock lock(&m_csFreeFrames);
+        if (!m_FreeFrames.empty())
+        {
+            *ppFrame = m_FreeFrames.back();
+            m_FreeFrames.pop_back();
+        }
+    }
+
+    if (!*ppFrame)
+        *ppFrame = (LAVFrame *)CoTaskMemAlloc(sizeof(LAVFrame));
     if (!*ppFrame)
     {
         return E_OUTOFMEMORY;
@@ -1798,7 +2002,18 @@ STDMETHODIMP CLAVVideo::ReleaseFrame(LAVFrame **ppFrame)
     if (*ppFrame)
     {
         FreeLAVFrameBuffers(*ppFrame);
-        SAFE_CO_FREE(*ppFrame);
+
+        // Keep the frame structure around for the next frame, all frames are allocated with CoTaskMemAlloc
+        CAutoLock lock(&m_csFreeFrames);
+        if (m_FreeFrames.size() < LAV_FREE_FRAMES_MAX)
+        {
+            m_FreeFrames.push_back(*ppFrame);
+            *ppFrame = nullptr;
+        }
+        else
+        {
+            SAFE_CO_FREE(*ppFrame);
+        }
     }
     return S_OK;
 }
@@ -1879,7 +2094,9 @@ STDMETHODIMP CLAVVideo::Deliver(LAVFrame *pFrame)
     if (pFrame->flags & LAV_FRAME_FLAG_FLUSH)
     {
         DbgLog((LOG_TRACE, 10, L"Decoder triggered a flush..."));
+        LONGLONG llStart = CPipelineStats::Now();
         Filter(GetFlushFrame());
+        m_llCallbackTicks += CPipelineStats::Now() - llStart;
 
         ReleaseFrame(&pFrame);
         return S_FALSE;
@@ -1900,9 +2117,7 @@ STDMETHODIMP CLAVVideo::Deliver(LAVFrame *pFrame)
     if (pFrame->rtStop == AV_NOPTS_VALUE)
     {
         REFERENCE_TIME duration = 0;
-
-        CMediaType &mt = m_pOutput->CurrentMediaType();
-        videoFormatTypeHandler(mt.Format(), mt.FormatType(), nullptr, &duration, nullptr, nullptr);
+        GetOutputFormat(nullptr, nullptr, &duration);
 
         REFERENCE_TIME decoderDuration = m_Decoder.GetFrameDuration();
         if (pFrame->avgFrameDuration && pFrame->avgFrameDuration != AV_NOPTS_VALUE)
@@ -1936,28 +2151,66 @@ STDMETHODIMP CLAVVideo::Deliver(LAVFrame *pFrame)
     else
         m_rtAvgTimePerFrame = pFrame->avgFrameDuration;
 
+    // Frames that were already delivered from the frame cache
+    if (m_FrameCache.IsReplayed(pFrame->rtStart + m_pInput->CurrentStartTime()))
+    {
+        ReleaseFrame(&pFrame);
+        return S_OK;
+    }
+
+    if (pFrame->rtStart < 0 || pFrame->rtStart <= m_rtPrerollEnd)
+        m_SeekStats.nPendingPreroll++;
+
+    // Frames of preroll samples after the segment start are dropped right away, they can't be cached either
+    if (pFrame->rtStart >= 0 && pFrame->rtStart <= m_rtPrerollEnd && !(pFrame->flags & LAV_FRAME_FLAG_REDRAW))
+    {
+        ReleaseFrame(&pFrame);
+        return S_OK;
+    }
+
     if (pFrame->rtStart < 0)
     {
+        // Preroll frames are not delivered, but converted into the frame cache, so stepping backwards within the GOP
+        // does not need to decode it again. Deinterlacing needs the frames in sequence, so those are not cached.
+        if (CanCacheFrame(pFrame) && !(m_Decoder.IsInterlaced(FALSE) && m_settings.SWDeintMode != SWDeintMode_None))
+            return DeliverToRenderer(pFrame);
+
         ReleaseFrame(&pFrame);
         return S_OK;
     }
 
+    if (m_settings.bQualityControl && !m_Decoder.IsHWDecoderActive())
+        m_QualityControl.FrameDecoded(pFrame->rtStart, m_pInput->CurrentRate());
+
+    HRESULT hr = S_OK;
+    LONGLONG llStart = CPipelineStats::Now();
+
     // Only perform filtering if we have to.
     // DXVA Native generally can't be filtered, and the only filtering we currently support is software deinterlacing
     if (pFrame->format == LAVPixFmt_DXVA2 || pFrame->format == LAVPixFmt_D3D11 ||
         !(m_Decoder.IsInterlaced(FALSE) && m_settings.SWDeintMode != SWDeintMode_None) ||
         pFrame->flags & LAV_FRAME_FLAG_REDRAW)
     {
-        return DeliverToRenderer(pFrame);
+        hr = DeliverToRenderer(pFrame);
     }
     else
     {
         Filter(pFrame);
     }
-    return S_OK;
+
+    m_llCallbackTicks += CPipelineStats::Now() - llStart;
+    return hr;
 }
 
 HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
+{
+    if (m_DeliveryPipeline.IsRunning())
+        return m_DeliveryPipeline.Queue(pFrame);
+
+    return ConvertAndDeliver(pFrame);
+}
+
+HRESULT CLAVVideo::ConvertAndDeliver(LAVFrame *pFrame)
 {
     HRESULT hr = S_OK;
 
@@ -1968,6 +2221,10 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         return S_FALSE;
     }
 
+    // Preroll frames only go into the frame cache
+    if (pFrame->rtStart < 0 && !(pFrame->flags & LAV_FRAME_FLAG_REDRAW))
+        return CacheFrame(pFrame);
+
     if (!(pFrame->flags & LAV_FRAME_FLAG_REDRAW))
     {
         // Release the old End-of-Sequence frame, this ensures any "normal" frame will clear the stored EOS frame
@@ -2051,6 +2308,20 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         return S_FALSE;
     }
 
+    // Don't spend any time converting frames that are going to be late anyway
+    if (m_QualityControl.GetLevel() >= LAVQualityLevel_DropLate && m_State == State_Running && m_pClock &&
+        !(pFrame->flags & LAV_FRAME_FLAG_END_OF_SEQUENCE))
+    {
+        // Not using StreamTime(), it takes the filter lock
+        REFERENCE_TIME rtClock = 0;
+        if (SUCCEEDED(m_pClock->GetTime(&rtClock)) &&
+            m_QualityControl.DropLateFrame(pFrame->rtStop, rtClock - m_tStart))
+        {
+            ReleaseFrame(&pFrame);
+            return S_OK;
+        }
+    }
+
     // Process stream-level sidedata and attach it to the frame if necessary
     if (m_SideData.Mastering.has_colorspace)
     {
@@ -2119,10 +2390,24 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         height = 1080;
     }
 
+    // Subtitles are laid out for the full video size
+    const int videoWidth = width, videoHeight = height;
+
+    // Preview decoding, frames the decoder could not reduce itself are decimated by the converter
+    if (pFrame->decimation)
+    {
+        width = AV_CEIL_RSHIFT(width, pFrame->decimation);
+        height = AV_CEIL_RSHIFT(height, pFrame->decimation);
+    }
+    m_PixFmtConverter.SetDecimation(pFrame->decimation);
+
     if (m_PixFmtConverter.SetInputFmt(pFrame->sw_format, pFrame->bpp) || m_bForceFormatNegotiation)
     {
         DbgLog((LOG_TRACE, 10, L"::Decode(): Changed input pixel format to %d (%d bpp, hw: %d)", pFrame->sw_format, pFrame->bpp, (pFrame->format != pFrame->sw_format)));
 
+        // Buffers of the previous format are not going to be used anymore
+        TrimLAVFrameBufferPool();
+
         CMediaType &mt = m_pOutput->CurrentMediaType();
 
         if (m_PixFmtConverter.GetOutputBySubtype(mt.Subtype()) != m_PixFmtConverter.GetPreferredOutput())
@@ -2132,31 +2417,18 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         m_bForceFormatNegotiation = FALSE;
     }
     m_PixFmtConverter.SetColorProps(pFrame->ext_format, m_settings.RGBRange);
-
-    // Update flags for cases where the converter can change the nominal range
-    if (m_PixFmtConverter.IsRGBConverterActive())
-    {
-        if (m_settings.RGBRange != 0)
-            pFrame->ext_format.NominalRange =
-                m_settings.RGBRange == 1 ? DXVA2_NominalRange_16_235 : DXVA2_NominalRange_0_255;
-        else if (pFrame->ext_format.NominalRange == DXVA2_NominalRange_Unknown)
-            pFrame->ext_format.NominalRange = DXVA2_NominalRange_16_235;
-    }
-    else if (m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB32 ||
-             m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB24 ||
-             m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB48)
-    {
-        pFrame->ext_format.NominalRange = DXVA2_NominalRange_0_255;
-    }
+    UpdateNominalRange(pFrame);
 
     // Check if we are doing RGB output
     BOOL bRGBOut = (m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB24 ||
                     m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB32);
     // And blend subtitles if we're on YUV output before blending (because the output YUV formats are more complicated
     // to handle)
+    LONGLONG llSubtitleTicks = 0;
     if (m_SubtitleConsumer && m_SubtitleConsumer->HasProvider())
     {
-        m_SubtitleConsumer->SetVideoSize(width, height);
+        LONGLONG llStart = CPipelineStats::Now();
+        m_SubtitleConsumer->SetVideoSize(videoWidth, videoHeight);
         m_SubtitleConsumer->RequestFrame(pFrame->rtStart, pFrame->rtStop);
         if (!bRGBOut)
         {
@@ -2171,6 +2443,7 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             }
             m_SubtitleConsumer->ProcessFrame(pFrame);
         }
+        llSubtitleTicks = CPipelineStats::Now() - llStart;
     }
 
     // Grab a media sample, and start assembling the data for it.
@@ -2193,9 +2466,11 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     }
     else
     {
-        if (FAILED(hr = GetDeliveryBuffer(&pSampleOut, width, height, pFrame->aspect_ratio, pFrame->ext_format,
-                                          avgDuration)) ||
-            FAILED(hr = pSampleOut->GetPointer(&pDataOut)) || pDataOut == nullptr)
+        LONGLONG llStart = CPipelineStats::Now();
+        hr = GetDeliveryBuffer(&pSampleOut, width, height, pFrame->aspect_ratio, pFrame->ext_format, avgDuration);
+        m_PipelineStats.Add(LAVPipelineStage_OutputWait, CPipelineStats::Now() - llStart);
+
+        if (FAILED(hr) || FAILED(hr = pSampleOut->GetPointer(&pDataOut)) || pDataOut == nullptr)
         {
             SafeRelease(&pSampleOut);
             ReleaseFrame(&pFrame);
@@ -2267,7 +2542,10 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         QueryPerformanceCounter(&start);
 #endif
 
-        if (pFrame->direct && !m_PixFmtConverter.IsDirectModeSupported((uintptr_t)pDataOut, pBIH->biWidth))
+        LONGLONG llConvertStart = CPipelineStats::Now();
+
+        if (pFrame->direct &&
+            (pFrame->decimation || !m_PixFmtConverter.IsDirectModeSupported((uintptr_t)pDataOut, pBIH->biWidth)))
         {
             DeDirectFrame(pFrame, true);
         }
@@ -2283,7 +2561,10 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         double diff = (end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
         m_pixFmtTimingAvg.Sample(diff);
 
-        DbgLog((LOG_TRACE, 10, L"Pixel Mapping took %2.3fms in avg", m_pixFmtTimingAvg.Average()));
+        // Memory bandwidth of the conversion, counting one read and one write of the output image
+        double avg = m_pixFmtTimingAvg.Average();
+        DbgLog((LOG_TRACE, 10, L"Pixel Mapping took %2.3fms in avg (%.0f MB/s, input stride %d, output stride %d)", avg,
+                avg > 0.0 ? (2.0 * pBIH->biSizeImage / 1000.0) / avg : 0.0, pFrame->stride[0], pBIH->biWidth));
 #endif
 
         // Write the second view into IMediaSample3D, if available
@@ -2302,6 +2583,8 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             }
         }
 
+        m_PipelineStats.Add(LAVPipelineStage_Convert, CPipelineStats::Now() - llConvertStart);
+
         // Once we're done with the old frame, release its buffers
         // This does not release the frame yet, just free its buffers
         FreeLAVFrameBuffers(pFrame);
@@ -2330,7 +2613,15 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             pFrame->sw_format = pixFmt;
             pFrame->bpp = 8;
             pFrame->flags |= LAV_FRAME_FLAG_BUFFER_MODIFY;
+            if (pFrame->decimation)
+            {
+                pFrame->width = width;
+                pFrame->height = height;
+            }
+
+            LONGLONG llStart = CPipelineStats::Now();
             m_SubtitleConsumer->ProcessFrame(pFrame);
+            llSubtitleTicks += CPipelineStats::Now() - llStart;
         }
 
         if ((mt.subtype == MEDIASUBTYPE_RGB32 || mt.subtype == MEDIASUBTYPE_RGB24) && pBIH->biHeight > 0)
@@ -2340,6 +2631,9 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
         }
     }
 
+    if (m_SubtitleConsumer && m_SubtitleConsumer->HasProvider())
+        m_PipelineStats.Add(LAVPipelineStage_Subtitles, llSubtitleTicks);
+
     BOOL bSizeChanged = FALSE;
     if (m_bSendMediaType)
     {
@@ -2351,6 +2645,8 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
             bSizeChanged = TRUE;
     }
 
+    REFERENCE_TIME rtFrameStart = pFrame->rtStart;
+
     // Handle DVD playback rate..
     if (GetDecodeFlags() & LAV_VIDEO_DEC_FLAG_DVD)
     {
@@ -2377,10 +2673,26 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     // And frame flags..
     SetFrameFlags(pSampleOut, pFrame);
 
+    // Keep a copy for seeks back into the current GOP
+    if (pDataOut && CanCacheFrame(pFrame))
+    {
+        CFrameCache::FrameFormat format = {width, height, pFrame->aspect_ratio, pFrame->ext_format, avgDuration};
+        m_FrameCache.Add(pSampleOut, mt, m_pInput->CurrentStartTime(), format, pFrame->key_frame);
+    }
+
     // Release frame before delivery, so it can be re-used by the decoder (if required)
     ReleaseFrame(&pFrame);
 
+    LARGE_INTEGER liStart, liEnd;
+    QueryPerformanceCounter(&liStart);
     hr = m_pOutput->Deliver(pSampleOut);
+    QueryPerformanceCounter(&liEnd);
+    m_PipelineStats.Add(LAVPipelineStage_Deliver, liEnd.QuadPart - liStart.QuadPart);
+    m_DeliveryPipeline.AddDownstreamTime(liEnd.QuadPart - liStart.QuadPart);
+    if (m_settings.bLowLatency && SUCCEEDED(hr))
+        m_LatencyMonitor.FrameDelivered(rtFrameStart);
+    if (SUCCEEDED(hr))
+        SeekFrameDelivered();
     if (FAILED(hr))
     {
         DbgLog((LOG_ERROR, 10, L"::Decode(): Deliver failed with hr: %x", hr));
@@ -2395,6 +2707,153 @@ HRESULT CLAVVideo::DeliverToRenderer(LAVFrame *pFrame)
     return hr;
 }
 
+void CLAVVideo::UpdateNominalRange(LAVFrame *pFrame)
+{
+    // Update flags for cases where the converter can change the nominal range
+    if (m_PixFmtConverter.IsRGBConverterActive())
+    {
+        if (m_settings.RGBRange != 0)
+            pFrame->ext_format.NominalRange =
+                m_settings.RGBRange == 1 ? DXVA2_NominalRange_16_235 : DXVA2_NominalRange_0_255;
+        else if (pFrame->ext_format.NominalRange == DXVA2_NominalRange_Unknown)
+            pFrame->ext_format.NominalRange = DXVA2_NominalRange_16_235;
+    }
+    else if (m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB32 ||
+             m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB24 ||
+             m_PixFmtConverter.GetOutputPixFmt() == LAVOutPixFmt_RGB48)
+    {
+        pFrame->ext_format.NominalRange = DXVA2_NominalRange_0_255;
+    }
+}
+
+BOOL CLAVVideo::CanCacheFrame(LAVFrame *pFrame)
+{
+    // Hardware surfaces stay on the GPU, and subtitles or DVD menus depend on more than the frame time
+    return m_FrameCache.IsEnabled() && pFrame->format != LAVPixFmt_DXVA2 && pFrame->format != LAVPixFmt_D3D11 &&
+           !(pFrame->flags & (LAV_FRAME_FLAG_MVC | LAV_FRAME_FLAG_REDRAW)) &&
+           !(m_dwDecodeFlags & LAV_VIDEO_DEC_FLAG_DVD) && !(m_SubtitleConsumer && m_SubtitleConsumer->HasProvider());
+}
+
+HRESULT CLAVVideo::CacheFrame(LAVFrame *pFrame)
+{
+    int width = pFrame->width;
+    int height = pFrame->height;
+    if (width == 1920 && height == 1088)
+        height = 1080;
+    if (pFrame->decimation)
+    {
+        width = AV_CEIL_RSHIFT(width, pFrame->decimation);
+        height = AV_CEIL_RSHIFT(height, pFrame->decimation);
+    }
+
+    // Preroll frames are converted into the current output format, a format change has to wait for a delivered frame
+    CMediaType &mt = m_pOutput->CurrentMediaType();
+    BITMAPINFOHEADER *pBIH = nullptr;
+    videoFormatTypeHandler(mt.Format(), mt.FormatType(), &pBIH);
+    if (!pBIH || m_bSendMediaType || !m_PixFmtConverter.IsInputFmt(pFrame->sw_format, pFrame->bpp) ||
+        width > pBIH->biWidth || height != abs(pBIH->biHeight))
+    {
+        ReleaseFrame(&pFrame);
+        return S_OK;
+    }
+
+    LONGLONG llConvertStart = CPipelineStats::Now();
+
+    long lSize = m_PixFmtConverter.GetImageSize(pBIH->biWidth, abs(pBIH->biHeight));
+    BYTE *pBuffer = m_FrameCache.AllocBuffer(lSize);
+    if (!pBuffer)
+    {
+        ReleaseFrame(&pFrame);
+        return E_OUTOFMEMORY;
+    }
+
+    m_PixFmtConverter.SetColorProps(pFrame->ext_format, m_settings.RGBRange);
+    m_PixFmtConverter.SetDecimation(pFrame->decimation);
+    UpdateNominalRange(pFrame);
+
+    if (pFrame->direct)
+        DeDirectFrame(pFrame, false);
+    m_PixFmtConverter.Convert(pFrame->data, pFrame->stride, pBuffer, width, height, pBIH->biWidth,
+                              abs(pBIH->biHeight));
+
+    if ((mt.subtype == MEDIASUBTYPE_RGB32 || mt.subtype == MEDIASUBTYPE_RGB24) && pBIH->biHeight > 0)
+    {
+        int bpp = (mt.subtype == MEDIASUBTYPE_RGB32) ? 4 : 3;
+        flip_plane(pBuffer, pBIH->biWidth * bpp, height);
+    }
+
+    m_PipelineStats.Add(LAVPipelineStage_Convert, CPipelineStats::Now() - llConvertStart);
+
+    REFERENCE_TIME avgDuration = pFrame->avgFrameDuration ? pFrame->avgFrameDuration : AV_NOPTS_VALUE;
+    CFrameCache::FrameFormat format = {width, height, pFrame->aspect_ratio, pFrame->ext_format, avgDuration};
+    const REFERENCE_TIME rtSegment = m_pInput->CurrentStartTime();
+    m_FrameCache.AddBuffer(pBuffer, lSize, mt, pFrame->rtStart + rtSegment, pFrame->rtStop + rtSegment,
+                           GetFrameTypeFlags(pFrame), format, pFrame->key_frame);
+
+    ReleaseFrame(&pFrame);
+    return S_OK;
+}
+
+HRESULT CLAVVideo::DeliverCachedFrames()
+{
+    // The media type of a format change has to be sent with a decoded frame
+    if (m_bSendMediaType || !m_FrameCache.BeginReplay(m_pInput->CurrentStartTime(), m_pOutput->CurrentMediaType()))
+        return S_FALSE;
+
+    HRESULT hr = S_OK;
+    CFrameCache::FrameFormat format;
+    while (!m_bFlushing && m_FrameCache.GetReplayFormat(&format))
+    {
+        IMediaSample *pSampleOut = nullptr;
+        hr = GetDeliveryBuffer(&pSampleOut, format.width, format.height, format.aspect_ratio, format.ext_format,
+                               format.avgFrameDuration);
+        if (SUCCEEDED(hr) && !m_bSendMediaType)
+            hr = m_FrameCache.ReplayFrame(pSampleOut, m_pOutput->CurrentMediaType(), m_pInput->CurrentStartTime());
+        else if (SUCCEEDED(hr))
+            hr = VFW_E_TYPE_NOT_ACCEPTED;
+
+        // The output format changed, the decoder delivers the remaining frames
+        if (FAILED(hr))
+        {
+            DbgLog((LOG_TRACE, 10, L"::DeliverCachedFrames(): Replay stopped (hr: 0x%x)", hr));
+            SafeRelease(&pSampleOut);
+            m_FrameCache.StopReplay();
+            return hr;
+        }
+
+        LONGLONG llStart = CPipelineStats::Now();
+        hr = m_pOutput->Deliver(pSampleOut);
+        m_PipelineStats.Add(LAVPipelineStage_Deliver, CPipelineStats::Now() - llStart);
+        SafeRelease(&pSampleOut);
+
+        if (FAILED(hr))
+        {
+            DbgLog((LOG_ERROR, 10, L"::DeliverCachedFrames(): Deliver failed with hr: %x", hr));
+            m_hrDeliver = hr;
+            break;
+        }
+        SeekFrameDelivered();
+    }
+
+    return hr;
+}
+
+void CLAVVideo::SeekFrameDelivered()
+{
+    if (!m_SeekStats.llStart)
+        return;
+
+    CAutoLock lock(&m_SeekStats.csStats);
+    m_SeekStats.llLast = CPipelineStats::Now() - m_SeekStats.llStart;
+    m_SeekStats.llTotal += m_SeekStats.llLast;
+    m_SeekStats.nSeeks++;
+    m_SeekStats.nLastPreroll = m_SeekStats.nPendingPreroll;
+    m_SeekStats.llStart = 0;
+
+    DbgLog((LOG_TRACE, 10, L"::SeekFrameDelivered(): First frame after %.1f ms, %I64u preroll frames",
+            m_SeekStats.llLast * 1000.0 / m_SeekStats.liFrequency.QuadPart, m_SeekStats.nLastPreroll));
+}
+
 HRESULT CLAVVideo::GetD3DBuffer(LAVFrame *pFrame)
 {
     CheckPointer(pFrame, E_POINTER);
@@ -2439,7 +2898,8 @@ HRESULT CLAVVideo::RedrawStillImage()
     {
         CAutoLock lock(&m_csReceive);
         // Since a delivery call can clear the stored sequence frame, we need a second check here
-        // Because only after we obtained the receive lock, we are in charge..
+        // Because only after we obtained the receive lock, and delivered all queued frames, we are in charge..
+        m_DeliveryPipeline.Drain();
         if (!m_pLastSequenceFrame)
             return S_FALSE;
 
@@ -2510,15 +2970,7 @@ HRESULT CLAVVideo::SetFrameFlags(IMediaSample *pMS, LAVFrame *pFrame)
         if (SUCCEEDED(pMS2->GetProperties(sizeof(props), (BYTE *)&props)))
         {
             props.dwTypeSpecificFlags &= ~0x7f;
-
-            if (!pFrame->interlaced)
-                props.dwTypeSpecificFlags |= AM_VIDEO_FLAG_WEAVE;
-
-            if (pFrame->tff)
-                props.dwTypeSpecificFlags |= AM_VIDEO_FLAG_FIELD1FIRST;
-
-            if (pFrame->repeat)
-                props.dwTypeSpecificFlags |= AM_VIDEO_FLAG_REPEAT_FIELD;
+            props.dwTypeSpecificFlags |= GetFrameTypeFlags(pFrame);
 
             pMS2->SetProperties(sizeof(props), (BYTE *)&props);
         }
@@ -2527,6 +2979,22 @@ HRESULT CLAVVideo::SetFrameFlags(IMediaSample *pMS, LAVFrame *pFrame)
     return hr;
 }
 
+DWORD CLAVVideo::GetFrameTypeFlags(LAVFrame *pFrame)
+{
+    DWORD dwFlags = 0;
+
+    if (!pFrame->interlaced)
+        dwFlags |= AM_VIDEO_FLAG_WEAVE;
+
+    if (pFrame->tff)
+        dwFlags |= AM_VIDEO_FLAG_FIELD1FIRST;
+
+    if (pFrame->repeat)
+        dwFlags |= AM_VIDEO_FLAG_REPEAT_FIELD;
+
+    return dwFlags;
+}
+
 STDMETHODIMP CLAVVideo::Read(LPCOLESTR pszPropName, VARIANT *pVar, IErrorLog *pErrorLog)
 {
     CheckPointer(pszPropName, E_INVALIDARG);
@@ -2556,6 +3024,9 @@ STDMETHODIMP CLAVVideo::SetRuntimeConfig(BOOL bRuntimeConfig)
 {
     m_bRuntimeConfig = bRuntimeConfig;
     LoadSettings();
+    DecoderThreadBudget::SetBudget((int)m_settings.ThreadBudget);
+    m_FrameCache.SetMaxSize(m_settings.dwFrameCacheSize);
+    m_Decoder.SetPrerollSkip(!m_FrameCache.IsEnabled());
 
     // Tray Icon is disabled by default
     SAFE_DELETE(m_pTrayIcon);
@@ -2997,7 +3468,149 @@ STDMETHODIMP CLAVVideo::SetEnableCCOutputPin(BOOL bEnabled)
     return S_OK;
 }
 
+STDMETHODIMP CLAVVideo::SetPipelinedDelivery(BOOL bEnabled)
+{
+    m_settings.bPipelinedDelivery = bEnabled;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVVideo::GetPipelinedDelivery()
+{
+    return m_settings.bPipelinedDelivery;
+}
+
 STDMETHODIMP CLAVVideo::GetHWAccelActiveDevice(BSTR *pstrDeviceName)
 {
     return m_Decoder.GetHWAccelActiveDevice(pstrDeviceName);
 }
+
+STDMETHODIMP CLAVVideo::SetThreadBudget(DWORD dwNum)
+{
+    m_settings.ThreadBudget = dwNum;
+    DecoderThreadBudget::SetBudget((int)dwNum);
+    return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVVideo::GetThreadBudget()
+{
+    return m_settings.ThreadBudget;
+}
+
+STDMETHODIMP CLAVVideo::GetThreadBudgetStatus(int *pnBudget, int *pnDecoders, int *pnAllotted, int *pnThreads)
+{
+    DecoderThreadBudget::GetStatus(pnBudget, pnDecoders, pnAllotted);
+    if (pnThreads)
+        *pnThreads = m_Decoder.GetThreadAllotment();
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::SetQualityControl(BOOL bEnabled)
+{
+    m_settings.bQualityControl = bEnabled;
+    if (!bEnabled)
+        m_QualityControl.Reset();
+    return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVVideo::GetQualityControl()
+{
+    return m_settings.bQualityControl;
+}
+
+STDMETHODIMP CLAVVideo::GetQualityControlStatus(LAVQualityStatus *pStatus)
+{
+    CheckPointer(pStatus, E_POINTER);
+    m_QualityControl.GetStatus(pStatus);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::SetLowLatency(BOOL bEnabled)
+{
+    m_settings.bLowLatency = bEnabled;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVVideo::GetLowLatency()
+{
+    return m_settings.bLowLatency;
+}
+
+STDMETHODIMP CLAVVideo::SetPreviewHeight(DWORD dwHeight)
+{
+    m_settings.dwPreviewHeight = dwHeight;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVVideo::GetPreviewHeight()
+{
+    return m_settings.dwPreviewHeight;
+}
+
+STDMETHODIMP CLAVVideo::SetFrameCacheSize(DWORD dwSizeMB)
+{
+    m_settings.dwFrameCacheSize = dwSizeMB;
+    m_FrameCache.SetMaxSize(dwSizeMB);
+
+    // The frame cache keeps the preroll frames, so they have to be decoded in full
+    m_Decoder.SetPrerollSkip(!m_FrameCache.IsEnabled());
+    return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVVideo::GetFrameCacheSize()
+{
+    return m_settings.dwFrameCacheSize;
+}
+
+STDMETHODIMP CLAVVideo::GetLatencyStatus(REFERENCE_TIME *prtLast, REFERENCE_TIME *prtAverage, REFERENCE_TIME *prtMax,
+                                         ULONGLONG *pnFrames)
+{
+    m_LatencyMonitor.GetStatus(prtLast, prtAverage, prtMax, pnFrames);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::GetSeekStatus(ULONGLONG *pnSeeks, double *pdLastTime, double *pdAvgTime,
+                                      ULONGLONG *pnPrerollFrames)
+{
+    CAutoLock lock(&m_SeekStats.csStats);
+    const double dTicksPerMs = m_SeekStats.liFrequency.QuadPart / 1000.0;
+
+    if (pnSeeks)
+        *pnSeeks = m_SeekStats.nSeeks;
+    if (pdLastTime)
+        *pdLastTime = m_SeekStats.llLast / dTicksPerMs;
+    if (pdAvgTime)
+        *pdAvgTime = m_SeekStats.nSeeks ? m_SeekStats.llTotal / dTicksPerMs / m_SeekStats.nSeeks : 0.0;
+    if (pnPrerollFrames)
+        *pnPrerollFrames = m_SeekStats.nLastPreroll;
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::GetPipelinedDeliveryStatus(ULONGLONG *pnFrames, double *pdDecodeFps, double *pdConvertFps,
+                                                   double *pdDownstreamFps)
+{
+    m_DeliveryPipeline.GetStatus(pnFrames, pdDecodeFps, pdConvertFps, pdDownstreamFps);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::GetFrameCacheStatus(LAVFrameCacheStatus *pStatus)
+{
+    CheckPointer(pStatus, E_POINTER);
+    m_FrameCache.GetStatus(pStatus);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::GetStageStats(LAVPipelineStage stage, LAVPipelineStageStats *pStats)
+{
+    CheckPointer(pStats, E_POINTER);
+    if (stage < 0 || stage >= LAVPipelineStage_NB)
+        return E_INVALIDARG;
+
+    m_PipelineStats.GetStats(stage, pStats);
+    return S_OK;
+}
+
+STDMETHODIMP CLAVVideo::ResetStageStats()
+{
+    m_PipelineStats.Reset();
+    return S_OK;
+}
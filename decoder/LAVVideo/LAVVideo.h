@@ -34,6 +34,12 @@
 #include "subtitles/LAVVideoSubtitleInputPin.h"
 
 #include "CCOutputPin.h"
+#include "DeliveryPipeline.h"
+#include "QualityControl.h"
+#include "LatencyMonitor.h"
+#include "FrameCache.h"
+#include "Deinterlacer.h"
+#include "PipelineStats.h"
 
 #include "BaseTrayIcon.h"
 #include "IMediaSideData.h"
@@ -51,6 +57,9 @@ extern "C"
 #define LAVC_VIDEO_LOG_FILE L"LAVVideo.txt"
 
 #define DEBUG_FRAME_TIMINGS 0
+
+// Maximum number of unused frame structures kept for re-use
+#define LAV_FREE_FRAMES_MAX 16
 #define DEBUG_PIXELCONV_TIMINGS 0
 
 typedef struct
@@ -64,6 +73,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     , public ISpecifyPropertyPages2
     , public ILAVVideoSettings
     , public ILAVVideoStatus
+    , public ILAVVideoPipelineStats
     , public ILAVVideoCallback
     , public IPropertyBag
     , public ILAVVideoSettingsMPCHCCustom
@@ -153,9 +163,38 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
 
     STDMETHODIMP SetEnableCCOutputPin(BOOL bEnabled);
 
+    STDMETHODIMP SetPipelinedDelivery(BOOL bEnabled);
+    STDMETHODIMP_(BOOL) GetPipelinedDelivery();
+    STDMETHODIMP SetThreadBudget(DWORD dwNum);
+    STDMETHODIMP_(DWORD) GetThreadBudget();
+    STDMETHODIMP SetQualityControl(BOOL bEnabled);
+    STDMETHODIMP_(BOOL) GetQualityControl();
+    STDMETHODIMP SetLowLatency(BOOL bEnabled);
+    STDMETHODIMP_(BOOL) GetLowLatency();
+    STDMETHODIMP SetPreviewHeight(DWORD dwHeight);
+    STDMETHODIMP_(DWORD) GetPreviewHeight();
+    STDMETHODIMP SetFrameCacheSize(DWORD dwSizeMB);
+    STDMETHODIMP_(DWORD) GetFrameCacheSize();
+
     // ILAVVideoStatus
     STDMETHODIMP_(const WCHAR *) GetActiveDecoderName() { return m_Decoder.GetDecoderName(); }
     STDMETHODIMP GetHWAccelActiveDevice(BSTR *pstrDeviceName);
+    STDMETHODIMP GetThreadBudgetStatus(int *pnBudget, int *pnDecoders, int *pnAllotted, int *pnThreads);
+    STDMETHODIMP GetQualityControlStatus(LAVQualityStatus *pStatus);
+    STDMETHODIMP GetLatencyStatus(REFERENCE_TIME *prtLast, REFERENCE_TIME *prtAverage, REFERENCE_TIME *prtMax,
+                                  ULONGLONG *pnFrames);
+    STDMETHODIMP GetFormatSwitchStatus(ULONGLONG *pnSwitches, ULONGLONG *pnReused, double *pdAvgTime)
+    {
+        return m_Decoder.GetFormatSwitchStats(pnSwitches, pnReused, pdAvgTime);
+    }
+    STDMETHODIMP GetFrameCacheStatus(LAVFrameCacheStatus *pStatus);
+    STDMETHODIMP GetSeekStatus(ULONGLONG *pnSeeks, double *pdLastTime, double *pdAvgTime, ULONGLONG *pnPrerollFrames);
+    STDMETHODIMP GetPipelinedDeliveryStatus(ULONGLONG *pnFrames, double *pdDecodeFps, double *pdConvertFps,
+                                            double *pdDownstreamFps);
+
+    // ILAVVideoPipelineStats
+    STDMETHODIMP GetStageStats(LAVPipelineStage stage, LAVPipelineStageStats *pStats);
+    STDMETHODIMP ResetStageStats();
 
     // CTransformFilter
     STDMETHODIMP Stop();
@@ -171,12 +210,14 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     HRESULT EndFlush();
     HRESULT NewSegment(REFERENCE_TIME tStart, REFERENCE_TIME tStop, double dRate);
     HRESULT Receive(IMediaSample *pIn);
+    HRESULT AlterQuality(Quality q);
 
     HRESULT CheckConnect(PIN_DIRECTION dir, IPin *pPin);
     HRESULT BreakConnect(PIN_DIRECTION dir);
     HRESULT CompleteConnect(PIN_DIRECTION dir, IPin *pReceivePin);
 
     HRESULT StartStreaming();
+    HRESULT StopStreaming();
 
     int GetPinCount();
     CBasePin *GetPin(int n);
@@ -210,7 +251,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
         return E_FAIL;
     }
     STDMETHODIMP_(CBasePin *) GetOutputPin() { return m_pOutput; }
-    STDMETHODIMP_(CMediaType &) GetOutputMediaType() { return m_pOutput->CurrentMediaType(); }
+    STDMETHODIMP GetOutputFormat(GUID *pSubtype, LONG *pStride, REFERENCE_TIME *pAvgTimePerFrame);
     STDMETHODIMP DVDStripPacket(BYTE *&p, long &len)
     {
         static_cast<CDeCSSTransformInputPin *>(m_pInput)->StripPacket(p, len);
@@ -219,6 +260,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     STDMETHODIMP_(LAVFrame *) GetFlushFrame();
     STDMETHODIMP ReleaseAllDXVAResources()
     {
+        m_DeliveryPipeline.Drain();
         ReleaseLastSequenceFrame();
         return S_OK;
     }
@@ -230,6 +272,11 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
         return S_OK;
     }
     STDMETHODIMP_(int) GetX264Build() { return m_X264Build; }
+    STDMETHODIMP AddParseTime(LONGLONG llTicks)
+    {
+        m_llParseTicks += llTicks;
+        return S_OK;
+    }
 
     // IPropertyBag
     STDMETHODIMP Read(LPCOLESTR pszPropName, VARIANT *pVar, IErrorLog *pErrorLog);
@@ -258,6 +305,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
                             REFERENCE_TIME avgFrameDuration, BOOL bDXVA = FALSE);
 
     HRESULT SetFrameFlags(IMediaSample *pMS, LAVFrame *pFrame);
+    DWORD GetFrameTypeFlags(LAVFrame *pFrame);
 
     HRESULT NegotiatePixelFormat(CMediaType &mt, int width, int height);
     BOOL IsInterlacedOutput();
@@ -266,7 +314,19 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     HRESULT DeDirectFrame(LAVFrame *pFrame, bool bDisableDirectMode = true);
 
     HRESULT Filter(LAVFrame *pFrame);
+    HRESULT Deinterlace(LAVFrame *pFrame);
+
+    // BWDIF is run by the native deinterlacer, low-latency mode uses kerndeint in avfilter instead
+    BOOL UseNativeDeinterlacer() { return m_settings.SWDeintMode == SWDeintMode_BWDIF && !m_settings.bLowLatency; }
     HRESULT DeliverToRenderer(LAVFrame *pFrame);
+    HRESULT ConvertAndDeliver(LAVFrame *pFrame);
+
+    void UpdateNominalRange(LAVFrame *pFrame);
+
+    BOOL CanCacheFrame(LAVFrame *pFrame);
+    HRESULT CacheFrame(LAVFrame *pFrame);
+    HRESULT DeliverCachedFrames();
+    void SeekFrameDelivered();
 
     HRESULT PerformFlush();
     HRESULT ReleaseLastSequenceFrame();
@@ -285,8 +345,19 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     friend class CDecodeManager;
     friend class CLAVSubtitleProvider;
     friend class CLAVSubtitleConsumer;
+    friend class CDeliveryPipeline;
 
     CDecodeManager m_Decoder;
+    CDeliveryPipeline m_DeliveryPipeline{this};
+
+    // Output format fields used on the decoding thread, the delivery thread can renegotiate the output at any time
+    struct
+    {
+        CCritSec cs;
+        GUID subtype = GUID_NULL;
+        LONG lStride = 0;
+        REFERENCE_TIME rtAvgTimePerFrame = 0;
+    } m_OutputFormat;
 
     REFERENCE_TIME m_rtPrevStart = 0;
     REFERENCE_TIME m_rtPrevStop = 0;
@@ -299,6 +370,36 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
 
     HRESULT m_hrDeliver = S_OK;
 
+    CQualityController m_QualityControl;
+    LAVQualityLevel m_DecoderQualityLevel = LAVQualityLevel_Full;
+
+    CLatencyMonitor m_LatencyMonitor;
+
+    CFrameCache m_FrameCache;
+    BOOL m_bFrameCacheLookup = FALSE;
+
+    // Start time of input samples flagged as preroll, frames up to it are not shown
+    REFERENCE_TIME m_rtPrerollEnd = AV_NOPTS_VALUE;
+
+    // Time from a new segment to the delivery of its first frame
+    struct
+    {
+        CCritSec csStats;
+        LARGE_INTEGER liFrequency{};
+        LONGLONG llStart = 0;          // performance counter at the segment start, 0 once a frame was delivered
+        LONGLONG llLast = 0;
+        LONGLONG llTotal = 0;
+        ULONGLONG nSeeks = 0;
+        ULONGLONG nPendingPreroll = 0; // preroll frames decoded since the segment start
+        ULONGLONG nLastPreroll = 0;
+    } m_SeekStats;
+
+    CPipelineStats m_PipelineStats;
+
+    // Time spent in the parser and in the frame callback during the current input sample, to isolate decoding
+    LONGLONG m_llParseTicks = 0;
+    LONGLONG m_llCallbackTicks = 0;
+
     CLAVPixFmtConverter m_PixFmtConverter;
     std::wstring m_strExtension;
 
@@ -319,6 +420,8 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
     int m_filterHeight = 0;
     LAVFrame m_FilterPrevFrame;
 
+    CDeinterlacer m_Deinterlacer{this};
+
     BOOL m_LAVPinInfoValid = FALSE;
     LAVPinInfo m_LAVPinInfo;
     int m_X264Build = -1;
@@ -336,6 +439,9 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
 
     LAVFrame *m_pLastSequenceFrame = nullptr;
 
+    CCritSec m_csFreeFrames;
+    std::vector<LAVFrame *> m_FreeFrames;
+
     AM_SimpleRateChange m_DVDRate = AM_SimpleRateChange{AV_NOPTS_VALUE, 10000};
 
     BOOL m_bRuntimeConfig = FALSE;
@@ -344,6 +450,7 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
         BOOL TrayIcon;
         DWORD StreamAR;
         DWORD NumThreads;
+        DWORD ThreadBudget;
         BOOL bFormats[Codec_VideoNB];
         BOOL bMSWMV9DMO;
         BOOL bPixFmts[LAVOutPixFmt_NB];
@@ -366,6 +473,11 @@ class __declspec(uuid("EE30215D-164F-4A92-A4EB-9D4C13390F9F")) CLAVVideo
         DWORD HWAccelDeviceD3D11Desc;
         BOOL bH264MVCOverride;
         BOOL bCCOutputPinEnabled;
+        BOOL bPipelinedDelivery;
+        BOOL bQualityControl;
+        BOOL bLowLatency;
+        DWORD dwPreviewHeight;
+        DWORD dwFrameCacheSize;
     } m_settings;
 
     DWORD m_dwGPUDeviceIndex = DWORD_MAX;
@@ -0,0 +1,100 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LatencyMonitor.h"
+
+CLatencyMonitor::CLatencyMonitor()
+{
+    QueryPerformanceFrequency(&m_liFrequency);
+}
+
+void CLatencyMonitor::Reset()
+{
+    CAutoLock lock(&m_csLatency);
+
+    m_Pending.clear();
+    m_rtLast = m_rtMax = m_rtTotal = 0;
+    m_nFrames = 0;
+}
+
+void CLatencyMonitor::InputSample(REFERENCE_TIME rtStart)
+{
+    if (rtStart == AV_NOPTS_VALUE)
+        return;
+
+    LARGE_INTEGER liNow;
+    QueryPerformanceCounter(&liNow);
+
+    CAutoLock lock(&m_csLatency);
+
+    if (m_Pending.size() >= LATENCY_MAX_PENDING)
+        m_Pending.pop_front();
+    m_Pending.push_back({rtStart, liNow.QuadPart});
+}
+
+void CLatencyMonitor::FrameDelivered(REFERENCE_TIME rtStart)
+{
+    LARGE_INTEGER liNow;
+    QueryPerformanceCounter(&liNow);
+
+    CAutoLock lock(&m_csLatency);
+
+    // The pending samples are in decode order, look for the exact timestamp first, otherwise take the earliest
+    // sample before the frame. Samples after the frame in decode order can still be ahead in presentation order.
+    auto match = m_Pending.end();
+    for (auto it = m_Pending.begin(); it != m_Pending.end(); it++)
+    {
+        if (it->rtStart == rtStart)
+        {
+            match = it;
+            break;
+        }
+        if (it->rtStart < rtStart && (match == m_Pending.end() || it->rtStart < match->rtStart))
+            match = it;
+    }
+
+    if (match == m_Pending.end())
+        return;
+
+    REFERENCE_TIME rtLatency = (liNow.QuadPart - match->llArrival) * 10000000LL / m_liFrequency.QuadPart;
+    m_Pending.erase(match);
+
+    m_rtLast = rtLatency;
+    m_rtMax = max(m_rtMax, rtLatency);
+    m_rtTotal += rtLatency;
+    m_nFrames++;
+
+    DbgLog((LOG_TRACE, 20, L"CLatencyMonitor: frame %I64d, latency %.2f ms", rtStart, rtLatency / 10000.0));
+}
+
+void CLatencyMonitor::GetStatus(REFERENCE_TIME *prtLast, REFERENCE_TIME *prtAverage, REFERENCE_TIME *prtMax,
+                                ULONGLONG *pnFrames)
+{
+    CAutoLock lock(&m_csLatency);
+
+    if (prtLast)
+        *prtLast = m_rtLast;
+    if (prtAverage)
+        *prtAverage = m_nFrames ? (REFERENCE_TIME)(m_rtTotal / (LONGLONG)m_nFrames) : 0;
+    if (prtMax)
+        *prtMax = m_rtMax;
+    if (pnFrames)
+        *pnFrames = m_nFrames;
+}
@@ -0,0 +1,59 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <deque>
+
+// Maximum number of input samples waiting for their frame
+#define LATENCY_MAX_PENDING 64
+
+// Measures the time from the arrival of an input sample to the delivery of the frame decoded from it
+//
+// Frames are matched to input samples by their timestamp. Samples are pending in decode order while frames are
+// delivered in presentation order, so only the matched sample is removed. Frames without an exact match are
+// attributed to the earliest pending sample before them, which covers parsers that split or merge packets.
+class CLatencyMonitor
+{
+  public:
+    CLatencyMonitor();
+
+    void Reset();
+
+    void InputSample(REFERENCE_TIME rtStart);
+    void FrameDelivered(REFERENCE_TIME rtStart);
+
+    void GetStatus(REFERENCE_TIME *prtLast, REFERENCE_TIME *prtAverage, REFERENCE_TIME *prtMax, ULONGLONG *pnFrames);
+
+  private:
+    CCritSec m_csLatency;
+    LARGE_INTEGER m_liFrequency{};
+
+    struct PendingSample
+    {
+        REFERENCE_TIME rtStart;
+        LONGLONG llArrival;
+    };
+    std::deque<PendingSample> m_Pending;
+
+    REFERENCE_TIME m_rtLast = 0;
+    REFERENCE_TIME m_rtMax = 0;
+    REFERENCE_TIME m_rtTotal = 0;
+    ULONGLONG m_nFrames = 0;
+};
@@ -0,0 +1,91 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "PipelineStats.h"
+
+static const WCHAR *stage_names[LAVPipelineStage_NB] = {L"parse",     L"decode",      L"filter", L"convert",
+                                                        L"subtitles", L"output wait", L"deliver"};
+
+CPipelineStats::CPipelineStats()
+{
+    QueryPerformanceFrequency(&m_liFrequency);
+    m_llLastLog = Now();
+}
+
+void CPipelineStats::Reset()
+{
+    CAutoLock lock(&m_csStats);
+
+    memset(m_Stats, 0, sizeof(m_Stats));
+    m_llLastLog = Now();
+}
+
+void CPipelineStats::Add(LAVPipelineStage stage, LONGLONG llTicks)
+{
+    if (stage < 0 || stage >= LAVPipelineStage_NB || llTicks < 0)
+        return;
+
+    double dTime = llTicks * 1000.0 / m_liFrequency.QuadPart;
+
+    // Bucket 0 is below 0.125 ms, every following bucket doubles the limit
+    int bucket = 0;
+    for (double dLimit = 0.125; bucket < LAV_PIPELINE_HISTOGRAM_BUCKETS - 1 && dTime >= dLimit; dLimit *= 2.0)
+        bucket++;
+
+    CAutoLock lock(&m_csStats);
+
+    LAVPipelineStageStats &stats = m_Stats[stage];
+    stats.dAverage =
+        stats.nSamples ? stats.dAverage + (dTime - stats.dAverage) * PIPELINE_STATS_AVG_WEIGHT : dTime;
+    stats.dMax = max(stats.dMax, dTime);
+    stats.dTotal += dTime;
+    stats.nHistogram[bucket]++;
+    stats.nSamples++;
+}
+
+void CPipelineStats::LogPeriodic()
+{
+#ifdef DEBUG
+    LONGLONG llNow = Now();
+    if (llNow - m_llLastLog < PIPELINE_STATS_LOG_INTERVAL * m_liFrequency.QuadPart)
+        return;
+
+    CAutoLock lock(&m_csStats);
+    m_llLastLog = llNow;
+
+    WCHAR line[512] = L"";
+    for (int i = 0; i < LAVPipelineStage_NB; i++)
+    {
+        if (m_Stats[i].nSamples == 0)
+            continue;
+
+        WCHAR stage[64];
+        swprintf_s(stage, L" %s %.2f/%.2f ms", stage_names[i], m_Stats[i].dAverage, m_Stats[i].dMax);
+        wcscat_s(line, stage);
+    }
+    DbgLog((LOG_TRACE, 10, L"CPipelineStats: avg/max%s", line));
+#endif
+}
+
+void CPipelineStats::GetStats(LAVPipelineStage stage, LAVPipelineStageStats *pStats)
+{
+    CAutoLock lock(&m_csStats);
+    *pStats = m_Stats[stage];
+}
@@ -0,0 +1,64 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVVideoSettings.h"
+
+// Interval of the pipeline timing log line, in seconds
+#define PIPELINE_STATS_LOG_INTERVAL 10
+
+// Weight of a new measurement in the moving average of a stage
+#define PIPELINE_STATS_AVG_WEIGHT 0.05
+
+// Timing statistics of the stages of the video pipeline
+//
+// Stages are measured on the streaming thread and on the delivery thread, using the performance counter.
+// The cost is two counter reads per stage and an uncontended lock per measurement.
+class CPipelineStats
+{
+  public:
+    CPipelineStats();
+
+    void Reset();
+
+    // Current value of the performance counter
+    static LONGLONG Now()
+    {
+        LARGE_INTEGER liNow;
+        QueryPerformanceCounter(&liNow);
+        return liNow.QuadPart;
+    }
+
+    // Add a measurement of a stage, in performance counter ticks
+    void Add(LAVPipelineStage stage, LONGLONG llTicks);
+
+    // Log the averages of all stages to the debug log, if the log interval has passed
+    // Does nothing in release builds, the statistics are available through ILAVVideoPipelineStats there.
+    void LogPeriodic();
+
+    void GetStats(LAVPipelineStage stage, LAVPipelineStageStats *pStats);
+
+  private:
+    CCritSec m_csStats;
+    LARGE_INTEGER m_liFrequency{};
+
+    LAVPipelineStageStats m_Stats[LAVPipelineStage_NB]{};
+    LONGLONG m_llLastLog = 0;
+};
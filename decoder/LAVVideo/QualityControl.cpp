@@ -0,0 +1,185 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "QualityControl.h"
+
+static const WCHAR *QualityLevelName(LAVQualityLevel level)
+{
+    switch (level)
+    {
+    case LAVQualityLevel_Full: return L"full";
+    case LAVQualityLevel_SkipLoopFilter: return L"skip loop filter";
+    case LAVQualityLevel_SkipNonRef: return L"skip non-ref frames";
+    case LAVQualityLevel_DropLate: return L"drop late frames";
+    case LAVQualityLevel_KeyframesOnly: return L"keyframes only";
+    }
+    return L"unknown";
+}
+
+CQualityController::CQualityController()
+{
+    QueryPerformanceFrequency(&m_liFrequency);
+}
+
+void CQualityController::Reset()
+{
+    CAutoLock lock(&m_csQC);
+
+    m_Level = LAVQualityLevel_Full;
+    m_nOverloaded = m_nHealthy = 0;
+    m_nRecoverWindows = QC_RECOVER_WINDOWS;
+    m_nWindowsSinceRecover = -1;
+    m_nConsecutiveDrops = 0;
+
+    memset(&m_Status, 0, sizeof(m_Status));
+
+    m_rtWindowStart = AV_NOPTS_VALUE;
+    m_llDecodeTicks = 0;
+    m_rtMaxLate = 0;
+}
+
+void CQualityController::Flush()
+{
+    CAutoLock lock(&m_csQC);
+
+    // Keep the level, the decoder is not getting any faster by seeking
+    m_rtWindowStart = AV_NOPTS_VALUE;
+    m_llDecodeTicks = 0;
+    m_rtMaxLate = 0;
+    m_nConsecutiveDrops = 0;
+}
+
+void CQualityController::Notify(const Quality &q)
+{
+    // Flood messages indicate we are early, which is not a problem we can solve
+    if (q.Type != Famine)
+        return;
+
+    CAutoLock lock(&m_csQC);
+    m_rtMaxLate = max(m_rtMaxLate, q.Late);
+}
+
+bool CQualityController::FrameDecoded(REFERENCE_TIME rtStart, double dRate)
+{
+    CAutoLock lock(&m_csQC);
+
+    m_Status.nFrames[m_Level]++;
+
+    if (m_rtWindowStart == AV_NOPTS_VALUE || rtStart < m_rtWindowStart)
+    {
+        m_rtWindowStart = rtStart;
+        m_llDecodeTicks = 0;
+        return false;
+    }
+
+    // Measure over stream time instead of frames, so skipped frames and field-coded streams don't skew the load
+    REFERENCE_TIME rtWindow = rtStart - m_rtWindowStart;
+    if (rtWindow < QC_WINDOW_DURATION)
+        return false;
+
+    double dDecodeTime = m_llDecodeTicks * 10000000.0 / m_liFrequency.QuadPart;
+    double dLoad = dDecodeTime / rtWindow * (dRate > 0.0 ? dRate : 1.0);
+
+    // Sparse frames (ie. keyframes only) cover several windows at once, which all count towards recovery
+    int nWindows = (int)min(rtWindow / QC_WINDOW_DURATION, (REFERENCE_TIME)QC_RECOVER_WINDOWS_MAX);
+
+    LAVQualityLevel prevLevel = m_Level;
+    Evaluate(dLoad, m_rtMaxLate, nWindows);
+
+    m_rtWindowStart = rtStart;
+    m_llDecodeTicks = 0;
+    m_rtMaxLate = 0;
+
+    return m_Level != prevLevel;
+}
+
+void CQualityController::Evaluate(double dLoad, REFERENCE_TIME rtLate, int nWindows)
+{
+    if (m_nWindowsSinceRecover >= 0)
+        m_nWindowsSinceRecover += nWindows;
+
+    if (dLoad > QC_LOAD_HIGH || rtLate > QC_LATE_THRESHOLD)
+    {
+        m_nHealthy = 0;
+        if (++m_nOverloaded >= QC_ESCALATE_WINDOWS && m_Level < LAVQualityLevel_KeyframesOnly)
+        {
+            // The last recovery did not hold, wait longer before trying again
+            if (m_nWindowsSinceRecover >= 0 && m_nWindowsSinceRecover <= 2 * m_nRecoverWindows)
+                m_nRecoverWindows = min(2 * m_nRecoverWindows, QC_RECOVER_WINDOWS_MAX);
+            m_nWindowsSinceRecover = -1;
+
+            DbgLog((LOG_TRACE, 10, L"CQualityController: overloaded (load: %.2f, late: %I64d ms)", dLoad,
+                    rtLate / 10000));
+            SetLevel((LAVQualityLevel)(m_Level + 1));
+            m_Status.nEscalations[m_Level]++;
+            m_nOverloaded = 0;
+        }
+    }
+    else if (dLoad < QC_LOAD_LOW && rtLate <= 0)
+    {
+        m_nOverloaded = 0;
+        m_nHealthy += nWindows;
+        if (m_nHealthy >= m_nRecoverWindows && m_Level > LAVQualityLevel_Full)
+        {
+            SetLevel((LAVQualityLevel)(m_Level - 1));
+            m_nWindowsSinceRecover = 0;
+            m_nHealthy = 0;
+        }
+    }
+    else
+    {
+        // In between the thresholds, hold the current level
+        m_nOverloaded = 0;
+        m_nHealthy = 0;
+    }
+}
+
+void CQualityController::SetLevel(LAVQualityLevel level)
+{
+    DbgLog((LOG_TRACE, 10, L"CQualityController: quality level %s -> %s", QualityLevelName(m_Level),
+            QualityLevelName(level)));
+    DbgLog((LOG_TRACE, 10, L"-> frames per level: %I64u/%I64u/%I64u/%I64u/%I64u, dropped late: %I64u",
+            m_Status.nFrames[0], m_Status.nFrames[1], m_Status.nFrames[2], m_Status.nFrames[3], m_Status.nFrames[4],
+            m_Status.nDroppedLate));
+    m_Level = level;
+}
+
+bool CQualityController::DropLateFrame(REFERENCE_TIME rtStop, REFERENCE_TIME rtNow)
+{
+    CAutoLock lock(&m_csQC);
+
+    if (m_Level < LAVQualityLevel_DropLate || rtStop >= rtNow || m_nConsecutiveDrops >= QC_MAX_CONSECUTIVE_DROPS)
+    {
+        m_nConsecutiveDrops = 0;
+        return false;
+    }
+
+    m_nConsecutiveDrops++;
+    m_Status.nDroppedLate++;
+    return true;
+}
+
+void CQualityController::GetStatus(LAVQualityStatus *pStatus)
+{
+    CAutoLock lock(&m_csQC);
+
+    *pStatus = m_Status;
+    pStatus->level = m_Level;
+}
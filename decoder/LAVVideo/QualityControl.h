@@ -0,0 +1,100 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "LAVVideoSettings.h"
+
+// Length of the measurement window, in stream time
+#define QC_WINDOW_DURATION 5000000LL
+
+// Consecutive overloaded windows before the quality level is lowered
+#define QC_ESCALATE_WINDOWS 2
+
+// Consecutive healthy windows before the quality level is raised again, doubled every time a raised level fails
+#define QC_RECOVER_WINDOWS 6
+#define QC_RECOVER_WINDOWS_MAX 48
+
+// Decode load (time spent decoding relative to the stream time covered) considered overloaded and healthy
+#define QC_LOAD_HIGH 0.95
+#define QC_LOAD_LOW 0.70
+
+// Lateness reported by the renderer considered overloaded
+#define QC_LATE_THRESHOLD 400000LL
+
+// Frames dropped before conversion are limited, so the renderer still gets to show some frames
+#define QC_MAX_CONSECUTIVE_DROPS 8
+
+// Adaptive quality control for software decoding
+//
+// Decoding load is measured per window of stream time, from the time spent in the decoder and the lateness
+// reported by the renderer through IQualityControl. When decoding can't keep up, the quality level is lowered
+// one step at a time, and only raised again after a longer period without any pressure.
+class CQualityController
+{
+  public:
+    CQualityController();
+
+    // Return to full quality and clear all counters, for a new stream
+    void Reset();
+
+    // Discard the current measurement, after a seek
+    void Flush();
+
+    // Quality message of the renderer, can be called from any thread
+    void Notify(const Quality &q);
+
+    // Time spent decoding, in performance counter ticks
+    void AddDecodeTime(LONGLONG llTicks) { m_llDecodeTicks += llTicks; }
+
+    // Account a decoded frame, evaluates the load once a window of stream time is complete
+    // Returns true if the quality level changed
+    bool FrameDecoded(REFERENCE_TIME rtStart, double dRate);
+
+    // Check if a frame should be dropped instead of being converted, because it would be late anyway
+    bool DropLateFrame(REFERENCE_TIME rtStop, REFERENCE_TIME rtNow);
+
+    LAVQualityLevel GetLevel() const { return m_Level; }
+    void GetStatus(LAVQualityStatus *pStatus);
+
+  private:
+    void Evaluate(double dLoad, REFERENCE_TIME rtLate, int nWindows);
+    void SetLevel(LAVQualityLevel level);
+
+  private:
+    CCritSec m_csQC;
+
+    LAVQualityLevel m_Level = LAVQualityLevel_Full;
+    LARGE_INTEGER m_liFrequency{};
+
+    // current measurement window
+    REFERENCE_TIME m_rtWindowStart = AV_NOPTS_VALUE;
+    LONGLONG m_llDecodeTicks = 0;
+    REFERENCE_TIME m_rtMaxLate = 0;
+
+    // hysteresis
+    int m_nOverloaded = 0;
+    int m_nHealthy = 0;
+    int m_nRecoverWindows = QC_RECOVER_WINDOWS;
+    int m_nWindowsSinceRecover = -1;
+
+    int m_nConsecutiveDrops = 0;
+
+    LAVQualityStatus m_Status{};
+};
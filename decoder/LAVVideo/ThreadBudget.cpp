@@ -0,0 +1,154 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "ThreadBudget.h"
+
+// Lower bound of the resolution used for the weight, so small streams still get a share
+#define THREAD_BUDGET_MIN_PIXELS (352 * 288)
+
+struct ThreadBudgetState
+{
+    CCritSec csBudget;
+    int nBudget = 0;
+    int nDecoders = 0;
+    int nAllotted = 0;
+    UINT64 totalWeight = 0;
+};
+
+static ThreadBudgetState &GetState()
+{
+    static ThreadBudgetState state;
+    return state;
+}
+
+static int GetBudget(const ThreadBudgetState &state)
+{
+    return state.nBudget > 0 ? state.nBudget : av_cpu_count();
+}
+
+// Relative decoding cost per pixel, in halves
+static int GetCodecCost(AVCodecID codec)
+{
+    switch (codec)
+    {
+    case AV_CODEC_ID_HEVC:
+    case AV_CODEC_ID_VP9:
+    case AV_CODEC_ID_AV1:
+    case AV_CODEC_ID_VVC: return 4;
+    case AV_CODEC_ID_H264:
+    case AV_CODEC_ID_VC1:
+    case AV_CODEC_ID_WMV3:
+    case AV_CODEC_ID_PRORES: return 2;
+    default: return 1;
+    }
+}
+
+CDecoderThreadAllotment::~CDecoderThreadAllotment()
+{
+    Release();
+}
+
+int CDecoderThreadAllotment::GetFairShare() const
+{
+    const ThreadBudgetState &state = GetState();
+    if (state.totalWeight == 0)
+        return m_nMaxThreads;
+
+    int nShare = (int)((GetBudget(state) * m_Weight + state.totalWeight / 2) / state.totalWeight);
+    return max(1, min(nShare, m_nMaxThreads));
+}
+
+int CDecoderThreadAllotment::Acquire(AVCodecID codec, int width, int height, int nMaxThreads)
+{
+    Release();
+
+    ThreadBudgetState &state = GetState();
+    CAutoLock lock(&state.csBudget);
+
+    m_Weight = (UINT64)max(abs(width * height), THREAD_BUDGET_MIN_PIXELS) * GetCodecCost(codec);
+    m_nMaxThreads = max(1, nMaxThreads);
+    state.totalWeight += m_Weight;
+    state.nDecoders++;
+
+    m_nThreads = GetFairShare();
+    state.nAllotted += m_nThreads;
+
+    DbgLog((LOG_TRACE, 10, L"CDecoderThreadAllotment::Acquire(): %S %dx%d, %d threads (budget: %d, decoders: %d)",
+            avcodec_get_name(codec), width, height, m_nThreads, GetBudget(state), state.nDecoders));
+
+    return m_nThreads;
+}
+
+void CDecoderThreadAllotment::Release()
+{
+    if (m_Weight == 0)
+        return;
+
+    ThreadBudgetState &state = GetState();
+    CAutoLock lock(&state.csBudget);
+
+    state.totalWeight -= m_Weight;
+    state.nDecoders--;
+    state.nAllotted -= m_nThreads;
+
+    m_Weight = 0;
+    m_nThreads = 0;
+}
+
+bool CDecoderThreadAllotment::NeedsRebalance() const
+{
+    if (m_Weight == 0)
+        return false;
+
+    ThreadBudgetState &state = GetState();
+    CAutoLock lock(&state.csBudget);
+
+    // Only react to substantial changes, re-initializing the decoder is not free
+    int nShare = GetFairShare();
+    return nShare >= 2 * m_nThreads || 2 * nShare <= m_nThreads;
+}
+
+void DecoderThreadBudget::SetBudget(int nThreads)
+{
+    ThreadBudgetState &state = GetState();
+    CAutoLock lock(&state.csBudget);
+    state.nBudget = max(0, nThreads);
+}
+
+void DecoderThreadBudget::GetStatus(int *pnBudget, int *pnDecoders, int *pnAllotted)
+{
+    ThreadBudgetState &state = GetState();
+    CAutoLock lock(&state.csBudget);
+
+    if (pnBudget)
+        *pnBudget = GetBudget(state);
+    if (pnDecoders)
+        *pnDecoders = state.nDecoders;
+    if (pnAllotted)
+        *pnAllotted = state.nAllotted;
+}
+
+int DecoderThreadBudget::GetConverterThreads()
+{
+    ThreadBudgetState &state = GetState();
+    CAutoLock lock(&state.csBudget);
+
+    return min(8, max(1, GetBudget(state) / 2 / max(1, state.nDecoders)));
+}
@@ -0,0 +1,60 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Thread allotment of one software decoder
+//
+// All decoders of the process share one budget of threads. Each decoder gets a share weighted by the complexity of
+// its stream (resolution and codec), and at least one thread. libavcodec can't change the thread count of an open
+// decoder, so the allotment is only updated when the decoder is (re-)initialized.
+class CDecoderThreadAllotment
+{
+  public:
+    ~CDecoderThreadAllotment();
+
+    // Register the stream with the budget, and get the number of threads the decoder should use
+    int Acquire(AVCodecID codec, int width, int height, int nMaxThreads);
+    void Release();
+
+    // Check if the fair share of the decoder changed enough since it was initialized to warrant a re-init
+    bool NeedsRebalance() const;
+
+    int GetThreads() const { return m_nThreads; }
+
+  private:
+    int GetFairShare() const;
+
+  private:
+    UINT64 m_Weight = 0;
+    int m_nThreads = 0;
+    int m_nMaxThreads = 0;
+};
+
+namespace DecoderThreadBudget
+{
+// Set the number of threads shared by all decoders of the process, 0 for the number of CPU cores
+void SetBudget(int nThreads);
+
+// Get the budget, the number of registered decoders and the threads allotted to them
+void GetStatus(int *pnBudget, int *pnDecoders, int *pnAllotted);
+
+// Number of threads for the pixel format conversion of one instance
+int GetConverterThreads();
+} // namespace DecoderThreadBudget
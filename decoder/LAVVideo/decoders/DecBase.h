@@ -59,6 +59,15 @@ class CDecBase : public ILAVDecoder
     }
     STDMETHODIMP GetHWAccelActiveDevice(BSTR *pstrDeviceName) { return E_UNEXPECTED; }
 
+    STDMETHODIMP_(int) GetThreadAllotment() { return 0; }
+    STDMETHODIMP SetQualityLevel(LAVQualityLevel level) { return S_FALSE; }
+    STDMETHODIMP_(int) GetPreviewScale() { return 0; }
+    STDMETHODIMP SetPrerollSkip(BOOL bEnabled) { return S_FALSE; }
+    STDMETHODIMP ReuseDecoder(AVCodecID codec, const CMediaType *pmt, const MediaSideDataFFMpeg *pSideData)
+    {
+        return S_FALSE;
+    }
+
     STDMETHODIMP Decode(IMediaSample *pSample)
     {
         HRESULT hr;
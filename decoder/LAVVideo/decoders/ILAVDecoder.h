@@ -161,6 +161,8 @@ typedef struct LAVFrame
     bool direct;
     bool (*direct_lock)(struct LAVFrame *, struct LAVDirectBuffer *);
     void (*direct_unlock)(struct LAVFrame *);
+
+    int decimation; ///< preview decoding: log2 of the factor the frame is decimated by on output (0 = none)
 } LAVFrame;
 
 /**
@@ -175,6 +177,31 @@ typedef struct LAVFrame
  */
 HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, ptrdiff_t stride = 0);
 
+/**
+ * Statistics of the pool of frame buffers allocated by AllocLAVFrameBuffers
+ */
+typedef struct LAVFrameBufferPoolStats
+{
+    size_t nAllocated;   ///< number of buffers allocated from the system
+    size_t nReused;      ///< number of buffers re-used from the pool
+    size_t nIdleBuffers; ///< number of buffers currently in the pool
+    size_t nIdleBytes;   ///< size of the buffers currently in the pool
+    size_t nBytesInUse;  ///< size of the buffers currently held by frames
+    size_t nPeakBytes;   ///< peak size of all buffers
+} LAVFrameBufferPoolStats;
+
+/**
+ * Release all buffers in the pool, ie. after a format change
+ *
+ * Buffers still held by frames are released once the frame is destructed.
+ */
+void TrimLAVFrameBufferPool();
+
+/**
+ * Get the statistics of the frame buffer pool
+ */
+void GetLAVFrameBufferPoolStats(LAVFrameBufferPoolStats *pStats);
+
 /**
  * Destruct a LAV Frame, freeing its data pointers
  */
@@ -280,11 +307,14 @@ interface ILAVVideoCallback
     STDMETHOD_(CBasePin *, GetOutputPin)() PURE;
 
     /**
-     * Get the output media type
+     * Get the current output format
+     * The output media type can change on the delivery thread, only use this snapshot of it while decoding
      *
-     * @result media type
+     * @param pSubtype Output subtype (optional)
+     * @param pStride Output stride, in pixels (optional)
+     * @param pAvgTimePerFrame Frame duration of the output media type (optional)
      */
-    STDMETHOD_(CMediaType &, GetOutputMediaType)() PURE;
+    STDMETHOD(GetOutputFormat)(GUID * pSubtype, LONG * pStride, REFERENCE_TIME * pAvgTimePerFrame) PURE;
 
     /**
      * Strip the packet for DVD decoding
@@ -320,6 +350,13 @@ interface ILAVVideoCallback
      * Get the x264 build info
      */
     STDMETHOD_(int, GetX264Build)() PURE;
+
+    /**
+     * Report time spent parsing and preparing the input for the decoder
+     *
+     * @param llTicks duration in performance counter ticks
+     */
+    STDMETHOD(AddParseTime)(LONGLONG llTicks) PURE;
 };
 
 /**
@@ -458,6 +495,49 @@ interface ILAVDecoder
      * Get the description of the currently active hwaccel device
      */
     STDMETHOD(GetHWAccelActiveDevice)(BSTR * pstrDeviceName) PURE;
+
+    /**
+     * Get the number of threads allotted to the decoder from the process-wide thread budget
+     *
+     * @return number of threads, 0 if the decoder does not use the budget
+     */
+    STDMETHOD_(int, GetThreadAllotment)() PURE;
+
+    /**
+     * Set the quality level requested by the quality control
+     * The decoder should skip the work associated with the level, where possible.
+     *
+     * @return S_OK if the level is supported, S_FALSE if the decoder ignores it
+     */
+    STDMETHOD(SetQualityLevel)(LAVQualityLevel level) PURE;
+
+    /**
+     * Check if the decoder can keep its context for a new input format, instead of being re-initialized
+     * If it can, the decoder is flushed and picks up the new format (ie. extradata) with the next packet.
+     *
+     * @param codec Codec Id of the new format
+     * @param pmt DirectShow Media Type of the new format
+     * @param pSideData Stream-level side data of the new format
+     * @return S_OK if the decoder was re-used, S_FALSE if it needs to be re-initialized
+     */
+    STDMETHOD(ReuseDecoder)(AVCodecID codec, const CMediaType *pmt, const MediaSideDataFFMpeg *pSideData) PURE;
+
+    /**
+     * Get the reduction of the output resolution in preview decoding (see ILAVVideoSettings::SetPreviewHeight)
+     * The reduction includes the decimation the decoder requests through LAVFrame::decimation.
+     *
+     * @return log2 of the reduction factor, 0 for full resolution
+     */
+    STDMETHOD_(int, GetPreviewScale)() PURE;
+
+    /**
+     * Allow the decoder to skip non-reference frames of preroll input
+     * Preroll input is marked with IMediaSample::IsPreroll, or has a timestamp before the start of the segment.
+     * Its frames are not displayed, so only the reference frames needed for the seek target have to be decoded.
+     *
+     * @return S_OK if preroll skipping is supported, S_FALSE if the decoder ignores it
+     */
+    STDMETHOD(SetPrerollSkip)(BOOL bEnabled) PURE;
 };
 
 /**
@@ -37,6 +37,7 @@
 extern "C"
 {
 #include "libavutil/pixdesc.h"
+#include "libavutil/imgutils.h"
 #include "libavutil/mastering_display_metadata.h"
 #include "libavutil/hdr_dynamic_metadata.h"
 #include "libavutil/dovi_meta.h"
@@ -282,6 +283,95 @@ static struct PixelFormatMapping getPixFmtMapping(AVPixelFormat pixfmt)
     return result;
 }
 
+static BOOL IsAVC1Format(const CMediaType *pmt, unsigned codec_tag)
+{
+    return pmt->formattype == FORMAT_MPEG2Video &&
+           (codec_tag == MAKEFOURCC('a', 'v', 'c', '1') || codec_tag == MAKEFOURCC('A', 'V', 'C', '1') ||
+            codec_tag == MAKEFOURCC('C', 'C', 'V', '1'));
+}
+
+// Reconstruct AVC1 extradata format from the parameter sets in the MPEG2VIDEOINFO
+static uint8_t *BuildAVC1Extradata(const CMediaType *pmt, size_t *pSize)
+{
+    size_t extralen = 0;
+    getExtraData(*pmt, nullptr, &extralen);
+
+    MPEG2VIDEOINFO *mp2vi = (MPEG2VIDEOINFO *)pmt->Format();
+    extralen += 7;
+    BYTE *extra = (uint8_t *)av_mallocz(extralen + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!extra)
+    {
+        *pSize = 0;
+        return nullptr;
+    }
+
+    extra[0] = 1;
+    extra[1] = (BYTE)mp2vi->dwProfile;
+    extra[2] = 0;
+    extra[3] = (BYTE)mp2vi->dwLevel;
+    extra[4] = (BYTE)(mp2vi->dwFlags ? mp2vi->dwFlags : 4) - 1;
+
+    // only process extradata if available
+    uint8_t ps_count = 0;
+    if (extralen > 7)
+    {
+        // Actually copy the metadata into our new buffer
+        size_t actual_len;
+        getExtraData(*pmt, extra + 6, &actual_len);
+
+        // Count the number of SPS/PPS in them and set the length
+        // We'll put them all into one block and add a second block with 0 elements afterwards
+        // The parsing logic does not care what type they are, it just expects 2 blocks.
+        BYTE *p = extra + 6, *end = extra + 6 + actual_len;
+        while (p + 1 < end)
+        {
+            unsigned len = (((unsigned)p[0] << 8) | p[1]) + 2;
+            if (p + len > end)
+            {
+                break;
+            }
+            ps_count++;
+            p += len;
+        }
+    }
+    extra[5] = ps_count;
+    extra[extralen - 1] = 0;
+
+    *pSize = extralen;
+    return extra;
+}
+
+// Codecs which handle parameter changes in the bitstream, and can keep their context across format changes
+static BOOL IsReusableCodec(AVCodecID codec)
+{
+    return codec == AV_CODEC_ID_H264 || codec == AV_CODEC_ID_HEVC || codec == AV_CODEC_ID_MPEG1VIDEO ||
+           codec == AV_CODEC_ID_MPEG2VIDEO || codec == AV_CODEC_ID_VP8 || codec == AV_CODEC_ID_VP9 ||
+           codec == AV_CODEC_ID_AV1;
+}
+
+// Group profiles which decode to the same output format, as far as the media type tells
+static int GetProfileFamily(AVCodecID codec, const CMediaType *pmt)
+{
+    int profile = 0;
+    if (pmt->formattype == FORMAT_MPEG2Video)
+        profile = (int)((MPEG2VIDEOINFO *)pmt->Format())->dwProfile;
+
+    switch (codec)
+    {
+    case AV_CODEC_ID_H264:
+        // Baseline, Main, Extended and High are all 8-bit 4:2:0
+        if (profile == AV_PROFILE_H264_BASELINE || profile == AV_PROFILE_H264_CONSTRAINED_BASELINE ||
+            profile == AV_PROFILE_H264_MAIN || profile == AV_PROFILE_H264_EXTENDED || profile == AV_PROFILE_H264_HIGH)
+            return 0;
+        break;
+    case AV_CODEC_ID_HEVC:
+        if (profile == AV_PROFILE_HEVC_MAIN_STILL_PICTURE)
+            return AV_PROFILE_HEVC_MAIN;
+        break;
+    }
+    return profile;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // AVCodec decoder implementation
 ////////////////////////////////////////////////////////////////////////////////
@@ -372,73 +462,58 @@ STDMETHODIMP CDecAvcodec::InitDecoder(AVCodecID codec, const CMediaType *pmt, co
     // Setup threading
     // Thread Count. 0 = auto detect
     int thread_count = m_pSettings->GetNumThreads();
-    if (thread_count == 0)
+    if (dwDecFlags & LAV_VIDEO_DEC_FLAG_NO_MT || codec == AV_CODEC_ID_MPEG4)
     {
+        thread_count = 1;
+    }
+    else if (thread_count == 0)
+    {
+        // Software decoders share the thread budget of the process
         thread_count = av_cpu_count();
+        if (!IsHardwareAccelerator())
+            thread_count = m_ThreadAllotment.Acquire(codec, pBMI->biWidth, abs(pBMI->biHeight),
+                                                     min(thread_count, AVCODEC_MAX_THREADS));
     }
     m_pAVCtx->thread_count = max(1, min(thread_count, AVCODEC_MAX_THREADS));
 
-    if (dwDecFlags & LAV_VIDEO_DEC_FLAG_NO_MT || codec == AV_CODEC_ID_MPEG4)
+    // Preview decoding uses lowres where the codec supports it, and decimates the rest on output
+    m_nPreviewScale = IsHardwareAccelerator() ? 0 : SelectPreviewScale(abs(pBMI->biHeight));
+    m_nPreviewDecimation = 0;
+    if (m_nPreviewScale > 0)
     {
-        m_pAVCtx->thread_count = 1;
+        m_pAVCtx->lowres = min(m_nPreviewScale, (int)m_pAVCodec->max_lowres);
+        m_nPreviewDecimation = m_nPreviewScale - m_pAVCtx->lowres;
+        if (m_nPreviewDecimation > 0)
+            m_pAVCtx->flags2 |= AV_CODEC_FLAG2_FAST;
+
+        DbgLog((LOG_TRACE, 10, L"-> Preview decoding at 1/%d resolution (lowres: %d, decimation: %d)",
+                1 << m_nPreviewScale, m_pAVCtx->lowres, m_nPreviewDecimation));
     }
 
+    // Frame threading delays the output by one frame per thread, low-latency mode only uses slice threading
+    const BOOL bLowLatency = m_pSettings->GetLowLatency();
+    if (bLowLatency)
+        m_pAVCtx->thread_type = FF_THREAD_SLICE;
+
+    ApplyQualityLevel();
+
     m_pFrame = av_frame_alloc();
     CheckPointer(m_pFrame, E_POINTER);
 
+    // Allocate frame buffers from our own pools, hardware decoders override this in AdditionaDecoderInit
+    m_pAVCtx->get_buffer2 = lav_get_buffer;
+    m_pAVCtx->opaque = this;
+
     // Process Extradata
     size_t extralen = 0;
     getExtraData(*pmt, nullptr, &extralen);
 
     BOOL bH264avc = FALSE;
-    if (pmt->formattype == FORMAT_MPEG2Video && (m_pAVCtx->codec_tag == MAKEFOURCC('a', 'v', 'c', '1') ||
-                                                 m_pAVCtx->codec_tag == MAKEFOURCC('A', 'V', 'C', '1') ||
-                                                 m_pAVCtx->codec_tag == MAKEFOURCC('C', 'C', 'V', '1')))
+    if (IsAVC1Format(pmt, m_pAVCtx->codec_tag))
     {
-        // Reconstruct AVC1 extradata format
         DbgLog((LOG_TRACE, 10, L"-> Processing AVC1 extradata of %d bytes", extralen));
-        MPEG2VIDEOINFO *mp2vi = (MPEG2VIDEOINFO *)pmt->Format();
-        extralen += 7;
-        BYTE *extra = (uint8_t *)av_mallocz(extralen + AV_INPUT_BUFFER_PADDING_SIZE);
-        extra[0] = 1;
-        extra[1] = (BYTE)mp2vi->dwProfile;
-        extra[2] = 0;
-        extra[3] = (BYTE)mp2vi->dwLevel;
-        extra[4] = (BYTE)(mp2vi->dwFlags ? mp2vi->dwFlags : 4) - 1;
-
-        // only process extradata if available
-        uint8_t ps_count = 0;
-        if (extralen > 7)
-        {
-            // Actually copy the metadata into our new buffer
-            size_t actual_len;
-            getExtraData(*pmt, extra + 6, &actual_len);
-
-            // Count the number of SPS/PPS in them and set the length
-            // We'll put them all into one block and add a second block with 0 elements afterwards
-            // The parsing logic does not care what type they are, it just expects 2 blocks.
-            BYTE *p = extra + 6, *end = extra + 6 + actual_len;
-            BOOL bSPS = FALSE, bPPS = FALSE;
-            while (p + 1 < end)
-            {
-                unsigned len = (((unsigned)p[0] << 8) | p[1]) + 2;
-                if (p + len > end)
-                {
-                    break;
-                }
-                if ((p[2] & 0x1F) == 7)
-                    bSPS = TRUE;
-                if ((p[2] & 0x1F) == 8)
-                    bPPS = TRUE;
-                ps_count++;
-                p += len;
-            }
-        }
-        extra[5] = ps_count;
-        extra[extralen - 1] = 0;
-
         bH264avc = TRUE;
-        m_pAVCtx->extradata = extra;
+        m_pAVCtx->extradata = BuildAVC1Extradata(pmt, &extralen);
         m_pAVCtx->extradata_size = (int)extralen;
     }
     else if (extralen > 0)
@@ -653,7 +728,7 @@ STDMETHODIMP CDecAvcodec::InitDecoder(AVCodecID codec, const CMediaType *pmt, co
     if (bLAVInfoValid)
     {
         // Use strict decoding with LAV Splitter and non-live sources
-        if (codec == AV_CODEC_ID_H264 && !(dwDecFlags & LAV_VIDEO_DEC_FLAG_LIVE) && m_bFFReordering &&
+        if (codec == AV_CODEC_ID_H264 && !(dwDecFlags & LAV_VIDEO_DEC_FLAG_LIVE) && !bLowLatency && m_bFFReordering &&
             !m_pAVCtx->hwaccel_context)
         {
             m_pAVCtx->strict_std_compliance = FF_COMPLIANCE_STRICT;
@@ -668,6 +743,15 @@ STDMETHODIMP CDecAvcodec::InitDecoder(AVCodecID codec, const CMediaType *pmt, co
             if (codec == AV_CODEC_ID_H264 && m_pAVCtx->has_b_frames == 1)
                 m_pAVCtx->has_b_frames = 2;
         }
+
+        // Output frames right away if the stream is known to have no B-frames
+        if (bLowLatency && lavPinInfo.has_b_frames == 0)
+        {
+            DbgLog((LOG_TRACE, 10, L"-> Low-latency mode, disabling reordering delay"));
+            m_pAVCtx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+            m_pAVCtx->has_b_frames = 0;
+            m_bBFrameDelay = FALSE;
+        }
     }
 
     // side data
@@ -717,6 +801,7 @@ STDMETHODIMP CDecAvcodec::InitDecoder(AVCodecID codec, const CMediaType *pmt, co
     {
         DbgLog((LOG_TRACE, 10, L"-> ffmpeg codec opened successfully (ret: %d)", ret));
         m_nCodecId = codec;
+        StoreInitFormat(pmt, pSideData, bLAVInfoValid ? lavPinInfo.has_b_frames : -1, bLowLatency, nX264Build);
     }
     else
     {
@@ -820,9 +905,15 @@ STDMETHODIMP CDecAvcodec::DestroyDecoder()
     }
     av_frame_free(&m_pFrame);
 
+    FreeBufferPool();
+    m_ThreadAllotment.Release();
+
     av_freep(&m_pFFBuffer);
     m_nFFBufferSize = 0;
 
+    av_freep(&m_pNewExtradata);
+    m_nNewExtradataSize = 0;
+
     if (m_pSwsContext)
     {
         sws_freeContext(m_pSwsContext);
@@ -830,10 +921,124 @@ STDMETHODIMP CDecAvcodec::DestroyDecoder()
     }
 
     m_nCodecId = AV_CODEC_ID_NONE;
+    m_nPreviewScale = 0;
+    m_nPreviewDecimation = 0;
+    m_bPreroll = FALSE;
 
     return S_OK;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Frame buffer allocation
+////////////////////////////////////////////////////////////////////////////////
+
+// Allocates frame buffers with the stride of the output samples where possible, so frames that don't need
+// a pixel format conversion can be copied into the sample in one block per plane
+int CDecAvcodec::lav_get_buffer(struct AVCodecContext *c, AVFrame *pic, int flags)
+{
+    CDecAvcodec *pDec = (CDecAvcodec *)c->opaque;
+
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat)pic->format);
+    if (!(c->codec->capabilities & AV_CODEC_CAP_DR1) || !desc ||
+        (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)))
+        return avcodec_default_get_buffer2(c, pic, flags);
+
+    CAutoLock lock(&pDec->m_csBufferPool);
+
+    if (pic->format != pDec->m_BufferPoolFormat || pic->width != pDec->m_BufferPoolWidth ||
+        pic->height != pDec->m_BufferPoolHeight || pDec->m_nOutputStride != pDec->m_BufferPoolStride ||
+        !pDec->m_pBufferPool[0])
+    {
+        if (FAILED(pDec->InitBufferPool(c, pic)))
+            return avcodec_default_get_buffer2(c, pic, flags);
+    }
+
+    for (int i = 0; i < 4 && pDec->m_pBufferPool[i]; i++)
+    {
+        pic->buf[i] = av_buffer_pool_get(pDec->m_pBufferPool[i]);
+        if (!pic->buf[i])
+        {
+            av_frame_unref(pic);
+            return AVERROR(ENOMEM);
+        }
+        pic->data[i] = pic->buf[i]->data;
+        pic->linesize[i] = pDec->m_BufferPoolLinesize[i];
+    }
+    pic->extended_data = pic->data;
+
+    return 0;
+}
+
+HRESULT CDecAvcodec::InitBufferPool(AVCodecContext *c, AVFrame *pic)
+{
+    FreeBufferPool();
+
+    int w = pic->width, h = pic->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(c, &w, &h, linesize_align);
+
+    // Pad the lines to the stride of the output samples
+    if (m_nOutputStride > w)
+        w = m_nOutputStride;
+
+    // Increase the alignment until all planes fulfill the requirements of the decoder
+    int linesize[4];
+    int unaligned = 0;
+    do
+    {
+        if (av_image_fill_linesizes(linesize, (AVPixelFormat)pic->format, w) < 0)
+            return E_FAIL;
+        unaligned = 0;
+        for (int i = 0; i < 4; i++)
+            unaligned |= linesize[i] % linesize_align[i];
+        if (unaligned)
+            w += w & ~(w - 1);
+    } while (unaligned);
+
+    ptrdiff_t linesize_ptr[4];
+    size_t sizes[4];
+    for (int i = 0; i < 4; i++)
+        linesize_ptr[i] = linesize[i];
+    if (av_image_fill_plane_sizes(sizes, (AVPixelFormat)pic->format, h, linesize_ptr) < 0)
+        return E_FAIL;
+
+    for (int i = 0; i < 4 && sizes[i]; i++)
+    {
+        // extra space for decoders that over-read or over-write the plane, same as the default allocator
+        m_pBufferPool[i] = av_buffer_pool_init((size_t)sizes[i] + 16 + 64 - 1, av_buffer_allocz);
+        if (!m_pBufferPool[i])
+        {
+            FreeBufferPool();
+            return E_OUTOFMEMORY;
+        }
+        m_BufferPoolLinesize[i] = linesize[i];
+    }
+
+    m_BufferPoolFormat = pic->format;
+    m_BufferPoolWidth = pic->width;
+    m_BufferPoolHeight = pic->height;
+    m_BufferPoolStride = m_nOutputStride;
+
+    DbgLog((LOG_TRACE, 10, L"CDecAvcodec::InitBufferPool(): %S %dx%d, luma stride %d (output stride %d)",
+            av_get_pix_fmt_name((AVPixelFormat)pic->format), pic->width, pic->height, linesize[0], m_nOutputStride));
+
+    return S_OK;
+}
+
+void CDecAvcodec::FreeBufferPool()
+{
+    CAutoLock lock(&m_csBufferPool);
+
+    // Buffers still referenced by frames stay valid, the pools are freed once they are returned
+    for (int i = 0; i < 4; i++)
+    {
+        av_buffer_pool_uninit(&m_pBufferPool[i]);
+        m_BufferPoolLinesize[i] = 0;
+    }
+    m_BufferPoolFormat = -1;
+    m_BufferPoolWidth = m_BufferPoolHeight = m_BufferPoolStride = 0;
+}
+
 static void lav_avframe_free(LAVFrame *frame)
 {
     ASSERT(frame->priv_data);
@@ -846,10 +1051,37 @@ static void avpacket_mediasample_free(void *opaque, uint8_t *buffer)
     SafeRelease(&pSample);
 }
 
+void CDecAvcodec::UpdateCopyStats(int nInput, int nCopied)
+{
+    if (m_CopyStats.nPackets == 0)
+        QueryPerformanceCounter(&m_CopyStats.liStart);
+
+    m_CopyStats.nInput += nInput;
+    m_CopyStats.nCopied += nCopied;
+
+    if (++m_CopyStats.nPackets >= AVCODEC_COPY_STATS_INTERVAL)
+    {
+        LARGE_INTEGER liFrequency, liNow;
+        QueryPerformanceFrequency(&liFrequency);
+        QueryPerformanceCounter(&liNow);
+
+        double secs = (liNow.QuadPart - m_CopyStats.liStart.QuadPart) / (double)liFrequency.QuadPart;
+        if (secs > 0.0)
+        {
+            DbgLog((LOG_TRACE, 10, L"CDecAvcodec: input %.0f kB/s, copied %.0f kB/s (%.1f%%)",
+                    m_CopyStats.nInput / secs / 1000.0, m_CopyStats.nCopied / secs / 1000.0,
+                    m_CopyStats.nInput ? m_CopyStats.nCopied * 100.0 / m_CopyStats.nInput : 0.0));
+        }
+        m_CopyStats.nInput = m_CopyStats.nCopied = 0;
+        m_CopyStats.nPackets = 0;
+    }
+}
+
 STDMETHODIMP CDecAvcodec::FillAVPacketData(AVPacket *avpkt, const uint8_t *buffer, int buflen, IMediaSample *pSample,
                                            bool bRefCounting)
 {
-    if (m_bInputPadded && (m_pParser == nullptr))
+    // Parser output is only used in-place when it ends with the input sample, signaled by bRefCounting
+    if (m_bInputPadded && (m_pParser == nullptr || bRefCounting))
     {
         avpkt->data = (uint8_t *)buffer;
         avpkt->size = buflen;
@@ -875,6 +1107,9 @@ STDMETHODIMP CDecAvcodec::FillAVPacketData(AVPacket *avpkt, const uint8_t *buffe
         memcpy(avpkt->data, buffer, buflen);
     }
 
+    // packets without a reference are copied by avcodec
+    UpdateCopyStats(buflen, avpkt->buf ? 0 : buflen);
+
     // copy side-data from input sample
     if (pSample)
     {
@@ -903,6 +1138,14 @@ STDMETHODIMP CDecAvcodec::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME
 {
     CheckPointer(m_pAVCtx, E_UNEXPECTED);
 
+    // Track the stride of the output samples for the frame buffer allocation
+    if (m_pAVCtx->get_buffer2 == lav_get_buffer)
+    {
+        LONG lStride = 0;
+        m_pCallback->GetOutputFormat(nullptr, &lStride, nullptr);
+        m_nOutputStride = lStride;
+    }
+
     // Put timestamps into the buffers if appropriate
     if (m_pAVCtx->active_thread_type & FF_THREAD_FRAME)
     {
@@ -921,6 +1164,23 @@ STDMETHODIMP CDecAvcodec::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME
         m_nBFramePos = !m_nBFramePos;
     }
 
+    // Preroll input is recognized by the flag, or by the timestamp if it is the presentation time. Decode timestamps
+    // can be before the segment start for frames that are displayed after it.
+    if (m_bPrerollSkip)
+    {
+        BOOL bPreroll = m_bPreroll;
+        if (pSample && pSample->IsPreroll() == S_OK)
+            bPreroll = TRUE;
+        else if (rtStartIn != AV_NOPTS_VALUE)
+            bPreroll = m_bFFReordering && rtStartIn < 0;
+
+        if (bPreroll != m_bPreroll)
+        {
+            m_bPreroll = bPreroll;
+            ApplyQualityLevel();
+        }
+    }
+
     // if we have a parser, it'll handle calling the decode function
     if (m_pParser)
     {
@@ -935,6 +1195,8 @@ STDMETHODIMP CDecAvcodec::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME
         }
 
         // build an AVPacket
+        LARGE_INTEGER liStart, liEnd;
+        QueryPerformanceCounter(&liStart);
         AVPacket *avpkt = av_packet_alloc();
 
         // set data pointers
@@ -942,6 +1204,8 @@ STDMETHODIMP CDecAvcodec::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME
         {
             return E_OUTOFMEMORY;
         }
+        QueryPerformanceCounter(&liEnd);
+        m_pCallback->AddParseTime(liEnd.QuadPart - liStart.QuadPart);
 
         // timestamps
         avpkt->pts = rtStartIn;
@@ -973,8 +1237,12 @@ STDMETHODIMP CDecAvcodec::ParsePacket(const BYTE *buffer, int buflen, REFERENCE_
     BOOL bFlush = (buffer == NULL);
     int used_bytes = 0;
     uint8_t *pDataBuffer = (uint8_t *)buffer;
+    const uint8_t *pDataEnd = buffer + buflen;
     HRESULT hr = S_OK;
 
+    LARGE_INTEGER liStart, liEnd;
+    QueryPerformanceCounter(&liStart);
+
     // re-allocate with padding, if needed
     if (m_bInputPadded == false && buflen > 0)
     {
@@ -989,6 +1257,7 @@ STDMETHODIMP CDecAvcodec::ParsePacket(const BYTE *buffer, int buflen, REFERENCE_
         memcpy(m_pFFBuffer, buffer, buflen);
         memset(m_pFFBuffer + buflen, 0, AV_INPUT_BUFFER_PADDING_SIZE);
         pDataBuffer = m_pFFBuffer;
+        m_CopyStats.nCopied += buflen;
     }
 
     // loop over the data buffer until the parser has consumed all data
@@ -1001,6 +1270,8 @@ STDMETHODIMP CDecAvcodec::ParsePacket(const BYTE *buffer, int buflen, REFERENCE_
 
         used_bytes = av_parser_parse2(m_pParser, m_pAVCtx, &pOutBuffer, &pOutLen, pDataBuffer, buflen, AV_NOPTS_VALUE,
                                       AV_NOPTS_VALUE, 0);
+        QueryPerformanceCounter(&liEnd);
+        m_pCallback->AddParseTime(liEnd.QuadPart - liStart.QuadPart);
 
         if (used_bytes == 0 && pOutLen == 0 && !bFlush)
         {
@@ -1042,13 +1313,20 @@ STDMETHODIMP CDecAvcodec::ParsePacket(const BYTE *buffer, int buflen, REFERENCE_
         // decode any parsed data
         if (pOutLen > 0)
         {
+            QueryPerformanceCounter(&liStart);
             AVPacket *avpkt = av_packet_alloc();
 
+            // Frames that end at the end of the padded input sample can reference it. Anything else is followed by
+            // the data of the next frame instead of zeroed padding, or is in the buffer of the parser, and is copied.
+            bool bInSample = m_bInputPadded && pOutBuffer >= buffer && pOutBuffer + pOutLen == pDataEnd;
+
             // set data pointers
-            if (FAILED(FillAVPacketData(avpkt, pOutBuffer, pOutLen, pSample, false)))
+            if (FAILED(FillAVPacketData(avpkt, pOutBuffer, pOutLen, pSample, bInSample)))
             {
                 return E_OUTOFMEMORY;
             }
+            QueryPerformanceCounter(&liEnd);
+            m_pCallback->AddParseTime(liEnd.QuadPart - liStart.QuadPart);
 
             // timestamp
             avpkt->pts = rtStart;
@@ -1074,6 +1352,8 @@ STDMETHODIMP CDecAvcodec::ParsePacket(const BYTE *buffer, int buflen, REFERENCE_
             }
             break;
         }
+
+        QueryPerformanceCounter(&liStart);
     }
 
     return S_OK;
@@ -1150,6 +1430,15 @@ STDMETHODIMP CDecAvcodec::DecodePacket(AVPacket *avpkt, REFERENCE_TIME rtStartIn
             for (int i = 0; i < pal_size / 4; i++)
                 pal[i] = 0xFF << 24 | AV_RL32(pal_src + 4 * i);
         }
+
+        // Pass the extradata of a format change to the decoder
+        if (m_pNewExtradata)
+        {
+            if (av_packet_add_side_data(avpkt, AV_PKT_DATA_NEW_EXTRADATA, m_pNewExtradata, m_nNewExtradataSize) < 0)
+                av_freep(&m_pNewExtradata);
+            m_pNewExtradata = nullptr;
+            m_nNewExtradataSize = 0;
+        }
     }
 
 send_packet:
@@ -1272,6 +1561,7 @@ send_packet:
 
         pOutFrame->width = m_pFrame->width;
         pOutFrame->height = m_pFrame->height;
+        pOutFrame->decimation = m_nPreviewDecimation;
         pOutFrame->aspect_ratio = display_aspect_ratio;
         pOutFrame->repeat = m_pFrame->repeat_pict;
         pOutFrame->key_frame = !!(m_pFrame->flags & AV_FRAME_FLAG_KEY);
@@ -1476,7 +1766,7 @@ send_packet:
     return S_OK;
 }
 
-STDMETHODIMP CDecAvcodec::Flush()
+void CDecAvcodec::FlushDecoder()
 {
     if (m_pAVCtx && avcodec_is_open(m_pAVCtx))
     {
@@ -1497,16 +1787,210 @@ STDMETHODIMP CDecAvcodec::Flush()
     m_nBFramePos = 0;
     m_tcBFrameDelay[0].rtStart = m_tcBFrameDelay[0].rtStop = AV_NOPTS_VALUE;
     m_tcBFrameDelay[1].rtStart = m_tcBFrameDelay[1].rtStop = AV_NOPTS_VALUE;
+}
+
+STDMETHODIMP CDecAvcodec::Flush()
+{
+    FlushDecoder();
 
+    // Re-initializing also applies a changed share of the thread budget
     if (!(m_pCallback->GetDecodeFlags() & LAV_VIDEO_DEC_FLAG_DVD) &&
-        (m_nCodecId == AV_CODEC_ID_H264 || m_nCodecId == AV_CODEC_ID_MPEG2VIDEO))
+        (m_nCodecId == AV_CODEC_ID_H264 || m_nCodecId == AV_CODEC_ID_MPEG2VIDEO || m_ThreadAllotment.NeedsRebalance()))
     {
+        DbgLog((LOG_TRACE, 10, L"CDecAvcodec::Flush(): Re-initializing decoder (thread allotment: %d, rebalance: %d)",
+                m_ThreadAllotment.GetThreads(), m_ThreadAllotment.NeedsRebalance()));
         CDecAvcodec::InitDecoder(m_nCodecId, &m_pCallback->GetInputMediaType(), nullptr);
     }
 
     return __super::Flush();
 }
 
+static void SerializeSideData(const MediaSideDataFFMpeg *pSideData, std::vector<BYTE> &out)
+{
+    out.clear();
+    if (!pSideData)
+        return;
+
+    for (int i = 0; i < pSideData->side_data_elems; i++)
+    {
+        const AVPacketSideData *sd = &pSideData->side_data[i];
+        const BYTE *hdr[2] = {(const BYTE *)&sd->type, (const BYTE *)&sd->size};
+        out.insert(out.end(), hdr[0], hdr[0] + sizeof(sd->type));
+        out.insert(out.end(), hdr[1], hdr[1] + sizeof(sd->size));
+        out.insert(out.end(), sd->data, sd->data + sd->size);
+    }
+}
+
+void CDecAvcodec::StoreInitFormat(const CMediaType *pmt, const MediaSideDataFFMpeg *pSideData, int nPinBFrames,
+                                  BOOL bLowLatency, int nX264Build)
+{
+    BITMAPINFOHEADER *pBMI = nullptr;
+    videoFormatTypeHandler((const BYTE *)pmt->Format(), pmt->FormatType(), &pBMI);
+
+    m_InitFormat.subtype = pmt->subtype;
+    m_InitFormat.formattype = pmt->formattype;
+    m_InitFormat.dwCompression = pBMI ? pBMI->biCompression : 0;
+    m_InitFormat.dwDecFlags = m_pCallback->GetDecodeFlags();
+    m_InitFormat.nProfileFamily = GetProfileFamily(m_nCodecId, pmt);
+    m_InitFormat.nPinBFrames = nPinBFrames;
+    m_InitFormat.bLowLatency = bLowLatency;
+    m_InitFormat.dwNumThreads = m_pSettings->GetNumThreads();
+    m_InitFormat.nX264Build = nX264Build;
+
+    size_t extralen = 0;
+    getExtraData(*pmt, nullptr, &extralen);
+    m_InitFormat.extradata.resize(extralen);
+    if (extralen > 0)
+        getExtraData(*pmt, m_InitFormat.extradata.data(), nullptr);
+
+    SerializeSideData(pSideData, m_InitFormat.sidedata);
+}
+
+STDMETHODIMP CDecAvcodec::ReuseDecoder(AVCodecID codec, const CMediaType *pmt, const MediaSideDataFFMpeg *pSideData)
+{
+    if (!m_pAVCtx || !avcodec_is_open(m_pAVCtx) || IsHardwareAccelerator() || codec != m_nCodecId ||
+        !IsReusableCodec(codec))
+        return S_FALSE;
+
+    BITMAPINFOHEADER *pBMI = nullptr;
+    videoFormatTypeHandler((const BYTE *)pmt->Format(), pmt->FormatType(), &pBMI);
+    if (!pBMI)
+        return S_FALSE;
+
+    LAVPinInfo lavPinInfo = {0};
+    BOOL bLAVInfoValid = SUCCEEDED(m_pCallback->GetLAVPinInfo(lavPinInfo));
+
+    // Everything which configures the context at init time has to match
+    if (pmt->subtype != m_InitFormat.subtype || pmt->formattype != m_InitFormat.formattype ||
+        pBMI->biCompression != m_InitFormat.dwCompression ||
+        m_pCallback->GetDecodeFlags() != m_InitFormat.dwDecFlags ||
+        GetProfileFamily(codec, pmt) != m_InitFormat.nProfileFamily ||
+        (bLAVInfoValid ? lavPinInfo.has_b_frames : -1) != m_InitFormat.nPinBFrames ||
+        m_pSettings->GetLowLatency() != m_InitFormat.bLowLatency ||
+        m_pSettings->GetNumThreads() != m_InitFormat.dwNumThreads ||
+        m_pCallback->GetX264Build() != m_InitFormat.nX264Build ||
+        (IsHardwareAccelerator() ? 0 : SelectPreviewScale(abs(pBMI->biHeight))) != m_nPreviewScale)
+    {
+        DbgLog((LOG_TRACE, 10, L"CDecAvcodec::ReuseDecoder(): Format is not compatible"));
+        return S_FALSE;
+    }
+
+    std::vector<BYTE> sidedata;
+    SerializeSideData(pSideData, sidedata);
+    if (sidedata != m_InitFormat.sidedata)
+    {
+        DbgLog((LOG_TRACE, 10, L"CDecAvcodec::ReuseDecoder(): Stream side data changed"));
+        return S_FALSE;
+    }
+
+    size_t extralen = 0;
+    getExtraData(*pmt, nullptr, &extralen);
+    std::vector<BYTE> extradata(extralen);
+    if (extralen > 0)
+        getExtraData(*pmt, extradata.data(), nullptr);
+
+    // Only H.264 and HEVC can take new parameter sets through packet side data
+    const BOOL bExtradataChanged = extradata != m_InitFormat.extradata;
+    if (bExtradataChanged && codec != AV_CODEC_ID_H264 && codec != AV_CODEC_ID_HEVC)
+    {
+        DbgLog((LOG_TRACE, 10, L"CDecAvcodec::ReuseDecoder(): Extradata changed"));
+        return S_FALSE;
+    }
+
+    DbgLog((LOG_TRACE, 10, L"CDecAvcodec::ReuseDecoder(): Re-using decoder for codec %S (new extradata: %d)",
+            avcodec_get_name(codec), bExtradataChanged));
+
+    FlushDecoder();
+
+    av_freep(&m_pNewExtradata);
+    m_nNewExtradataSize = 0;
+
+    if (bExtradataChanged)
+    {
+        if (IsAVC1Format(pmt, pBMI->biCompression))
+        {
+            m_pNewExtradata = BuildAVC1Extradata(pmt, &m_nNewExtradataSize);
+        }
+        else if (extralen > 0 && !(codec == AV_CODEC_ID_H264 && extradata[0] == 1))
+        {
+            m_pNewExtradata = (uint8_t *)av_mallocz(extralen + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (m_pNewExtradata)
+            {
+                memcpy(m_pNewExtradata, extradata.data(), extralen);
+                m_nNewExtradataSize = extralen;
+            }
+        }
+
+        // Interlacing of H.264 was detected from the old extradata
+        if (codec == AV_CODEC_ID_H264)
+            m_iInterlaced = -1;
+
+        m_InitFormat.extradata.swap(extradata);
+    }
+
+    return S_OK;
+}
+
+STDMETHODIMP CDecAvcodec::SetPrerollSkip(BOOL bEnabled)
+{
+    if (IsHardwareAccelerator())
+        return S_FALSE;
+
+    m_bPrerollSkip = bEnabled;
+    if (!m_bPrerollSkip && m_bPreroll)
+    {
+        m_bPreroll = FALSE;
+        ApplyQualityLevel();
+    }
+
+    return S_OK;
+}
+
+STDMETHODIMP CDecAvcodec::SetQualityLevel(LAVQualityLevel level)
+{
+    if (IsHardwareAccelerator())
+        return S_FALSE;
+
+    m_QualityLevel = level;
+    ApplyQualityLevel();
+
+    return S_OK;
+}
+
+void CDecAvcodec::ApplyQualityLevel()
+{
+    if (!m_pAVCtx)
+        return;
+
+    // Frame threads pick up the new settings with the next packet
+    // Decimated preview frames don't show the artifacts of the missing loop filter (deblocking), so it is skipped
+    if (m_nPreviewDecimation > 0)
+        m_pAVCtx->skip_loop_filter = AVDISCARD_ALL;
+    else
+        m_pAVCtx->skip_loop_filter =
+            m_QualityLevel >= LAVQualityLevel_SkipLoopFilter ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+    // Non-reference frames of preroll input are never displayed
+    if (m_QualityLevel >= LAVQualityLevel_KeyframesOnly)
+        m_pAVCtx->skip_frame = AVDISCARD_NONKEY;
+    else if (m_QualityLevel >= LAVQualityLevel_SkipNonRef || m_bPreroll)
+        m_pAVCtx->skip_frame = AVDISCARD_NONREF;
+    else
+        m_pAVCtx->skip_frame = AVDISCARD_DEFAULT;
+}
+
+int CDecAvcodec::SelectPreviewScale(int height)
+{
+    DWORD dwPreviewHeight = m_pSettings->GetPreviewHeight();
+    if (dwPreviewHeight == 0)
+        return 0;
+
+    int scale = 0;
+    while (scale < AVCODEC_MAX_PREVIEW_SCALE && AV_CEIL_RSHIFT(height, scale + 1) >= (int)dwPreviewHeight)
+        scale++;
+    return scale;
+}
+
 STDMETHODIMP CDecAvcodec::EndOfStream()
 {
     Decode(nullptr, 0, AV_NOPTS_VALUE, AV_NOPTS_VALUE, FALSE, FALSE, nullptr);
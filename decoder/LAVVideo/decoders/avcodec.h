@@ -20,11 +20,19 @@
 #pragma once
 
 #include "DecBase.h"
+#include "ThreadBudget.h"
 
 #include <map>
+#include <vector>
 
 #define AVCODEC_MAX_THREADS 32
 
+// Maximum reduction of the resolution in preview decoding (log2)
+#define AVCODEC_MAX_PREVIEW_SCALE 3
+
+// Number of packets between logging the input copy statistics
+#define AVCODEC_COPY_STATS_INTERVAL 1000
+
 typedef struct
 {
     REFERENCE_TIME rtStart;
@@ -48,6 +56,11 @@ class CDecAvcodec : public CDecBase
     STDMETHODIMP_(BOOL) IsInterlaced(BOOL bAllowGuess);
     STDMETHODIMP_(const WCHAR *) GetDecoderName() { return L"avcodec"; }
     STDMETHODIMP HasThreadSafeBuffers() { return S_OK; }
+    STDMETHODIMP_(int) GetThreadAllotment() { return m_ThreadAllotment.GetThreads(); }
+    STDMETHODIMP SetQualityLevel(LAVQualityLevel level);
+    STDMETHODIMP ReuseDecoder(AVCodecID codec, const CMediaType *pmt, const MediaSideDataFFMpeg *pSideData);
+    STDMETHODIMP_(int) GetPreviewScale() { return m_nPreviewScale; }
+    STDMETHODIMP SetPrerollSkip(BOOL bEnabled);
 
     // CDecBase
     STDMETHODIMP Init();
@@ -68,6 +81,18 @@ class CDecAvcodec : public CDecBase
   private:
     STDMETHODIMP ConvertPixFmt(AVFrame *pFrame, LAVFrame *pOutFrame);
 
+    static int lav_get_buffer(struct AVCodecContext *c, AVFrame *pic, int flags);
+    HRESULT InitBufferPool(AVCodecContext *c, AVFrame *pic);
+    void FreeBufferPool();
+
+    void UpdateCopyStats(int nInput, int nCopied);
+    void ApplyQualityLevel();
+    int SelectPreviewScale(int height);
+
+    void FlushDecoder();
+    void StoreInitFormat(const CMediaType *pmt, const MediaSideDataFFMpeg *pSideData, int nPinBFrames,
+                         BOOL bLowLatency, int nX264Build);
+
   protected:
     AVCodecContext *m_pAVCtx = nullptr;
     AVFrame *m_pFrame = nullptr;
@@ -81,10 +106,51 @@ class CDecAvcodec : public CDecBase
     BYTE *m_pFFBuffer = nullptr;
     unsigned int m_nFFBufferSize = 0;
 
+    // Input bytes, and bytes copied before reaching the decoder
+    struct
+    {
+        int64_t nInput;
+        int64_t nCopied;
+        int nPackets;
+        LARGE_INTEGER liStart;
+    } m_CopyStats{};
+
     SwsContext *m_pSwsContext = nullptr;
 
+    // Frame buffer pools, one per plane, used by software decoders
+    CCritSec m_csBufferPool;
+    AVBufferPool *m_pBufferPool[4] = {nullptr};
+    int m_BufferPoolLinesize[4] = {0};
+    int m_BufferPoolFormat = -1;
+    int m_BufferPoolWidth = 0;
+    int m_BufferPoolHeight = 0;
+    int m_BufferPoolStride = 0;
+
+    // Stride of the output samples, in pixels
+    int m_nOutputStride = 0;
+
     BOOL m_bHasPalette = FALSE;
 
+    // Format the decoder was opened with, to decide if a format change can keep the context
+    struct
+    {
+        GUID subtype;
+        GUID formattype;
+        DWORD dwCompression;
+        DWORD dwDecFlags;
+        int nProfileFamily;
+        int nPinBFrames;
+        BOOL bLowLatency;
+        DWORD dwNumThreads;
+        int nX264Build;
+        std::vector<BYTE> extradata;
+        std::vector<BYTE> sidedata;
+    } m_InitFormat{};
+
+    // Extradata of a format change, passed to the decoder with the next packet
+    uint8_t *m_pNewExtradata = nullptr;
+    size_t m_nNewExtradataSize = 0;
+
     // Timing settings
     BOOL m_bFFReordering = FALSE;
     BOOL m_bCalculateStopTime = FALSE;
@@ -96,8 +162,19 @@ class CDecAvcodec : public CDecBase
     int m_nBFramePos = 0;
 
     TimingCache m_tcThreadBuffer[AVCODEC_MAX_THREADS];
+    CDecoderThreadAllotment m_ThreadAllotment;
+
+    LAVQualityLevel m_QualityLevel = LAVQualityLevel_Full;
     int m_CurrentThread = 0;
 
+    // Preview decoding, total reduction and the part applied by decimation on output (log2)
+    int m_nPreviewScale = 0;
+    int m_nPreviewDecimation = 0;
+
+    // Skipping of non-reference frames in preroll input, and the state of the last packet
+    BOOL m_bPrerollSkip = FALSE;
+    BOOL m_bPreroll = FALSE;
+
     REFERENCE_TIME m_rtStartCache = AV_NOPTS_VALUE;
     BOOL m_bResumeAtKeyFrame = FALSE;
     BOOL m_bWaitingForKeyFrame = FALSE;
@@ -1350,11 +1350,11 @@ STDMETHODIMP CDecCuvid::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME rt
     CUVIDSOURCEDATAPACKET pCuvidPacket;
     ZeroMemory(&pCuvidPacket, sizeof(pCuvidPacket));
 
-    BYTE *pBuffer = nullptr;
     if (m_AnnexBConverter)
     {
+        const BYTE *pBuffer = nullptr;
         int size = 0;
-        hr = m_AnnexBConverter->Convert(&pBuffer, &size, buffer, buflen);
+        hr = m_AnnexBConverter->ConvertPacket(&pBuffer, &size, buffer, buflen);
         if (SUCCEEDED(hr))
         {
             pCuvidPacket.payload = pBuffer;
@@ -1433,8 +1433,6 @@ STDMETHODIMP CDecCuvid::Decode(const BYTE *buffer, int buflen, REFERENCE_TIME rt
     }
     cuda.cuvidCtxUnlock(m_cudaCtxLock, 0);
 
-    av_freep(&pBuffer);
-
     if (m_bEndOfSequence)
     {
         EndOfStream();
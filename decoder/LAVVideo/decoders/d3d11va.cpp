@@ -483,16 +483,17 @@ STDMETHODIMP CDecD3D11::PostConnect(IPin *pPin)
     // check if the connection supports native mode
     if (pD3D11DecoderConfiguration)
     {
-        CMediaType mt = m_pCallback->GetOutputMediaType();
-        if ((m_SurfaceFormat == DXGI_FORMAT_NV12 && mt.subtype != MEDIASUBTYPE_NV12) ||
-            (m_SurfaceFormat == DXGI_FORMAT_P010 && mt.subtype != MEDIASUBTYPE_P010) ||
-            (m_SurfaceFormat == DXGI_FORMAT_P016 && mt.subtype != MEDIASUBTYPE_P016) ||
-            (m_SurfaceFormat == DXGI_FORMAT_AYUV && mt.subtype != MEDIASUBTYPE_AYUV) ||
-            (m_SurfaceFormat == DXGI_FORMAT_Y410 && mt.subtype != MEDIASUBTYPE_Y410) ||
-            (m_SurfaceFormat == DXGI_FORMAT_Y416 && mt.subtype != MEDIASUBTYPE_Y416) ||
-            (m_SurfaceFormat == DXGI_FORMAT_YUY2 && mt.subtype != MEDIASUBTYPE_YUY2) ||
-            (m_SurfaceFormat == DXGI_FORMAT_Y210 && mt.subtype != MEDIASUBTYPE_Y210) ||
-            (m_SurfaceFormat == DXGI_FORMAT_Y216 && mt.subtype != MEDIASUBTYPE_Y216))
+        GUID subtype = GUID_NULL;
+        m_pCallback->GetOutputFormat(&subtype, nullptr, nullptr);
+        if ((m_SurfaceFormat == DXGI_FORMAT_NV12 && subtype != MEDIASUBTYPE_NV12) ||
+            (m_SurfaceFormat == DXGI_FORMAT_P010 && subtype != MEDIASUBTYPE_P010) ||
+            (m_SurfaceFormat == DXGI_FORMAT_P016 && subtype != MEDIASUBTYPE_P016) ||
+            (m_SurfaceFormat == DXGI_FORMAT_AYUV && subtype != MEDIASUBTYPE_AYUV) ||
+            (m_SurfaceFormat == DXGI_FORMAT_Y410 && subtype != MEDIASUBTYPE_Y410) ||
+            (m_SurfaceFormat == DXGI_FORMAT_Y416 && subtype != MEDIASUBTYPE_Y416) ||
+            (m_SurfaceFormat == DXGI_FORMAT_YUY2 && subtype != MEDIASUBTYPE_YUY2) ||
+            (m_SurfaceFormat == DXGI_FORMAT_Y210 && subtype != MEDIASUBTYPE_Y210) ||
+            (m_SurfaceFormat == DXGI_FORMAT_Y216 && subtype != MEDIASUBTYPE_Y216))
         {
             DbgLog((LOG_ERROR, 10, L"-> Connection is not the appropriate pixel format for D3D11 Native"));
 
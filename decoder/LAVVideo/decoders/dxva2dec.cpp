@@ -278,10 +278,11 @@ STDMETHODIMP CDecDXVA2::PostConnect(IPin *pPin)
             m_dwSurfaceHeight = dxva_align_dimensions(m_pAVCtx->codec_id, m_pAVCtx->coded_height);
         }
 
-        CMediaType mt = m_pCallback->GetOutputMediaType();
-        if ((m_eSurfaceFormat == FOURCC_NV12 && mt.subtype != MEDIASUBTYPE_NV12) ||
-            (m_eSurfaceFormat == FOURCC_P010 && mt.subtype != MEDIASUBTYPE_P010) ||
-            (m_eSurfaceFormat == FOURCC_P016 && mt.subtype != MEDIASUBTYPE_P016))
+        GUID subtype = GUID_NULL;
+        m_pCallback->GetOutputFormat(&subtype, nullptr, nullptr);
+        if ((m_eSurfaceFormat == FOURCC_NV12 && subtype != MEDIASUBTYPE_NV12) ||
+            (m_eSurfaceFormat == FOURCC_P010 && subtype != MEDIASUBTYPE_P010) ||
+            (m_eSurfaceFormat == FOURCC_P016 && subtype != MEDIASUBTYPE_P016))
         {
             DbgLog((LOG_ERROR, 10, L"-> Connection is not the appropriate pixel format for DXVA2 Native"));
             hr = E_FAIL;
@@ -20,6 +20,8 @@
 #include "stdafx.h"
 #include "ILAVDecoder.h"
 
+#include <vector>
+
 static LAVPixFmtDesc lav_pixfmt_desc[] = {
     {1, 3, {1, 2, 2}, {1, 2, 2}}, ///< LAVPixFmt_YUV420
     {2, 3, {1, 2, 2}, {1, 2, 2}}, ///< LAVPixFmt_YUV420bX
@@ -102,19 +104,148 @@ AVPixelFormat getFFPixelFormatFromLAV(LAVPixelFormat pixFmt, int bpp)
     return fmt;
 }
 
+// Frame buffers are pooled, the conversion and copy paths need a buffer of the same size for every frame
+#define FRAME_POOL_MAX_IDLE_PER_KEY 8
+
+struct FrameBufferKey
+{
+    LAVPixelFormat format;
+    ptrdiff_t stride;
+    int height;
+    bool mvc;
+
+    bool operator==(const FrameBufferKey &other) const
+    {
+        return format == other.format && stride == other.stride && height == other.height && mvc == other.mvc;
+    }
+};
+
+// One allocation holding all planes of a frame
+struct FrameBuffer
+{
+    FrameBufferKey key;
+    unsigned generation;
+    size_t size;
+    BYTE *data;
+};
+
+struct FrameBufferPool
+{
+    CCritSec csPool;
+    unsigned generation = 0;
+    std::vector<FrameBuffer *> idle;
+    LAVFrameBufferPoolStats stats{};
+};
+
+static FrameBufferPool &GetFrameBufferPool()
+{
+    static FrameBufferPool pool;
+    return pool;
+}
+
+static void free_frame_buffer(FrameBuffer *pBuffer)
+{
+    _aligned_free(pBuffer->data);
+    delete pBuffer;
+}
+
+static FrameBuffer *get_frame_buffer(const FrameBufferKey &key, size_t size)
+{
+    FrameBufferPool &pool = GetFrameBufferPool();
+    {
+        CAutoLock lock(&pool.csPool);
+        for (auto it = pool.idle.rbegin(); it != pool.idle.rend(); it++)
+        {
+            if ((*it)->key == key)
+            {
+                FrameBuffer *pBuffer = *it;
+                pool.idle.erase(std::next(it).base());
+
+                pool.stats.nReused++;
+                pool.stats.nIdleBuffers--;
+                pool.stats.nIdleBytes -= pBuffer->size;
+                pool.stats.nBytesInUse += pBuffer->size;
+                pool.stats.nPeakBytes = max(pool.stats.nPeakBytes, pool.stats.nBytesInUse + pool.stats.nIdleBytes);
+                return pBuffer;
+            }
+        }
+    }
+
+    FrameBuffer *pBuffer = new FrameBuffer();
+    pBuffer->key = key;
+    pBuffer->size = size;
+    pBuffer->data = (BYTE *)_aligned_malloc(size, 64);
+    if (pBuffer->data == nullptr)
+    {
+        delete pBuffer;
+        return nullptr;
+    }
+
+    CAutoLock lock(&pool.csPool);
+    pBuffer->generation = pool.generation;
+    pool.stats.nAllocated++;
+    pool.stats.nBytesInUse += size;
+    pool.stats.nPeakBytes = max(pool.stats.nPeakBytes, pool.stats.nBytesInUse + pool.stats.nIdleBytes);
+    return pBuffer;
+}
+
 static void free_buffers(struct LAVFrame *pFrame)
 {
-    _aligned_free(pFrame->data[0]);
-    _aligned_free(pFrame->data[1]);
-    _aligned_free(pFrame->data[2]);
-    _aligned_free(pFrame->data[3]);
+    FrameBuffer *pBuffer = (FrameBuffer *)pFrame->priv_data;
     memset(pFrame->data, 0, sizeof(pFrame->data));
-
-    _aligned_free(pFrame->stereo[0]);
-    _aligned_free(pFrame->stereo[1]);
-    _aligned_free(pFrame->stereo[2]);
-    _aligned_free(pFrame->stereo[3]);
     memset(pFrame->stereo, 0, sizeof(pFrame->stereo));
+    if (pBuffer == nullptr)
+        return;
+
+    FrameBufferPool &pool = GetFrameBufferPool();
+    CAutoLock lock(&pool.csPool);
+    pool.stats.nBytesInUse -= pBuffer->size;
+
+    // Buffers from before the last trim are not pooled again
+    if (pBuffer->generation == pool.generation)
+    {
+        size_t count = 0;
+        for (FrameBuffer *pIdle : pool.idle)
+        {
+            if (pIdle->key == pBuffer->key)
+                count++;
+        }
+
+        if (count < FRAME_POOL_MAX_IDLE_PER_KEY)
+        {
+            pool.idle.push_back(pBuffer);
+            pool.stats.nIdleBuffers++;
+            pool.stats.nIdleBytes += pBuffer->size;
+            return;
+        }
+    }
+
+    free_frame_buffer(pBuffer);
+}
+
+void TrimLAVFrameBufferPool()
+{
+    FrameBufferPool &pool = GetFrameBufferPool();
+    CAutoLock lock(&pool.csPool);
+
+    if (!pool.idle.empty())
+        DbgLog((LOG_TRACE, 10, L"TrimLAVFrameBufferPool(): Releasing %u idle buffers (%Iu bytes)",
+                (unsigned)pool.idle.size(), pool.stats.nIdleBytes));
+
+    for (FrameBuffer *pBuffer : pool.idle)
+        free_frame_buffer(pBuffer);
+    pool.idle.clear();
+
+    pool.generation++;
+    pool.stats.nIdleBuffers = 0;
+    pool.stats.nIdleBytes = 0;
+}
+
+void GetLAVFrameBufferPoolStats(LAVFrameBufferPoolStats *pStats)
+{
+    FrameBufferPool &pool = GetFrameBufferPool();
+    CAutoLock lock(&pool.csPool);
+    *pStats = pool.stats;
 }
 
 HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, ptrdiff_t stride)
@@ -130,38 +261,37 @@ HRESULT AllocLAVFrameBuffers(LAVFrame *pFrame, ptrdiff_t stride)
     stride *= desc.codedbytes;
 
     int alignedHeight = FFALIGN(pFrame->height, 2);
+    bool bMVC = !!(pFrame->flags & LAV_FRAME_FLAG_MVC);
 
-    memset(pFrame->data, 0, sizeof(pFrame->data));
-    memset(pFrame->stereo, 0, sizeof(pFrame->stereo));
-    memset(pFrame->stride, 0, sizeof(pFrame->stride));
+    // Every plane starts 64-byte aligned, and is followed by the padding
+    size_t planeOffset[4] = {0};
+    size_t size = 0;
     for (int plane = 0; plane < desc.planes; plane++)
     {
-        ptrdiff_t planeStride = stride / desc.planeWidth[plane];
-        size_t size = planeStride * (alignedHeight / desc.planeHeight[plane]);
-        pFrame->data[plane] = (BYTE *)_aligned_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE, 64);
-        if (pFrame->data[plane] == nullptr)
-        {
-            free_buffers(pFrame);
-            return E_OUTOFMEMORY;
-        }
-        pFrame->stride[plane] = planeStride;
+        planeOffset[plane] = size;
+        size += FFALIGN((stride / desc.planeWidth[plane]) * (alignedHeight / desc.planeHeight[plane]) +
+                            AV_INPUT_BUFFER_PADDING_SIZE,
+                        64);
     }
 
-    if (pFrame->flags & LAV_FRAME_FLAG_MVC)
+    FrameBufferKey key = {pFrame->format, stride, alignedHeight, bMVC};
+    FrameBuffer *pBuffer = get_frame_buffer(key, bMVC ? size * 2 : size);
+    if (pBuffer == nullptr)
+        return E_OUTOFMEMORY;
+
+    memset(pFrame->data, 0, sizeof(pFrame->data));
+    memset(pFrame->stereo, 0, sizeof(pFrame->stereo));
+    memset(pFrame->stride, 0, sizeof(pFrame->stride));
+    for (int plane = 0; plane < desc.planes; plane++)
     {
-        for (int plane = 0; plane < desc.planes; plane++)
-        {
-            size_t size = pFrame->stride[plane] * (alignedHeight / desc.planeHeight[plane]);
-            pFrame->stereo[plane] = (BYTE *)_aligned_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE, 64);
-            if (pFrame->stereo[plane] == nullptr)
-            {
-                free_buffers(pFrame);
-                return E_OUTOFMEMORY;
-            }
-        }
+        pFrame->data[plane] = pBuffer->data + planeOffset[plane];
+        if (bMVC)
+            pFrame->stereo[plane] = pBuffer->data + size + planeOffset[plane];
+        pFrame->stride[plane] = stride / desc.planeWidth[plane];
     }
 
     pFrame->destruct = &free_buffers;
+    pFrame->priv_data = pBuffer;
     pFrame->flags |= LAV_FRAME_FLAG_BUFFER_MODIFY;
 
     return S_OK;
@@ -28,6 +28,7 @@ CAnnexBConverter::CAnnexBConverter(void)
 
 CAnnexBConverter::~CAnnexBConverter(void)
 {
+    av_freep(&m_pBuffer);
 }
 
 static HRESULT alloc_and_copy(uint8_t **poutbuf, int *poutbuf_size, const uint8_t *in, uint32_t in_size)
@@ -55,49 +56,120 @@ static HRESULT alloc_and_copy(uint8_t **poutbuf, int *poutbuf_size, const uint8_
     return S_OK;
 }
 
-HRESULT CAnnexBConverter::Convert(BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size)
+static inline int32_t read_nal_size(const uint8_t *buf, int nalu_size)
 {
-    int32_t nal_size;
+    if (nalu_size == 1)
+        return buf[0];
+    else if (nalu_size == 2)
+        return AV_RB16(buf);
+    else if (nalu_size == 3)
+        return AV_RB24(buf);
+    else
+        return (int32_t)AV_RB32(buf);
+}
+
+// The first NAL unit gets a 4 byte start code, all others 3 bytes
+// Returns the size of the converted data, or -1 if the NAL sizes are invalid
+int CAnnexBConverter::GetOutputSize(const BYTE *buf, int buf_size) const
+{
+    if (m_NaluSize < 1 || m_NaluSize > 4 || buf_size <= 0)
+        return -1;
+
     const uint8_t *buf_end = buf + buf_size;
+    int64_t out_size = 0;
 
-    *poutbuf_size = 0;
+    while (buf < buf_end)
+    {
+        if (buf_end - buf < m_NaluSize)
+            return -1;
+
+        int32_t nal_size = read_nal_size(buf, m_NaluSize);
+        buf += m_NaluSize;
 
-    do
+        if (nal_size < 0 || nal_size > buf_end - buf)
+            return -1;
+
+        out_size += nal_size + (out_size ? 3 : 4);
+        buf += nal_size;
+    }
+
+    if (out_size > INT_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        return -1;
+
+    return (int)out_size;
+}
+
+// Only called after GetOutputSize validated the NAL sizes
+void CAnnexBConverter::WriteOutput(BYTE *out, const BYTE *buf, int buf_size) const
+{
+    const uint8_t *buf_end = buf + buf_size;
+    bool first = true;
+
+    while (buf < buf_end)
     {
-        if (buf + m_NaluSize > buf_end)
-            goto fail;
+        int32_t nal_size = read_nal_size(buf, m_NaluSize);
+        buf += m_NaluSize;
 
-        if (m_NaluSize == 1)
-        {
-            nal_size = buf[0];
-        }
-        else if (m_NaluSize == 2)
+        if (first)
         {
-            nal_size = AV_RB16(buf);
+            AV_WB32(out, 1);
+            out += 4;
+            first = false;
         }
         else
         {
-            nal_size = AV_RB32(buf);
-            if (m_NaluSize == 3)
-                nal_size >>= 8;
+            out[0] = out[1] = 0;
+            out[2] = 1;
+            out += 3;
         }
 
-        buf += m_NaluSize;
+        memcpy(out, buf, nal_size);
+        out += nal_size;
+        buf += nal_size;
+    }
+}
+
+HRESULT CAnnexBConverter::Convert(BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size)
+{
+    av_freep(poutbuf);
+    *poutbuf_size = 0;
 
-        if (buf + nal_size > buf_end || nal_size < 0)
-            goto fail;
+    int out_size = GetOutputSize(buf, buf_size);
+    if (out_size < 0)
+        return E_FAIL;
 
-        if (FAILED(alloc_and_copy(poutbuf, poutbuf_size, buf, nal_size)))
-            goto fail;
+    *poutbuf = (BYTE *)av_mallocz(out_size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!*poutbuf)
+        return E_OUTOFMEMORY;
 
-        buf += nal_size;
-        buf_size -= (nal_size + m_NaluSize);
-    } while (buf_size > 0);
+    WriteOutput(*poutbuf, buf, buf_size);
+    *poutbuf_size = out_size;
+
+    return S_OK;
+}
+
+HRESULT CAnnexBConverter::ConvertPacket(const BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size)
+{
+    *poutbuf = nullptr;
+    *poutbuf_size = 0;
+
+    int out_size = GetOutputSize(buf, buf_size);
+    if (out_size < 0)
+        return E_FAIL;
+
+    av_fast_padded_malloc(&m_pBuffer, &m_nBufferSize, out_size);
+    if (!m_pBuffer)
+    {
+        m_nBufferSize = 0;
+        return E_OUTOFMEMORY;
+    }
+
+    WriteOutput(m_pBuffer, buf, buf_size);
+
+    *poutbuf = m_pBuffer;
+    *poutbuf_size = out_size;
 
     return S_OK;
-fail:
-    av_freep(poutbuf);
-    return E_FAIL;
 }
 
 HRESULT CAnnexBConverter::ConvertHEVCExtradata(BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size)
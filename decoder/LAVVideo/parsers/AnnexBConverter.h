@@ -30,10 +30,23 @@ class CAnnexBConverter
         m_NaluSize = nalusize;
         return S_OK;
     }
+
+    // Convert into a newly allocated buffer, which has to be freed by the caller with av_free
     HRESULT Convert(BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size);
 
+    // Convert into a buffer owned by the converter, which is re-used for every packet
+    // The output is valid until the next call
+    HRESULT ConvertPacket(const BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size);
+
     HRESULT ConvertHEVCExtradata(BYTE **poutbuf, int *poutbuf_size, const BYTE *buf, int buf_size);
 
+  private:
+    int GetOutputSize(const BYTE *buf, int buf_size) const;
+    void WriteOutput(BYTE *out, const BYTE *buf, int buf_size) const;
+
   private:
     int m_NaluSize = 0;
+
+    BYTE *m_pBuffer = nullptr;
+    unsigned int m_nBufferSize = 0;
 };
@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "MPEG2HeaderParser.h"
+#include "StartCodeScanner.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4101)
@@ -32,17 +33,7 @@
 
 static inline const uint8_t *find_next_marker(const uint8_t *src, const uint8_t *end)
 {
-    uint32_t mrk = 0xFFFFFFFF;
-
-    if (end - src < 4)
-        return end;
-    while (src < end)
-    {
-        mrk = (mrk << 8) | *src++;
-        if ((mrk & ~0xFF) == 0x00000100)
-            return src - 4;
-    }
-    return end;
+    return FindStartCodeMarker(src, end);
 }
 
 CMPEG2HeaderParser::CMPEG2HeaderParser(const BYTE *pData, size_t length)
@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "VC1HeaderParser.h"
+#include "StartCodeScanner.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4101)
@@ -71,17 +72,7 @@ enum FrameCodingMode
  */
 static inline const uint8_t *find_next_marker(const uint8_t *src, const uint8_t *end)
 {
-    uint32_t mrk = 0xFFFFFFFF;
-
-    if (end - src < 4)
-        return end;
-    while (src < end)
-    {
-        mrk = (mrk << 8) | *src++;
-        if (IS_MARKER(mrk))
-            return src - 4;
-    }
-    return end;
+    return FindStartCodeMarker(src, end);
 }
 
 static inline int vc1_unescape_buffer(const uint8_t *src, int size, uint8_t *dst)
@@ -0,0 +1,153 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+
+#include <emmintrin.h>
+
+#include "LAVPixFmtConverter.h"
+
+// Point-sample every 2^shift'th element of a row
+template <typename T> static void decimate_row_c(const uint8_t *src, uint8_t *dst, int count, int shift, int start)
+{
+    const T *in = (const T *)src;
+    T *out = (T *)dst;
+    for (int x = start; x < count; x++)
+        out[x] = in[x << shift];
+}
+
+static void decimate_row(const uint8_t *src, uint8_t *dst, int count, int element, int shift)
+{
+    int x = 0;
+
+    // Halving is the common case for preview sizes, and can be done with a pack
+    if (shift == 1 && element == 1)
+    {
+        const __m128i mask = _mm_set1_epi16(0x00ff);
+        for (; x + 16 <= count; x += 16)
+        {
+            __m128i xmm0 = _mm_loadu_si128((const __m128i *)(src + 2 * x));
+            __m128i xmm1 = _mm_loadu_si128((const __m128i *)(src + 2 * x + 16));
+            xmm0 = _mm_packus_epi16(_mm_and_si128(xmm0, mask), _mm_and_si128(xmm1, mask));
+            _mm_storeu_si128((__m128i *)(dst + x), xmm0);
+        }
+    }
+    else if (shift == 1 && element == 2)
+    {
+        for (; x + 8 <= count; x += 8)
+        {
+            __m128i xmm0 = _mm_loadu_si128((const __m128i *)(src + 4 * x));
+            __m128i xmm1 = _mm_loadu_si128((const __m128i *)(src + 4 * x + 16));
+            // sign-extend the low word of every dword, so the signed pack is lossless
+            xmm0 = _mm_srai_epi32(_mm_slli_epi32(xmm0, 16), 16);
+            xmm1 = _mm_srai_epi32(_mm_slli_epi32(xmm1, 16), 16);
+            _mm_storeu_si128((__m128i *)(dst + 2 * x), _mm_packs_epi32(xmm0, xmm1));
+        }
+    }
+
+    switch (element)
+    {
+    case 1: decimate_row_c<uint8_t>(src, dst, count, shift, x); break;
+    case 2: decimate_row_c<uint16_t>(src, dst, count, shift, x); break;
+    case 4: decimate_row_c<uint32_t>(src, dst, count, shift, x); break;
+    case 8: decimate_row_c<uint64_t>(src, dst, count, shift, x); break;
+    default:
+        for (; x < count; x++)
+            memcpy(dst + x * element, src + (x << shift) * element, element);
+    }
+}
+
+// Packed 4:2:2 (Y0 U Y1 V) keeps the chroma of every 2^shift'th macropixel, and takes the second luma sample
+// from halfway to the next one, so luma stays evenly spaced
+template <typename T> static void decimate_row_422packed(const uint8_t *src, uint8_t *dst, int count, int shift)
+{
+    const T *in = (const T *)src;
+    T *out = (T *)dst;
+    const int half = 1 << (shift - 1);
+    for (int x = 0; x < count; x++)
+    {
+        const T *mp0 = in + ((ptrdiff_t)x << shift) * 4;
+        const T *mp1 = in + (((ptrdiff_t)x << shift) + half) * 4;
+        out[4 * x + 0] = mp0[0];
+        out[4 * x + 1] = mp0[1];
+        out[4 * x + 2] = mp1[0];
+        out[4 * x + 3] = mp0[3];
+    }
+}
+
+HRESULT CLAVPixFmtConverter::Decimate(const uint8_t *const src[4], const ptrdiff_t srcStride[4], int width, int height,
+                                      uint8_t *dst[4], ptrdiff_t dstStride[4])
+{
+    const LAVPixFmtDesc desc = getPixelFormatDesc(m_InputPixFmt);
+    const int shift = m_nDecimation;
+
+    // Interleaved chroma and packed 4:2:2 formats are sampled in pairs
+    const bool bInterleaved = (m_InputPixFmt == LAVPixFmt_NV12 || m_InputPixFmt == LAVPixFmt_P016);
+    const bool bPacked422 = (m_InputPixFmt == LAVPixFmt_YUY2 || m_InputPixFmt == LAVPixFmt_Y216);
+
+    int count[4] = {0}, rows[4] = {0}, element[4] = {0};
+    size_t size = 0;
+    for (int plane = 0; plane < desc.planes; plane++)
+    {
+        if ((bInterleaved && plane == 1) || bPacked422)
+        {
+            count[plane] = (width + 1) >> 1;
+            element[plane] = desc.codedbytes * 2;
+        }
+        else
+        {
+            count[plane] = (width + desc.planeWidth[plane] - 1) / desc.planeWidth[plane];
+            element[plane] = desc.codedbytes;
+        }
+        rows[plane] = (height + desc.planeHeight[plane] - 1) / desc.planeHeight[plane];
+        dstStride[plane] = FFALIGN(count[plane] * element[plane], 64);
+        size += dstStride[plane] * rows[plane];
+    }
+
+    if (size > m_nDecimateBufferSize || !m_pDecimateBuffer)
+    {
+        av_freep(&m_pDecimateBuffer);
+        m_pDecimateBuffer = (uint8_t *)av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+        if (!m_pDecimateBuffer)
+        {
+            m_nDecimateBufferSize = 0;
+            return E_OUTOFMEMORY;
+        }
+        m_nDecimateBufferSize = size;
+    }
+
+    uint8_t *out = m_pDecimateBuffer;
+    for (int plane = 0; plane < desc.planes; plane++)
+    {
+        dst[plane] = out;
+        for (int y = 0; y < rows[plane]; y++)
+        {
+            const uint8_t *in = src[plane] + ((ptrdiff_t)y << shift) * srcStride[plane];
+            if (bPacked422 && desc.codedbytes == 2)
+                decimate_row_422packed<uint8_t>(in, out, count[plane], shift);
+            else if (bPacked422)
+                decimate_row_422packed<uint16_t>(in, out, count[plane], shift);
+            else
+                decimate_row(in, out, count[plane], element[plane], shift);
+            out += dstStride[plane];
+        }
+    }
+
+    return S_OK;
+}
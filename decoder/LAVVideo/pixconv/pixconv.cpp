@@ -47,13 +47,20 @@ DECLARE_CONV_FUNC_IMPL(plane_copy)
 
     for (plane = 0; plane < planes; plane++)
     {
-        const int planeWidth = widthBytes / desc.planeWidth[plane];
-        const int planeHeight = height / desc.planeHeight[plane];
+        ptrdiff_t planeWidth = widthBytes / desc.planeWidth[plane];
+        ptrdiff_t planeHeight = height / desc.planeHeight[plane];
         const ptrdiff_t srcPlaneStride = srcStride[plane];
         const ptrdiff_t dstPlaneStride = dstStride[plane];
         const uint8_t *const srcBuf = src[plane];
         uint8_t *const dstBuf = dst[plane];
 
+        // With matching strides, the plane is copied as one block
+        if (srcPlaneStride == dstPlaneStride && dstPlaneStride > 0 && planeHeight > 0)
+        {
+            planeWidth += dstPlaneStride * (planeHeight - 1);
+            planeHeight = 1;
+        }
+
         for (line = 0; line < planeHeight; ++line)
         {
             memcpy(dstBuf + line * dstPlaneStride, srcBuf + line * srcPlaneStride, planeWidth);
@@ -74,13 +81,20 @@ DECLARE_CONV_FUNC_IMPL(plane_copy_sse2)
 
     for (plane = 0; plane < planes; plane++)
     {
-        const int planeWidth = widthBytes / desc.planeWidth[plane];
-        const int planeHeight = height / desc.planeHeight[plane];
+        ptrdiff_t planeWidth = widthBytes / desc.planeWidth[plane];
+        ptrdiff_t planeHeight = height / desc.planeHeight[plane];
         const ptrdiff_t srcPlaneStride = srcStride[plane];
         const ptrdiff_t dstPlaneStride = dstStride[plane];
         const uint8_t *const srcBuf = src[plane];
         uint8_t *const dstBuf = dst[plane];
 
+        // With matching strides, the plane is copied as one block
+        if (srcPlaneStride == dstPlaneStride && dstPlaneStride > 0 && planeHeight > 0)
+        {
+            planeWidth += dstPlaneStride * (planeHeight - 1);
+            planeHeight = 1;
+        }
+
         if ((dstPlaneStride % 16) == 0 && ((intptr_t)dstBuf % 16u) == 0)
         {
             for (line = 0; line < planeHeight; ++line)
@@ -206,6 +206,20 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv)
     if (inputFormat == LAVPixFmt_YUV420 || inputFormat == LAVPixFmt_YUV422)
         chromaWidth = (chromaWidth + 1) >> 1;
 
+    // With matching strides, each plane is copied as one block
+    ptrdiff_t lumaWidth = width;
+    ptrdiff_t lumaHeight = height;
+    if (inLumaStride == outLumaStride && outLumaStride > 0 && lumaHeight > 0)
+    {
+        lumaWidth += outLumaStride * (lumaHeight - 1);
+        lumaHeight = 1;
+    }
+    if (inChromaStride == outChromaStride && outChromaStride > 0 && chromaHeight > 0)
+    {
+        chromaWidth += outChromaStride * (chromaHeight - 1);
+        chromaHeight = 1;
+    }
+
     // Copy planes
 
     _mm_sfence();
@@ -213,16 +227,16 @@ DECLARE_CONV_FUNC_IMPL(convert_yuv_yv)
     // Y
     if ((outLumaStride % 16) == 0 && ((intptr_t)dst[0] % 16u) == 0)
     {
-        for (line = 0; line < height; ++line)
+        for (line = 0; line < lumaHeight; ++line)
         {
-            PIXCONV_MEMCPY_ALIGNED(dst[0] + outLumaStride * line, y + inLumaStride * line, width);
+            PIXCONV_MEMCPY_ALIGNED(dst[0] + outLumaStride * line, y + inLumaStride * line, lumaWidth);
         }
     }
     else
     {
-        for (line = 0; line < height; ++line)
+        for (line = 0; line < lumaHeight; ++line)
         {
-            memcpy(dst[0] + outLumaStride * line, y + inLumaStride * line, width);
+            memcpy(dst[0] + outLumaStride * line, y + inLumaStride * line, lumaWidth);
         }
     }
 
@@ -0,0 +1,177 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "BDClipPrefetcher.h"
+#include "BDDemuxer.h"
+
+#define BD_PREFETCH_READ_SIZE (1024 * 1024)
+
+CBDClipPrefetcher::CBDClipPrefetcher()
+{
+}
+
+CBDClipPrefetcher::~CBDClipPrefetcher()
+{
+    m_bAbort = TRUE;
+    if (ThreadExists())
+    {
+        CallWorker(CMD_EXIT);
+        Close();
+    }
+
+    FreeResults();
+    av_freep(&m_pReadBuffer);
+}
+
+void CBDClipPrefetcher::FreeResults()
+{
+    if (m_MVCContext)
+        avformat_close_input(&m_MVCContext);
+
+    m_MVCStreamIndex = -1;
+}
+
+HRESULT CBDClipPrefetcher::Prefetch(int clip, const char *m2tsFile, const char *mvcFile)
+{
+    CheckPointer(m2tsFile, E_POINTER);
+
+    // make sure a previous prefetch is finished before re-using the state
+    Reset();
+
+    {
+        CAutoLock lock(&m_csResults);
+        m_Clip = clip;
+        m_M2TSFile = m2tsFile;
+        m_MVCFile = mvcFile ? mvcFile : "";
+        m_bAbort = FALSE;
+        m_evDone.Reset();
+    }
+
+    if (!ThreadExists() && !Create())
+    {
+        m_evDone.Set();
+        return E_FAIL;
+    }
+
+    CallWorker(CMD_PREFETCH);
+    return S_OK;
+}
+
+HRESULT CBDClipPrefetcher::Take(int clip, AVFormatContext **ppMVCContext, int *pMVCStreamIndex)
+{
+    if (m_Clip != clip)
+        return S_FALSE;
+
+    // The prefetch should be long done by now, if it isn't, waiting is still faster then starting over
+    m_evDone.Wait();
+
+    CAutoLock lock(&m_csResults);
+    if (ppMVCContext)
+    {
+        *ppMVCContext = m_MVCContext;
+        m_MVCContext = nullptr;
+        if (pMVCStreamIndex)
+            *pMVCStreamIndex = m_MVCStreamIndex;
+    }
+
+    FreeResults();
+    m_Clip = -1;
+
+    return S_OK;
+}
+
+void CBDClipPrefetcher::Reset()
+{
+    if (m_Clip == -1)
+        return;
+
+    m_bAbort = TRUE;
+    m_evDone.Wait();
+
+    CAutoLock lock(&m_csResults);
+    FreeResults();
+    m_Clip = -1;
+}
+
+DWORD CBDClipPrefetcher::ThreadProc()
+{
+    SetThreadName(-1, "LAV BD Clip Prefetcher");
+
+    DWORD cmd;
+    while (1)
+    {
+        cmd = GetRequest();
+        switch (cmd)
+        {
+        case CMD_EXIT: Reply(S_OK); return 0;
+        case CMD_PREFETCH:
+            Reply(S_OK);
+            DoPrefetch();
+            m_evDone.Set();
+            break;
+        }
+    }
+    return 1;
+}
+
+void CBDClipPrefetcher::DoPrefetch()
+{
+    DbgLog((LOG_TRACE, 10, L"CBDClipPrefetcher::DoPrefetch(): Prefetching clip %d", m_Clip));
+
+    // Read the head of the clip, so the initial reads of libbluray are served from the file cache
+    wchar_t wFileName[4096];
+    if (SafeMultiByteToWideChar(CP_UTF8, 0, m_M2TSFile.c_str(), -1, wFileName, 4096))
+    {
+        HANDLE hFile = CreateFile(wFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (hFile != INVALID_HANDLE_VALUE)
+        {
+            if (!m_pReadBuffer)
+                m_pReadBuffer = (uint8_t *)av_malloc(BD_PREFETCH_READ_SIZE);
+
+            DWORD dwTotal = 0, dwRead = 0;
+            while (m_pReadBuffer && !m_bAbort && dwTotal < BD_PREFETCH_HEAD_SIZE &&
+                   ReadFile(hFile, m_pReadBuffer, BD_PREFETCH_READ_SIZE, &dwRead, nullptr) && dwRead > 0)
+            {
+                dwTotal += dwRead;
+            }
+            CloseHandle(hFile);
+            DbgLog((LOG_TRACE, 10, L" -> Read %u bytes from the head of the clip", dwTotal));
+        }
+    }
+
+    if (m_bAbort)
+        return;
+
+    // Open the MVC extension stream, this requires probing the stream and is by far the most expensive part
+    AVFormatContext *mvcContext = nullptr;
+    int mvcStreamIndex = -1;
+    if (!m_bAbort && !m_MVCFile.empty())
+    {
+        if (FAILED(CBDDemuxer::OpenMVCExtensionFile(m_MVCFile.c_str(), &mvcContext, &mvcStreamIndex)))
+        {
+            DbgLog((LOG_TRACE, 10, L" -> Opening the MVC extension failed"));
+        }
+    }
+
+    CAutoLock lock(&m_csResults);
+    m_MVCContext = mvcContext;
+    m_MVCStreamIndex = mvcStreamIndex;
+}
@@ -0,0 +1,75 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <string>
+
+// Amount of data read from the head of the next clip, to warm up the file cache
+#define BD_PREFETCH_HEAD_SIZE (8 * 1024 * 1024)
+
+// Distance to the end of the current clip (in bytes) at which the next clip is being prefetched
+#define BD_PREFETCH_LOOKAHEAD (16 * 1024 * 1024)
+
+// Background worker that prepares the next clip of a playlist before playback reaches it.
+// It reads the head of the M2TS file and optionally opens the MVC extension stream,
+// so the clip transition on the demuxing thread only has to pick up the results.
+class CBDClipPrefetcher : protected CAMThread
+{
+  public:
+    CBDClipPrefetcher();
+    ~CBDClipPrefetcher();
+
+    // Queue a prefetch of the given clip. Returns immediately, the work is done on the worker thread.
+    HRESULT Prefetch(int clip, const char *m2tsFile, const char *mvcFile);
+
+    // Wait for the prefetch of the given clip to finish, and take ownership of its results.
+    // Returns S_FALSE if the clip was not prefetched.
+    HRESULT Take(int clip, AVFormatContext **ppMVCContext, int *pMVCStreamIndex);
+
+    // Abort any running prefetch and discard all results
+    void Reset();
+
+    int GetClip() const { return m_Clip; }
+
+  private:
+    enum
+    {
+        CMD_EXIT,
+        CMD_PREFETCH
+    };
+    DWORD ThreadProc();
+
+    void DoPrefetch();
+    void FreeResults();
+
+  private:
+    CCritSec m_csResults;
+    CAMEvent m_evDone{TRUE};
+    volatile BOOL m_bAbort = FALSE;
+
+    int m_Clip = -1;
+    std::string m_M2TSFile;
+    std::string m_MVCFile;
+
+    AVFormatContext *m_MVCContext = nullptr;
+    int m_MVCStreamIndex = -1;
+
+    uint8_t *m_pReadBuffer = nullptr;
+};
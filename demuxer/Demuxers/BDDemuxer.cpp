@@ -139,8 +139,12 @@ CBDDemuxer::CBDDemuxer(CCritSec *pLock, ILAVFSettingsInternal *pSettings)
 
 CBDDemuxer::~CBDDemuxer(void)
 {
+    m_Prefetcher.Reset();
     CloseMVCExtensionDemuxer();
 
+    if (m_MVCPrefetchContext)
+        avformat_close_input(&m_MVCPrefetchContext);
+
     if (m_pTitle)
     {
         bd_free_title_info(m_pTitle);
@@ -162,6 +166,7 @@ CBDDemuxer::~CBDDemuxer(void)
     SafeRelease(&m_lavfDemuxer);
     SAFE_CO_FREE(m_StreamClip);
     SAFE_CO_FREE(m_rtOffset);
+    SAFE_DELETE(m_pCache);
 }
 
 STDMETHODIMP CBDDemuxer::NonDelegatingQueryInterface(REFIID riid, void **ppv)
@@ -229,56 +234,51 @@ STDMETHODIMP CBDDemuxer::Open(LPCOLESTR pszFileName, LPCOLESTR pszUserAgent, LPC
         m_pBD = bd;
         strcpy_s(m_cBDRootPath, bd_path);
 
-        uint32_t timelimit = (iPlaylist != -1) ? 0 : 180;
-        uint8_t flags = (iPlaylist != -1) ? TITLES_ALL : TITLES_RELEVANT;
+        // Reading ahead on optical drives or network shares competes with the playing clip, only prefetch locally
+        if (pszFileName[0] && pszFileName[1] == L':')
+        {
+            WCHAR root[] = {pszFileName[0], L':', L'\\', 0};
+            UINT type = GetDriveTypeW(root);
+            m_bLocalRoot = (type == DRIVE_FIXED || type == DRIVE_REMOVABLE || type == DRIVE_RAMDISK);
+        }
+        DbgLog((LOG_TRACE, 10, L"Clip prefetching %s", m_bLocalRoot ? L"available" : L"disabled (not a local disk)"));
 
-        // Fetch titles
-    fetchtitles:
-        m_nTitleCount = bd_get_titles(bd, flags, timelimit);
+        m_pCache = new CBDMetadataCache(m_cBDRootPath);
+        m_pCache->Load();
 
-        if (m_nTitleCount <= 0)
-        {
-            if (timelimit > 0)
-            {
-                timelimit = 0;
-                goto fetchtitles;
-            }
-            if (flags != TITLES_ALL)
-            {
-                flags = TITLES_ALL;
-                goto fetchtitles;
-            }
+        // Fetch titles, all of them if a playlist was opened, or if the disc has no relevant titles
+        m_Titles.clear();
+        if (iPlaylist == -1)
+            FetchTitles(CBDMetadataCache::TitlesRelevant, m_Titles);
+        if (m_Titles.empty())
+            FetchTitles(CBDMetadataCache::TitlesAll, m_Titles);
+        m_pCache->Save();
+
+        m_nTitleCount = (uint32_t)m_Titles.size();
+        if (m_nTitleCount == 0)
             return E_FAIL;
-        }
 
         DbgLog((LOG_TRACE, 20, L"Found %d titles", m_nTitleCount));
         DbgLog((LOG_TRACE, 20, L" ------ Begin Title Listing ------"));
 
         uint64_t longest_duration = 0;
         uint32_t title_id = 0;
-        boolean found = false;
         for (uint32_t i = 0; i < m_nTitleCount; i++)
         {
-            BLURAY_TITLE_INFO *info = bd_get_title_info(bd, i, 0);
-            if (info)
+            const BDCacheTitle &info = m_Titles[i];
+            DbgLog((LOG_TRACE, 20, L"Title %u, Playlist %u (%u clips), Duration %I64u (%I64u seconds)", i,
+                    info.playlist, info.clip_count, info.duration,
+                    Convert90KhzToDSTime(info.duration) / DSHOW_TIME_BASE));
+            if (iPlaylist != -1 && info.playlist == iPlaylist)
             {
-                DbgLog((LOG_TRACE, 20, L"Title %u, Playlist %u (%u clips, %u chapters), Duration %I64u (%I64u seconds)",
-                        i, info->playlist, info->clip_count, info->chapter_count, info->duration,
-                        Convert90KhzToDSTime(info->duration) / DSHOW_TIME_BASE));
-                if (iPlaylist != -1 && info->playlist == iPlaylist)
-                {
-                    title_id = i;
-                    found = true;
-                }
-                else if (iPlaylist == -1 && info->duration > longest_duration)
-                {
-                    title_id = i;
-                    longest_duration = info->duration;
-                }
-                bd_free_title_info(info);
-            }
-            if (found)
+                title_id = i;
                 break;
+            }
+            else if (iPlaylist == -1 && info.duration > longest_duration)
+            {
+                title_id = i;
+                longest_duration = info.duration;
+            }
         }
         DbgLog((LOG_TRACE, 20, L" ------ End Title Listing ------"));
 
@@ -288,6 +288,37 @@ STDMETHODIMP CBDDemuxer::Open(LPCOLESTR pszFileName, LPCOLESTR pszUserAgent, LPC
     return hr;
 }
 
+// Get one of the title lists from the cache, or from libbluray. Each list is cached under its own key, including
+// an empty one, so a disc without relevant titles does not have to be enumerated twice.
+void CBDDemuxer::FetchTitles(CBDMetadataCache::TitleList list, std::vector<BDCacheTitle> &titles)
+{
+    titles.clear();
+    if (m_pCache->GetTitles(list, titles))
+    {
+        DbgLog((LOG_TRACE, 20, L"Using cached title list %d", list));
+        return;
+    }
+
+    const uint8_t flags = (list == CBDMetadataCache::TitlesAll) ? TITLES_ALL : TITLES_RELEVANT;
+    uint32_t count = bd_get_titles(m_pBD, flags, (list == CBDMetadataCache::TitlesAll) ? 0 : 180);
+    if (count == 0 && list != CBDMetadataCache::TitlesAll)
+        count = bd_get_titles(m_pBD, flags, 0);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        BLURAY_TITLE_INFO *info = bd_get_title_info(m_pBD, i, 0);
+        if (info)
+        {
+            BDCacheTitle title;
+            CBDMetadataCache::ParseTitleInfo(info, title);
+            titles.push_back(title);
+            bd_free_title_info(info);
+        }
+    }
+
+    m_pCache->SetTitles(list, titles);
+}
+
 STDMETHODIMP CBDDemuxer::Start()
 {
     HRESULT hr = m_lavfDemuxer->Start();
@@ -326,6 +357,15 @@ void CBDDemuxer::ProcessBDEvents()
                 m_NewClip = event.param;
                 DbgLog((LOG_TRACE, 10, L"New clip! offset: %I64d bytepos: %I64u", m_rtNewOffset, bytepos));
             }
+
+            // Remember where the next clip starts, so it can be prefetched in time
+            uint64_t next_start, next_in, next_bytepos;
+            m_llNextClipPos = -1;
+            if (m_pTitle && event.param + 1 < m_pTitle->clip_count &&
+                bd_get_clip_infos(m_pBD, event.param + 1, &next_start, &next_in, &next_bytepos, nullptr))
+            {
+                m_llNextClipPos = next_bytepos;
+            }
             m_EndOfStreamPacketFlushProtection = FALSE;
         }
         else if (event.event == BD_EVENT_END_OF_TITLE)
@@ -343,6 +383,14 @@ STDMETHODIMP CBDDemuxer::ProcessPacket(Packet *pPacket)
 {
     ProcessBDEvents();
 
+    // Start prefetching the next clip when we're getting close to its start
+    if (pPacket && pPacket->bPosition != -1 && m_llNextClipPos > 0 && m_TransitionClip == m_NewClip &&
+        m_Prefetcher.GetClip() != m_NewClip + 1 && pPacket->bPosition + BD_PREFETCH_LOOKAHEAD >= m_llNextClipPos &&
+        m_bLocalRoot && m_pSettings->GetBDClipPrefetch())
+    {
+        PrefetchNextClip();
+    }
+
     if (pPacket && pPacket->rtStart != Packet::INVALID_TIME)
     {
         REFERENCE_TIME rtOffset = m_rtOffset[pPacket->StreamId];
@@ -355,13 +403,28 @@ STDMETHODIMP CBDDemuxer::ProcessPacket(Packet *pPacket)
             rtOffset = m_rtOffset[pPacket->StreamId] = m_rtNewOffset;
             m_StreamClip[pPacket->StreamId] = m_NewClip;
 
+            if (m_TransitionClip != m_NewClip)
+                ProcessClipTransition();
+
             // Flush MVC extensions on stream change, it'll re-fill automatically
             if (m_MVCPlayback && pPacket->StreamId == m_lavfDemuxer->m_nH264MVCBaseStream &&
                 m_MVCExtensionClip != m_NewClip)
             {
                 m_lavfDemuxer->FlushMVCExtensionQueue();
                 CloseMVCExtensionDemuxer();
-                OpenMVCExtensionDemuxer(m_NewClip);
+
+                // Use the prefetched extension stream, if available
+                if (m_MVCPrefetchContext)
+                {
+                    m_MVCFormatContext = m_MVCPrefetchContext;
+                    m_MVCStreamIndex = m_MVCPrefetchStreamIndex;
+                    m_MVCExtensionClip = m_NewClip;
+                    m_MVCPrefetchContext = nullptr;
+                }
+                else
+                {
+                    OpenMVCExtensionDemuxer(m_NewClip);
+                }
             }
         }
         // DbgLog((LOG_TRACE, 10, L"Frame: stream: %d, start: %I64d, corrected: %I64d, bytepos: %I64d",
@@ -382,6 +445,103 @@ STDMETHODIMP CBDDemuxer::ProcessPacket(Packet *pPacket)
         }
     }
 
+    if (pPacket)
+        QueryPerformanceCounter(&m_liLastPacketTime);
+
+    return S_OK;
+}
+
+void CBDDemuxer::PrefetchNextClip()
+{
+    int clip = m_NewClip + 1;
+    MPLS_PL *pl = bd_get_title_mpls(m_pBD);
+    if (!pl || clip >= pl->list_count)
+        return;
+
+    const char *clip_id = pl->play_item[clip].clip[0].clip_id;
+    char *m2tsFile = av_asprintf("%sBDMV\\STREAM\\%s.m2ts", m_cBDRootPath, clip_id);
+    char *mvcFile = nullptr;
+    if (m_MVCPlayback)
+    {
+        const char *mvc_clip_id = pl->ext_sub_path[m_MVCExtensionSubPathIndex].sub_play_item[clip].clip->clip_id;
+        mvcFile = av_asprintf("%sBDMV\\STREAM\\%s.m2ts", m_cBDRootPath, mvc_clip_id);
+    }
+
+    if (m2tsFile)
+    {
+        DbgLog((LOG_TRACE, 10, L"CBDDemuxer::PrefetchNextClip(): Prefetching clip %d (%S)", clip, clip_id));
+        m_Prefetcher.Prefetch(clip, m2tsFile, mvcFile);
+    }
+
+    av_free(m2tsFile);
+    av_free(mvcFile);
+}
+
+// The stream info of all clips was processed when the title was opened, only the prefetched extension stream is
+// picked up here. The clip timing is updated from the playitem events.
+void CBDDemuxer::ProcessClipTransition()
+{
+    LARGE_INTEGER liStart, liEnd;
+    QueryPerformanceCounter(&liStart);
+
+    AVFormatContext *mvcContext = nullptr;
+    int mvcStreamIndex = -1;
+    HRESULT hr = m_Prefetcher.Take(m_NewClip, &mvcContext, &mvcStreamIndex);
+
+    // Keep the extension stream until the base view reaches the new clip
+    if (m_MVCPrefetchContext)
+        avformat_close_input(&m_MVCPrefetchContext);
+    m_MVCPrefetchContext = mvcContext;
+    m_MVCPrefetchStreamIndex = mvcStreamIndex;
+
+    m_TransitionClip = m_NewClip;
+
+    QueryPerformanceCounter(&liEnd);
+
+    // The gap between the last packet of the previous clip and the first one of the new clip
+    // Transitions right after opening a title or seeking have no previous packet, and are not counted.
+    if (m_liLastPacketTime.QuadPart)
+    {
+        const LONGLONG llGap = liEnd.QuadPart - m_liLastPacketTime.QuadPart;
+
+        CAutoLock lock(&m_TransitionStats.csStats);
+        m_TransitionStats.nTransitions++;
+        if (hr == S_OK)
+            m_TransitionStats.nPrefetched++;
+        m_TransitionStats.llGapTotal += llGap;
+        m_TransitionStats.llGapMax = max(m_TransitionStats.llGapMax, llGap);
+    }
+
+#ifdef DEBUG
+    LARGE_INTEGER liFrequency;
+    QueryPerformanceFrequency(&liFrequency);
+    DbgLog((LOG_TRACE, 10,
+            L"CBDDemuxer::ProcessClipTransition(): Clip %d, prefetched: %d, delivery gap: %.2f ms, transition: %.2f ms",
+            m_NewClip, hr == S_OK,
+            m_liLastPacketTime.QuadPart ? (liEnd.QuadPart - m_liLastPacketTime.QuadPart) * 1000.0 / liFrequency.QuadPart
+                                        : 0.0,
+            (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFrequency.QuadPart));
+#endif
+}
+
+STDMETHODIMP CBDDemuxer::GetClipTransitionStatus(ULONGLONG *pnTransitions, ULONGLONG *pnPrefetched, double *pdAvgGap,
+                                                 double *pdMaxGap)
+{
+    LARGE_INTEGER liFrequency;
+    QueryPerformanceFrequency(&liFrequency);
+    const double dTicksPerMs = liFrequency.QuadPart / 1000.0;
+
+    CAutoLock lock(&m_TransitionStats.csStats);
+    if (pnTransitions)
+        *pnTransitions = m_TransitionStats.nTransitions;
+    if (pnPrefetched)
+        *pnPrefetched = m_TransitionStats.nPrefetched;
+    if (pdAvgGap)
+        *pdAvgGap = m_TransitionStats.nTransitions
+                        ? m_TransitionStats.llGapTotal / dTicksPerMs / m_TransitionStats.nTransitions
+                        : 0.0;
+    if (pdMaxGap)
+        *pdMaxGap = m_TransitionStats.llGapMax / dTicksPerMs;
     return S_OK;
 }
 
@@ -393,65 +553,82 @@ void CBDDemuxer::CloseMVCExtensionDemuxer()
     m_MVCExtensionClip = -1;
 }
 
-STDMETHODIMP CBDDemuxer::OpenMVCExtensionDemuxer(int playItem)
+HRESULT CBDDemuxer::OpenMVCExtensionFile(const char *fileName, AVFormatContext **ppFormatContext, int *pStreamIndex)
 {
     int ret;
-    MPLS_PL *pl = bd_get_title_mpls(m_pBD);
-    if (!pl)
-        return E_FAIL;
-
-    const char *clip_id = pl->ext_sub_path[m_MVCExtensionSubPathIndex].sub_play_item[playItem].clip->clip_id;
-    char *fileName = av_asprintf("%sBDMV\\STREAM\\%s.m2ts", m_cBDRootPath, clip_id);
+    AVFormatContext *ctx = nullptr;
 
-    DbgLog((LOG_TRACE, 10, "CBDDemuxer::OpenMVCExtensionDemuxer(): Opening MVC extension stream at %s", fileName));
+    *ppFormatContext = nullptr;
+    *pStreamIndex = -1;
 
     // Try to open the MVC stream
     const AVInputFormat *format = av_find_input_format("mpegts");
-    ret = avformat_open_input(&m_MVCFormatContext, fileName, format, nullptr);
+    ret = avformat_open_input(&ctx, fileName, format, nullptr);
     if (ret < 0)
     {
         DbgLog((LOG_TRACE, 10, "-> Opening MVC demuxing context failed (%d)", ret));
-        goto fail;
+        return E_FAIL;
     }
 
-    av_opt_set_int(m_MVCFormatContext, "correct_ts_overflow", 0, 0);
+    av_opt_set_int(ctx, "correct_ts_overflow", 0, 0);
 
     // Find the streams
-    ret = avformat_find_stream_info(m_MVCFormatContext, nullptr);
+    ret = avformat_find_stream_info(ctx, nullptr);
     if (ret < 0)
     {
         DbgLog((LOG_TRACE, 10, "-> avformat_find_stream_info failed (%d)", ret));
-        goto fail;
+        avformat_close_input(&ctx);
+        return E_FAIL;
     }
 
     // Find and select our MVC stream
-    DbgLog((LOG_TRACE, 10, "-> MVC m2ts has %d streams", m_MVCFormatContext->nb_streams));
-    for (unsigned i = 0; i < m_MVCFormatContext->nb_streams; i++)
+    DbgLog((LOG_TRACE, 10, "-> MVC m2ts has %d streams", ctx->nb_streams));
+    for (unsigned i = 0; i < ctx->nb_streams; i++)
     {
-        if (m_MVCFormatContext->streams[i]->codecpar->codec_id == AV_CODEC_ID_H264_MVC &&
-            m_MVCFormatContext->streams[i]->codecpar->extradata_size > 0)
+        if (ctx->streams[i]->codecpar->codec_id == AV_CODEC_ID_H264_MVC &&
+            ctx->streams[i]->codecpar->extradata_size > 0)
         {
-            m_MVCStreamIndex = i;
+            *pStreamIndex = i;
             break;
         }
         else
         {
-            m_MVCFormatContext->streams[i]->discard = AVDISCARD_ALL;
+            ctx->streams[i]->discard = AVDISCARD_ALL;
         }
     }
 
-    if (m_MVCStreamIndex < 0)
+    if (*pStreamIndex < 0)
     {
         DbgLog((LOG_TRACE, 10, "-> MVC Stream not found"));
-        goto fail;
+        avformat_close_input(&ctx);
+        return E_FAIL;
     }
 
+    *ppFormatContext = ctx;
+    return S_OK;
+}
+
+STDMETHODIMP CBDDemuxer::OpenMVCExtensionDemuxer(int playItem)
+{
+    MPLS_PL *pl = bd_get_title_mpls(m_pBD);
+    if (!pl)
+        return E_FAIL;
+
+    const char *clip_id = pl->ext_sub_path[m_MVCExtensionSubPathIndex].sub_play_item[playItem].clip->clip_id;
+    char *fileName = av_asprintf("%sBDMV\\STREAM\\%s.m2ts", m_cBDRootPath, clip_id);
+
+    DbgLog((LOG_TRACE, 10, "CBDDemuxer::OpenMVCExtensionDemuxer(): Opening MVC extension stream at %s", fileName));
+
+    CloseMVCExtensionDemuxer();
+    HRESULT hr = OpenMVCExtensionFile(fileName, &m_MVCFormatContext, &m_MVCStreamIndex);
+    av_free(fileName);
+
+    if (FAILED(hr))
+        return hr;
+
     m_MVCExtensionClip = playItem;
 
     return S_OK;
-fail:
-    CloseMVCExtensionDemuxer();
-    return E_FAIL;
 }
 
 #define MVC_DEMUX_COUNT 100
@@ -539,22 +716,41 @@ STDMETHODIMP CBDDemuxer::SetTitle(int idx)
 {
     HRESULT hr = S_OK;
     int ret; // return values
-    if (m_pTitle)
-    {
-        bd_free_title_info(m_pTitle);
-    }
+    if (idx < 0 || (size_t)idx >= m_Titles.size())
+        return E_INVALIDARG;
 
     // Init Event Queue
     bd_get_event(m_pBD, nullptr);
 
-    // Select title
-    m_pTitle = bd_get_title_info(m_pBD, idx, 0);
-    ret = bd_select_title(m_pBD, idx);
+    // Select title by its playlist, which works without enumerating all titles first
+    BLURAY_TITLE_INFO *pTitle = bd_get_playlist_info(m_pBD, m_Titles[idx].playlist, 0);
+    ret = pTitle ? bd_select_playlist(m_pBD, m_Titles[idx].playlist) : 0;
     if (ret == 0)
     {
+        if (pTitle)
+            bd_free_title_info(pTitle);
         return E_FAIL;
     }
 
+    if (m_pTitle)
+    {
+        bd_free_title_info(m_pTitle);
+    }
+    m_pTitle = pTitle;
+
+    // Drop any state of the previous title
+    m_Prefetcher.Reset();
+    if (m_MVCPrefetchContext)
+        avformat_close_input(&m_MVCPrefetchContext);
+    m_llNextClipPos = -1;
+    m_TransitionClip = -1;
+    m_liLastPacketTime.QuadPart = 0;
+    {
+        CAutoLock lock(&m_TransitionStats.csStats);
+        m_TransitionStats.nTransitions = m_TransitionStats.nPrefetched = 0;
+        m_TransitionStats.llGapTotal = m_TransitionStats.llGapMax = 0;
+    }
+
     MPLS_PL *mpls = bd_get_title_mpls(m_pBD);
     if (mpls)
     {
@@ -657,7 +853,9 @@ void CBDDemuxer::ProcessBluRayMetadata()
     }
 
     ASSERT(m_pTitle->clip_count >= 1 && m_pTitle->clips);
+    MPLS_PL *mpls = bd_get_title_mpls(m_pBD);
     int64_t max_clip_duration = 0;
+    std::vector<BDCacheStream> streams;
     for (uint32_t i = 0; i < m_pTitle->clip_count; ++i)
     {
         int64_t clip_duration = (m_pTitle->clips[i].out_time - m_pTitle->clips[i].in_time);
@@ -667,12 +865,29 @@ void CBDDemuxer::ProcessBluRayMetadata()
             overwrite_info = true;
             max_clip_duration = clip_duration;
         }
-        CLPI_CL *clpi = bd_get_clpi(m_pBD, i);
-        ProcessClipInfo(clpi, overwrite_info);
-        bd_free_clpi(clpi);
+
+        // Clip infos are shared between playlists, and are cached by their id
+        const char *clip_id = (mpls && i < mpls->list_count) ? mpls->play_item[i].clip[0].clip_id : nullptr;
+        const std::vector<BDCacheStream> *cached = (clip_id && m_pCache) ? m_pCache->GetClip(clip_id) : nullptr;
+        if (cached)
+        {
+            ProcessClipInfo(*cached, overwrite_info);
+        }
+        else
+        {
+            CLPI_CL *clpi = bd_get_clpi(m_pBD, i);
+            CBDMetadataCache::ParseClipInfo(clpi, streams);
+            bd_free_clpi(clpi);
+
+            if (clip_id && m_pCache && !streams.empty())
+                m_pCache->SetClip(clip_id, streams);
+            ProcessClipInfo(streams, overwrite_info);
+        }
     }
 
-    MPLS_PL *mpls = bd_get_title_mpls(m_pBD);
+    if (m_pCache)
+        m_pCache->Save();
+
     if (mpls)
     {
         // Read the PG offsets and store them as metadata
@@ -766,113 +981,106 @@ void CBDDemuxer::ProcessBluRayMetadata()
 
 STDMETHODIMP CBDDemuxer::GetTitleInfo(int idx, REFERENCE_TIME *rtDuration, WCHAR **ppszName)
 {
-  if (idx >= m_nTitleCount) { return E_FAIL; }
+    if (idx < 0 || (size_t)idx >= m_Titles.size())
+    {
+        return E_FAIL;
+    }
 
-  BLURAY_TITLE_INFO *info = bd_get_title_info(m_pBD, idx, 0);
-  if (info) {
-    if (rtDuration) {
-      *rtDuration = Convert90KhzToDSTime(info->duration);
+    // The title list is either cached or was read on open, no need to parse the playlist again
+    if (rtDuration)
+    {
+        *rtDuration = Convert90KhzToDSTime(m_Titles[idx].duration);
     }
-    if (ppszName) {
-      WCHAR buffer[80];
-      swprintf_s(buffer, L"Title %d", idx + 1);
-      size_t size = (wcslen(buffer) + 1) * sizeof(WCHAR);
-      *ppszName = (WCHAR *)CoTaskMemAlloc(size);
-      if (*ppszName)
-        memcpy(*ppszName, buffer, size);
+    if (ppszName)
+    {
+        WCHAR buffer[80];
+        swprintf_s(buffer, L"Title %d", idx + 1);
+        size_t size = (wcslen(buffer) + 1) * sizeof(WCHAR);
+        *ppszName = (WCHAR *)CoTaskMemAlloc(size);
+        if (*ppszName)
+            memcpy(*ppszName, buffer, size);
     }
 
     return S_OK;
-  }
-
-  return E_FAIL;
 }*/
 
-void CBDDemuxer::ProcessClipInfo(CLPI_CL *clpi, bool overwrite)
+void CBDDemuxer::ProcessClipInfo(const std::vector<BDCacheStream> &streams, bool overwrite)
 {
-    if (!clpi)
-    {
-        return;
-    }
-    for (int k = 0; k < clpi->program.num_prog; k++)
+    for (auto it = streams.begin(); it != streams.end(); it++)
     {
-        for (int i = 0; i < clpi->program.progs[k].num_streams; i++)
+        const BDCacheStream *stream = &(*it);
+        AVStream *avstream = m_lavfDemuxer->GetAVStreamByPID(stream->pid);
+        if (!avstream)
         {
-            CLPI_PROG_STREAM *stream = &clpi->program.progs[k].streams[i];
-            AVStream *avstream = m_lavfDemuxer->GetAVStreamByPID(stream->pid);
-            if (!avstream)
-            {
-                DbgLog((LOG_TRACE, 10,
-                        "CBDDemuxer::ProcessStreams(): Stream with PID 0x%04x not found, trying to add it..",
-                        stream->pid));
-                m_lavfDemuxer->AddMPEGTSStream(stream->pid, stream->coding_type);
-                avstream = m_lavfDemuxer->GetAVStreamByPID(stream->pid);
-            }
-            if (avstream)
+            DbgLog((LOG_TRACE, 10, "CBDDemuxer::ProcessStreams(): Stream with PID 0x%04x not found, trying to add it..",
+                    stream->pid));
+            m_lavfDemuxer->AddMPEGTSStream(stream->pid, stream->coding_type);
+            avstream = m_lavfDemuxer->GetAVStreamByPID(stream->pid);
+        }
+        if (avstream)
+        {
+            if (stream->lang[0] != 0)
+                av_dict_set(&avstream->metadata, "language", (const char *)stream->lang,
+                            overwrite ? 0 : AV_DICT_DONT_OVERWRITE);
+            if (avstream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
             {
-                if (stream->lang[0] != 0)
-                    av_dict_set(&avstream->metadata, "language", (const char *)stream->lang,
-                                overwrite ? 0 : AV_DICT_DONT_OVERWRITE);
-                if (avstream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+                if (avstream->codecpar->width == 0 || avstream->codecpar->height == 0)
                 {
-                    if (avstream->codecpar->width == 0 || avstream->codecpar->height == 0)
+                    switch (stream->format)
                     {
-                        switch (stream->format)
-                        {
-                        case BLURAY_VIDEO_FORMAT_480I:
-                        case BLURAY_VIDEO_FORMAT_480P:
-                            avstream->codecpar->width = 720;
-                            avstream->codecpar->height = 480;
-                            break;
-                        case BLURAY_VIDEO_FORMAT_576I:
-                        case BLURAY_VIDEO_FORMAT_576P:
-                            avstream->codecpar->width = 720;
-                            avstream->codecpar->height = 576;
-                            break;
-                        case BLURAY_VIDEO_FORMAT_720P:
-                            avstream->codecpar->width = 1280;
-                            avstream->codecpar->height = 720;
-                            break;
-                        case BLURAY_VIDEO_FORMAT_1080I:
-                        case BLURAY_VIDEO_FORMAT_1080P:
-                        default:
-                            avstream->codecpar->width = 1920;
-                            avstream->codecpar->height = 1080;
-                            break;
-                        case BLURAY_VIDEO_FORMAT_2160P:
-                            avstream->codecpar->width = 3840;
-                            avstream->codecpar->height = 2160;
-                            break;
-                        }
+                    case BLURAY_VIDEO_FORMAT_480I:
+                    case BLURAY_VIDEO_FORMAT_480P:
+                        avstream->codecpar->width = 720;
+                        avstream->codecpar->height = 480;
+                        break;
+                    case BLURAY_VIDEO_FORMAT_576I:
+                    case BLURAY_VIDEO_FORMAT_576P:
+                        avstream->codecpar->width = 720;
+                        avstream->codecpar->height = 576;
+                        break;
+                    case BLURAY_VIDEO_FORMAT_720P:
+                        avstream->codecpar->width = 1280;
+                        avstream->codecpar->height = 720;
+                        break;
+                    case BLURAY_VIDEO_FORMAT_1080I:
+                    case BLURAY_VIDEO_FORMAT_1080P:
+                    default:
+                        avstream->codecpar->width = 1920;
+                        avstream->codecpar->height = 1080;
+                        break;
+                    case BLURAY_VIDEO_FORMAT_2160P:
+                        avstream->codecpar->width = 3840;
+                        avstream->codecpar->height = 2160;
+                        break;
                     }
+                }
 
-                    if (m_MVCPlayback && stream->coding_type == BLURAY_STREAM_TYPE_VIDEO_H264)
-                    {
-                        av_dict_set(&avstream->metadata, "stereo_mode",
-                                    m_pTitle->mvc_base_view_r_flag ? "mvc_rl" : "mvc_lr", 0);
-                    }
+                if (m_MVCPlayback && stream->coding_type == BLURAY_STREAM_TYPE_VIDEO_H264)
+                {
+                    av_dict_set(&avstream->metadata, "stereo_mode",
+                                m_pTitle->mvc_base_view_r_flag ? "mvc_rl" : "mvc_lr", 0);
                 }
-                else if (avstream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            }
+            else if (avstream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            {
+                if (avstream->codecpar->ch_layout.nb_channels == 0)
                 {
-                    if (avstream->codecpar->ch_layout.nb_channels == 0)
+                    av_channel_layout_default(&avstream->codecpar->ch_layout,
+                                              (stream->format == BLURAY_AUDIO_FORMAT_MONO)     ? 1
+                                              : (stream->format == BLURAY_AUDIO_FORMAT_STEREO) ? 2
+                                                                                               : 6);
+                    avstream->codecpar->sample_rate =
+                        (stream->rate == BLURAY_AUDIO_RATE_96 || stream->rate == BLURAY_AUDIO_RATE_96_COMBO)
+                            ? 96000
+                            : (stream->rate == BLURAY_AUDIO_RATE_192 || stream->rate == BLURAY_AUDIO_RATE_192_COMBO)
+                                  ? 192000
+                                  : 48000;
+                    if (avstream->codecpar->codec_id == AV_CODEC_ID_DTS)
                     {
-                        av_channel_layout_default(&avstream->codecpar->ch_layout,
-                                                  (stream->format == BLURAY_AUDIO_FORMAT_MONO)     ? 1
-                                                  : (stream->format == BLURAY_AUDIO_FORMAT_STEREO) ? 2
-                                                                                                   : 6);
-                        avstream->codecpar->sample_rate =
-                            (stream->rate == BLURAY_AUDIO_RATE_96 || stream->rate == BLURAY_AUDIO_RATE_96_COMBO)
-                                ? 96000
-                                : (stream->rate == BLURAY_AUDIO_RATE_192 || stream->rate == BLURAY_AUDIO_RATE_192_COMBO)
-                                      ? 192000
-                                      : 48000;
-                        if (avstream->codecpar->codec_id == AV_CODEC_ID_DTS)
-                        {
-                            if (stream->coding_type == BLURAY_STREAM_TYPE_AUDIO_DTSHD)
-                                avstream->codecpar->profile = AV_PROFILE_DTS_HD_HRA;
-                            else if (stream->coding_type == BLURAY_STREAM_TYPE_AUDIO_DTSHD_MASTER)
-                                avstream->codecpar->profile = AV_PROFILE_DTS_HD_MA;
-                        }
+                        if (stream->coding_type == BLURAY_STREAM_TYPE_AUDIO_DTSHD)
+                            avstream->codecpar->profile = AV_PROFILE_DTS_HD_HRA;
+                        else if (stream->coding_type == BLURAY_STREAM_TYPE_AUDIO_DTSHD_MASTER)
+                            avstream->codecpar->profile = AV_PROFILE_DTS_HD_MA;
                     }
                 }
             }
@@ -887,6 +1095,12 @@ STDMETHODIMP CBDDemuxer::Seek(REFERENCE_TIME rTime)
     int64_t target = bd_find_seek_point(m_pBD, ConvertDSTimeTo90Khz(rTime));
     m_EndOfStreamPacketFlushProtection = FALSE;
 
+    // Any prefetched clip is likely useless after a seek, and a delivery gap is expected
+    m_Prefetcher.Reset();
+    if (m_MVCPrefetchContext)
+        avformat_close_input(&m_MVCPrefetchContext);
+    m_liLastPacketTime.QuadPart = 0;
+
     DbgLog((LOG_TRACE, 1, "Seek Request: %I64u (time); %I64u (byte), %I64u (prev byte)", rTime, target, prev));
     HRESULT hr = m_lavfDemuxer->SeekByte(target + 4, AVSEEK_FLAG_BACKWARD);
 
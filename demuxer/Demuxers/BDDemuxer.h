@@ -21,6 +21,8 @@
 
 #include "BaseDemuxer.h"
 #include "LAVFDemuxer.h"
+#include "BDClipPrefetcher.h"
+#include "BDMetadataCache.h"
 
 class CBDDemuxer
     : public CBaseDemuxer
@@ -111,6 +113,8 @@ class CBDDemuxer
     }
 
     STDMETHODIMP SetTitle(int idx);
+    STDMETHODIMP GetClipTransitionStatus(ULONGLONG *pnTransitions, ULONGLONG *pnPrefetched, double *pdAvgGap,
+                                         double *pdMaxGap);
     /*STDMETHODIMP GetTitleInfo(int idx, REFERENCE_TIME *rtDuration, WCHAR **ppszName);
     STDMETHODIMP GetNumTitles(int *count);*/
 
@@ -127,13 +131,19 @@ class CBDDemuxer
     STDMETHODIMP ProcessPacket(Packet *pPacket);
     STDMETHODIMP FillMVCExtensionQueue(REFERENCE_TIME rtBase);
 
+    static HRESULT OpenMVCExtensionFile(const char *fileName, AVFormatContext **ppFormatContext, int *pStreamIndex);
+
   private:
-    void ProcessClipInfo(struct clpi_cl *clpi, bool overwrite);
+    void FetchTitles(CBDMetadataCache::TitleList list, std::vector<BDCacheTitle> &titles);
+    void ProcessClipInfo(const std::vector<BDCacheStream> &streams, bool overwrite);
     void ProcessBDEvents();
 
     void CloseMVCExtensionDemuxer();
     STDMETHODIMP OpenMVCExtensionDemuxer(int playItem);
 
+    void PrefetchNextClip();
+    void ProcessClipTransition();
+
     static int BDByteStreamRead(void *opaque, uint8_t *buf, int buf_size);
     static int64_t CBDDemuxer::BDByteStreamSeek(void *opaque, int64_t offset, int whence);
 
@@ -147,6 +157,9 @@ class CBDDemuxer
 
     BLURAY_TITLE_INFO *m_pTitle = nullptr;
     uint32_t m_nTitleCount = 0;
+    std::vector<BDCacheTitle> m_Titles;
+
+    CBDMetadataCache *m_pCache = nullptr;
 
     uint16_t *m_StreamClip = nullptr;
     uint16_t m_NewClip = 0;
@@ -162,4 +175,24 @@ class CBDDemuxer
     int m_MVCStreamIndex = -1;
 
     BOOL m_EndOfStreamPacketFlushProtection = FALSE;
+
+    // Clip prefetching, only on local disks
+    CBDClipPrefetcher m_Prefetcher;
+    BOOL m_bLocalRoot = FALSE;
+    int64_t m_llNextClipPos = -1;
+    int m_TransitionClip = -1;
+    LARGE_INTEGER m_liLastPacketTime = {0};
+
+    // Clip transition statistics of the current title
+    struct
+    {
+        CCritSec csStats;
+        ULONGLONG nTransitions = 0;
+        ULONGLONG nPrefetched = 0; // transitions to a prefetched clip
+        LONGLONG llGapTotal = 0;
+        LONGLONG llGapMax = 0;
+    } m_TransitionStats;
+
+    AVFormatContext *m_MVCPrefetchContext = nullptr;
+    int m_MVCPrefetchStreamIndex = -1;
 };
@@ -0,0 +1,392 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "BDMetadataCache.h"
+
+#include <algorithm>
+#include <ShlObj.h>
+
+#define BD_CACHE_MAGIC MKTAG('L', 'B', 'D', 'C')
+#define BD_CACHE_VERSION 2
+
+// Number of discs kept in the cache folder, the least recently used ones are removed
+#define BD_CACHE_MAX_FILES 64
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+CBDMetadataCache::CBDMetadataCache(const char *bdRootPath)
+    : m_RootPath(bdRootPath)
+{
+    PWSTR pszAppData = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &pszAppData)))
+    {
+        // name the cache file after the root path, so every disc has exactly one cache file
+        std::string path = m_RootPath;
+        std::transform(path.begin(), path.end(), path.begin(), ::tolower);
+        uint64_t pathHash = fnv1a(FNV_OFFSET_BASIS, path.c_str(), path.length());
+
+        WCHAR wCacheFile[MAX_PATH];
+        swprintf_s(wCacheFile, L"%s\\LAV Filters\\BDCache\\%016I64x.cache", pszAppData, pathHash);
+        m_CacheFile = wCacheFile;
+    }
+    CoTaskMemFree(pszAppData);
+
+    m_Fingerprint = ComputeFingerprint();
+}
+
+CBDMetadataCache::~CBDMetadataCache()
+{
+}
+
+uint64_t CBDMetadataCache::ComputeFingerprint() const
+{
+    WCHAR wRoot[4096];
+    if (!SafeMultiByteToWideChar(CP_UTF8, 0, m_RootPath.c_str(), -1, wRoot, 4096))
+        return 0;
+
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    // The index is small, hash its contents
+    std::wstring index = std::wstring(wRoot) + L"BDMV\\index.bdmv";
+    HANDLE hFile = CreateFile(index.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return 0;
+
+    BYTE buffer[4096];
+    DWORD dwRead = 0;
+    while (ReadFile(hFile, buffer, sizeof(buffer), &dwRead, nullptr) && dwRead > 0)
+        hash = fnv1a(hash, buffer, dwRead);
+    CloseHandle(hFile);
+
+    // For playlists and clip infos, the directory information is sufficient
+    static const WCHAR *patterns[] = {L"BDMV\\PLAYLIST\\*.mpls", L"BDMV\\CLIPINF\\*.clpi"};
+    for (int i = 0; i < countof(patterns); i++)
+    {
+        std::vector<std::wstring> entries;
+
+        WIN32_FIND_DATA fd;
+        std::wstring search = std::wstring(wRoot) + patterns[i];
+        HANDLE hFind = FindFirstFile(search.c_str(), &fd);
+        if (hFind == INVALID_HANDLE_VALUE)
+            continue;
+
+        do
+        {
+            WCHAR entry[MAX_PATH + 64];
+            swprintf_s(entry, L"%s|%u|%u|%u|%u", fd.cFileName, fd.nFileSizeHigh, fd.nFileSizeLow,
+                       fd.ftLastWriteTime.dwHighDateTime, fd.ftLastWriteTime.dwLowDateTime);
+            entries.push_back(entry);
+        } while (FindNextFile(hFind, &fd));
+        FindClose(hFind);
+
+        // not all file systems return entries in a stable order
+        std::sort(entries.begin(), entries.end());
+        for (auto it = entries.begin(); it != entries.end(); it++)
+            hash = fnv1a(hash, it->c_str(), it->length() * sizeof(WCHAR));
+    }
+
+    return hash;
+}
+
+bool CBDMetadataCache::GetTitles(TitleList list, std::vector<BDCacheTitle> &titles) const
+{
+    if (!m_bHasTitles[list])
+        return false;
+
+    titles = m_Titles[list];
+    return true;
+}
+
+void CBDMetadataCache::SetTitles(TitleList list, const std::vector<BDCacheTitle> &titles)
+{
+    m_Titles[list] = titles;
+    m_bHasTitles[list] = true;
+    m_bDirty = true;
+}
+
+const std::vector<BDCacheStream> *CBDMetadataCache::GetClip(const char *clip_id) const
+{
+    auto it = m_Clips.find(clip_id);
+    if (it == m_Clips.end())
+        return nullptr;
+
+    return &it->second;
+}
+
+void CBDMetadataCache::SetClip(const char *clip_id, const std::vector<BDCacheStream> &streams)
+{
+    m_Clips[clip_id] = streams;
+    m_bDirty = true;
+}
+
+void CBDMetadataCache::ParseClipInfo(const CLPI_CL *clpi, std::vector<BDCacheStream> &streams)
+{
+    streams.clear();
+    if (!clpi)
+        return;
+
+    for (int k = 0; k < clpi->program.num_prog; k++)
+    {
+        for (int i = 0; i < clpi->program.progs[k].num_streams; i++)
+        {
+            const CLPI_PROG_STREAM *stream = &clpi->program.progs[k].streams[i];
+
+            BDCacheStream s = {0};
+            s.pid = stream->pid;
+            s.coding_type = stream->coding_type;
+            s.format = stream->format;
+            s.rate = stream->rate;
+            memcpy(s.lang, stream->lang, sizeof(s.lang));
+            s.lang[3] = 0;
+            streams.push_back(s);
+        }
+    }
+}
+
+void CBDMetadataCache::ParseTitleInfo(const BLURAY_TITLE_INFO *info, BDCacheTitle &title)
+{
+    title.playlist = info->playlist;
+    title.duration = info->duration;
+    title.clip_count = info->clip_count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Serialization
+
+template <typename T> static bool read_value(FILE *f, T &value)
+{
+    return fread(&value, sizeof(T), 1, f) == 1;
+}
+
+template <typename T> static bool write_value(FILE *f, const T &value)
+{
+    return fwrite(&value, sizeof(T), 1, f) == 1;
+}
+
+static bool read_string(FILE *f, std::string &str)
+{
+    uint32_t len = 0;
+    if (!read_value(f, len) || len > 4096)
+        return false;
+    str.resize(len);
+    return len == 0 || fread(&str[0], 1, len, f) == len;
+}
+
+static bool write_string(FILE *f, const std::string &str)
+{
+    uint32_t len = (uint32_t)str.length();
+    return write_value(f, len) && fwrite(str.c_str(), 1, len, f) == len;
+}
+
+bool CBDMetadataCache::Load()
+{
+    if (m_CacheFile.empty() || m_Fingerprint == 0)
+        return false;
+
+    FILE *f = nullptr;
+    if (_wfopen_s(&f, m_CacheFile.c_str(), L"rb") != 0 || !f)
+        return false;
+
+    bool bValid = false;
+    uint32_t magic = 0, version = 0, count = 0;
+    uint64_t fingerprint = 0;
+    std::string rootPath;
+
+    if (!read_value(f, magic) || magic != BD_CACHE_MAGIC || !read_value(f, version) || version != BD_CACHE_VERSION)
+        goto done;
+    if (!read_value(f, fingerprint) || fingerprint != m_Fingerprint)
+    {
+        DbgLog((LOG_TRACE, 10, L"CBDMetadataCache::Load(): Fingerprint mismatch, discarding cache"));
+        goto done;
+    }
+    if (!read_string(f, rootPath) || _stricmp(rootPath.c_str(), m_RootPath.c_str()) != 0)
+        goto done;
+
+    for (int list = 0; list < TitleListCount; list++)
+    {
+        uint8_t has = 0;
+        if (!read_value(f, has) || !read_value(f, count))
+            goto done;
+
+        m_bHasTitles[list] = !!has;
+        m_Titles[list].resize(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            BDCacheTitle &title = m_Titles[list][i];
+            if (!read_value(f, title.playlist) || !read_value(f, title.duration) || !read_value(f, title.clip_count))
+                goto done;
+        }
+    }
+
+    if (!read_value(f, count))
+        goto done;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        std::string clip_id;
+        uint32_t streams = 0;
+        if (!read_string(f, clip_id) || !read_value(f, streams) || streams > 0xFFFF)
+            goto done;
+
+        std::vector<BDCacheStream> &clip = m_Clips[clip_id];
+        clip.resize(streams);
+        for (uint32_t j = 0; j < streams; j++)
+        {
+            if (!read_value(f, clip[j].pid) || !read_value(f, clip[j].coding_type) ||
+                !read_value(f, clip[j].format) || !read_value(f, clip[j].rate) ||
+                fread(clip[j].lang, 1, sizeof(clip[j].lang), f) != sizeof(clip[j].lang))
+                goto done;
+        }
+    }
+
+    bValid = true;
+
+done:
+    fclose(f);
+
+    // Mark the cache as recently used, which keeps it from being pruned
+    if (bValid)
+    {
+        HANDLE hFile = CreateFile(m_CacheFile.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                  nullptr, OPEN_EXISTING, 0, nullptr);
+        if (hFile != INVALID_HANDLE_VALUE)
+        {
+            FILETIME ftNow;
+            GetSystemTimeAsFileTime(&ftNow);
+            SetFileTime(hFile, nullptr, nullptr, &ftNow);
+            CloseHandle(hFile);
+        }
+    }
+    else
+    {
+        for (int list = 0; list < TitleListCount; list++)
+        {
+            m_bHasTitles[list] = false;
+            m_Titles[list].clear();
+        }
+        m_Clips.clear();
+    }
+
+    DbgLog((LOG_TRACE, 10, L"CBDMetadataCache::Load(): Cache for %S %s (%u clips)", m_RootPath.c_str(),
+            bValid ? L"loaded" : L"invalid", (unsigned)m_Clips.size()));
+
+    m_bDirty = false;
+    return bValid;
+}
+
+HRESULT CBDMetadataCache::Save()
+{
+    if (!m_bDirty)
+        return S_FALSE;
+    if (m_CacheFile.empty() || m_Fingerprint == 0)
+        return E_FAIL;
+
+    // Make sure the cache folder exists
+    std::wstring folder = m_CacheFile.substr(0, m_CacheFile.find_last_of(L'\\'));
+    int ret = SHCreateDirectoryEx(nullptr, folder.c_str(), nullptr);
+    if (ret != ERROR_SUCCESS && ret != ERROR_ALREADY_EXISTS)
+        return E_FAIL;
+
+    // Write to a temporary file first, so concurrent readers never see a partial file
+    WCHAR wTempFile[MAX_PATH];
+    swprintf_s(wTempFile, L"%s.%u.tmp", m_CacheFile.c_str(), GetCurrentProcessId());
+
+    FILE *f = nullptr;
+    if (_wfopen_s(&f, wTempFile, L"wb") != 0 || !f)
+        return E_FAIL;
+
+    bool bOk = write_value(f, (uint32_t)BD_CACHE_MAGIC) && write_value(f, (uint32_t)BD_CACHE_VERSION) &&
+               write_value(f, m_Fingerprint) && write_string(f, m_RootPath);
+
+    for (int list = 0; bOk && list < TitleListCount; list++)
+    {
+        bOk = write_value(f, (uint8_t)m_bHasTitles[list]) && write_value(f, (uint32_t)m_Titles[list].size());
+        for (auto it = m_Titles[list].begin(); bOk && it != m_Titles[list].end(); it++)
+        {
+            bOk = write_value(f, it->playlist) && write_value(f, it->duration) && write_value(f, it->clip_count);
+        }
+    }
+
+    bOk = bOk && write_value(f, (uint32_t)m_Clips.size());
+    for (auto it = m_Clips.begin(); bOk && it != m_Clips.end(); it++)
+    {
+        bOk = write_string(f, it->first) && write_value(f, (uint32_t)it->second.size());
+        for (auto s = it->second.begin(); bOk && s != it->second.end(); s++)
+        {
+            bOk = write_value(f, s->pid) && write_value(f, s->coding_type) && write_value(f, s->format) &&
+                  write_value(f, s->rate) && fwrite(s->lang, 1, sizeof(s->lang), f) == sizeof(s->lang);
+        }
+    }
+
+    fclose(f);
+
+    if (!bOk || !MoveFileEx(wTempFile, m_CacheFile.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        DeleteFile(wTempFile);
+        return E_FAIL;
+    }
+
+    DbgLog((LOG_TRACE, 10, L"CBDMetadataCache::Save(): Wrote cache for %S", m_RootPath.c_str()));
+    m_bDirty = false;
+
+    PruneCacheFolder(folder);
+    return S_OK;
+}
+
+void CBDMetadataCache::PruneCacheFolder(const std::wstring &folder)
+{
+    std::vector<std::pair<ULONGLONG, std::wstring>> files;
+
+    WIN32_FIND_DATA fd;
+    HANDLE hFind = FindFirstFile((folder + L"\\*.cache").c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        ULARGE_INTEGER uliLastWrite;
+        uliLastWrite.LowPart = fd.ftLastWriteTime.dwLowDateTime;
+        uliLastWrite.HighPart = fd.ftLastWriteTime.dwHighDateTime;
+        files.push_back(std::make_pair(uliLastWrite.QuadPart, folder + L"\\" + fd.cFileName));
+    } while (FindNextFile(hFind, &fd));
+    FindClose(hFind);
+
+    if (files.size() <= BD_CACHE_MAX_FILES)
+        return;
+
+    // Remove the least recently used caches
+    std::sort(files.begin(), files.end());
+    for (size_t i = 0; i < files.size() - BD_CACHE_MAX_FILES; i++)
+    {
+        DbgLog((LOG_TRACE, 10, L"CBDMetadataCache::PruneCacheFolder(): Removing %s", files[i].second.c_str()));
+        DeleteFile(files[i].second.c_str());
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+// Stream information of one clip, as found in the CLPI file
+typedef struct BDCacheStream
+{
+    uint16_t pid;
+    uint8_t coding_type;
+    uint8_t format;
+    uint8_t rate;
+    uint8_t lang[4];
+} BDCacheStream;
+
+// One entry of the title list, as returned by bd_get_titles
+typedef struct BDCacheTitle
+{
+    uint32_t playlist;
+    uint64_t duration;
+    uint32_t clip_count;
+} BDCacheTitle;
+
+// Persistent cache of the playlist and clip metadata of a BluRay folder.
+//
+// The cache is stored per BDMV root path in the local application data folder, and is validated
+// against a fingerprint of the index, playlist and clip info files (name, size and modification time).
+// Any change to those files invalidates the cache. Only the most recently used caches are kept.
+class CBDMetadataCache
+{
+  public:
+    enum TitleList
+    {
+        TitlesRelevant,
+        TitlesAll,
+        TitleListCount
+    };
+
+    CBDMetadataCache(const char *bdRootPath);
+    ~CBDMetadataCache();
+
+    // Load the cache from disk, returns false if no valid cache is available
+    bool Load();
+    // Write the cache to disk, if anything changed
+    HRESULT Save();
+
+    bool GetTitles(TitleList list, std::vector<BDCacheTitle> &titles) const;
+    void SetTitles(TitleList list, const std::vector<BDCacheTitle> &titles);
+
+    const std::vector<BDCacheStream> *GetClip(const char *clip_id) const;
+    void SetClip(const char *clip_id, const std::vector<BDCacheStream> &streams);
+
+    static void ParseClipInfo(const struct clpi_cl *clpi, std::vector<BDCacheStream> &streams);
+    static void ParseTitleInfo(const BLURAY_TITLE_INFO *info, BDCacheTitle &title);
+
+  private:
+    uint64_t ComputeFingerprint() const;
+    static void PruneCacheFolder(const std::wstring &folder);
+
+  private:
+    std::string m_RootPath;
+    std::wstring m_CacheFile;
+    uint64_t m_Fingerprint = 0;
+    bool m_bDirty = false;
+
+    bool m_bHasTitles[TitleListCount] = {false};
+    std::vector<BDCacheTitle> m_Titles[TitleListCount];
+    std::map<std::string, std::vector<BDCacheStream>> m_Clips;
+};
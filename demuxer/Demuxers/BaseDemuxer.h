@@ -114,6 +114,12 @@ class CBaseDemuxer : public CUnknown
     virtual STDMETHODIMP GetTitleInfo(int idx, REFERENCE_TIME *rtDuration, WCHAR **ppszName) { return E_NOTIMPL; }
     // Title count
     virtual STDMETHODIMP_(int) GetNumTitles() { return 0; }
+    // Clip transition statistics of playlists
+    virtual STDMETHODIMP GetClipTransitionStatus(ULONGLONG *pnTransitions, ULONGLONG *pnPrefetched, double *pdAvgGap,
+                                                 double *pdMaxGap)
+    {
+        return E_NOTIMPL;
+    }
 
     // Set the currently active stream of one type
     // The demuxers can use this to filter packets before returning back to the caller on GetNextPacket
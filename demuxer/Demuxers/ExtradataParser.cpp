@@ -19,6 +19,7 @@
 
 #include "stdafx.h"
 #include "ExtradataParser.h"
+#include "StartCodeScanner.h"
 
 #define MARKER           \
     if (BitRead(1) != 1) \
@@ -39,14 +40,17 @@ CExtradataParser::~CExtradataParser()
 bool CExtradataParser::NextMPEGStartCode(BYTE &code)
 {
     BitByteAlign();
-    DWORD dw = (DWORD)-1;
-    do
+
+    const BYTE *pos = Start() + Pos();
+    const BYTE *sc = FindStartCodeMarker(pos, End());
+    if (sc >= End())
     {
-        if (!Remaining())
-            return false;
-        dw = (dw << 8) | (BYTE)BitRead(8);
-    } while ((dw & 0xffffff00) != 0x00000100);
-    code = (BYTE)(dw & 0xff);
+        BitSkip((unsigned int)RemainingBits());
+        return false;
+    }
+
+    BitSkip((unsigned int)(sc + 3 - pos) * 8);
+    code = (BYTE)BitRead(8);
     return true;
 }
 
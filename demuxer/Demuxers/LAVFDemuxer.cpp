@@ -27,6 +27,7 @@
 #include "IMediaSideDataFFmpeg.h"
 
 #include "LAVSplitterSettingsInternal.h"
+#include "LAVSplitterProbe.h"
 
 #include "moreuuids.h"
 
@@ -51,10 +52,19 @@ extern "C"
 #endif
 
 #include "BDDemuxer.h"
+#include "LAVFStreamCursor.h"
 #include "CueSheet.h"
 
 #define AVFORMAT_OPEN_TIMEOUT 20
 
+// Maximum number of packets read while looking for a thumbnail keyframe
+#define THUMBNAIL_MAX_PACKETS 2000
+
+// Number of index positions checked for the interleaving of audio and video
+#define INTERLEAVE_CHECK_POINTS 32
+// Distance between audio and video chunks of the same time that is considered poorly interleaved
+#define INTERLEAVE_MAX_DISTANCE (4 * 1024 * 1024)
+
 extern void lavf_get_iformat_infos(const AVInputFormat *pFormat, const char **pszName, const char **pszDescription);
 
 static const AVRational AV_RATIONAL_TIMEBASE = {1, AV_TIME_BASE};
@@ -146,6 +156,139 @@ STDMETHODIMP CLAVFDemuxer::Open(LPCOLESTR pszFileName, LPCOLESTR pszUserAgent, L
     return OpenInputStream(nullptr, pszFileName, nullptr, TRUE, false, pszUserAgent, pszReferrer);
 }
 
+STDMETHODIMP CLAVFDemuxer::OpenProbe(LPCOLESTR pszFileName, DWORD dwAnalyzeDuration, DWORD dwProbeSize)
+{
+    m_bProbeOnly = TRUE;
+    m_dwProbeAnalyzeDuration = dwAnalyzeDuration;
+    m_dwProbeSize = dwProbeSize;
+
+    return OpenInputStream(nullptr, pszFileName, nullptr, TRUE, FALSE);
+}
+
+STDMETHODIMP CLAVFDemuxer::GetProbeInfo(LAVProbeFileInfo *pInfo)
+{
+    CheckPointer(pInfo, E_POINTER);
+    CheckPointer(m_avFormat, E_UNEXPECTED);
+
+    REFERENCE_TIME rtDuration = GetDuration();
+    pInfo->rtDuration = rtDuration > 0 ? rtDuration : 0;
+    strncpy_s(pInfo->format, m_pszInputFormat, _TRUNCATE);
+
+    pInfo->nStreams = 0;
+    pInfo->pStreams = nullptr;
+    if (m_avFormat->nb_streams == 0)
+        return S_OK;
+
+    pInfo->pStreams = (LAVProbeStreamInfo *)CoTaskMemAlloc(sizeof(LAVProbeStreamInfo) * m_avFormat->nb_streams);
+    if (!pInfo->pStreams)
+        return E_OUTOFMEMORY;
+
+    for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
+    {
+        const AVStream *st = m_avFormat->streams[idx];
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_ATTACHMENT || (st->disposition & AV_DISPOSITION_ATTACHED_PIC))
+            continue;
+
+        LAVProbeStreamInfo *s = &pInfo->pStreams[pInfo->nStreams++];
+        ZeroMemory(s, sizeof(*s));
+
+        switch (st->codecpar->codec_type)
+        {
+        case AVMEDIA_TYPE_VIDEO:
+            s->type = LAVProbeStream_Video;
+            s->width = st->codecpar->width;
+            s->height = st->codecpar->height;
+            break;
+        case AVMEDIA_TYPE_AUDIO:
+            s->type = LAVProbeStream_Audio;
+            s->channels = st->codecpar->ch_layout.nb_channels;
+            s->sampleRate = st->codecpar->sample_rate;
+            break;
+        case AVMEDIA_TYPE_SUBTITLE: s->type = LAVProbeStream_Subtitle; break;
+        default: s->type = LAVProbeStream_Other; break;
+        }
+
+        s->id = st->id;
+        s->bitRate = st->codecpar->bit_rate;
+        s->bDefault = !!(st->disposition & AV_DISPOSITION_DEFAULT);
+        s->bForced = !!(st->disposition & AV_DISPOSITION_FORCED);
+        strncpy_s(s->codec, avcodec_get_name(st->codecpar->codec_id), _TRUNCATE);
+
+        const AVDictionaryEntry *lang = av_dict_get(st->metadata, "language", nullptr, 0);
+        if (lang)
+            strncpy_s(s->language, lang->value, _TRUNCATE);
+
+        const AVDictionaryEntry *title = av_dict_get(st->metadata, "title", nullptr, 0);
+        if (title)
+            strncpy_s(s->title, title->value, _TRUNCATE);
+    }
+
+    return S_OK;
+}
+
+STDMETHODIMP CLAVFDemuxer::ReadThumbnailPacket(REFERENCE_TIME rtPosition, AVPacket *pkt, const AVStream **ppStream,
+                                               REFERENCE_TIME *prtPacket)
+{
+    CheckPointer(pkt, E_POINTER);
+    CheckPointer(ppStream, E_POINTER);
+    CheckPointer(m_avFormat, E_UNEXPECTED);
+
+    int idx = av_find_best_stream(m_avFormat, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (idx < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"::ReadThumbnailPacket(): No video stream found"));
+        return E_FAIL;
+    }
+
+    AVStream *st = m_avFormat->streams[idx];
+    *ppStream = st;
+
+    // Cover art is used as-is
+    if (st->disposition & AV_DISPOSITION_ATTACHED_PIC)
+    {
+        if (prtPacket)
+            *prtPacket = 0;
+        return av_packet_ref(pkt, &st->attached_pic) < 0 ? E_OUTOFMEMORY : S_OK;
+    }
+
+    for (unsigned int i = 0; i < m_avFormat->nb_streams; i++)
+        m_avFormat->streams[i]->discard = ((int)i == idx) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+
+    // Positions are relative to the start of the stream, just like for a regular seek
+    // Probing skips the start time fix-ups of a full open, so the start time of the stream itself is used.
+    const int64_t start_time = st->start_time;
+
+    // Seek using the index, reading continues from the start if the seek fails
+    if (rtPosition > 0)
+    {
+        int64_t seek_pts = ConvertRTToTimestamp(rtPosition, st->time_base.num, st->time_base.den, start_time);
+        if (av_seek_frame(m_avFormat, idx, seek_pts, AVSEEK_FLAG_BACKWARD) < 0)
+        {
+            DbgLog((LOG_TRACE, 10, L"::ReadThumbnailPacket(): Seek failed, using the first keyframe"));
+        }
+    }
+
+    for (int i = 0; i < THUMBNAIL_MAX_PACKETS; i++)
+    {
+        if (av_read_frame(m_avFormat, pkt) < 0)
+            break;
+
+        if (pkt->stream_index == idx && (pkt->flags & AV_PKT_FLAG_KEY))
+        {
+            if (prtPacket)
+            {
+                int64_t pts = pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts;
+                *prtPacket = ConvertTimestampToRT(pts, st->time_base.num, st->time_base.den, start_time);
+            }
+            return S_OK;
+        }
+        av_packet_unref(pkt);
+    }
+
+    DbgLog((LOG_TRACE, 10, L"::ReadThumbnailPacket(): No keyframe found"));
+    return E_FAIL;
+}
+
 STDMETHODIMP CLAVFDemuxer::Start()
 {
     if (m_bH264MVCCombine)
@@ -468,6 +611,13 @@ trynoformat:
 
     CHECK_HR(hr = InitAVFormat(pszFileName, bForce));
 
+    // Local files can be opened a second time for dual-cursor reading
+    if (pszFileName && (!byteContext || bFileSource) && !m_bProbeOnly && !(m_avFormat->flags & AVFMT_FLAG_NETWORK) &&
+        (m_bAVI || _strnicmp(m_avFormat->iformat->name, "mov,", 4) == 0) && m_pSettings->GetSeparateAudioReading())
+    {
+        CheckInterleaving(pszFileName);
+    }
+
     SAFE_CO_FREE(fileName);
     return S_OK;
 done:
@@ -701,8 +851,14 @@ STDMETHODIMP CLAVFDemuxer::InitAVFormat(LPCOLESTR pszFileName, BOOL bForce)
     }
 
     // TODO: make both durations below configurable
+    if (m_bProbeOnly)
+    {
+        // probing uses a fixed budget, no matter the format
+        av_opt_set_int(m_avFormat, "analyzeduration", (int64_t)m_dwProbeAnalyzeDuration * 1000, 0);
+        av_opt_set_int(m_avFormat, "probesize", m_dwProbeSize, 0);
+    }
     // decrease analyze duration for network streams
-    if (m_avFormat->flags & AVFMT_FLAG_NETWORK ||
+    else if (m_avFormat->flags & AVFMT_FLAG_NETWORK ||
         (m_avFormat->flags & AVFMT_FLAG_CUSTOM_IO && !m_avFormat->pb->seekable))
     {
         // require at least 0.2 seconds
@@ -743,6 +899,10 @@ STDMETHODIMP CLAVFDemuxer::InitAVFormat(LPCOLESTR pszFileName, BOOL bForce)
         CheckBDM2TSCPLI(pszFileName);
     }
 
+    // Probing only needs the stream information, skip attachments, chapters, parsers and stream creation
+    if (m_bProbeOnly)
+        return S_OK;
+
     char *icy_headers = nullptr;
     if (av_opt_get(m_avFormat, "icy_metadata_headers", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&icy_headers) >= 0 &&
         icy_headers && strlen(icy_headers) > 0)
@@ -967,6 +1127,11 @@ done:
 void CLAVFDemuxer::CleanupAVFormat()
 {
     FlushMVCExtensionQueue();
+    SAFE_DELETE(m_pAudioCursor);
+    av_packet_free(&m_pMainPacket);
+    m_bMainPacketPending = false;
+    m_bAudioCursorActive = false;
+    m_bAudioCursorResync = false;
     if (m_avFormat)
     {
         // Override abort timer to ensure the close function in network protocols can actually close the stream
@@ -1017,6 +1182,9 @@ HRESULT CLAVFDemuxer::SetActiveStream(StreamType type, int pid)
             m_ForcedSubStream = subst->pid;
     }
 
+    // Instant audio switching needs the packets of all audio streams, not only the active one
+    BOOL bKeepAllAudio = m_pSettings->GetInstantAudioSwitch();
+
     for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
     {
         AVStream *st = m_avFormat->streams[idx];
@@ -1030,7 +1198,7 @@ HRESULT CLAVFDemuxer::SetActiveStream(StreamType type, int pid)
         }
         else if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
         {
-            st->discard = (m_dActiveStreams[audio] == idx) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+            st->discard = (bKeepAllAudio || m_dActiveStreams[audio] == idx) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
             // If the stream is a sub stream, make sure to activate the main stream as well
             if (m_bMPEGTS && (st->disposition & LAVF_DISPOSITION_SUB_STREAM) && st->discard == AVDISCARD_DEFAULT)
             {
@@ -1058,9 +1226,242 @@ HRESULT CLAVFDemuxer::SetActiveStream(StreamType type, int pid)
         }
     }
 
+    UpdateAudioCursorStreams();
+
     return hr;
 }
 
+HRESULT CLAVFDemuxer::CheckInterleaving(LPCOLESTR pszFileName)
+{
+    int vidx = av_find_best_stream(m_avFormat, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    int aidx = av_find_best_stream(m_avFormat, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    if (vidx < 0 || aidx < 0)
+        return S_FALSE;
+
+    AVStream *vst = m_avFormat->streams[vidx];
+    AVStream *ast = m_avFormat->streams[aidx];
+    int nVideoEntries = avformat_index_get_entries_count(vst);
+    if (nVideoEntries < INTERLEAVE_CHECK_POINTS || avformat_index_get_entries_count(ast) == 0)
+        return S_FALSE;
+
+    // Compare the file positions of audio and video at the same time, spread over the whole file
+    int nFar = 0;
+    for (int i = 0; i < INTERLEAVE_CHECK_POINTS; i++)
+    {
+        const AVIndexEntry *ve =
+            avformat_index_get_entry(vst, (int)((int64_t)nVideoEntries * i / INTERLEAVE_CHECK_POINTS));
+        if (!ve)
+            continue;
+
+        int aentry = av_index_search_timestamp(ast, av_rescale_q(ve->timestamp, vst->time_base, ast->time_base),
+                                               AVSEEK_FLAG_BACKWARD);
+        const AVIndexEntry *ae = avformat_index_get_entry(ast, max(aentry, 0));
+        if (ae && _abs64(ae->pos - ve->pos) > INTERLEAVE_MAX_DISTANCE)
+            nFar++;
+    }
+
+    DbgLog((LOG_TRACE, 10, L"::CheckInterleaving(): %d of %d index positions are poorly interleaved", nFar,
+            INTERLEAVE_CHECK_POINTS));
+    if (nFar <= INTERLEAVE_CHECK_POINTS / 2)
+        return S_FALSE;
+
+    m_pAudioCursor = new CLAVFStreamCursor();
+    HRESULT hr = m_pAudioCursor->Open(pszFileName, m_avFormat->iformat, &m_avFormat->interrupt_callback);
+    if (SUCCEEDED(hr))
+    {
+        // The stream layout is defined by the file header, and needs to match
+        AVFormatContext *ctx = m_pAudioCursor->GetContext();
+        if (ctx->nb_streams != m_avFormat->nb_streams)
+            hr = E_FAIL;
+
+        for (unsigned int idx = 0; SUCCEEDED(hr) && idx < ctx->nb_streams; idx++)
+        {
+            AVStream *st = m_avFormat->streams[idx];
+            AVStream *cst = ctx->streams[idx];
+            if (cst->codecpar->codec_type != st->codecpar->codec_type || av_cmp_q(cst->time_base, st->time_base) != 0)
+            {
+                hr = E_FAIL;
+                break;
+            }
+
+            av_lav_stream_parser_set_needed(cst, av_lav_stream_parser_get_needed(st));
+            init_parser(ctx, cst);
+            UpdateParserFlags(cst);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_pMainPacket = av_packet_alloc();
+        if (!m_pMainPacket)
+            hr = E_OUTOFMEMORY;
+    }
+
+    if (FAILED(hr))
+    {
+        DbgLog((LOG_TRACE, 10, L"::CheckInterleaving(): Opening the audio cursor failed"));
+        SAFE_DELETE(m_pAudioCursor);
+        return hr;
+    }
+
+    DbgLog((LOG_TRACE, 10, L"::CheckInterleaving(): Reading audio through a separate cursor"));
+    return S_OK;
+}
+
+void CLAVFDemuxer::UpdateAudioCursorStreams()
+{
+    if (!m_pAudioCursor)
+        return;
+
+    // audio streams are only read by the audio cursor, everything else only by the main context
+    AVFormatContext *ctx = m_pAudioCursor->GetContext();
+    bool bActive = false;
+    for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
+    {
+        AVStream *st = m_avFormat->streams[idx];
+        if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+        {
+            ctx->streams[idx]->discard = st->discard;
+            st->discard = AVDISCARD_ALL;
+            if (ctx->streams[idx]->discard != AVDISCARD_ALL)
+                bActive = true;
+        }
+        else
+        {
+            ctx->streams[idx]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    // The cursor isn't read while all audio streams are discarded, catch up with the main context once one is enabled
+    if (bActive && !m_bAudioCursorActive)
+        m_bAudioCursorResync = true;
+    m_bAudioCursorActive = bActive;
+}
+
+void CLAVFDemuxer::CloseAudioCursor()
+{
+    if (!m_pAudioCursor)
+        return;
+
+    // hand the audio streams back to the main context
+    AVFormatContext *ctx = m_pAudioCursor->GetContext();
+    for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
+    {
+        if (m_avFormat->streams[idx]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO)
+            m_avFormat->streams[idx]->discard = ctx->streams[idx]->discard;
+    }
+
+    SAFE_DELETE(m_pAudioCursor);
+    m_bAudioCursorActive = false;
+    m_bAudioCursorResync = false;
+}
+
+void CLAVFDemuxer::SeekAudioCursor(int64_t timestamp)
+{
+    if (!m_pAudioCursor)
+        return;
+
+    av_packet_unref(m_pMainPacket);
+    m_bMainPacketPending = false;
+    m_bAudioCursorResync = false;
+
+    RestartAudioCursor(timestamp);
+}
+
+void CLAVFDemuxer::RestartAudioCursor(int64_t timestamp)
+{
+    if (m_pAudioCursor->Seek(timestamp) < 0)
+    {
+        DbgLog((LOG_ERROR, 1, L"::RestartAudioCursor() -- Seek failed, reading audio from the main context"));
+        CloseAudioCursor();
+        return;
+    }
+
+    AVFormatContext *ctx = m_pAudioCursor->GetContext();
+    for (unsigned i = 0; i < ctx->nb_streams; i++)
+    {
+        init_parser(ctx, ctx->streams[i]);
+        UpdateParserFlags(ctx->streams[i]);
+    }
+}
+
+void CLAVFDemuxer::ResyncAudioCursor()
+{
+    // Byte positions don't translate between the two contexts, use the first timestamp read by the main context
+    int64_t ts = m_pMainPacket->dts != AV_NOPTS_VALUE ? m_pMainPacket->dts : m_pMainPacket->pts;
+    if (ts == AV_NOPTS_VALUE)
+        return;
+
+    m_bAudioCursorResync = false;
+
+    const AVStream *st = m_avFormat->streams[m_pMainPacket->stream_index];
+    RestartAudioCursor(av_rescale_q(ts, st->time_base, AV_TIME_BASE_Q));
+}
+
+int CLAVFDemuxer::ReadFrame(AVPacket *pkt)
+{
+    if (!m_pAudioCursor)
+    {
+        // a packet can still be pending if the audio cursor failed
+        if (m_bMainPacketPending)
+        {
+            av_packet_move_ref(pkt, m_pMainPacket);
+            m_bMainPacketPending = false;
+            return 0;
+        }
+        return av_read_frame(m_avFormat, pkt);
+    }
+
+    // Keep one packet of each cursor pending, and return the earlier one
+    if (!m_bMainPacketPending)
+    {
+        int ret = av_read_frame(m_avFormat, m_pMainPacket);
+        if (ret >= 0)
+            m_bMainPacketPending = true;
+        else if (ret != AVERROR_EOF)
+            return ret;
+    }
+
+    if (m_bAudioCursorResync && m_bAudioCursorActive && m_bMainPacketPending)
+        ResyncAudioCursor();
+
+    // Until the audio cursor is positioned, only the main context is read
+    const AVPacket *apkt = nullptr;
+    if (m_pAudioCursor && m_bAudioCursorActive && !m_bAudioCursorResync)
+    {
+        int ret = m_pAudioCursor->Fill();
+        if (ret < 0 && ret != AVERROR_EOF && ret != AVERROR(EAGAIN))
+        {
+            DbgLog((LOG_TRACE, 10, L"::ReadFrame(): Audio cursor failed (%d)", ret));
+        }
+        apkt = m_pAudioCursor->Peek();
+    }
+    if (!m_bMainPacketPending && !apkt)
+        return AVERROR_EOF;
+
+    bool bAudio = !m_bMainPacketPending;
+    if (apkt && m_bMainPacketPending)
+    {
+        const AVStream *mst = m_avFormat->streams[m_pMainPacket->stream_index];
+        const AVStream *ast = m_avFormat->streams[apkt->stream_index];
+        int64_t mts = m_pMainPacket->dts != AV_NOPTS_VALUE ? m_pMainPacket->dts : m_pMainPacket->pts;
+        int64_t ats = apkt->dts != AV_NOPTS_VALUE ? apkt->dts : apkt->pts;
+        bAudio = (mts != AV_NOPTS_VALUE && ats != AV_NOPTS_VALUE &&
+                  av_compare_ts(ats, ast->time_base, mts, mst->time_base) < 0);
+    }
+
+    if (bAudio)
+    {
+        m_pAudioCursor->Take(pkt);
+    }
+    else
+    {
+        av_packet_move_ref(pkt, m_pMainPacket);
+        m_bMainPacketPending = false;
+    }
+    return 0;
+}
+
 void CLAVFDemuxer::UpdateSubStreams()
 {
     for (unsigned int idx = 0; idx < m_avFormat->nb_streams; ++idx)
@@ -1482,7 +1883,7 @@ STDMETHODIMP CLAVFDemuxer::GetNextPacket(Packet **ppPacket)
     int result = 0;
     try
     {
-        DBG_TIMING("av_read_frame", 30, result = av_read_frame(m_avFormat, &pkt))
+        DBG_TIMING("av_read_frame", 30, result = ReadFrame(&pkt))
     }
     catch (...)
     {
@@ -1902,6 +2303,8 @@ retry:
         UpdateParserFlags(m_avFormat->streams[i]);
     }
 
+    SeekAudioCursor(ConvertRTToTimestamp(max(rTime, 0ll), 1, AV_TIME_BASE));
+
     m_bVC1SeenTimestamp = FALSE;
 
     // Flush MVC extensions on seek (no-op if empty)
@@ -1918,6 +2321,18 @@ STDMETHODIMP CLAVFDemuxer::SeekByte(int64_t pos, int flags)
         DbgLog((LOG_ERROR, 1, L"::SeekByte() -- Seek failed"));
     }
 
+    // Byte positions of the main context don't translate to the audio cursor, it follows once a timestamp is known
+    if (pos == 0)
+    {
+        SeekAudioCursor(ConvertRTToTimestamp(0, 1, AV_TIME_BASE));
+    }
+    else if (m_pAudioCursor)
+    {
+        av_packet_unref(m_pMainPacket);
+        m_bMainPacketPending = false;
+        m_bAudioCursorResync = true;
+    }
+
     for (unsigned i = 0; i < m_avFormat->nb_streams; i++)
     {
         init_parser(m_avFormat, m_avFormat->streams[i]);
@@ -34,6 +34,8 @@
 
 class FormatInfo;
 class CBDDemuxer;
+struct LAVProbeFileInfo;
+class CLAVFStreamCursor;
 
 #define FFMPEG_FILE_BUFFER_SIZE 32768 // default reading size for ffmpeg
 class CLAVFDemuxer
@@ -167,6 +169,14 @@ class CLAVFDemuxer
 
     void AddMPEGTSStream(int pid, uint32_t stream_type);
 
+    // Open a file for probing only, with a bounded analysis budget (duration in ms, size in bytes)
+    // No streams are created, GetProbeInfo is the only valid call afterwards.
+    STDMETHODIMP OpenProbe(LPCOLESTR pszFileName, DWORD dwAnalyzeDuration, DWORD dwProbeSize);
+    STDMETHODIMP GetProbeInfo(LAVProbeFileInfo *pInfo);
+    // Read the keyframe at or before the position from the best video stream of a probed file
+    STDMETHODIMP ReadThumbnailPacket(REFERENCE_TIME rtPosition, AVPacket *pkt, const AVStream **ppStream,
+                                     REFERENCE_TIME *prtPacket);
+
   private:
     STDMETHODIMP AddStream(int streamId);
     STDMETHODIMP CreateStreams();
@@ -192,6 +202,15 @@ class CLAVFDemuxer
                                        BYTE *paramchange, int paramchange_size);
     STDMETHODIMP ParseICYMetadataPacket();
 
+    // Dual-cursor reading of poorly interleaved files
+    HRESULT CheckInterleaving(LPCOLESTR pszFileName);
+    void UpdateAudioCursorStreams();
+    void CloseAudioCursor();
+    void SeekAudioCursor(int64_t timestamp);
+    void RestartAudioCursor(int64_t timestamp);
+    void ResyncAudioCursor();
+    int ReadFrame(AVPacket *pkt);
+
     STDMETHODIMP QueueMVCExtension(Packet *pPacket);
     STDMETHODIMP FlushMVCExtensionQueue();
     STDMETHODIMP CombineMVCBaseExtension(Packet *pBasePacket);
@@ -228,11 +247,22 @@ class CLAVFDemuxer
 
     AVStreamParseType *m_stOrigParser = nullptr;
 
+    // Separate read cursor for the audio streams of poorly interleaved files
+    CLAVFStreamCursor *m_pAudioCursor = nullptr;
+    AVPacket *m_pMainPacket = nullptr;
+    bool m_bMainPacketPending = false;
+    bool m_bAudioCursorActive = false;
+    bool m_bAudioCursorResync = false;
+
     CFontInstaller *m_pFontInstaller = nullptr;
     ILAVFSettingsInternal *m_pSettings = nullptr;
 
     BOOL m_bEnableTrackInfo = TRUE;
 
+    BOOL m_bProbeOnly = FALSE;
+    DWORD m_dwProbeAnalyzeDuration = 0;
+    DWORD m_dwProbeSize = 0;
+
     CBDDemuxer *m_pBluRay = nullptr;
 
     int m_Abort = 0;
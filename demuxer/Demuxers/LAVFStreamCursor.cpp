@@ -0,0 +1,181 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVFStreamCursor.h"
+
+CLAVFStreamCursor::CLAVFStreamCursor()
+{
+    m_pkt = av_packet_alloc();
+}
+
+CLAVFStreamCursor::~CLAVFStreamCursor()
+{
+    Close();
+    av_packet_free(&m_pkt);
+}
+
+HRESULT CLAVFStreamCursor::Open(LPCOLESTR pszFileName, const AVInputFormat *format, const AVIOInterruptCB *cb)
+{
+    CheckPointer(pszFileName, E_POINTER);
+    CheckPointer(m_pkt, E_OUTOFMEMORY);
+
+    Close();
+
+    m_hFile = CreateFileW(pszFileName, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+                          FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        DbgLog((LOG_TRACE, 10, L"CLAVFStreamCursor::Open(): Opening the file failed"));
+        return E_FAIL;
+    }
+
+    uint8_t *buffer = (uint8_t *)av_malloc(STREAM_CURSOR_BUFFER_SIZE + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (buffer)
+        m_pb = avio_alloc_context(buffer, STREAM_CURSOR_BUFFER_SIZE, 0, this, ReadIO, nullptr, SeekIO);
+    if (!m_pb)
+    {
+        av_free(buffer);
+        Close();
+        return E_OUTOFMEMORY;
+    }
+
+    m_avFormat = avformat_alloc_context();
+    if (!m_avFormat)
+    {
+        Close();
+        return E_OUTOFMEMORY;
+    }
+
+    m_avFormat->pb = m_pb;
+    m_avFormat->flags |= AVFMT_FLAG_CUSTOM_IO;
+    // read AVI files through the index, even if they appear to be interleaved
+    m_avFormat->flags |= AVFMT_FLAG_SORT_DTS;
+    if (cb)
+        m_avFormat->interrupt_callback = *cb;
+
+    int ret = avformat_open_input(&m_avFormat, nullptr, format, nullptr);
+    if (ret < 0)
+    {
+        DbgLog((LOG_TRACE, 10, L"CLAVFStreamCursor::Open(): avformat_open_input failed (%d)", ret));
+        Close();
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
+
+void CLAVFStreamCursor::Close()
+{
+    // a failed avformat_open_input frees the context on its own
+    if (m_avFormat)
+        avformat_close_input(&m_avFormat);
+
+    if (m_pb)
+    {
+        av_freep(&m_pb->buffer);
+        avio_context_free(&m_pb);
+    }
+
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+    if (m_pkt)
+        av_packet_unref(m_pkt);
+    m_bPending = false;
+    m_bEOF = false;
+}
+
+int CLAVFStreamCursor::Fill()
+{
+    if (m_bPending)
+        return 0;
+    if (m_bEOF || !m_avFormat)
+        return AVERROR_EOF;
+
+    int ret = av_read_frame(m_avFormat, m_pkt);
+    if (ret >= 0)
+        m_bPending = true;
+    else if (ret == AVERROR_EOF)
+        m_bEOF = true;
+
+    return ret;
+}
+
+void CLAVFStreamCursor::Take(AVPacket *pkt)
+{
+    ASSERT(m_bPending);
+    av_packet_move_ref(pkt, m_pkt);
+    m_bPending = false;
+}
+
+int CLAVFStreamCursor::Seek(int64_t timestamp)
+{
+    if (!m_avFormat)
+        return AVERROR(EINVAL);
+
+    av_packet_unref(m_pkt);
+    m_bPending = false;
+    m_bEOF = false;
+
+    return av_seek_frame(m_avFormat, -1, timestamp, AVSEEK_FLAG_BACKWARD);
+}
+
+int CLAVFStreamCursor::ReadIO(void *opaque, uint8_t *buf, int buf_size)
+{
+    CLAVFStreamCursor *cursor = static_cast<CLAVFStreamCursor *>(opaque);
+
+    DWORD dwRead = 0;
+    if (!ReadFile(cursor->m_hFile, buf, buf_size, &dwRead, nullptr))
+        return AVERROR(EIO);
+
+    return dwRead ? (int)dwRead : AVERROR_EOF;
+}
+
+int64_t CLAVFStreamCursor::SeekIO(void *opaque, int64_t offset, int whence)
+{
+    CLAVFStreamCursor *cursor = static_cast<CLAVFStreamCursor *>(opaque);
+
+    LARGE_INTEGER li;
+    if (whence == AVSEEK_SIZE)
+    {
+        if (!GetFileSizeEx(cursor->m_hFile, &li))
+            return AVERROR(EIO);
+        return li.QuadPart;
+    }
+
+    DWORD dwMethod;
+    switch (whence & ~AVSEEK_FORCE)
+    {
+    case SEEK_SET: dwMethod = FILE_BEGIN; break;
+    case SEEK_CUR: dwMethod = FILE_CURRENT; break;
+    case SEEK_END: dwMethod = FILE_END; break;
+    default: return AVERROR(EINVAL);
+    }
+
+    LARGE_INTEGER liNew;
+    li.QuadPart = offset;
+    if (!SetFilePointerEx(cursor->m_hFile, li, &liNew, dwMethod))
+        return AVERROR(EIO);
+
+    return liNew.QuadPart;
+}
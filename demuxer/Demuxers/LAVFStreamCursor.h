@@ -0,0 +1,66 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// I/O buffer size of a stream cursor, chunks within this distance are served by one read
+#define STREAM_CURSOR_BUFFER_SIZE (1024 * 1024)
+
+// Independent read position for a subset of the streams of a file
+//
+// Poorly interleaved AVI/MP4 files are read through two cursors, one for the video and one for the audio streams.
+// Each cursor opens its own demuxer instance on the file, so the sample tables (MP4 stsz/stco, AVI idx1) drive
+// the reads of its streams, and the streams don't force seeks on each other.
+class CLAVFStreamCursor
+{
+  public:
+    CLAVFStreamCursor();
+    ~CLAVFStreamCursor();
+
+    HRESULT Open(LPCOLESTR pszFileName, const AVInputFormat *format, const AVIOInterruptCB *cb);
+    void Close();
+
+    AVFormatContext *GetContext() const { return m_avFormat; }
+
+    // Read the next packet, unless one is already pending
+    // Returns the av_read_frame result if no packet could be read
+    int Fill();
+
+    // Get the pending packet, if any
+    const AVPacket *Peek() const { return m_bPending ? m_pkt : nullptr; }
+
+    // Move the pending packet into pkt
+    void Take(AVPacket *pkt);
+
+    // Seek to a timestamp in AV_TIME_BASE units (or to the keyframe before it), and drop the pending packet
+    int Seek(int64_t timestamp);
+
+  private:
+    static int ReadIO(void *opaque, uint8_t *buf, int buf_size);
+    static int64_t SeekIO(void *opaque, int64_t offset, int whence);
+
+  private:
+    HANDLE m_hFile = INVALID_HANDLE_VALUE;
+    AVIOContext *m_pb = nullptr;
+    AVFormatContext *m_avFormat = nullptr;
+
+    AVPacket *m_pkt = nullptr;
+    bool m_bPending = false;
+    bool m_bEOF = false;
+};
@@ -19,6 +19,7 @@
 
 #include <stdafx.h>
 #include "Packet.h"
+#include "PacketSideData.h"
 
 Packet::Packet()
 {
@@ -28,6 +29,23 @@ Packet::~Packet()
 {
     DeleteMediaType(pmt);
     av_packet_free(&m_Packet);
+    if (m_pSideData)
+        m_pSideData->Release();
+}
+
+int Packet::GetNumSideData() const
+{
+    return m_pSideData ? m_pSideData->GetNumSideData() : 0;
+}
+
+const AVPacketSideData *Packet::GetSideData() const
+{
+    return m_pSideData ? m_pSideData->GetSideData() : nullptr;
+}
+
+const MediaSideDataFFMpeg *Packet::GetMediaSideData() const
+{
+    return m_pSideData ? m_pSideData->GetMediaSideData() : nullptr;
 }
 
 int Packet::SetDataSize(int len)
@@ -76,7 +94,25 @@ int Packet::SetPacket(AVPacket *pkt)
     if (!m_Packet)
         return -1;
 
-    return av_packet_ref(m_Packet, pkt);
+    if (pkt->side_data_elems > 0)
+    {
+        m_pSideData = CPacketSideData::Create(pkt->side_data, pkt->side_data_elems);
+        if (!m_pSideData)
+            return AVERROR(ENOMEM);
+    }
+
+    // Reference the packet without its side data, which is kept in the shared instance instead of a copy
+    AVPacketSideData *side_data = pkt->side_data;
+    int side_data_elems = pkt->side_data_elems;
+    pkt->side_data = nullptr;
+    pkt->side_data_elems = 0;
+
+    int ret = av_packet_ref(m_Packet, pkt);
+
+    pkt->side_data = side_data;
+    pkt->side_data_elems = side_data_elems;
+
+    return ret;
 }
 
 int Packet::Append(Packet *ptr)
@@ -19,6 +19,9 @@
 
 #pragma once
 
+class CPacketSideData;
+struct MediaSideDataFFMpeg;
+
 // Data Packet for queue storage
 class Packet
 {
@@ -31,8 +34,9 @@ class Packet
     int GetDataSize() const { return m_Packet ? m_Packet->size : 0; }
     BYTE *GetData() { return m_Packet ? m_Packet->data : nullptr; }
 
-    int GetNumSideData() const { return m_Packet ? m_Packet->side_data_elems : 0; }
-    AVPacketSideData *GetSideData() { return m_Packet ? m_Packet->side_data : nullptr; }
+    int GetNumSideData() const;
+    const AVPacketSideData *GetSideData() const;
+    const MediaSideDataFFMpeg *GetMediaSideData() const;
 
     int SetDataSize(int len);
     int SetData(const void *ptr, int len);
@@ -70,4 +74,7 @@ class Packet
 
   private:
     AVPacket *m_Packet = nullptr;
+
+    // side data is shared between all packets with the same payload
+    CPacketSideData *m_pSideData = nullptr;
 };
@@ -0,0 +1,168 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "PacketSideData.h"
+
+#include <unordered_map>
+
+// Process-wide table of all live side data instances
+struct SideDataTable
+{
+    CCritSec csTable;
+    std::unordered_multimap<uint32_t, CPacketSideData *> entries;
+};
+
+static SideDataTable &GetSideDataTable()
+{
+    static SideDataTable table;
+    return table;
+}
+
+CPacketSideData::CPacketSideData(uint32_t hash)
+    : m_Hash(hash)
+{
+}
+
+CPacketSideData::~CPacketSideData()
+{
+    av_freep(&m_pBuffer);
+}
+
+uint32_t CPacketSideData::Hash(const AVPacketSideData *side_data, int side_data_elems)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    auto update = [&hash](const uint8_t *data, size_t size) {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ data[i]) * 16777619u;
+    };
+
+    for (int i = 0; i < side_data_elems; i++)
+    {
+        update((const uint8_t *)&side_data[i].type, sizeof(side_data[i].type));
+        update((const uint8_t *)&side_data[i].size, sizeof(side_data[i].size));
+        update(side_data[i].data, side_data[i].size);
+    }
+    return hash;
+}
+
+bool CPacketSideData::Equals(const AVPacketSideData *side_data, int side_data_elems) const
+{
+    if (m_SideData.side_data_elems != side_data_elems)
+        return false;
+
+    for (int i = 0; i < side_data_elems; i++)
+    {
+        const AVPacketSideData *sd = &m_SideData.side_data[i];
+        if (sd->type != side_data[i].type || sd->size != side_data[i].size ||
+            memcmp(sd->data, side_data[i].data, sd->size) != 0)
+            return false;
+    }
+    return true;
+}
+
+CPacketSideData *CPacketSideData::Create(const AVPacketSideData *side_data, int side_data_elems)
+{
+    if (!side_data || side_data_elems <= 0)
+        return nullptr;
+
+    uint32_t hash = Hash(side_data, side_data_elems);
+
+    SideDataTable &table = GetSideDataTable();
+    CAutoLock lock(&table.csTable);
+
+    // Re-use an existing instance with the same payload
+    auto range = table.entries.equal_range(hash);
+    for (auto it = range.first; it != range.second; it++)
+    {
+        if (it->second->Equals(side_data, side_data_elems))
+        {
+            it->second->AddRef();
+            return it->second;
+        }
+    }
+
+    size_t size = sizeof(AVPacketSideData) * side_data_elems;
+    for (int i = 0; i < side_data_elems; i++)
+        size += FFALIGN(side_data[i].size, 16);
+
+    CPacketSideData *pSideData = new CPacketSideData(hash);
+    pSideData->m_pBuffer = (uint8_t *)av_malloc(size);
+    if (!pSideData->m_pBuffer)
+    {
+        delete pSideData;
+        return nullptr;
+    }
+
+    AVPacketSideData *sd = (AVPacketSideData *)pSideData->m_pBuffer;
+    uint8_t *data = pSideData->m_pBuffer + sizeof(AVPacketSideData) * side_data_elems;
+    for (int i = 0; i < side_data_elems; i++)
+    {
+        sd[i].type = side_data[i].type;
+        sd[i].size = side_data[i].size;
+        sd[i].data = data;
+        memcpy(data, side_data[i].data, side_data[i].size);
+        data += FFALIGN(side_data[i].size, 16);
+    }
+
+    pSideData->m_SideData.side_data = sd;
+    pSideData->m_SideData.side_data_elems = side_data_elems;
+
+    table.entries.emplace(hash, pSideData);
+    return pSideData;
+}
+
+ULONG CPacketSideData::AddRef()
+{
+    return (ULONG)InterlockedIncrement(&m_cRef);
+}
+
+ULONG CPacketSideData::Release()
+{
+    // Releasing a reference that is not the last one does not need to touch the table
+    LONG lRef = m_cRef;
+    while (lRef > 1)
+    {
+        LONG lPrev = InterlockedCompareExchange(&m_cRef, lRef - 1, lRef);
+        if (lPrev == lRef)
+            return (ULONG)(lRef - 1);
+        lRef = lPrev;
+    }
+
+    // The last reference is released under the table lock, so Create can't resurrect the instance
+    SideDataTable &table = GetSideDataTable();
+    CAutoLock lock(&table.csTable);
+
+    lRef = InterlockedDecrement(&m_cRef);
+    if (lRef == 0)
+    {
+        auto range = table.entries.equal_range(m_Hash);
+        for (auto it = range.first; it != range.second; it++)
+        {
+            if (it->second == this)
+            {
+                table.entries.erase(it);
+                break;
+            }
+        }
+        delete this;
+    }
+    return (ULONG)lRef;
+}
@@ -0,0 +1,57 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include "IMediaSideDataFFmpeg.h"
+
+// Immutable, refcounted set of packet side data
+//
+// Instances are interned, packets carrying identical side data (ie. repeated mastering metadata or palettes)
+// share one instance instead of storing a copy each.
+class CPacketSideData
+{
+  public:
+    // Get the shared instance for the side data, a reference is returned to the caller
+    static CPacketSideData *Create(const AVPacketSideData *side_data, int side_data_elems);
+
+    ULONG AddRef();
+    ULONG Release();
+
+    int GetNumSideData() const { return m_SideData.side_data_elems; }
+    const AVPacketSideData *GetSideData() const { return m_SideData.side_data; }
+
+    // Side data in the format exposed through IMediaSideData, valid as long as a reference is held
+    const MediaSideDataFFMpeg *GetMediaSideData() const { return &m_SideData; }
+
+  private:
+    CPacketSideData(uint32_t hash);
+    ~CPacketSideData();
+
+    static uint32_t Hash(const AVPacketSideData *side_data, int side_data_elems);
+    bool Equals(const AVPacketSideData *side_data, int side_data_elems) const;
+
+  private:
+    volatile LONG m_cRef = 1;
+    uint32_t m_Hash = 0;
+
+    // side data array and payloads are stored in one allocation
+    uint8_t *m_pBuffer = nullptr;
+    MediaSideDataFFMpeg m_SideData{};
+};
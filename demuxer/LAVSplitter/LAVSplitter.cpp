@@ -51,6 +51,7 @@ CLAVSplitter::CLAVSplitter(LPUNKNOWN pUnk, HRESULT *phr)
     m_InputFormats.insert(lavf_formats.begin(), lavf_formats.end());
 
     LoadSettings();
+    m_QueueMemory.SetCeiling((size_t)m_settings.QueueMaxMemGlobal * 1024 * 1024);
 
     m_pInput = new CLAVInputPin(NAME("LAV Input Pin"), this, this, phr);
 
@@ -64,6 +65,9 @@ CLAVSplitter::CLAVSplitter(LPUNKNOWN pUnk, HRESULT *phr)
 
 CLAVSplitter::~CLAVSplitter()
 {
+    DbgLog((LOG_TRACE, 10, L"CLAVSplitter::~CLAVSplitter(): Peak queue memory: %Iu KB (process: %Iu KB)",
+            m_QueueMemory.GetPeak() / 1024, QueueMemoryBudget::GetPeak() / 1024));
+
     SAFE_DELETE(m_pInput);
     SAFE_DELETE(m_pTrayIcon);
     Close();
@@ -146,11 +150,15 @@ STDMETHODIMP CLAVSplitter::LoadDefaults()
 
     m_settings.StreamSwitchReselectSubs = FALSE;
     m_settings.StreamSwitchRemoveAudio = FALSE;
+    m_settings.InstantAudioSwitch = FALSE;
     m_settings.ImpairedAudio = FALSE;
     m_settings.PreferHighQualityAudio = TRUE;
     m_settings.QueueMaxPackets = 350;
     m_settings.QueueMaxMemSize = 256;
+    m_settings.QueueMaxMemGlobal = 1024;
     m_settings.NetworkAnalysisDuration = 2100;
+    m_settings.BDClipPrefetch = TRUE;
+    m_settings.SeparateAudioReading = TRUE;
 
     for (const FormatInfo &fmt : m_InputFormats)
     {
@@ -230,6 +238,10 @@ STDMETHODIMP CLAVSplitter::ReadSettings(HKEY rootKey)
         if (SUCCEEDED(hr))
             m_settings.StreamSwitchRemoveAudio = bFlag;
 
+        bFlag = reg.ReadDWORD(L"InstantAudioSwitch", hr);
+        if (SUCCEEDED(hr))
+            m_settings.InstantAudioSwitch = bFlag;
+
         bFlag = reg.ReadDWORD(L"PreferHighQualityAudio", hr);
         if (SUCCEEDED(hr))
             m_settings.PreferHighQualityAudio = bFlag;
@@ -242,6 +254,10 @@ STDMETHODIMP CLAVSplitter::ReadSettings(HKEY rootKey)
         if (SUCCEEDED(hr))
             m_settings.QueueMaxMemSize = dwVal;
 
+        dwVal = reg.ReadDWORD(L"QueueMaxMemGlobal", hr);
+        if (SUCCEEDED(hr))
+            m_settings.QueueMaxMemGlobal = dwVal;
+
         dwVal = reg.ReadDWORD(L"NetworkAnalysisDuration", hr);
         if (SUCCEEDED(hr))
             m_settings.NetworkAnalysisDuration = dwVal;
@@ -249,6 +265,14 @@ STDMETHODIMP CLAVSplitter::ReadSettings(HKEY rootKey)
         dwVal = reg.ReadDWORD(L"QueueMaxPackets", hr);
         if (SUCCEEDED(hr))
             m_settings.QueueMaxPackets = dwVal;
+
+        bFlag = reg.ReadBOOL(L"BDClipPrefetch", hr);
+        if (SUCCEEDED(hr))
+            m_settings.BDClipPrefetch = bFlag;
+
+        bFlag = reg.ReadBOOL(L"SeparateAudioReading", hr);
+        if (SUCCEEDED(hr))
+            m_settings.SeparateAudioReading = bFlag;
     }
 
     CRegistry regF = CRegistry(rootKey, LAVF_REGISTRY_KEY_FORMATS, hr, TRUE);
@@ -293,11 +317,15 @@ STDMETHODIMP CLAVSplitter::SaveSettings()
         reg.WriteBOOL(L"MatroskaExternalSegments", m_settings.MatroskaExternalSegments);
         reg.WriteBOOL(L"StreamSwitchReselectSubs", m_settings.StreamSwitchReselectSubs);
         reg.WriteBOOL(L"StreamSwitchRemoveAudio", m_settings.StreamSwitchRemoveAudio);
+        reg.WriteBOOL(L"InstantAudioSwitch", m_settings.InstantAudioSwitch);
         reg.WriteBOOL(L"PreferHighQualityAudio", m_settings.PreferHighQualityAudio);
         reg.WriteBOOL(L"ImpairedAudio", m_settings.ImpairedAudio);
         reg.WriteDWORD(L"QueueMaxSize", m_settings.QueueMaxMemSize);
+        reg.WriteDWORD(L"QueueMaxMemGlobal", m_settings.QueueMaxMemGlobal);
         reg.WriteDWORD(L"NetworkAnalysisDuration", m_settings.NetworkAnalysisDuration);
         reg.WriteDWORD(L"QueueMaxPackets", m_settings.QueueMaxPackets);
+        reg.WriteBOOL(L"BDClipPrefetch", m_settings.BDClipPrefetch);
+        reg.WriteBOOL(L"SeparateAudioReading", m_settings.SeparateAudioReading);
     }
 
     CreateRegistryKey(HKEY_CURRENT_USER, LAVF_REGISTRY_KEY_FORMATS);
@@ -770,6 +798,19 @@ DWORD CLAVSplitter::ThreadProc()
     {
         if (cmd == CMD_EXIT)
         {
+            ClearAudioBuffers();
+
+            // Fail any pending audio switch, the caller will fall back to a full graph rebuild
+            {
+                CAutoLock lock(&m_csAudioSwitch);
+                if (m_AudioSwitch.bPending)
+                {
+                    m_AudioSwitch.bPending = FALSE;
+                    m_AudioSwitch.hr = E_FAIL;
+                    m_eAudioSwitchDone.Set();
+                }
+            }
+
             Reply(S_OK);
             m_ePlaybackInit.Set();
             return 0;
@@ -799,6 +840,9 @@ DWORD CLAVSplitter::ThreadProc()
         // Wait for the end of any flush
         m_eEndFlush.Wait();
 
+        // Buffered audio is from before the seek
+        ClearAudioBuffers();
+
         m_pActivePins.clear();
 
         for (pinIter = m_pPins.begin(); pinIter != m_pPins.end() && !m_fFlushing; ++pinIter)
@@ -819,6 +863,9 @@ DWORD CLAVSplitter::ThreadProc()
         HRESULT hr = S_OK;
         while (SUCCEEDED(hr) && !CheckRequest(&cmd))
         {
+            if (m_AudioSwitch.bPending)
+                ProcessAudioSwitch();
+
             hr = DemuxNextPacket();
         }
 
@@ -874,6 +921,14 @@ HRESULT CLAVSplitter::DeliverPacket(Packet *pPacket)
     CLAVOutputPin *pPin = GetOutputPin(pPacket->StreamId, TRUE);
     if (!pPin || !pPin->IsConnected())
     {
+        // Keep recent packets of inactive audio streams, so a stream switch can resume at the current position
+        if (!pPin && m_settings.InstantAudioSwitch &&
+            m_pDemuxer->GetStreams(CBaseDemuxer::audio)->FindStream(pPacket->StreamId))
+        {
+            BufferInactiveAudioPacket(pPacket);
+            return S_FALSE;
+        }
+
         delete pPacket;
         return S_FALSE;
     }
@@ -1323,6 +1378,182 @@ static int QueryAcceptMediaTypes(IPin *pPin, std::deque<CMediaType> pmts)
     return -1;
 }
 
+// Duration and maximum number of packets kept for every inactive audio stream
+#define AUDIO_SWITCH_BUFFER_DURATION (5 * DSHOW_TIME_BASE)
+#define AUDIO_SWITCH_BUFFER_PACKETS 2000
+
+// Time to wait for the demux thread to perform an instant audio switch, in ms
+#define AUDIO_SWITCH_TIMEOUT 1000
+
+void CLAVSplitter::BufferInactiveAudioPacket(Packet *pPacket)
+{
+    std::deque<Packet *> &buffer = m_AudioBuffers[pPacket->StreamId];
+    buffer.push_back(pPacket);
+    m_AudioBufferMemory.Add((size_t)pPacket->GetDataSize());
+
+    // Drop packets which are too old to be useful for a switch, or exceed the share of the queue memory budget
+    REFERENCE_TIME rtNewest = pPacket->rtStart;
+    while (buffer.size() > 1 &&
+           (buffer.size() > AUDIO_SWITCH_BUFFER_PACKETS || m_AudioBufferMemory.IsOverBudget() ||
+            (rtNewest != Packet::INVALID_TIME && buffer.front()->rtStart != Packet::INVALID_TIME &&
+             rtNewest - buffer.front()->rtStart > AUDIO_SWITCH_BUFFER_DURATION)))
+    {
+        m_AudioBufferMemory.Remove((size_t)buffer.front()->GetDataSize());
+        delete buffer.front();
+        buffer.pop_front();
+    }
+}
+
+void CLAVSplitter::ClearAudioBuffers()
+{
+    for (auto &it : m_AudioBuffers)
+    {
+        for (Packet *pPacket : it.second)
+        {
+            m_AudioBufferMemory.Remove((size_t)pPacket->GetDataSize());
+            delete pPacket;
+        }
+    }
+    m_AudioBuffers.clear();
+}
+
+// Switch the audio stream of a pin without stopping the graph
+// The switch itself is performed by the demux thread, this waits for it to finish.
+HRESULT CLAVSplitter::SwitchAudioStream(CLAVOutputPin *pPin, DWORD TrackNumDst, const std::deque<CMediaType> &pmts,
+                                        int mtIdx)
+{
+    {
+        CAutoLock lock(&m_csAudioSwitch);
+        m_AudioSwitch.pPin = pPin;
+        m_AudioSwitch.dwStreamId = TrackNumDst;
+        m_AudioSwitch.mts = pmts;
+        m_AudioSwitch.mtIdx = mtIdx;
+        m_AudioSwitch.hr = S_OK;
+        QueryPerformanceCounter(&m_AudioSwitch.liRequestTime);
+
+        m_eAudioSwitchDone.Reset();
+        m_AudioSwitch.bPending = TRUE;
+    }
+
+    BOOL bDone = m_eAudioSwitchDone.Wait(AUDIO_SWITCH_TIMEOUT);
+    if (!bDone)
+    {
+        CAutoLock lock(&m_csAudioSwitch);
+        if (m_AudioSwitch.bPending)
+        {
+            // The demux thread did not get to it, ie. because the queues are full while paused
+            m_AudioSwitch.bPending = FALSE;
+            return S_FALSE;
+        }
+    }
+
+    // The demux thread already started the switch, it has to finish it
+    if (!bDone)
+        m_eAudioSwitchDone.Wait();
+
+    CAutoLock lock(&m_csAudioSwitch);
+    return m_AudioSwitch.hr;
+}
+
+void CLAVSplitter::ProcessAudioSwitch()
+{
+    // Take the request, packets are delivered without holding the lock
+    AudioSwitchRequest request;
+    {
+        CAutoLock lock(&m_csAudioSwitch);
+        if (!m_AudioSwitch.bPending)
+            return;
+        m_AudioSwitch.bPending = FALSE;
+        request = m_AudioSwitch;
+    }
+
+    LARGE_INTEGER liStart, liEnd, liFreq;
+    QueryPerformanceCounter(&liStart);
+    QueryPerformanceFrequency(&liFreq);
+
+    CLAVOutputPin *pPin = request.pPin;
+    const DWORD dwStreamId = request.dwStreamId;
+
+    DbgLog((LOG_TRACE, 10, L"::ProcessAudioSwitch(): Switching audio stream %d to %d", pPin->GetStreamId(),
+            dwStreamId));
+
+    // Determine the current playback position, in demuxer time
+    // Switches are only requested while running, if the graph was paused since then the playback position is not
+    // known. Start at the demuxing position instead of replaying stale packets.
+    REFERENCE_TIME rtTarget = Packet::INVALID_TIME;
+    CRefTime rtStream;
+    if (m_State == State_Running && SUCCEEDED(StreamTime(rtStream)))
+    {
+        rtTarget = (REFERENCE_TIME)(rtStream.m_time * m_dRate) + m_rtStart;
+        if (m_rtOffset != AV_NOPTS_VALUE)
+            rtTarget -= m_rtOffset;
+    }
+    const BOOL bTargetKnown = (rtTarget != Packet::INVALID_TIME);
+    if (!bTargetKnown)
+        rtTarget = m_rtCurrent;
+
+    // Only flush the audio path, all other pins keep their queues
+    pPin->DeliverBeginFlush();
+    pPin->DeliverEndFlush();
+
+    pPin->SetStreamId(dwStreamId);
+    m_pDemuxer->SetActiveStream(CBaseDemuxer::audio, dwStreamId);
+    pPin->SetNewMediaTypes(request.mts);
+    pPin->SendMediaType(new CMediaType(request.mts[request.mtIdx]));
+    pPin->DeliverNewSegment(m_rtStart, m_rtStop, m_dRate);
+    m_bDiscontinuitySent.erase(dwStreamId);
+
+    // Take the buffered packets of the new stream
+    std::deque<Packet *> buffer;
+    auto it = m_AudioBuffers.find(dwStreamId);
+    if (it != m_AudioBuffers.end())
+    {
+        buffer.swap(it->second);
+        m_AudioBuffers.erase(it);
+        for (Packet *pPacket : buffer)
+            m_AudioBufferMemory.Remove((size_t)pPacket->GetDataSize());
+    }
+
+    // Start with the last packet before the playback position, or the first one at the demuxing position
+    size_t first = 0;
+    for (size_t i = 0; i < buffer.size(); i++)
+    {
+        if (buffer[i]->rtStart != Packet::INVALID_TIME && buffer[i]->rtStart <= rtTarget)
+            first = bTargetKnown ? i : i + 1;
+    }
+
+    REFERENCE_TIME rtFirst = Packet::INVALID_TIME;
+    REFERENCE_TIME rtCurrent = m_rtCurrent;
+    for (size_t i = 0; i < buffer.size(); i++)
+    {
+        if (i < first)
+        {
+            delete buffer[i];
+            continue;
+        }
+
+        if (rtFirst == Packet::INVALID_TIME)
+            rtFirst = buffer[i]->rtStart;
+        DeliverPacket(buffer[i]);
+    }
+    m_rtCurrent = rtCurrent;
+
+    QueryPerformanceCounter(&liEnd);
+
+    // Video delivery is only interrupted while the demux thread performs the switch
+    // The audio gap is the distance between the playback position and the first replayed packet (-1 if unknown)
+    DbgLog((LOG_TRACE, 10, L" -> Request waited %.1f ms, switch took %.1f ms (video delivery gap)",
+            (liStart.QuadPart - request.liRequestTime.QuadPart) * 1000.0 / liFreq.QuadPart,
+            (liEnd.QuadPart - liStart.QuadPart) * 1000.0 / liFreq.QuadPart));
+    DbgLog((LOG_TRACE, 10, L" -> Replayed %Iu of %Iu buffered packets, audio gap %I64d ms", buffer.size() - first,
+            buffer.size(),
+            (bTargetKnown && rtFirst != Packet::INVALID_TIME) ? max(rtFirst - rtTarget, 0LL) / 10000 : -1LL));
+
+    CAutoLock lock(&m_csAudioSwitch);
+    m_AudioSwitch.hr = S_OK;
+    m_eAudioSwitchDone.Set();
+}
+
 STDMETHODIMP CLAVSplitter::RenameOutputPin(DWORD TrackNumSrc, DWORD TrackNumDst, std::deque<CMediaType> pmts)
 {
     CheckPointer(m_pDemuxer, E_UNEXPECTED);
@@ -1338,6 +1569,34 @@ STDMETHODIMP CLAVSplitter::RenameOutputPin(DWORD TrackNumSrc, DWORD TrackNumDst,
 
     DbgLog((LOG_TRACE, 20, L"::RenameOutputPin() - Switching %s Stream %d to %d",
             CBaseDemuxer::CStreamList::ToStringW(pPin->GetPinType()), TrackNumSrc, TrackNumDst));
+
+    // Audio streams can be switched while playing, if the connected filter accepts the new stream as-is
+    // Players that delegate graph rebuilding, or the option to remove the audio decoder, require the full path.
+    // While paused the playback position is unknown, the full path seeks to it instead.
+    if (pPin && pPin->IsConnected() && pPin->IsAudioPin() && m_settings.InstantAudioSwitch &&
+        !m_settings.StreamSwitchRemoveAudio && m_State == State_Running && ThreadExists())
+    {
+        IGraphRebuildDelegate *pDelegate = nullptr;
+        BOOL bDelegate = SUCCEEDED(GetSite(IID_IGraphRebuildDelegate, (void **)&pDelegate)) && pDelegate;
+        SafeRelease(&pDelegate);
+
+        int mtIdx = bDelegate ? -1 : QueryAcceptMediaTypes(pPin->GetConnected(), pmts);
+        if (mtIdx >= 0)
+        {
+            HRESULT hr = SwitchAudioStream(pPin, TrackNumDst, pmts, mtIdx);
+            if (hr == S_OK)
+            {
+                if (m_settings.PGSForcedStream)
+                    UpdateForcedSubtitleMediaType();
+
+                if (m_settings.StreamSwitchReselectSubs)
+                    ReselectSubs(TrackNumDst);
+
+                return S_OK;
+            }
+            DbgLog((LOG_TRACE, 10, L"::RenameOutputPin() - Instant audio switch failed (hr %x), rebuilding", hr));
+        }
+    }
     // Output Pin was found
     // Stop the Graph, remove the old filter, render the graph again, start it up again
     // This only works on pins that were connected before, or the filter graph could .. well, break
@@ -1855,6 +2114,7 @@ HRESULT CLAVSplitter::SetRuntimeConfig(BOOL bRuntimeConfig)
 {
     m_bRuntimeConfig = bRuntimeConfig;
     LoadSettings();
+    m_QueueMemory.SetCeiling((size_t)m_settings.QueueMaxMemGlobal * 1024 * 1024);
 
     // Tray Icon is disabled by default
     SAFE_DELETE(m_pTrayIcon);
@@ -2095,6 +2355,68 @@ STDMETHODIMP_(BOOL) CLAVSplitter::GetStreamSwitchReselectSubtitles()
     return m_settings.StreamSwitchReselectSubs;
 }
 
+STDMETHODIMP CLAVSplitter::SetInstantAudioSwitch(BOOL bEnabled)
+{
+    m_settings.InstantAudioSwitch = bEnabled;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVSplitter::GetInstantAudioSwitch()
+{
+    return m_settings.InstantAudioSwitch;
+}
+
+STDMETHODIMP CLAVSplitter::SetMaxGlobalQueueMemSize(DWORD dwMaxSize)
+{
+    m_settings.QueueMaxMemGlobal = dwMaxSize;
+    m_QueueMemory.SetCeiling((size_t)dwMaxSize * 1024 * 1024);
+    return SaveSettings();
+}
+
+STDMETHODIMP_(DWORD) CLAVSplitter::GetMaxGlobalQueueMemSize()
+{
+    return m_settings.QueueMaxMemGlobal;
+}
+
+STDMETHODIMP CLAVSplitter::GetQueueMemoryUsage(ULONGLONG *pCurrent, ULONGLONG *pPeak)
+{
+    if (pCurrent)
+        *pCurrent = m_QueueMemory.GetCurrent();
+    if (pPeak)
+        *pPeak = m_QueueMemory.GetPeak();
+    return S_OK;
+}
+
+STDMETHODIMP CLAVSplitter::SetBDClipPrefetch(BOOL bEnabled)
+{
+    m_settings.BDClipPrefetch = bEnabled;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVSplitter::GetBDClipPrefetch()
+{
+    return m_settings.BDClipPrefetch;
+}
+
+STDMETHODIMP CLAVSplitter::GetBDClipTransitionStatus(ULONGLONG *pnTransitions, ULONGLONG *pnPrefetched,
+                                                     double *pdAvgGap, double *pdMaxGap)
+{
+    if (!m_pDemuxer)
+        return E_NOTIMPL;
+    return m_pDemuxer->GetClipTransitionStatus(pnTransitions, pnPrefetched, pdAvgGap, pdMaxGap);
+}
+
+STDMETHODIMP CLAVSplitter::SetSeparateAudioReading(BOOL bEnabled)
+{
+    m_settings.SeparateAudioReading = bEnabled;
+    return SaveSettings();
+}
+
+STDMETHODIMP_(BOOL) CLAVSplitter::GetSeparateAudioReading()
+{
+    return m_settings.SeparateAudioReading;
+}
+
 STDMETHODIMP CLAVSplitter::SetTrayIcon(BOOL bEnabled)
 {
     m_settings.TrayIcon = bEnabled;
@@ -28,6 +28,7 @@
 #include <vector>
 #include <map>
 #include "PacketQueue.h"
+#include "QueueMemoryBudget.h"
 
 #include "BaseDemuxer.h"
 
@@ -182,6 +183,17 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     STDMETHODIMP_(DWORD) GetMaxQueueSize();
     STDMETHODIMP SetStreamSwitchReselectSubtitles(BOOL bEnabled);
     STDMETHODIMP_(BOOL) GetStreamSwitchReselectSubtitles();
+    STDMETHODIMP SetInstantAudioSwitch(BOOL bEnabled);
+    STDMETHODIMP_(BOOL) GetInstantAudioSwitch();
+    STDMETHODIMP SetMaxGlobalQueueMemSize(DWORD dwMaxSize);
+    STDMETHODIMP_(DWORD) GetMaxGlobalQueueMemSize();
+    STDMETHODIMP GetQueueMemoryUsage(ULONGLONG *pCurrent, ULONGLONG *pPeak);
+    STDMETHODIMP SetBDClipPrefetch(BOOL bEnabled);
+    STDMETHODIMP_(BOOL) GetBDClipPrefetch();
+    STDMETHODIMP GetBDClipTransitionStatus(ULONGLONG *pnTransitions, ULONGLONG *pnPrefetched, double *pdAvgGap,
+                                           double *pdMaxGap);
+    STDMETHODIMP SetSeparateAudioReading(BOOL bEnabled);
+    STDMETHODIMP_(BOOL) GetSeparateAudioReading();
 
     // ILAVFSettingsMPCHCCustom
     STDMETHODIMP SetPropertyPageCallback(HRESULT (*fpPropPageCallback)(IBaseFilter* pFilter));
@@ -237,6 +249,7 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     std::list<CSubtitleSelector> GetSubtitleSelectors();
 
     bool IsAnyPinDrying();
+    CQueueMemoryInstance *GetQueueMemoryInstance() { return &m_QueueMemory; }
     void SetFakeASFReader(BOOL bFlag) { m_bFakeASFReader = bFlag; }
 
   protected:
@@ -255,6 +268,12 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     void DeliverBeginFlush();
     void DeliverEndFlush();
 
+    // Instant audio stream switching
+    HRESULT SwitchAudioStream(CLAVOutputPin *pPin, DWORD TrackNumDst, const std::deque<CMediaType> &pmts, int mtIdx);
+    void ProcessAudioSwitch();
+    void BufferInactiveAudioPacket(Packet *pPacket);
+    void ClearAudioBuffers();
+
     STDMETHODIMP Close();
     STDMETHODIMP DeleteOutputs();
 
@@ -289,6 +308,7 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     std::vector<CLAVOutputPin *> m_pPins;
     std::vector<CLAVOutputPin *> m_pActivePins;
     std::vector<CLAVOutputPin *> m_pRetiredPins;
+    CQueueMemoryInstance m_QueueMemory;
     std::set<DWORD> m_bDiscontinuitySent;
 
     std::wstring m_fileName;
@@ -320,6 +340,24 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
     bool m_fFlushing = FALSE;
     CAMEvent m_eEndFlush;
 
+    // Instant audio stream switching, performed by the demux thread
+    CCritSec m_csAudioSwitch;
+    struct AudioSwitchRequest
+    {
+        BOOL bPending = FALSE;
+        CLAVOutputPin *pPin = nullptr;
+        DWORD dwStreamId = 0;
+        std::deque<CMediaType> mts;
+        int mtIdx = 0;
+        HRESULT hr = S_OK;
+        LARGE_INTEGER liRequestTime{};
+    } m_AudioSwitch;
+    CAMEvent m_eAudioSwitchDone{TRUE};
+
+    // Recent packets of the inactive audio streams (demux thread only)
+    std::map<DWORD, std::deque<Packet *>> m_AudioBuffers;
+    CQueueMemoryAccount m_AudioBufferMemory{&m_QueueMemory};
+
     std::set<FormatInfo> m_InputFormats;
 
     // Settings
@@ -340,11 +378,15 @@ class __declspec(uuid("171252A0-8820-4AFE-9DF8-5C92B2D66B04")) CLAVSplitter
         BOOL StreamSwitchReselectSubs;
 
         BOOL StreamSwitchRemoveAudio;
+        BOOL InstantAudioSwitch;
         BOOL ImpairedAudio;
         BOOL PreferHighQualityAudio;
         DWORD QueueMaxPackets;
         DWORD QueueMaxMemSize;
+        DWORD QueueMaxMemGlobal;
         DWORD NetworkAnalysisDuration;
+        BOOL BDClipPrefetch;
+        BOOL SeparateAudioReading;
 
         std::map<std::string, BOOL> formats;
     } m_settings;
@@ -0,0 +1,482 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "LAVSplitter.h"
+#include "LAVSplitterProbe.h"
+
+#include "LAVFDemuxer.h"
+
+extern "C"
+{
+#include "libswscale/swscale.h"
+};
+
+#define PROBE_DEFAULT_ANALYZE_DURATION 1000
+#define PROBE_DEFAULT_PROBE_SIZE (2 * 1024 * 1024)
+
+#define THUMBNAIL_DEFAULT_WIDTH 320
+#define THUMBNAIL_DEFAULT_HEIGHT 180
+
+// Work shared by all workers of one batch, every file is processed by exactly one worker
+class CProbeBatch
+{
+  public:
+    virtual ~CProbeBatch() {}
+    virtual HRESULT ProcessFile(UINT nFile, CCritSec *pLock) = 0;
+
+    HRESULT Run(UINT nFiles, UINT nConcurrency, double *pdSeconds);
+    LONG NextFile() { return InterlockedIncrement(&m_lNextFile); }
+
+  protected:
+    UINT m_nFiles = 0;
+
+    DWORD m_dwAnalyzeDuration = PROBE_DEFAULT_ANALYZE_DURATION;
+    DWORD m_dwProbeSize = PROBE_DEFAULT_PROBE_SIZE;
+
+    // settings are only read during probing, one instance is shared by all workers
+    ILAVFSettingsInternal *m_pSettings = nullptr;
+
+  private:
+    volatile LONG m_lNextFile = -1;
+};
+
+class CProbeWorker : protected CAMThread
+{
+  public:
+    CProbeWorker(CProbeBatch *pBatch, UINT nFiles)
+        : m_pBatch(pBatch)
+        , m_nFiles(nFiles)
+    {
+    }
+    ~CProbeWorker() { CAMThread::Close(); }
+
+    BOOL Start() { return CAMThread::Create(); }
+    void Wait() { CAMThread::Close(); }
+
+  private:
+    DWORD ThreadProc() override
+    {
+        LONG lFile;
+        while ((lFile = m_pBatch->NextFile()) < (LONG)m_nFiles)
+            m_pBatch->ProcessFile((UINT)lFile, &m_csDemuxer);
+        return 0;
+    }
+
+  private:
+    CProbeBatch *m_pBatch = nullptr;
+    UINT m_nFiles = 0;
+
+    // each worker owns its demuxer lock, demuxers are never shared between workers
+    CCritSec m_csDemuxer;
+};
+
+HRESULT CProbeBatch::Run(UINT nFiles, UINT nConcurrency, double *pdSeconds)
+{
+    if (nConcurrency == 0)
+    {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        nConcurrency = si.dwNumberOfProcessors;
+    }
+    nConcurrency = max(1u, min(nConcurrency, nFiles));
+
+    HRESULT hr = S_OK;
+    CLAVSplitter *pSplitter = new CLAVSplitter(nullptr, &hr);
+    pSplitter->AddRef();
+    if (FAILED(hr))
+    {
+        pSplitter->Release();
+        return hr;
+    }
+    m_pSettings = static_cast<ILAVFSettingsInternal *>(pSplitter);
+    m_nFiles = nFiles;
+
+    LARGE_INTEGER frequency, start, stop;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    std::vector<CProbeWorker *> workers;
+    for (UINT i = 0; i < nConcurrency; i++)
+    {
+        CProbeWorker *pWorker = new CProbeWorker(this, nFiles);
+        if (!pWorker->Start())
+        {
+            delete pWorker;
+            break;
+        }
+        workers.push_back(pWorker);
+    }
+
+    if (workers.empty())
+    {
+        DbgLog((LOG_ERROR, 10, L"CProbeBatch::Run(): Failed to start worker threads"));
+        hr = E_FAIL;
+    }
+
+    for (CProbeWorker *pWorker : workers)
+    {
+        pWorker->Wait();
+        delete pWorker;
+    }
+
+    QueryPerformanceCounter(&stop);
+    if (pdSeconds)
+        *pdSeconds = (stop.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+
+    DbgLog((LOG_TRACE, 10, L"CProbeBatch::Run(): Processed %u files with %u threads", nFiles, (UINT)workers.size()));
+
+    m_pSettings = nullptr;
+    pSplitter->Release();
+
+    return hr;
+}
+
+static double GetElapsedMs(LARGE_INTEGER &last)
+{
+    LARGE_INTEGER frequency, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    double ms = (now.QuadPart - last.QuadPart) * 1000.0 / frequency.QuadPart;
+    last = now;
+    return ms;
+}
+
+// --- Stream information ------------------------------------
+
+class CStreamInfoBatch : public CProbeBatch
+{
+  public:
+    CStreamInfoBatch(const LPCWSTR *ppszFiles, const LAVProbeOptions *pOptions, LAVProbeFileInfo *pResults)
+        : m_ppszFiles(ppszFiles)
+        , m_pResults(pResults)
+    {
+        if (pOptions && pOptions->dwAnalyzeDuration)
+            m_dwAnalyzeDuration = pOptions->dwAnalyzeDuration;
+        if (pOptions && pOptions->dwProbeSize)
+            m_dwProbeSize = pOptions->dwProbeSize;
+    }
+
+    HRESULT ProcessFile(UINT nFile, CCritSec *pLock) override
+    {
+        LAVProbeFileInfo *pInfo = &m_pResults[nFile];
+        LPCWSTR pszFile = m_ppszFiles[nFile];
+        if (!pszFile)
+            return (pInfo->hr = E_POINTER);
+
+        CLAVFDemuxer *pDemuxer = new CLAVFDemuxer(pLock, m_pSettings);
+        pDemuxer->AddRef();
+
+        HRESULT hr = pDemuxer->OpenProbe(pszFile, m_dwAnalyzeDuration, m_dwProbeSize);
+        if (SUCCEEDED(hr))
+            hr = pDemuxer->GetProbeInfo(pInfo);
+
+        pDemuxer->Release();
+
+        DbgLog((LOG_TRACE, 20, L"CStreamInfoBatch::ProcessFile(): %s, hr: 0x%x", pszFile, hr));
+        return (pInfo->hr = hr);
+    }
+
+  private:
+    const LPCWSTR *m_ppszFiles = nullptr;
+    LAVProbeFileInfo *m_pResults = nullptr;
+};
+
+STDAPI LAVProbeFiles(const LPCWSTR *ppszFiles, UINT nFiles, const LAVProbeOptions *pOptions,
+                     LAVProbeFileInfo *pResults, double *pdFilesPerSecond)
+{
+    CheckPointer(ppszFiles, E_POINTER);
+    CheckPointer(pResults, E_POINTER);
+
+    ZeroMemory(pResults, sizeof(LAVProbeFileInfo) * nFiles);
+    for (UINT i = 0; i < nFiles; i++)
+        pResults[i].hr = E_ABORT;
+
+    if (pdFilesPerSecond)
+        *pdFilesPerSecond = 0.0;
+
+    if (nFiles == 0)
+        return S_OK;
+
+    CStreamInfoBatch batch(ppszFiles, pOptions, pResults);
+
+    double secs = 0.0;
+    HRESULT hr = batch.Run(nFiles, pOptions ? pOptions->nConcurrency : 0, &secs);
+    if (FAILED(hr))
+        return hr;
+
+    UINT nFailed = 0;
+    for (UINT i = 0; i < nFiles; i++)
+    {
+        if (FAILED(pResults[i].hr))
+            nFailed++;
+    }
+
+    double fps = secs > 0.0 ? nFiles / secs : 0.0;
+    DbgLog((LOG_TRACE, 10, L"LAVProbeFiles(): Probed %u files (%u failed) in %.3fs, %.1f files/s", nFiles, nFailed,
+            secs, fps));
+
+    if (pdFilesPerSecond)
+        *pdFilesPerSecond = fps;
+
+    return nFailed ? S_FALSE : S_OK;
+}
+
+STDAPI_(void) LAVProbeFreeResults(LAVProbeFileInfo *pResults, UINT nFiles)
+{
+    if (!pResults)
+        return;
+
+    for (UINT i = 0; i < nFiles; i++)
+    {
+        SAFE_CO_FREE(pResults[i].pStreams);
+        pResults[i].nStreams = 0;
+    }
+}
+
+// --- Thumbnails --------------------------------------------
+
+class CThumbnailBatch : public CProbeBatch
+{
+  public:
+    CThumbnailBatch(const LPCWSTR *ppszFiles, const LAVThumbnailOptions *pOptions, LAVThumbnail *pResults)
+        : m_ppszFiles(ppszFiles)
+        , m_pResults(pResults)
+    {
+        if (pOptions)
+        {
+            if (pOptions->dwAnalyzeDuration)
+                m_dwAnalyzeDuration = pOptions->dwAnalyzeDuration;
+            if (pOptions->dwProbeSize)
+                m_dwProbeSize = pOptions->dwProbeSize;
+            if (pOptions->nMaxWidth)
+                m_nMaxWidth = pOptions->nMaxWidth;
+            if (pOptions->nMaxHeight)
+                m_nMaxHeight = pOptions->nMaxHeight;
+            if (pOptions->rtPosition > 0)
+                m_rtPosition = pOptions->rtPosition;
+        }
+    }
+
+    HRESULT ProcessFile(UINT nFile, CCritSec *pLock) override;
+
+  private:
+    HRESULT DecodeKeyframe(const AVStream *st, const AVPacket *pkt, AVFrame *frame);
+    HRESULT ScaleFrame(const AVFrame *frame, LAVThumbnail *pThumb);
+
+  private:
+    const LPCWSTR *m_ppszFiles = nullptr;
+    LAVThumbnail *m_pResults = nullptr;
+
+    UINT m_nMaxWidth = THUMBNAIL_DEFAULT_WIDTH;
+    UINT m_nMaxHeight = THUMBNAIL_DEFAULT_HEIGHT;
+    REFERENCE_TIME m_rtPosition = 0;
+};
+
+HRESULT CThumbnailBatch::ProcessFile(UINT nFile, CCritSec *pLock)
+{
+    LAVThumbnail *pThumb = &m_pResults[nFile];
+    LPCWSTR pszFile = m_ppszFiles[nFile];
+    if (!pszFile)
+        return (pThumb->hr = E_POINTER);
+
+    const AVStream *st = nullptr;
+    AVPacket *pkt = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+
+    LARGE_INTEGER timer;
+    QueryPerformanceCounter(&timer);
+
+    CLAVFDemuxer *pDemuxer = new CLAVFDemuxer(pLock, m_pSettings);
+    pDemuxer->AddRef();
+
+    HRESULT hr = (pkt && frame) ? S_OK : E_OUTOFMEMORY;
+    if (SUCCEEDED(hr))
+        hr = pDemuxer->OpenProbe(pszFile, m_dwAnalyzeDuration, m_dwProbeSize);
+    pThumb->dOpenTime = GetElapsedMs(timer);
+
+    if (SUCCEEDED(hr))
+    {
+        REFERENCE_TIME rtPosition = m_rtPosition;
+        if (rtPosition == 0)
+            rtPosition = max(pDemuxer->GetDuration(), 0ll) / 10;
+
+        hr = pDemuxer->ReadThumbnailPacket(rtPosition, pkt, &st, &pThumb->rtFrame);
+        pThumb->dSeekTime = GetElapsedMs(timer);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = DecodeKeyframe(st, pkt, frame);
+        pThumb->dDecodeTime = GetElapsedMs(timer);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = ScaleFrame(frame, pThumb);
+        pThumb->dScaleTime = GetElapsedMs(timer);
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    pDemuxer->Release();
+
+    DbgLog((LOG_TRACE, 20,
+            L"CThumbnailBatch::ProcessFile(): %s, hr: 0x%x, open: %.1fms, seek: %.1fms, decode: %.1fms, scale: %.1fms",
+            pszFile, hr, pThumb->dOpenTime, pThumb->dSeekTime, pThumb->dDecodeTime, pThumb->dScaleTime));
+    return (pThumb->hr = hr);
+}
+
+HRESULT CThumbnailBatch::DecodeKeyframe(const AVStream *st, const AVPacket *pkt, AVFrame *frame)
+{
+    const AVCodec *codec = avcodec_find_decoder(st->codecpar->codec_id);
+    if (!codec)
+        return VFW_E_UNSUPPORTED_VIDEO;
+
+    AVCodecContext *ctx = avcodec_alloc_context3(codec);
+    if (!ctx)
+        return E_OUTOFMEMORY;
+
+    HRESULT hr = E_FAIL;
+    if (avcodec_parameters_to_context(ctx, st->codecpar) >= 0)
+    {
+        ctx->pkt_timebase = st->time_base;
+
+        // files are decoded in parallel, one thread per decoder avoids the frame threading delay
+        ctx->thread_count = 1;
+        ctx->skip_frame = AVDISCARD_NONKEY;
+        ctx->skip_loop_filter = AVDISCARD_ALL;
+        ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+
+        // Decode at the lowest resolution that is still larger than the thumbnail
+        int lowres = 0;
+        while (lowres < codec->max_lowres && (ctx->width >> (lowres + 1)) >= (int)m_nMaxWidth &&
+               (ctx->height >> (lowres + 1)) >= (int)m_nMaxHeight)
+            lowres++;
+        ctx->lowres = lowres;
+
+        // Send the keyframe followed by a drain, so decoders with a reorder delay output it right away
+        if (avcodec_open2(ctx, codec, nullptr) >= 0 && avcodec_send_packet(ctx, pkt) >= 0 &&
+            avcodec_send_packet(ctx, nullptr) >= 0 && avcodec_receive_frame(ctx, frame) >= 0)
+            hr = S_OK;
+    }
+
+    avcodec_free_context(&ctx);
+    return hr;
+}
+
+HRESULT CThumbnailBatch::ScaleFrame(const AVFrame *frame, LAVThumbnail *pThumb)
+{
+    if (frame->width <= 0 || frame->height <= 0)
+        return E_FAIL;
+
+    // Fit the display size into the thumbnail, without upscaling
+    int64_t dispWidth = frame->width, dispHeight = frame->height;
+    if (frame->sample_aspect_ratio.num > 0 && frame->sample_aspect_ratio.den > 0)
+        dispWidth = av_rescale(dispWidth, frame->sample_aspect_ratio.num, frame->sample_aspect_ratio.den);
+
+    double scale = min(1.0, min(m_nMaxWidth / (double)dispWidth, m_nMaxHeight / (double)dispHeight));
+    int width = max(1, (int)(dispWidth * scale + 0.5));
+    int height = max(1, (int)(dispHeight * scale + 0.5));
+
+    SwsContext *sws = sws_getContext(frame->width, frame->height, (AVPixelFormat)frame->format, width, height,
+                                     AV_PIX_FMT_BGRA, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws)
+        return E_FAIL;
+
+    HRESULT hr = S_OK;
+    int stride = width * 4;
+    BYTE *pData = (BYTE *)CoTaskMemAlloc((size_t)stride * height);
+    if (pData)
+    {
+        uint8_t *dst[4] = {pData};
+        int dstStride[4] = {stride};
+        sws_scale(sws, frame->data, frame->linesize, 0, frame->height, dst, dstStride);
+
+        pThumb->width = width;
+        pThumb->height = height;
+        pThumb->stride = stride;
+        pThumb->pData = pData;
+    }
+    else
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    sws_freeContext(sws);
+    return hr;
+}
+
+STDAPI LAVExtractThumbnails(const LPCWSTR *ppszFiles, UINT nFiles, const LAVThumbnailOptions *pOptions,
+                            LAVThumbnail *pResults, double *pdFilesPerSecond)
+{
+    CheckPointer(ppszFiles, E_POINTER);
+    CheckPointer(pResults, E_POINTER);
+
+    ZeroMemory(pResults, sizeof(LAVThumbnail) * nFiles);
+    for (UINT i = 0; i < nFiles; i++)
+        pResults[i].hr = E_ABORT;
+
+    if (pdFilesPerSecond)
+        *pdFilesPerSecond = 0.0;
+
+    if (nFiles == 0)
+        return S_OK;
+
+    CThumbnailBatch batch(ppszFiles, pOptions, pResults);
+
+    double secs = 0.0;
+    HRESULT hr = batch.Run(nFiles, pOptions ? pOptions->nConcurrency : 0, &secs);
+    if (FAILED(hr))
+        return hr;
+
+    UINT nFailed = 0;
+    double dOpen = 0.0, dSeek = 0.0, dDecode = 0.0, dScale = 0.0;
+    for (UINT i = 0; i < nFiles; i++)
+    {
+        if (FAILED(pResults[i].hr))
+            nFailed++;
+        dOpen += pResults[i].dOpenTime;
+        dSeek += pResults[i].dSeekTime;
+        dDecode += pResults[i].dDecodeTime;
+        dScale += pResults[i].dScaleTime;
+    }
+
+    double fps = secs > 0.0 ? nFiles / secs : 0.0;
+    DbgLog((LOG_TRACE, 10,
+            L"LAVExtractThumbnails(): %u files (%u failed) in %.3fs, %.1f files/s; avg open: %.1fms, seek: %.1fms, "
+            L"decode: %.1fms, scale: %.1fms",
+            nFiles, nFailed, secs, fps, dOpen / nFiles, dSeek / nFiles, dDecode / nFiles, dScale / nFiles));
+
+    if (pdFilesPerSecond)
+        *pdFilesPerSecond = fps;
+
+    return nFailed ? S_FALSE : S_OK;
+}
+
+STDAPI_(void) LAVFreeThumbnails(LAVThumbnail *pResults, UINT nFiles)
+{
+    if (!pResults)
+        return;
+
+    for (UINT i = 0; i < nFiles; i++)
+    {
+        SAFE_CO_FREE(pResults[i].pData);
+    }
+}
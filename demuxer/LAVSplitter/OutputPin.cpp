@@ -32,10 +32,12 @@ CLAVOutputPin::CLAVOutputPin(std::deque<CMediaType> &mts, LPCWSTR pName, CBaseFi
                              HRESULT *phr, CBaseDemuxer::StreamType pinType, const char *container)
     : CBaseOutputPin(NAME("lavf dshow output pin"), pFilter, pLock, phr, pName)
     , m_mts(mts)
+    , m_MemoryAccount(static_cast<CLAVSplitter *>(pFilter)->GetQueueMemoryInstance())
     , m_containerFormat(container)
     , m_pinType(pinType)
     , m_Parser(this, container)
 {
+    m_queue.SetMemoryAccount(&m_MemoryAccount);
     SetQueueSizes();
 }
 
@@ -365,11 +367,16 @@ HRESULT CLAVOutputPin::QueuePacket(Packet *pPacket)
 
     CLAVSplitter *pSplitter = static_cast<CLAVSplitter *>(m_pFilter);
 
+    m_MemoryAccount.SetWeight(m_BitRate.nCurrentBitRate, m_queue.Size() < m_nQueueLow);
+
     // While everything is good AND no pin is drying AND the queue is full .. sleep
     // The queue has a "soft" limit of MAX_PACKETS_IN_QUEUE, and a hard limit of MAX_PACKETS_IN_QUEUE * 16 (and a memory limit)
     // That means, even if one pin is drying, we'll never exceed MAX_PACKETS_IN_QUEUE * 16
-    while (S_OK == m_hrDeliver && (m_queue.DataSize() > m_nQueueMaxMem || m_queue.Size() > 16 * m_nQueueHigh ||
-                                   (m_queue.Size() > m_nQueueHigh && !pSplitter->IsAnyPinDrying())))
+    // Additionally, the queues of the instance share a memory budget, which throttles pins above their share.
+    // All pins are fed by the same thread, so like the soft limit, the budget is not enforced while any pin is drying.
+    while (S_OK == m_hrDeliver &&
+           (m_queue.DataSize() > m_nQueueMaxMem || m_queue.Size() > 16 * m_nQueueHigh ||
+            ((m_queue.Size() > m_nQueueHigh || m_MemoryAccount.IsOverBudget()) && !pSplitter->IsAnyPinDrying())))
         Sleep(10);
 
     if (S_OK != m_hrDeliver)
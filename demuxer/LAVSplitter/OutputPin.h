@@ -165,6 +165,7 @@ class CLAVOutputPin
   private:
     CCritSec m_csMT;
     std::deque<CMediaType> m_mts;
+    CQueueMemoryAccount m_MemoryAccount;
     CPacketQueue m_queue;
     CMediaType m_StreamMT;
 
@@ -79,8 +79,6 @@ STDMETHODIMP_(ULONG) CMediaPacketSample::Release()
         SAFE_DELETE(m_pPacket);
         SetPointer(nullptr, 0);
 
-        SAFE_DELETE(m_pSideData);
-
         /* This may cause us to be deleted */
         // Our refcount is reliably 0 thus no-one will mess with us
         m_pAllocator->ReleaseBuffer(this);
@@ -94,15 +92,6 @@ STDMETHODIMP CMediaPacketSample::SetPacket(Packet *pPacket)
     m_pPacket = pPacket;
     SetPointer(pPacket->GetData(), (LONG)pPacket->GetDataSize());
 
-    SAFE_DELETE(m_pSideData);
-
-    if (pPacket->GetNumSideData() > 0)
-    {
-        m_pSideData = new MediaSideDataFFMpeg();
-        m_pSideData->side_data = pPacket->GetSideData();
-        m_pSideData->side_data_elems = pPacket->GetNumSideData();
-    }
-
     return S_OK;
 }
 
@@ -113,9 +102,11 @@ STDMETHODIMP CMediaPacketSample::SetSideData(GUID guidType, const BYTE *pData, s
 
 STDMETHODIMP CMediaPacketSample::GetSideData(GUID guidType, const BYTE **pData, size_t *pSize)
 {
-    if (guidType == IID_MediaSideDataFFMpeg && m_pSideData)
+    // The side data is owned by the packet, which lives as long as the sample holds it
+    const MediaSideDataFFMpeg *pSideData = m_pPacket ? m_pPacket->GetMediaSideData() : nullptr;
+    if (guidType == IID_MediaSideDataFFMpeg && pSideData)
     {
-        *pData = (const BYTE *)m_pSideData;
+        *pData = (const BYTE *)pSideData;
         *pSize = sizeof(MediaSideDataFFMpeg);
 
         return S_OK;
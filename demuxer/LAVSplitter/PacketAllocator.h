@@ -54,7 +54,6 @@ class CMediaPacketSample
 
   protected:
     Packet *m_pPacket = nullptr;
-    MediaSideDataFFMpeg *m_pSideData = nullptr;
 };
 
 class CPacketAllocator
@@ -20,6 +20,7 @@
 #include "stdafx.h"
 #include "PacketQueue.h"
 #include "BaseDemuxer.h"
+#include "QueueMemoryBudget.h"
 
 // Queue a new packet at the end of the list
 void CPacketQueue::Queue(Packet *pPacket)
@@ -27,7 +28,11 @@ void CPacketQueue::Queue(Packet *pPacket)
     CAutoLock cAutoLock(this);
 
     if (pPacket)
+    {
         m_dataSize += (size_t)pPacket->GetDataSize();
+        if (m_pMemoryAccount)
+            m_pMemoryAccount->Add((size_t)pPacket->GetDataSize());
+    }
 
     m_queue.push_back(pPacket);
 }
@@ -45,7 +50,11 @@ Packet *CPacketQueue::Get()
     m_queue.pop_front();
 
     if (pPacket)
+    {
         m_dataSize -= (size_t)pPacket->GetDataSize();
+        if (m_pMemoryAccount)
+            m_pMemoryAccount->Remove((size_t)pPacket->GetDataSize());
+    }
 
     return pPacket;
 }
@@ -79,5 +88,8 @@ void CPacketQueue::Clear()
         delete *it;
     }
     m_queue.clear();
+
+    if (m_pMemoryAccount)
+        m_pMemoryAccount->Remove(m_dataSize);
     m_dataSize = 0;
 }
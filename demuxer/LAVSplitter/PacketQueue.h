@@ -24,6 +24,7 @@
 #define MIN_PACKETS_IN_QUEUE 50 // Below this is considered "drying pin"
 
 class Packet;
+class CQueueMemoryAccount;
 
 // FIFO Packet Queue
 class CPacketQueue : public CCritSec
@@ -46,6 +47,9 @@ class CPacketQueue : public CCritSec
     // Clear the List (all elements are free'ed)
     void Clear();
 
+    // Account the memory of all queued packets with the queue memory budget of the instance
+    void SetMemoryAccount(CQueueMemoryAccount *pAccount) { m_pMemoryAccount = pAccount; }
+
     // Get access to the internal queue
     std::deque<Packet *> *GetQueue() { return &m_queue; }
 
@@ -59,6 +63,7 @@ class CPacketQueue : public CCritSec
     // The actual storage class
     std::deque<Packet *> m_queue;
     size_t m_dataSize = 0;
+    CQueueMemoryAccount *m_pMemoryAccount = nullptr;
 
 #ifdef DEBUG
     bool m_bWarnedFull = false;
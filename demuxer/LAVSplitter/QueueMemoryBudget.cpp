@@ -0,0 +1,129 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stdafx.h"
+#include "QueueMemoryBudget.h"
+
+// Lower bound of the bitrate used for the weight, so idle or unknown streams still get a share
+#define QUEUE_MEMORY_MIN_BITRATE 64000
+
+// Memory held in the queues of all instances, for reporting only
+static volatile LONGLONG g_llCurrent = 0;
+static volatile LONGLONG g_llPeak = 0;
+
+static void UpdatePeak(volatile LONGLONG *pPeak, LONGLONG llValue)
+{
+    LONGLONG llPeak = *pPeak;
+    while (llValue > llPeak)
+    {
+        LONGLONG llPrev = InterlockedCompareExchange64(pPeak, llValue, llPeak);
+        if (llPrev == llPeak)
+            break;
+        llPeak = llPrev;
+    }
+}
+
+CQueueMemoryAccount::CQueueMemoryAccount(CQueueMemoryInstance *pInstance)
+    : m_pInstance(pInstance)
+{
+    m_Weight = QUEUE_MEMORY_MIN_BITRATE;
+    if (m_pInstance)
+    {
+        CAutoLock lock(&m_pInstance->m_csAccounts);
+        m_pInstance->m_TotalWeight += m_Weight;
+    }
+}
+
+CQueueMemoryAccount::~CQueueMemoryAccount()
+{
+    Remove((size_t)m_llCurrent);
+
+    if (m_pInstance)
+    {
+        CAutoLock lock(&m_pInstance->m_csAccounts);
+        m_pInstance->m_TotalWeight -= m_Weight;
+    }
+}
+
+void CQueueMemoryAccount::Add(size_t size)
+{
+    if (size == 0)
+        return;
+
+    InterlockedExchangeAdd64(&m_llCurrent, (LONGLONG)size);
+    UpdatePeak(&g_llPeak, InterlockedExchangeAdd64(&g_llCurrent, (LONGLONG)size) + (LONGLONG)size);
+    if (m_pInstance)
+    {
+        UpdatePeak(&m_pInstance->m_llPeak,
+                   InterlockedExchangeAdd64(&m_pInstance->m_llCurrent, (LONGLONG)size) + (LONGLONG)size);
+    }
+}
+
+void CQueueMemoryAccount::Remove(size_t size)
+{
+    if (size == 0)
+        return;
+
+    InterlockedExchangeAdd64(&m_llCurrent, -(LONGLONG)size);
+    InterlockedExchangeAdd64(&g_llCurrent, -(LONGLONG)size);
+    if (m_pInstance)
+        InterlockedExchangeAdd64(&m_pInstance->m_llCurrent, -(LONGLONG)size);
+}
+
+void CQueueMemoryAccount::SetWeight(DWORD dwBitRate, BOOL bDrying)
+{
+    UINT64 weight = max(dwBitRate, (DWORD)QUEUE_MEMORY_MIN_BITRATE);
+    if (bDrying)
+        weight *= 2;
+
+    if (weight == m_Weight || !m_pInstance)
+        return;
+
+    CAutoLock lock(&m_pInstance->m_csAccounts);
+    m_pInstance->m_TotalWeight = m_pInstance->m_TotalWeight - m_Weight + weight;
+    m_Weight = weight;
+}
+
+bool CQueueMemoryAccount::IsOverBudget() const
+{
+    if (!m_pInstance)
+        return false;
+
+    LONGLONG llCeiling = m_pInstance->m_llCeiling;
+    if (llCeiling <= 0 || m_pInstance->m_llCurrent <= llCeiling)
+        return false;
+
+    CAutoLock lock(&m_pInstance->m_csAccounts);
+
+    LONGLONG llShare = llCeiling;
+    if (m_pInstance->m_TotalWeight > 0)
+        llShare = (LONGLONG)((double)llCeiling * m_Weight / m_pInstance->m_TotalWeight);
+
+    return m_llCurrent > llShare;
+}
+
+size_t QueueMemoryBudget::GetCurrent()
+{
+    return (size_t)g_llCurrent;
+}
+
+size_t QueueMemoryBudget::GetPeak()
+{
+    return (size_t)g_llPeak;
+}
@@ -0,0 +1,76 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Queue memory of one splitter instance, the sum of all its pin accounts
+//
+// Every instance has its own budget, so the ceiling of one instance does not throttle the others.
+class CQueueMemoryInstance
+{
+  public:
+    // Set the ceiling of this instance in bytes, 0 to not limit the budget
+    void SetCeiling(size_t ceiling) { InterlockedExchange64(&m_llCeiling, (LONGLONG)ceiling); }
+
+    size_t GetCurrent() const { return (size_t)m_llCurrent; }
+    size_t GetPeak() const { return (size_t)m_llPeak; }
+
+  private:
+    friend class CQueueMemoryAccount;
+
+    CCritSec m_csAccounts;
+    UINT64 m_TotalWeight = 0;
+
+    volatile LONGLONG m_llCeiling = 0;
+    volatile LONGLONG m_llCurrent = 0;
+    volatile LONGLONG m_llPeak = 0;
+};
+
+// Queue memory of one output pin
+//
+// All accounts of an instance share its budget. Once the memory of all its queues exceeds the ceiling, accounts
+// holding more than their fair share are throttled. Shares are weighted by bitrate, and drying pins get a
+// larger share, so the pins that are about to run empty are not starved by the others.
+class CQueueMemoryAccount
+{
+  public:
+    CQueueMemoryAccount(CQueueMemoryInstance *pInstance);
+    ~CQueueMemoryAccount();
+
+    void Add(size_t size);
+    void Remove(size_t size);
+
+    // Update the weight of the account from its current bitrate (bits/s)
+    void SetWeight(DWORD dwBitRate, BOOL bDrying);
+
+    // Check if the instance is over its budget, and this account holds more than its fair share
+    bool IsOverBudget() const;
+
+  private:
+    CQueueMemoryInstance *m_pInstance = nullptr;
+    volatile LONGLONG m_llCurrent = 0;
+    UINT64 m_Weight = 0;
+};
+
+namespace QueueMemoryBudget
+{
+// Get the memory held in all packet queues of the process
+size_t GetCurrent();
+size_t GetPeak();
+} // namespace QueueMemoryBudget
@@ -110,6 +110,9 @@ HRESULT CStreamParser::Flush()
 {
     DbgLog((LOG_TRACE, 10, L"CStreamParser::Flush()"));
     SAFE_DELETE(m_pPacketBuffer);
+    m_AnnexBScanner.Reset();
+    m_nAnnexBScanPos = 0;
+    m_bAnnexBSynced = false;
     m_queue.Clear();
     m_bPGSDropState = FALSE;
     m_bHasAccessUnitDelimiters = false;
@@ -146,12 +149,6 @@ static Packet *InitPacket(Packet *pSource)
     return pNew;
 }
 
-#define MOVE_TO_H264_START_CODE(b, e)                                                                  \
-    while (b <= e - 4 && !((*(DWORD *)b == 0x01000000) || ((*(DWORD *)b & 0x00FFFFFF) == 0x00010000))) \
-        b++;                                                                                           \
-    if ((b <= e - 4) && *(DWORD *)b == 0x01000000)                                                     \
-        b++;
-
 HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
 {
     if (!m_pPacketBuffer)
@@ -161,21 +158,30 @@ HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
 
     m_pPacketBuffer->Append(pPacket);
 
-    BYTE *start = m_pPacketBuffer->GetData();
-    BYTE *end = start + m_pPacketBuffer->GetDataSize();
+    BYTE *data = m_pPacketBuffer->GetData();
+    BYTE *end = data + m_pPacketBuffer->GetDataSize();
 
-    MOVE_TO_H264_START_CODE(start, end);
+    // Once synced, the buffer starts with a start code. Only the data after the scan position is new, the scanner
+    // keeps track of a start code that is split between the buffered data and the new packet.
+    BYTE *start = m_bAnnexBSynced ? data : nullptr;
+    BYTE *scan = data + m_nAnnexBScanPos;
 
-    while (start <= end - 4)
+    for (;;)
     {
-        BYTE *next = start + 1;
+        ptrdiff_t offset = m_AnnexBScanner.Scan(scan, end - scan);
+        if (offset < 0)
+        {
+            scan = end;
+            break;
+        }
 
-        MOVE_TO_H264_START_CODE(next, end);
+        BYTE *next = scan + offset - 3;
+        scan += offset;
 
-        // End of buffer reached
-        if (next >= end - 4)
+        if (!start)
         {
-            break;
+            start = next;
+            continue;
         }
 
         size_t size = next - start;
@@ -252,10 +258,17 @@ HRESULT CStreamParser::ParseH264AnnexB(Packet *pPacket)
         start = next;
     }
 
-    if (start > m_pPacketBuffer->GetData())
+    // Without a start code, only keep the bytes a split start code can begin in
+    if (!start)
+        start = max(data, end - 2);
+    else
+        m_bAnnexBSynced = true;
+
+    if (start > data)
     {
-        m_pPacketBuffer->RemoveHead((int)(start - m_pPacketBuffer->GetData()));
+        m_pPacketBuffer->RemoveHead((int)(start - data));
     }
+    m_nAnnexBScanPos = scan - start;
 
     SAFE_DELETE(pPacket);
 
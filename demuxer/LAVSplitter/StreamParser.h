@@ -23,6 +23,7 @@
 
 #include "PacketQueue.h"
 #include "growarray.h"
+#include "StartCodeScanner.h"
 
 class CLAVOutputPin;
 
@@ -52,6 +53,9 @@ class CStreamParser
     GUID m_gSubtype = GUID_NULL;
 
     Packet *m_pPacketBuffer = nullptr;
+    CStartCodeScanner m_AnnexBScanner;
+    size_t m_nAnnexBScanPos = 0;
+    bool m_bAnnexBSynced = false;
 
     BOOL m_bPGSDropState = FALSE;
     GrowableArray<BYTE> m_pgsBuffer;
@@ -0,0 +1,130 @@
+/*
+ *      Copyright (C) 2010-2021 Hendrik Leppkes
+ *      http://www.1f0.de
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+// Probe API for media library scanning
+//
+// Reads the duration and stream information of files without creating a filter, using a bounded probe budget.
+// Attachments, chapters and stream parsers are not processed.
+//
+// Thumbnails are extracted from the nearest keyframe, which is decoded on its own at the lowest
+// resolution the decoder supports and scaled to the target size in one step.
+//
+// The functions are exported from LAVSplitter.ax, and can be loaded with GetProcAddress.
+
+typedef enum LAVProbeStreamType
+{
+    LAVProbeStream_Video,
+    LAVProbeStream_Audio,
+    LAVProbeStream_Subtitle,
+    LAVProbeStream_Other
+} LAVProbeStreamType;
+
+typedef struct LAVProbeStreamInfo
+{
+    LAVProbeStreamType type;
+    int id;             // container specific stream id
+    char codec[32];     // codec name
+    char language[16];  // language code as found in the file, empty if unknown
+    char title[128];    // stream title (UTF-8), empty if unknown
+    int width;          // video only
+    int height;         // video only
+    int channels;       // audio only
+    int sampleRate;     // audio only
+    __int64 bitRate;    // 0 if unknown
+    BOOL bDefault;
+    BOOL bForced;
+} LAVProbeStreamInfo;
+
+typedef struct LAVProbeFileInfo
+{
+    HRESULT hr;                   // result of the probe of this file
+    REFERENCE_TIME rtDuration;    // duration in 100ns units, 0 if unknown
+    char format[32];              // container format
+    UINT nStreams;
+    LAVProbeStreamInfo *pStreams; // allocated with CoTaskMemAlloc, free with LAVProbeFreeResults
+} LAVProbeFileInfo;
+
+typedef struct LAVProbeOptions
+{
+    UINT nConcurrency;        // number of files probed in parallel, 0 for the number of CPU cores
+    DWORD dwAnalyzeDuration;  // maximum duration of the stream analysis, in ms, 0 for the default (1000 ms)
+    DWORD dwProbeSize;        // maximum amount of data read for the stream analysis, in bytes, 0 for the default (2 MB)
+} LAVProbeOptions;
+
+// Probe a batch of files
+//  ppszFiles: array of nFiles file names
+//  pOptions: probe options, or NULL for the defaults
+//  pResults: array of nFiles entries, filled with the results for each file
+//  pdFilesPerSecond: optional, receives the throughput of the batch
+// Returns S_OK if all files were probed, S_FALSE if some failed (check hr of the individual results)
+STDAPI LAVProbeFiles(const LPCWSTR *ppszFiles, UINT nFiles, const LAVProbeOptions *pOptions,
+                     LAVProbeFileInfo *pResults, double *pdFilesPerSecond);
+
+// Free the stream information allocated by LAVProbeFiles
+STDAPI_(void) LAVProbeFreeResults(LAVProbeFileInfo *pResults, UINT nFiles);
+
+typedef HRESULT(STDAPICALLTYPE *PFN_LAVPROBEFILES)(const LPCWSTR *ppszFiles, UINT nFiles,
+                                                   const LAVProbeOptions *pOptions, LAVProbeFileInfo *pResults,
+                                                   double *pdFilesPerSecond);
+typedef void(STDAPICALLTYPE *PFN_LAVPROBEFREERESULTS)(LAVProbeFileInfo *pResults, UINT nFiles);
+
+typedef struct LAVThumbnailOptions
+{
+    UINT nConcurrency;          // number of files processed in parallel, 0 for the number of CPU cores
+    UINT nMaxWidth;             // maximum thumbnail width, 0 for the default (320)
+    UINT nMaxHeight;            // maximum thumbnail height, 0 for the default (180)
+    REFERENCE_TIME rtPosition;  // position of the thumbnail, in 100ns units, 0 for the default (10% of the duration)
+    DWORD dwAnalyzeDuration;    // see LAVProbeOptions
+    DWORD dwProbeSize;          // see LAVProbeOptions
+} LAVThumbnailOptions;
+
+typedef struct LAVThumbnail
+{
+    HRESULT hr;                 // result of the thumbnail extraction of this file
+    UINT width;
+    UINT height;
+    UINT stride;                // in bytes
+    BYTE *pData;                // 32-bit BGRA, top-down, allocated with CoTaskMemAlloc, free with LAVFreeThumbnails
+    REFERENCE_TIME rtFrame;     // timestamp of the decoded keyframe
+
+    // time spent in each stage, in ms
+    double dOpenTime;
+    double dSeekTime;
+    double dDecodeTime;
+    double dScaleTime;
+} LAVThumbnail;
+
+// Extract a thumbnail from a batch of files
+//  ppszFiles: array of nFiles file names
+//  pOptions: thumbnail options, or NULL for the defaults
+//  pResults: array of nFiles entries, filled with the thumbnail of each file
+//  pdFilesPerSecond: optional, receives the throughput of the batch
+// Returns S_OK if all thumbnails were extracted, S_FALSE if some failed (check hr of the individual results)
+STDAPI LAVExtractThumbnails(const LPCWSTR *ppszFiles, UINT nFiles, const LAVThumbnailOptions *pOptions,
+                            LAVThumbnail *pResults, double *pdFilesPerSecond);
+
+// Free the image data allocated by LAVExtractThumbnails
+STDAPI_(void) LAVFreeThumbnails(LAVThumbnail *pResults, UINT nFiles);
+
+typedef HRESULT(STDAPICALLTYPE *PFN_LAVEXTRACTTHUMBNAILS)(const LPCWSTR *ppszFiles, UINT nFiles,
+                                                          const LAVThumbnailOptions *pOptions,
+                                                          LAVThumbnail *pResults, double *pdFilesPerSecond);
+typedef void(STDAPICALLTYPE *PFN_LAVFREETHUMBNAILS)(LAVThumbnail *pResults, UINT nFiles);
@@ -201,6 +201,47 @@ interface __declspec(uuid("774A919D-EA95-4A87-8A1E-F48ABE8499C7")) ILAVFSettings
 
     // Query if LAV Splitter should reselect subs based on given rules when audio stream is changed
     STDMETHOD_(BOOL, GetStreamSwitchReselectSubtitles)() = 0;
+
+    // Set if LAV Splitter should switch audio streams without interrupting playback
+    // This demuxes all audio streams and keeps their most recent packets in memory, which counts towards the
+    // queue memory limit of the instance
+    STDMETHOD(SetInstantAudioSwitch)(BOOL bEnabled) = 0;
+
+    // Query if LAV Splitter should switch audio streams without interrupting playback
+    STDMETHOD_(BOOL, GetInstantAudioSwitch)() = 0;
+
+    // Set the maximum memory used by the queues of all pins of this LAV Splitter instance, in megabytes
+    // Pins holding more than their share are throttled once it is exceeded, unless a pin is running dry
+    // 0 disables the limit
+    STDMETHOD(SetMaxGlobalQueueMemSize)(DWORD dwMaxSize) = 0;
+
+    // Get the maximum memory used by the queues of all pins of this LAV Splitter instance, in megabytes
+    STDMETHOD_(DWORD, GetMaxGlobalQueueMemSize)() = 0;
+
+    // Get the current and peak memory used by the queues of this instance, in bytes
+    STDMETHOD(GetQueueMemoryUsage)(ULONGLONG *pCurrent, ULONGLONG *pPeak) = 0;
+
+    // Set if LAV Splitter should read the head of the next clip of a Blu-ray playlist ahead of the clip transition
+    // Discs on optical drives and network paths are never prefetched, as it would seek away from the playing clip
+    STDMETHOD(SetBDClipPrefetch)(BOOL bEnabled) = 0;
+
+    // Query if LAV Splitter should read the head of the next clip of a Blu-ray playlist ahead of the clip transition
+    STDMETHOD_(BOOL, GetBDClipPrefetch)() = 0;
+
+    // Get the statistics of the clip transitions of the current Blu-ray title
+    //  pnTransitions: number of clip transitions
+    //  pnPrefetched: transitions to a prefetched clip
+    //  pdAvgGap, pdMaxGap: average and maximum time between the last packet of a clip and the first of the next, in ms
+    // Returns E_NOTIMPL if no Blu-ray is being played
+    STDMETHOD(GetBDClipTransitionStatus)(ULONGLONG *pnTransitions, ULONGLONG *pnPrefetched, double *pdAvgGap,
+                                         double *pdMaxGap) = 0;
+
+    // Set if LAV Splitter should read the audio of poorly interleaved local AVI/MP4 files through a second file handle
+    // This avoids seeking back and forth between the audio and video data, the setting applies to newly opened files
+    STDMETHOD(SetSeparateAudioReading)(BOOL bEnabled) = 0;
+
+    // Query if LAV Splitter should read the audio of poorly interleaved AVI/MP4 files through a second file handle
+    STDMETHOD_(BOOL, GetSeparateAudioReading)() = 0;
 };
 
 [uuid("77C1027F-BF53-458F-82CE-9DD88A2C300B")]
@@ -214,6 +214,69 @@ typedef enum LAVDitherMode
     LAVDither_Random
 } LAVDitherMode;
 
+// Quality levels of the adaptive quality control, used when software decoding can't keep up with playback
+// Every level includes the measures of the previous levels.
+typedef enum LAVQualityLevel
+{
+    LAVQualityLevel_Full,           // all frames are fully decoded
+    LAVQualityLevel_SkipLoopFilter, // skip the loop filter on non-reference frames
+    LAVQualityLevel_SkipNonRef,     // skip decoding of non-reference frames
+    LAVQualityLevel_DropLate,       // drop decoded frames that are already late, instead of converting them
+    LAVQualityLevel_KeyframesOnly,  // only decode keyframes
+
+    LAVQualityLevel_NB // Number of levels
+} LAVQualityLevel;
+
+// Quality control statistics, since the current stream was opened
+typedef struct LAVQualityStatus
+{
+    LAVQualityLevel level;                      // current quality level
+    ULONGLONG nFrames[LAVQualityLevel_NB];      // frames decoded at each level
+    ULONGLONG nEscalations[LAVQualityLevel_NB]; // number of times each level was entered because of overload
+    ULONGLONG nDroppedLate;                     // frames dropped before conversion
+} LAVQualityStatus;
+
+// Stages of the video pipeline, measured per frame or input sample
+typedef enum LAVPipelineStage
+{
+    LAVPipelineStage_Parse,      // input parsing and packet preparation in the decoder
+    LAVPipelineStage_Decode,     // sending packets to the decoder and receiving frames
+    LAVPipelineStage_Filter,     // software deinterlacing
+    LAVPipelineStage_Convert,    // pixel format conversion into the output sample
+    LAVPipelineStage_Subtitles,  // subtitle rendering and blending
+    LAVPipelineStage_OutputWait, // waiting for an output sample from the downstream allocator
+    LAVPipelineStage_Deliver,    // delivery to the downstream filter
+
+    LAVPipelineStage_NB // Number of stages
+} LAVPipelineStage;
+
+// Histogram buckets of the stage timings
+// Bucket 0 counts durations below 0.125 ms, every following bucket doubles the limit, the last bucket counts the rest.
+#define LAV_PIPELINE_HISTOGRAM_BUCKETS 12
+
+typedef struct LAVPipelineStageStats
+{
+    ULONGLONG nSamples;                                   // number of measurements
+    double dAverage;                                      // moving average, in ms
+    double dMax;                                          // maximum, in ms
+    double dTotal;                                        // total time spent in the stage, in ms
+    ULONGLONG nHistogram[LAV_PIPELINE_HISTOGRAM_BUCKETS]; // distribution of the measurements
+} LAVPipelineStageStats;
+
+// Frame cache statistics, since the filter was created
+typedef struct LAVFrameCacheStatus
+{
+    ULONGLONG nLookups;       // seeks checked against the cache
+    ULONGLONG nHits;          // seeks served from the cache
+    ULONGLONG nFramesStored;  // frames stored in the cache
+    ULONGLONG nFramesServed;  // frames delivered from the cache instead of the decoder
+    UINT nFrames;             // frames currently in the cache
+    ULONGLONG nBytes;         // memory used by the cached frames
+    ULONGLONG nPeakBytes;     // maximum memory used by the cached frames
+    REFERENCE_TIME rtStart;   // stream time range of the cached frames, 0 if empty
+    REFERENCE_TIME rtStop;
+} LAVFrameCacheStatus;
+
 // LAV Video configuration interface
 interface __declspec(uuid("FA40D6E9-4D38-4761-ADD2-71A9EC5FD32F")) ILAVVideoSettings : public IUnknown
 {
@@ -409,6 +472,46 @@ interface __declspec(uuid("FA40D6E9-4D38-4761-ADD2-71A9EC5FD32F")) ILAVVideoSett
 
     //  Enable the creation of the Closed Caption output pin
     STDMETHOD(SetEnableCCOutputPin)(BOOL bEnabled) = 0;
+
+    // Convert and deliver decoded frames on a separate thread, while the next frame is being decoded
+    // Takes effect when streaming starts, and disables direct decoder output. Has no effect in low-latency mode.
+    STDMETHOD(SetPipelinedDelivery)(BOOL bEnabled) = 0;
+    STDMETHOD_(BOOL, GetPipelinedDelivery)() = 0;
+
+    // Set the number of threads shared by the software decoders of all LAV Video instances in the process
+    // Decoders with an automatic thread count (see SetNumThreads) get a share weighted by the resolution and codec
+    // of their stream. Changes apply when decoders are initialized, or re-initialized on seeking.
+    //  0 = Number of CPU cores (default)
+    STDMETHOD(SetThreadBudget)(DWORD dwNum) = 0;
+    STDMETHOD_(DWORD, GetThreadBudget)() = 0;
+
+    // Adaptively reduce the decoding quality when software decoding can't keep up with playback
+    // The load is measured from the decoding time and the lateness reported by the renderer, see LAVQualityLevel for
+    // the steps taken. Full quality is restored once decoding keeps up again. (Default: Off)
+    STDMETHOD(SetQualityControl)(BOOL bEnabled) = 0;
+    STDMETHOD_(BOOL, GetQualityControl)() = 0;
+
+    // Low-latency mode for live sources
+    // Uses slice threading instead of frame threading, disables the reordering delay for streams without B-frames,
+    // delivers frames without the delivery pipeline and uses a deinterlacer without lookahead (always one frame per
+    // two fields). Takes effect when the decoder is initialized.
+    STDMETHOD(SetLowLatency)(BOOL bEnabled) = 0;
+    STDMETHOD_(BOOL, GetLowLatency)() = 0;
+
+    // Reduced-resolution preview decoding, for scrubbing previews and multiviewer tiles
+    // The software decoder reduces the resolution by powers of two (up to 1/8), as long as the picture stays at least
+    // dwHeight lines tall. Codecs with lowres support (ie. MPEG-1/2, MJPEG) decode at the reduced resolution, for other
+    // codecs the loop filter is skipped and the frames are decimated by the pixel format conversion.
+    // Set to 0 to disable (default). Takes effect when the decoder is initialized.
+    STDMETHOD(SetPreviewHeight)(DWORD dwHeight) = 0;
+    STDMETHOD_(DWORD, GetPreviewHeight)() = 0;
+
+    // Cache the converted frames of the most recent GOP, up to the given amount of memory (in MB)
+    // Seeks to a frame in the cached range, ie. stepping backwards frame by frame, are served from the cache
+    // instead of decoding the GOP again. Only software decoded frames without subtitles are cached.
+    // Set to 0 to disable (default).
+    STDMETHOD(SetFrameCacheSize)(DWORD dwSizeMB) = 0;
+    STDMETHOD_(DWORD, GetFrameCacheSize)() = 0;
 };
 
 [uuid("F3BB90A3-B1CE-48C1-954C-3A506A33DE25")]
@@ -426,4 +529,58 @@ interface __declspec(uuid("1CC2385F-36FA-41B1-9942-5024CE0235DC")) ILAVVideoStat
 
     // Get the name of the currently active hwaccel device
     STDMETHOD(GetHWAccelActiveDevice)(BSTR * pstrDeviceName) = 0;
+
+    // Get the state of the process-wide decoder thread budget
+    //  pnBudget: threads in the budget
+    //  pnDecoders: software decoders sharing the budget
+    //  pnAllotted: threads allotted to all decoders
+    //  pnThreads: threads allotted to the decoder of this instance, 0 if it does not use the budget
+    STDMETHOD(GetThreadBudgetStatus)(int *pnBudget, int *pnDecoders, int *pnAllotted, int *pnThreads) = 0;
+
+    // Get the state and statistics of the adaptive quality control
+    STDMETHOD(GetQualityControlStatus)(LAVQualityStatus *pStatus) = 0;
+
+    // Get the latency from the arrival of an input sample to the delivery of its frame, in 100ns units
+    // Only measured in low-latency mode.
+    //  prtLast: latency of the last frame
+    //  prtAverage, prtMax: average and maximum latency since the decoder was initialized
+    //  pnFrames: number of frames measured
+    STDMETHOD(GetLatencyStatus)(REFERENCE_TIME *prtLast, REFERENCE_TIME *prtAverage, REFERENCE_TIME *prtMax,
+                                ULONGLONG *pnFrames) = 0;
+
+    // Get the statistics of input format changes
+    //  pnSwitches: number of format changes
+    //  pnReused: format changes which kept the existing decoder
+    //  pdAvgTime: average time spent re-initializing per format change, in ms
+    STDMETHOD(GetFormatSwitchStatus)(ULONGLONG *pnSwitches, ULONGLONG *pnReused, double *pdAvgTime) = 0;
+
+    // Get the statistics of the frame cache (see ILAVVideoSettings::SetFrameCacheSize)
+    // The hit rate is nHits / nLookups.
+    STDMETHOD(GetFrameCacheStatus)(LAVFrameCacheStatus *pStatus) = 0;
+
+    // Get the time from a seek (or the start of playback) to the delivery of the first frame
+    //  pnSeeks: number of seeks measured
+    //  pdLastTime, pdAvgTime: time of the last seek and average time, in ms
+    //  pnPrerollFrames: frames decoded before the seek target in the last seek, which are not shown
+    STDMETHOD(GetSeekStatus)(ULONGLONG *pnSeeks, double *pdLastTime, double *pdAvgTime, ULONGLONG *pnPrerollFrames) = 0;
+
+    // Get the throughput of the stages of the pipelined delivery (see ILAVVideoSettings::SetPipelinedDelivery)
+    // The statistics are reset when streaming starts, and all zero if the pipelined delivery is not used.
+    //  pnFrames: number of frames delivered
+    //  pdDecodeFps: frames per second the decoder could produce, excluding waits for the delivery thread
+    //  pdConvertFps: frames per second of the conversion and subtitle blending on the delivery thread
+    //  pdDownstreamFps: frames per second accepted by the downstream filter
+    STDMETHOD(GetPipelinedDeliveryStatus)(ULONGLONG *pnFrames, double *pdDecodeFps, double *pdConvertFps,
+                                          double *pdDownstreamFps) = 0;
+};
+
+// LAV Video pipeline timing interface
+// The timings are always measured, and reset when a new decoder is created.
+interface __declspec(uuid("C25ED948-CB03-4DC9-8A35-1A0B23E95065")) ILAVVideoPipelineStats : public IUnknown
+{
+    // Get the timing statistics of one stage of the pipeline
+    STDMETHOD(GetStageStats)(LAVPipelineStage stage, LAVPipelineStageStats *pStats) = 0;
+
+    // Reset the statistics of all stages
+    STDMETHOD(ResetStageStats)() = 0;
 };